@@ -0,0 +1,180 @@
+/*
+
+  This benchmark compares the byte-at-a-time loops the OPL parser used to
+  find the end of fields and to parse integers with the vectorized versions
+  from opl_scan.hpp. It also measures the throughput of the complete OPL
+  line parser. All data is generated, the benchmark doesn't read any files.
+
+  The code in this file is released into the Public Domain.
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <osmium/io/detail/opl_parser_functions.hpp>
+#include <osmium/io/detail/opl_scan.hpp>
+#include <osmium/memory/buffer.hpp>
+
+namespace scan = osmium::io::detail::opl_scan;
+
+const int runs = 5;
+const int num_lines = 200000;
+
+// The way opl_parse_string() worked before the vectorized version.
+void old_parse_string(const char** data, std::string& result) {
+    const char* s = *data;
+    while (true) {
+        if (*s == '\0' || *s == ' ' || *s == '\t' || *s == ',' || *s == '=') {
+            break;
+        } else if (*s == '%') {
+            ++s;
+            osmium::io::detail::opl_parse_escaped(&s, result);
+        } else {
+            result += *s;
+            ++s;
+        }
+    }
+    *data = s;
+}
+
+// The way opl_parse_int() worked before the vectorized version (without
+// the sign and range checks which are the same in both versions).
+int64_t old_parse_int(const char** s) {
+    int64_t value = 0;
+    while (**s >= '0' && **s <= '9') {
+        value *= 10;
+        value += **s - '0';
+        ++*s;
+    }
+    return value;
+}
+
+int64_t new_parse_int(const char** s) {
+    const char* end = scan::find_digits_end(*s);
+    const auto value = static_cast<int64_t>(scan::digits_to_uint(*s, end));
+    *s = end;
+    return value;
+}
+
+std::vector<std::string> make_lines() {
+    std::vector<std::string> lines;
+    lines.reserve(num_lines);
+    for (int i = 0; i < num_lines; ++i) {
+        std::string line{"n"};
+        line += std::to_string(4000000000LL + i * 7919LL);
+        line += " v";
+        line += std::to_string(i % 17 + 1);
+        line += " dV c";
+        line += std::to_string(50000000 + i);
+        line += " t2017-08-25T12:34:56Z i";
+        line += std::to_string(100000 + i % 5000);
+        line += " uSome%20%User%20%Name Thighway=residential,name=Hauptstra%df%e,source=survey,note=some%20%longer%20%text%20%to%20%look%20%at x";
+        line += std::to_string(8 + (i % 1000) / 1000.0);
+        line += " y";
+        line += std::to_string(49 + (i % 777) / 1000.0);
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+std::size_t total_size(const std::vector<std::string>& lines) {
+    std::size_t size = 0;
+    for (const auto& line : lines) {
+        size += line.size();
+    }
+    return size;
+}
+
+template <typename TFunc>
+void benchmark(const char* name, std::size_t bytes, TFunc&& func) {
+    double min = std::numeric_limits<double>::max();
+    for (int run = 0; run < runs; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const auto end = std::chrono::steady_clock::now();
+        min = std::min(min, std::chrono::duration<double>(end - start).count());
+    }
+    std::cout << name << " time=" << (min * 1000) << "ms throughput="
+              << (static_cast<double>(bytes) / min / (1024 * 1024)) << "MB/s\n";
+}
+
+int main(int argc, char* /*argv*/[]) {
+    if (argc != 1) {
+        std::cerr << "Usage: osmium_benchmark_opl_scan\n";
+        std::exit(1);
+    }
+
+    auto lines = make_lines();
+    const std::size_t bytes = total_size(lines);
+
+    // Each line is parsed as a sequence of strings separated by single
+    // characters. This touches every byte of the line.
+    std::size_t check = 0;
+    const auto strings = [&lines, &check](void (*parse)(const char**, std::string&)) {
+        std::string str;
+        for (const auto& line : lines) {
+            const char* s = line.c_str();
+            while (*s) {
+                str.clear();
+                parse(&s, str);
+                check += str.size();
+                if (*s) {
+                    ++s;
+                }
+            }
+        }
+    };
+    benchmark("parse_string old", bytes, [&]() { strings(old_parse_string); });
+    benchmark("parse_string new", bytes, [&]() { strings(osmium::io::detail::opl_parse_string); });
+
+    const auto sections = [&lines, &check](const char* (*find)(const char*)) {
+        for (const auto& line : lines) {
+            const char* s = line.c_str();
+            while (*s) {
+                s = find(s);
+                ++check;
+                if (*s) {
+                    ++s;
+                }
+            }
+        }
+    };
+    benchmark("skip_section old", bytes, [&]() { sections(scan::scalar_find_section_end); });
+    benchmark("skip_section new", bytes, [&]() { sections(scan::find_section_end); });
+
+    std::vector<std::string> ints;
+    std::size_t int_bytes = 0;
+    for (int i = 0; i < num_lines * 5; ++i) {
+        ints.push_back(std::to_string(static_cast<int64_t>(i) * 2654435761LL % 100000000000LL));
+        int_bytes += ints.back().size();
+    }
+    const auto integers = [&ints, &check](int64_t (*parse)(const char**)) {
+        for (const auto& str : ints) {
+            const char* s = str.c_str();
+            check += static_cast<std::size_t>(parse(&s));
+        }
+    };
+    benchmark("parse_int old   ", int_bytes, [&]() { integers(old_parse_int); });
+    benchmark("parse_int new   ", int_bytes, [&]() { integers(new_parse_int); });
+
+    benchmark("parse_line      ", bytes, [&]() {
+        osmium::memory::Buffer buffer{10 * 1024 * 1024};
+        uint64_t line_count = 0;
+        for (const auto& line : lines) {
+            osmium::io::detail::opl_parse_line(line_count++, line.c_str(), buffer);
+            if (buffer.committed() > 9 * 1024 * 1024) {
+                buffer.clear();
+            }
+        }
+    });
+
+    // Make sure the compiler can't optimize the work away.
+    std::cerr << "check=" << check << "\n";
+}
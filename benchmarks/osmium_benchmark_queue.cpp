@@ -0,0 +1,80 @@
+/*
+
+  This benchmark compares the mutex-based osmium::thread::Queue with the
+  lock-free SPSCQueue and MPMCQueue. It pushes small items through each
+  queue from some producer threads to some consumer threads and reports the
+  best time of several runs.
+
+  The code in this file is released into the Public Domain.
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <osmium/thread/lockfree_queue.hpp>
+#include <osmium/thread/queue.hpp>
+
+const int runs = 5;
+const std::size_t queue_size = 20;
+const int items = 1000000;
+
+template <typename TQueue>
+double run_once(int producers, int consumers) {
+    TQueue queue{queue_size, "benchmark"};
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, producers]() {
+            for (int i = 0; i < items / producers; ++i) {
+                queue.push(i);
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&queue, producers, consumers]() {
+            for (int i = 0; i < (items / producers) * producers / consumers; ++i) {
+                int value;
+                queue.wait_and_pop(value);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename TQueue>
+void benchmark(const char* name, int producers, int consumers) {
+    double min = std::numeric_limits<double>::max();
+    for (int run = 0; run < runs; ++run) {
+        min = std::min(min, run_once<TQueue>(producers, consumers));
+    }
+    std::cout << name << " producers=" << producers << " consumers=" << consumers
+              << " items=" << items << " time=" << min << "ms\n";
+}
+
+int main(int argc, char* /*argv*/[]) {
+    if (argc != 1) {
+        std::cerr << "Usage: osmium_benchmark_queue\n";
+        std::exit(1);
+    }
+
+    benchmark<osmium::thread::Queue<int>>("mutex", 1, 1);
+    benchmark<osmium::thread::SPSCQueue<int>>("spsc ", 1, 1);
+    benchmark<osmium::thread::MPMCQueue<int>>("mpmc ", 1, 1);
+
+    benchmark<osmium::thread::Queue<int>>("mutex", 4, 4);
+    benchmark<osmium::thread::MPMCQueue<int>>("mpmc ", 4, 4);
+}
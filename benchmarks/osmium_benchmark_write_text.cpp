@@ -0,0 +1,51 @@
+/*
+
+  This benchmark reads the input file into memory completely and then
+  writes it out in the given output format to /dev/null, measuring only
+  the time needed for writing. Use it to measure the encoding of the text
+  formats (opl, osm, debug) which runs in parallel in the pool threads, on
+  its own or together with compression (for instance osm.bz2).
+
+  The code in this file is released into the Public Domain.
+
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <osmium/io/any_input.hpp>
+#include <osmium/io/any_output.hpp>
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " INPUT-FILE FORMAT\n";
+        std::exit(1);
+    }
+
+    const std::string input_filename{argv[1]};
+    const std::string format{argv[2]};
+
+    std::vector<osmium::memory::Buffer> buffers;
+    osmium::io::Reader reader{input_filename};
+    while (osmium::memory::Buffer buffer = reader.read()) {
+        buffers.push_back(std::move(buffer));
+    }
+    reader.close();
+
+    const auto start = std::chrono::steady_clock::now();
+
+    osmium::io::File output_file{"/dev/null", format};
+    osmium::io::Header header;
+    osmium::io::Writer writer{output_file, header, osmium::io::overwrite::allow};
+    for (auto& buffer : buffers) {
+        writer(std::move(buffer));
+    }
+    writer.close();
+
+    const auto end = std::chrono::steady_clock::now();
+    std::cout << format << " " << std::chrono::duration<double, std::milli>(end - start).count() << "ms\n";
+}
@@ -0,0 +1,16 @@
+#!/bin/sh
+#
+#  run_benchmark_opl_scan.sh
+#
+
+set -e
+
+BENCHMARK_NAME=opl_scan
+
+. @CMAKE_BINARY_DIR@/benchmarks/setup.sh
+
+CMD=$OB_DIR/osmium_benchmark_$BENCHMARK_NAME
+
+# This benchmark doesn't use the data files.
+$CMD
+
@@ -0,0 +1,16 @@
+#!/bin/sh
+#
+#  run_benchmark_queue.sh
+#
+
+set -e
+
+BENCHMARK_NAME=queue
+
+. @CMAKE_BINARY_DIR@/benchmarks/setup.sh
+
+CMD=$OB_DIR/osmium_benchmark_$BENCHMARK_NAME
+
+# This benchmark doesn't use the data files.
+$CMD
+
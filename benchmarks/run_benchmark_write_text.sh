@@ -0,0 +1,28 @@
+#!/bin/sh
+#
+#  run_benchmark_write_text.sh
+#
+#  Will read the input file into memory completely and then write it to
+#  /dev/null in several text formats. The benchmark program reports the time
+#  needed for writing only, the times reported by the time command include
+#  reading.
+#
+
+set -e
+
+BENCHMARK_NAME=write_text
+
+. @CMAKE_BINARY_DIR@/benchmarks/setup.sh
+
+CMD=$OB_DIR/osmium_benchmark_$BENCHMARK_NAME
+
+echo "# file size num mem time cpu_kernel cpu_user cpu_percent cmd options"
+for data in $OB_DATA_FILES; do
+    filename=`basename $data`
+    filesize=`stat --format="%s" --dereference $data`
+    for format in opl osm debug osm.bz2; do
+        for n in $OB_SEQ; do
+            $OB_TIME_CMD -f "$filename $filesize $n $OB_TIME_FORMAT" $CMD $data $format 2>&1 | sed -e "s%$DATA_DIR/%%" | sed -e "s%$OB_DIR/%%"
+        done
+    done
+done
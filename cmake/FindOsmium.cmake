@@ -28,6 +28,8 @@
 #    following components:
 #
 #      pbf        - include libraries needed for PBF input and output
+#                   (lz4 and zstd blob compression is enabled if those
+#                   libraries are found)
 #      xml        - include libraries needed for XML input and output
 #      io         - include libraries needed for any type of input/output
 #      geos       - include if you want to use any of the GEOS functions
@@ -138,6 +140,25 @@ if(Osmium_USE_PBF)
     else()
         message(WARNING "Osmium: Can not find some libraries for PBF input/output, please install them or configure the paths.")
     endif()
+
+    # Optional lz4 and zstd support for PBF blobs
+    find_path(LZ4_INCLUDE_DIR lz4.h)
+    find_library(LZ4_LIBRARY NAMES lz4)
+    if(LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+        message(STATUS "Osmium: Found lz4, enabling lz4 compression for PBF blobs")
+        add_definitions(-DOSMIUM_WITH_LZ4)
+        list(APPEND OSMIUM_PBF_LIBRARIES ${LZ4_LIBRARY})
+        list(APPEND OSMIUM_INCLUDE_DIRS ${LZ4_INCLUDE_DIR})
+    endif()
+
+    find_path(ZSTD_INCLUDE_DIR zstd.h)
+    find_library(ZSTD_LIBRARY NAMES zstd)
+    if(ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+        message(STATUS "Osmium: Found zstd, enabling zstd compression for PBF blobs")
+        add_definitions(-DOSMIUM_WITH_ZSTD)
+        list(APPEND OSMIUM_PBF_LIBRARIES ${ZSTD_LIBRARY})
+        list(APPEND OSMIUM_INCLUDE_DIRS ${ZSTD_INCLUDE_DIR})
+    endif()
 endif()
 
 #----------------------------------------------------------------------
@@ -33,17 +33,24 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <algorithm>
+#include <cstddef>
+#include <future>
 #include <limits>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <osmium/handler.hpp>
 #include <osmium/index/index.hpp>
 #include <osmium/index/map/dummy.hpp>
+#include <osmium/memory/buffer.hpp>
 #include <osmium/osm/location.hpp>
 #include <osmium/osm/node.hpp>
 #include <osmium/osm/node_ref.hpp>
 #include <osmium/osm/types.hpp>
 #include <osmium/osm/way.hpp>
+#include <osmium/thread/pool.hpp>
 
 #include <osmium/index/node_locations_map.hpp>
 
@@ -89,6 +96,25 @@ namespace osmium {
 
             bool m_must_sort = false;
 
+            // Batches of ways are only split into several tasks for the
+            // pool threads if each task gets at least this many node refs.
+            enum constant_min_node_refs_per_task : std::size_t {
+                min_node_refs_per_task = 16 * 1024
+            };
+
+            // Lookup of the locations for a range of ways in a batch.
+            struct lookup_task {
+
+                const NodeLocationsForWays* handler;
+                osmium::Way* const* first;
+                osmium::Way* const* last;
+
+                std::size_t operator()() const {
+                    return handler->set_locations(first, last);
+                }
+
+            }; // struct lookup_task
+
             // It is okay to have this static dummy instance, even when using several threads,
             // because it is read-only.
             static dummy_type& get_dummy() {
@@ -96,6 +122,126 @@ namespace osmium {
                 return instance;
             }
 
+            void sort_if_needed() {
+                if (m_must_sort) {
+                    m_storage_pos.sort();
+                    m_storage_neg.sort();
+                    m_must_sort = false;
+                    m_last_id = std::numeric_limits<osmium::unsigned_object_id_type>::max();
+                }
+            }
+
+            /**
+             * Set the locations of all node refs in the ways in the range.
+             * The node refs are sorted by id and each id is looked up only
+             * once using get_noexcept_batch() of the indexes. So the index
+             * is accessed in order and, for indexes supporting this, pages
+             * of memory mapped indexes are requested ahead of time.
+             *
+             * @returns The number of node refs without location.
+             */
+            std::size_t set_locations(osmium::Way* const* first, osmium::Way* const* last) const {
+                std::vector<std::pair<osmium::object_id_type, osmium::NodeRef*>> refs;
+                for (auto it = first; it != last; ++it) {
+                    for (auto& node_ref : (*it)->nodes()) {
+                        refs.emplace_back(node_ref.ref(), &node_ref);
+                    }
+                }
+
+                std::sort(refs.begin(), refs.end(), [](const std::pair<osmium::object_id_type, osmium::NodeRef*>& a,
+                                                       const std::pair<osmium::object_id_type, osmium::NodeRef*>& b) {
+                    return a.first < b.first;
+                });
+
+                // Negative ids come first in the sorted order.
+                std::vector<osmium::unsigned_object_id_type> ids;
+                ids.reserve(refs.size());
+                std::size_t num_neg = 0;
+                for (std::size_t i = 0; i < refs.size(); ++i) {
+                    if (i == 0 || refs[i].first != refs[i - 1].first) {
+                        const auto id = refs[i].first;
+                        if (id >= 0) {
+                            ids.push_back(static_cast<osmium::unsigned_object_id_type>( id));
+                        } else {
+                            ids.push_back(static_cast<osmium::unsigned_object_id_type>(-id));
+                            ++num_neg;
+                        }
+                    }
+                }
+
+                std::vector<osmium::Location> locations(ids.size());
+                m_storage_neg.get_noexcept_batch(ids.data(), locations.data(), num_neg);
+                m_storage_pos.get_noexcept_batch(ids.data() + num_neg, locations.data() + num_neg, ids.size() - num_neg);
+
+                std::size_t missing = 0;
+                std::size_t n = 0;
+                for (std::size_t i = 0; i < refs.size(); ++i) {
+                    if (i > 0 && refs[i].first != refs[i - 1].first) {
+                        ++n;
+                    }
+                    refs[i].second->set_location(locations[n]);
+                    if (!locations[n]) {
+                        ++missing;
+                    }
+                }
+
+                return missing;
+            }
+
+            /**
+             * Set the locations of all node refs in the ways. Large batches
+             * are split into ranges with about the same number of node refs
+             * which are looked up in the pool threads.
+             */
+            void set_locations(const std::vector<osmium::Way*>& ways, osmium::thread::Pool& pool) {
+                if (ways.empty()) {
+                    return;
+                }
+
+                sort_if_needed();
+
+                std::size_t num_node_refs = 0;
+                for (const auto* way : ways) {
+                    num_node_refs += way->nodes().size();
+                }
+
+                const std::size_t num_tasks = std::min(std::size_t(pool.num_threads()), num_node_refs / min_node_refs_per_task);
+
+                std::size_t missing = 0;
+                if (num_tasks <= 1) {
+                    missing = set_locations(ways.data(), ways.data() + ways.size());
+                } else {
+                    std::vector<lookup_task> tasks;
+                    const std::size_t refs_per_task = num_node_refs / num_tasks;
+                    auto first = ways.data();
+                    std::size_t count = 0;
+                    for (auto it = ways.data(); it != ways.data() + ways.size(); ++it) {
+                        count += (*it)->nodes().size();
+                        if (count >= refs_per_task && tasks.size() < num_tasks - 1) {
+                            tasks.push_back(lookup_task{this, first, it + 1});
+                            first = it + 1;
+                            count = 0;
+                        }
+                    }
+
+                    // The last range is done in this thread while the
+                    // pool threads work on the others.
+                    auto futures = pool.submit_batch(tasks.begin(), tasks.end());
+                    missing = set_locations(first, ways.data() + ways.size());
+
+                    for (auto& future : futures) {
+                        future.wait();
+                    }
+                    for (auto& future : futures) {
+                        missing += future.get();
+                    }
+                }
+
+                if (!m_ignore_errors && missing > 0) {
+                    throw osmium::not_found{"location for one or more nodes not found in node location index"};
+                }
+            }
+
         public:
 
             explicit NodeLocationsForWays(TStoragePosIDs& storage_pos,
@@ -133,6 +279,58 @@ namespace osmium {
                 }
             }
 
+            /**
+             * Prepare the indexes for nodes_concurrently(). See
+             * osmium::index::map::Map::prepare_concurrent_set().
+             *
+             * @param max_id Largest node id that will be stored.
+             * @param max_neg_id Largest absolute value of negative node ids
+             *                   that will be stored.
+             * @throws std::runtime_error if an index doesn't support
+             *         concurrent writes.
+             */
+            void prepare_concurrent_set(const osmium::unsigned_object_id_type max_id, const osmium::unsigned_object_id_type max_neg_id = 0) {
+                m_storage_pos.prepare_concurrent_set(max_id);
+                m_storage_neg.prepare_concurrent_set(max_neg_id);
+            }
+
+            /**
+             * Store the locations of all nodes in the buffer in the indexes.
+             * Unlike node() this can be called for several buffers from
+             * several threads at the same time, so it can be used as the
+             * osmium::io::decoded_buffer_callback of a Reader to fill the
+             * indexes in the pool threads while the file is decoded:
+             *
+             * @code
+             * handler.prepare_concurrent_set(max_id);
+             * osmium::io::Reader reader{file, osmium::io::decoded_buffer_callback{
+             *     [&handler](const osmium::memory::Buffer& buffer) {
+             *         handler.nodes_concurrently(buffer);
+             *     }}};
+             * @endcode
+             *
+             * Call prepare_concurrent_set() first. All calls must have
+             * finished before way() or handle_buffer() are called. With the
+             * Reader this is the case for all buffers read up to and
+             * including the buffer returned by the last call to read(). So
+             * if the input file is sorted, the locations of all nodes are in
+             * the index once read() returns the first buffer with ways. Do
+             * not call node() for the nodes in addition.
+             *
+             * @throws std::out_of_range if a node id is larger than the
+             *         maximum id given to prepare_concurrent_set().
+             */
+            void nodes_concurrently(const osmium::memory::Buffer& buffer) {
+                for (const auto& node : buffer.select<osmium::Node>()) {
+                    const auto id = node.id();
+                    if (id >= 0) {
+                        m_storage_pos.set_concurrently(static_cast<osmium::unsigned_object_id_type>( id), node.location());
+                    } else {
+                        m_storage_neg.set_concurrently(static_cast<osmium::unsigned_object_id_type>(-id), node.location());
+                    }
+                }
+            }
+
             /**
              * Get location of node with given id.
              */
@@ -149,12 +347,7 @@ namespace osmium {
              * them to the way object.
              */
             void way(osmium::Way& way) {
-                if (m_must_sort) {
-                    m_storage_pos.sort();
-                    m_storage_neg.sort();
-                    m_must_sort = false;
-                    m_last_id = std::numeric_limits<osmium::unsigned_object_id_type>::max();
-                }
+                sort_if_needed();
                 bool error = false;
                 for (auto& node_ref : way.nodes()) {
                     node_ref.set_location(get_node_location(node_ref.ref()));
@@ -167,6 +360,41 @@ namespace osmium {
                 }
             }
 
+            /**
+             * Handle all nodes and ways in the buffer. This has the same
+             * effect as calling node() and way() for them in the order they
+             * appear in the buffer, but the locations for each run of ways
+             * are looked up in one batch: The node refs are sorted by id, so
+             * the index is accessed in order which is much faster for
+             * indexes on disk, and for larger buffers the lookups are spread
+             * over the threads of the pool.
+             *
+             * Other objects in the buffer are ignored. If the locations for
+             * some nodes are not found (and ignore_errors() wasn't called),
+             * the osmium::not_found exception is thrown after all ways of
+             * the run have been handled.
+             *
+             * This must not be called from a pool thread. The index must
+             * allow concurrent calls to get_noexcept(), all indexes in
+             * libosmium do.
+             *
+             * @param buffer The buffer with the nodes and ways.
+             * @param pool The thread pool used for the lookups.
+             */
+            void handle_buffer(osmium::memory::Buffer& buffer, osmium::thread::Pool& pool = osmium::thread::Pool::default_instance()) {
+                std::vector<osmium::Way*> ways;
+                for (auto& item : buffer) {
+                    if (item.type() == osmium::item_type::node) {
+                        set_locations(ways, pool);
+                        ways.clear();
+                        node(static_cast<const osmium::Node&>(item));
+                    } else if (item.type() == osmium::item_type::way) {
+                        ways.push_back(&static_cast<osmium::Way&>(item));
+                    }
+                }
+                set_locations(ways, pool);
+            }
+
             /**
              * Call clear on the location indexes. Makes the
              * NodeLocationsForWays handler unusable. Used to explicitly free
@@ -36,6 +36,7 @@ DEALINGS IN THE SOFTWARE.
 #ifdef __linux__
 
 #include <osmium/index/detail/mmap_vector_base.hpp>
+#include <osmium/util/memory_mapping.hpp>
 
 namespace osmium {
 
@@ -44,6 +45,11 @@ namespace osmium {
         /**
          * This class looks and behaves like STL vector, but uses mmap
          * internally.
+         *
+         * The memory can be backed by huge pages and placed on NUMA nodes
+         * as set in the options. The default constructor gets them from
+         * the environment, see
+         * osmium::util::default_anonymous_mapping_options().
          */
         template <typename T>
         class mmap_vector_anon : public mmap_vector_base<T> {
@@ -51,7 +57,11 @@ namespace osmium {
         public:
 
             mmap_vector_anon() :
-                mmap_vector_base<T>() {
+                mmap_vector_base<T>(osmium::util::default_anonymous_mapping_options()) {
+            }
+
+            explicit mmap_vector_anon(const osmium::util::anonymous_mapping_options& options) :
+                mmap_vector_base<T>(options) {
             }
 
             ~mmap_vector_anon() noexcept = default;
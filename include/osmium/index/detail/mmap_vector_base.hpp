@@ -40,6 +40,7 @@ DEALINGS IN THE SOFTWARE.
 #include <stdexcept>
 
 #include <osmium/index/index.hpp>
+#include <osmium/util/file.hpp>
 #include <osmium/util/memory_mapping.hpp>
 
 namespace osmium {
@@ -77,6 +78,12 @@ namespace osmium {
                 std::fill_n(data(), capacity, osmium::index::empty_value<T>());
             }
 
+            explicit mmap_vector_base(const osmium::util::anonymous_mapping_options& options, size_t capacity = mmap_vector_size_increment) :
+                m_size(0),
+                m_mapping(capacity, options) {
+                std::fill_n(data(), capacity, osmium::index::empty_value<T>());
+            }
+
             ~mmap_vector_base() noexcept = default;
 
             using value_type      = T;
@@ -182,6 +189,59 @@ namespace osmium {
                 return data() + m_size;
             }
 
+            /**
+             * The options the memory mapping uses. See
+             * osmium::util::MemoryMapping::options().
+             */
+            const osmium::util::anonymous_mapping_options& mapping_options() const noexcept {
+                return m_mapping.options();
+            }
+
+            /**
+             * The number of bytes currently backed by huge pages. See
+             * osmium::util::MemoryMapping::huge_page_bytes().
+             */
+            size_t huge_page_bytes() const {
+                return m_mapping.huge_page_bytes();
+            }
+
+            /**
+             * Tell the operating system that the elements with the given
+             * indexes will be accessed soon, so that it can read in the
+             * pages they are on. The indexes should be sorted (ascending or
+             * descending), the pages of neighbouring indexes are combined
+             * into one request. Indexes not smaller than size() are ignored.
+             */
+            template <typename TIterator>
+            void will_need(TIterator first, TIterator last) const noexcept {
+                const size_t per_page = std::max(size_t(1), osmium::util::get_pagesize() / sizeof(T));
+
+                bool in_run = false;
+                size_t run_first = 0;
+                size_t run_last = 0;
+                for (; first != last; ++first) {
+                    const auto n = static_cast<size_t>(*first);
+                    if (n >= m_size) {
+                        continue;
+                    }
+                    const size_t page = n / per_page;
+                    if (in_run && page + 1 >= run_first && page <= run_last + 1) {
+                        run_first = std::min(run_first, page);
+                        run_last = std::max(run_last, page);
+                        continue;
+                    }
+                    if (in_run) {
+                        m_mapping.will_need(run_first * per_page, (run_last - run_first + 1) * per_page);
+                    }
+                    in_run = true;
+                    run_first = page;
+                    run_last = page;
+                }
+                if (in_run) {
+                    m_mapping.will_need(run_first * per_page, (run_last - run_first + 1) * per_page);
+                }
+            }
+
         }; // class mmap_vector_base
 
     } // namespace detail
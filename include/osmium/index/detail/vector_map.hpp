@@ -34,12 +34,17 @@ DEALINGS IN THE SOFTWARE.
 */
 
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <limits>
+#include <stdexcept>
 #include <utility>
 
 #include <osmium/index/index.hpp>
 #include <osmium/index/map.hpp>
 #include <osmium/io/detail/read_write.hpp>
+#include <osmium/util/file.hpp>
+#include <osmium/util/memory_mapping.hpp>
 
 namespace osmium {
 
@@ -47,11 +52,52 @@ namespace osmium {
 
         namespace map {
 
+            namespace detail {
+
+                // Vectors based on memory mappings can tell the operating
+                // system which pages will be needed soon.
+                template <typename TVector, typename TId>
+                inline auto will_need(const TVector& vector, const TId* first, const TId* last, int) noexcept -> decltype(vector.will_need(first, last)) {
+                    return vector.will_need(first, last);
+                }
+
+                template <typename TVector, typename TId>
+                inline void will_need(const TVector& /*vector*/, const TId* /*first*/, const TId* /*last*/, long) noexcept {
+                }
+
+                // Vectors based on anonymous memory mappings can be backed
+                // by huge pages.
+                template <typename TVector>
+                inline auto huge_page_bytes(const TVector& vector, int) -> decltype(vector.huge_page_bytes()) {
+                    return vector.huge_page_bytes();
+                }
+
+                template <typename TVector>
+                inline std::size_t huge_page_bytes(const TVector& /*vector*/, long) {
+                    return 0;
+                }
+
+            } // namespace detail
+
             template <typename TVector, typename TId, typename TValue>
             class VectorBasedDenseMap : public Map<TId, TValue> {
 
+                // How many ids ahead of the current one get_noexcept_batch()
+                // prefetches into the CPU cache.
+                enum constant_prefetch_distance : std::size_t {
+                    prefetch_distance = 16
+                };
+
+                // Number of ids get_noexcept_batch() tells the operating
+                // system about in advance (for memory mapped vectors).
+                enum constant_will_need_window : std::size_t {
+                    will_need_window = 4096
+                };
+
                 TVector m_vector;
 
+                mutable std::atomic<std::size_t> m_pages_touched{0};
+
             public:
 
                 using element_type   = TValue;
@@ -67,6 +113,15 @@ namespace osmium {
                     m_vector(fd) {
                 }
 
+                /**
+                 * Create map on a vector with huge page and NUMA options.
+                 * Only available for vectors based on anonymous memory
+                 * mappings (DenseMmapArray).
+                 */
+                explicit VectorBasedDenseMap(const osmium::util::anonymous_mapping_options& options) :
+                    m_vector(options) {
+                }
+
                 ~VectorBasedDenseMap() noexcept final = default;
 
                 void reserve(const std::size_t size) final {
@@ -80,6 +135,21 @@ namespace osmium {
                     m_vector[id] = value;
                 }
 
+                // The vector is resized once, after that every id has its
+                // own slot and can be written without locking.
+                void prepare_concurrent_set(const TId max_id) final {
+                    if (size() <= max_id) {
+                        m_vector.resize(max_id + 1);
+                    }
+                }
+
+                void set_concurrently(const TId id, const TValue value) final {
+                    if (size() <= id) {
+                        throw std::out_of_range{"id larger than max_id given to prepare_concurrent_set()"};
+                    }
+                    m_vector[id] = value;
+                }
+
                 TValue get(const TId id) const final {
                     if (id >= m_vector.size()) {
                         throw osmium::not_found{id};
@@ -98,6 +168,62 @@ namespace osmium {
                     return m_vector[id];
                 }
 
+                /**
+                 * Retrieve values for several ids at once. For each window of
+                 * upcoming ids the operating system is told which pages will
+                 * be needed (if the vector is memory mapped) and the values
+                 * a few ids ahead are prefetched into the CPU cache. This
+                 * works best if the ids are sorted: then pages are read in
+                 * order and each of them only once.
+                 */
+                void get_noexcept_batch(const TId* ids, TValue* values, const std::size_t count) const noexcept final {
+                    const std::size_t per_page = std::max(std::size_t(1), osmium::util::get_pagesize() / sizeof(TValue));
+                    const std::size_t vector_size = m_vector.size();
+
+                    std::size_t pages = 0;
+                    std::size_t last_page = std::numeric_limits<std::size_t>::max();
+                    for (std::size_t i = 0; i < count; ++i) {
+                        if (i % will_need_window == 0) {
+                            detail::will_need(m_vector, ids + i, ids + std::min(count, i + will_need_window), 0);
+                        }
+#if defined(__GNUC__) || defined(__clang__)
+                        if (i + prefetch_distance < count && ids[i + prefetch_distance] < vector_size) {
+                            __builtin_prefetch(&m_vector[ids[i + prefetch_distance]]);
+                        }
+#endif
+                        const auto id = ids[i];
+                        if (id < vector_size) {
+                            values[i] = m_vector[id];
+                            if (id / per_page != last_page) {
+                                last_page = id / per_page;
+                                ++pages;
+                            }
+                        } else {
+                            values[i] = osmium::index::empty_value<TValue>();
+                        }
+                    }
+
+                    m_pages_touched += pages;
+                }
+
+                /**
+                 * The number of memory pages accessed by all calls to
+                 * get_noexcept_batch() so far. Consecutive lookups on the
+                 * same page count only once.
+                 */
+                std::size_t pages_touched() const noexcept {
+                    return m_pages_touched;
+                }
+
+                /**
+                 * The number of bytes of the index currently backed by huge
+                 * pages. Always 0 for indexes not based on anonymous memory
+                 * mappings.
+                 */
+                std::size_t huge_page_bytes() const {
+                    return detail::huge_page_bytes(m_vector, 0);
+                }
+
                 std::size_t size() const final {
                     return m_vector.size();
                 }
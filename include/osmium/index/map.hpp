@@ -125,6 +125,35 @@ namespace osmium {
                 /// Set the field with id to value.
                 virtual void set(const TId id, const TValue value) = 0;
 
+                /**
+                 * Prepare the map for calls to set_concurrently() for ids
+                 * up to and including max_id. Only maps where every id has
+                 * its own slot support this. Must not be called while other
+                 * threads use the map.
+                 *
+                 * @throws std::runtime_error if the map doesn't support
+                 *         concurrent writes.
+                 */
+                virtual void prepare_concurrent_set(const TId /*max_id*/) {
+                    throw std::runtime_error{"map doesn't support concurrent writes"};
+                }
+
+                /**
+                 * Set the field with id to value. Unlike set() this can be
+                 * called from several threads at the same time after
+                 * prepare_concurrent_set() was called. The calls must have
+                 * finished (and be synchronized with the reading thread)
+                 * before the map is read or used in any other way.
+                 *
+                 * @throws std::out_of_range if the id is larger than the
+                 *         max_id given to prepare_concurrent_set().
+                 * @throws std::runtime_error if the map doesn't support
+                 *         concurrent writes.
+                 */
+                virtual void set_concurrently(const TId /*id*/, const TValue /*value*/) {
+                    throw std::runtime_error{"map doesn't support concurrent writes"};
+                }
+
                 /**
                  * Retrieve value by id.
                  *
@@ -145,6 +174,22 @@ namespace osmium {
                  */
                 virtual TValue get_noexcept(const TId id) const noexcept = 0;
 
+                /**
+                 * Retrieve values for several ids at once. This has the same
+                 * result as calling get_noexcept() for each id, but some
+                 * maps do this faster, especially if the ids are sorted.
+                 *
+                 * @param ids Pointer to the first of count ids.
+                 * @param values Pointer to space for count values where the
+                 *               results are written to.
+                 * @param count Number of ids.
+                 */
+                virtual void get_noexcept_batch(const TId* ids, TValue* values, const size_t count) const noexcept {
+                    for (size_t i = 0; i < count; ++i) {
+                        values[i] = get_noexcept(ids[i]);
+                    }
+                }
+
                 /**
                  * Get the approximate number of items in the storage. The storage
                  * might allocate memory in blocks, so this size might not be
@@ -0,0 +1,359 @@
+#ifndef OSMIUM_INDEX_MAP_COMPRESSED_MEM_HPP
+#define OSMIUM_INDEX_MAP_COMPRESSED_MEM_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <protozero/varint.hpp>
+
+#include <osmium/index/map.hpp>
+#include <osmium/index/index.hpp>
+#include <osmium/osm/location.hpp>
+
+#define OSMIUM_HAS_INDEX_MAP_COMPRESSED_MEM
+
+namespace osmium {
+
+    namespace index {
+
+        namespace map {
+
+            /**
+             * Index for node locations which stores the locations in
+             * compressed form in memory. It needs much less memory than the
+             * dense indexes, but is slower.
+             *
+             * Ids are grouped into blocks of 256 consecutive ids. For each
+             * block the locations of all ids which are set are stored one
+             * after the other, the coordinates delta encoded to the
+             * previous location in the block and written as zigzag varints.
+             * Nodes with consecutive ids are usually close to each other,
+             * so this typically needs 3 to 5 bytes per location. A bitmap
+             * marks which ids in the block are set (unless all are). The
+             * encoded blocks are stored in large chunks of memory, a vector
+             * with the offset of each block allows to find a block in
+             * constant time.
+             *
+             * Setting locations is fastest if it is done in order of ids,
+             * because the block currently written to is kept uncompressed
+             * and only encoded when a location for another block is set.
+             * When an already encoded block is set again, it is decoded
+             * and the old encoding becomes unused memory.
+             *
+             * Each thread reading from the index keeps a small cache of
+             * recently decoded blocks, so reading from several threads at
+             * the same time is fine (but not while writing).
+             *
+             * Only works with osmium::Location values. Locations that are
+             * set to the invalid osmium::Location{} are treated as unset.
+             */
+            template <typename TId, typename TValue>
+            class CompressedMem : public osmium::index::map::Map<TId, TValue> {
+
+                static_assert(std::is_same<TValue, osmium::Location>::value,
+                              "TValue template parameter for class CompressedMem must be osmium::Location");
+
+                enum constant_bits {
+                    bits = 8
+                };
+
+                enum constant_block_size : uint64_t {
+                    block_size = 1ull << bits
+                };
+
+                // Size of the chunks of memory the encoded blocks are
+                // stored in.
+                enum constant_chunk_size : std::size_t {
+                    chunk_size = 16 * 1024 * 1024
+                };
+
+                // Number of decoded blocks cached per thread. Must be a
+                // power of 2.
+                enum constant_cache_size : std::size_t {
+                    cache_size = 8
+                };
+
+                // Enough space for the flags, the bitmap, and two varints
+                // for each location.
+                enum constant_max_encoded_block_size : std::size_t {
+                    max_encoded_block_size = 1 + block_size / 8 + block_size * 2 * protozero::max_varint_length
+                };
+
+                // First byte of an encoded block.
+                enum block_flags : char {
+                    some_set = 0, // bitmap follows
+                    all_set  = 1
+                };
+
+                using block_type = std::array<TValue, block_size>;
+
+                struct cache_entry {
+                    uint64_t stamp = 0;
+                    uint64_t block = 0;
+                    block_type values;
+                };
+
+                static constexpr const uint64_t no_block = std::numeric_limits<uint64_t>::max();
+
+                std::vector<std::vector<char>> m_chunks;
+
+                // Offset of the encoded data (plus 1) for each block. 0 if
+                // the block is empty.
+                std::vector<uint64_t> m_block_offsets;
+
+                // The block currently written to.
+                block_type m_open;
+                uint64_t m_open_block = no_block;
+
+                // Number of locations in encoded blocks.
+                std::size_t m_size = 0;
+
+                // Identifies the current state of the encoded data. Cache
+                // entries with another stamp are stale.
+                uint64_t m_stamp;
+
+                static uint64_t new_stamp() noexcept {
+                    static std::atomic<uint64_t> counter{0};
+                    return ++counter;
+                }
+
+                static cache_entry* cache() noexcept {
+                    static thread_local std::array<cache_entry, cache_size> entries;
+                    return entries.data();
+                }
+
+                static uint64_t block(const uint64_t id) noexcept {
+                    return id >> bits;
+                }
+
+                static uint64_t offset(const uint64_t id) noexcept {
+                    return id & (block_size - 1);
+                }
+
+                static bool is_set(const TValue value) noexcept {
+                    return value != osmium::index::empty_value<TValue>();
+                }
+
+                static std::size_t count_set(const block_type& values) noexcept {
+                    std::size_t count = 0;
+                    for (const auto value : values) {
+                        if (is_set(value)) {
+                            ++count;
+                        }
+                    }
+                    return count;
+                }
+
+                std::vector<char>& chunk_with_space() {
+                    if (m_chunks.empty() || m_chunks.back().size() + max_encoded_block_size > chunk_size) {
+                        m_chunks.emplace_back();
+                        m_chunks.back().reserve(chunk_size);
+                    }
+                    return m_chunks.back();
+                }
+
+                void encode_open_block() {
+                    if (m_open_block == no_block) {
+                        return;
+                    }
+
+                    const auto count = count_set(m_open);
+                    if (count > 0) {
+                        auto& chunk = chunk_with_space();
+                        m_block_offsets[m_open_block] = (m_chunks.size() - 1) * chunk_size + chunk.size() + 1;
+
+                        if (count == block_size) {
+                            chunk.push_back(all_set);
+                        } else {
+                            chunk.push_back(some_set);
+                            for (std::size_t i = 0; i < block_size; i += 8) {
+                                unsigned char bitmap = 0;
+                                for (std::size_t j = 0; j < 8; ++j) {
+                                    if (is_set(m_open[i + j])) {
+                                        bitmap |= static_cast<unsigned char>(1u << j);
+                                    }
+                                }
+                                chunk.push_back(static_cast<char>(bitmap));
+                            }
+                        }
+
+                        int64_t x = 0;
+                        int64_t y = 0;
+                        for (const auto value : m_open) {
+                            if (is_set(value)) {
+                                protozero::write_varint(std::back_inserter(chunk), protozero::encode_zigzag64(value.x() - x));
+                                protozero::write_varint(std::back_inserter(chunk), protozero::encode_zigzag64(value.y() - y));
+                                x = value.x();
+                                y = value.y();
+                            }
+                        }
+
+                        m_size += count;
+                    }
+
+                    m_open_block = no_block;
+                }
+
+                void decode_block(const uint64_t num, block_type& values) const noexcept {
+                    const uint64_t pos = m_block_offsets[num] - 1;
+                    const auto& chunk = m_chunks[pos / chunk_size];
+                    const char* data = chunk.data() + pos % chunk_size;
+                    const char* const end = chunk.data() + chunk.size();
+
+                    const char* bitmap = nullptr;
+                    if (*data++ == some_set) {
+                        bitmap = data;
+                        data += block_size / 8;
+                    }
+
+                    int64_t x = 0;
+                    int64_t y = 0;
+                    for (std::size_t i = 0; i < block_size; ++i) {
+                        if (bitmap && !(static_cast<unsigned char>(bitmap[i / 8]) & (1u << (i % 8)))) {
+                            values[i] = osmium::index::empty_value<TValue>();
+                            continue;
+                        }
+                        x += protozero::decode_zigzag64(protozero::decode_varint(&data, end));
+                        y += protozero::decode_zigzag64(protozero::decode_varint(&data, end));
+                        values[i] = TValue{static_cast<int32_t>(x), static_cast<int32_t>(y)};
+                    }
+                }
+
+                void open_block(const uint64_t num) {
+                    encode_open_block();
+
+                    if (num >= m_block_offsets.size()) {
+                        m_block_offsets.resize(num + 1);
+                    }
+
+                    if (m_block_offsets[num] == 0) {
+                        m_open.fill(osmium::index::empty_value<TValue>());
+                    } else {
+                        decode_block(num, m_open);
+                        m_size -= count_set(m_open);
+                        m_block_offsets[num] = 0;
+                        m_stamp = new_stamp();
+                    }
+
+                    m_open_block = num;
+                }
+
+            public:
+
+                CompressedMem() :
+                    m_stamp(new_stamp()) {
+                }
+
+                ~CompressedMem() noexcept final = default;
+
+                std::size_t size() const noexcept final {
+                    return m_size + (m_open_block == no_block ? 0 : count_set(m_open));
+                }
+
+                // Chunks are allocated with the full chunk_size, but the
+                // memory is only really used when it is written to, so only
+                // the used part is counted here.
+                std::size_t used_memory() const noexcept final {
+                    std::size_t chunks_size = 0;
+                    for (const auto& chunk : m_chunks) {
+                        chunks_size += chunk.size() + sizeof(std::vector<char>);
+                    }
+                    return sizeof(CompressedMem) +
+                           m_block_offsets.capacity() * sizeof(uint64_t) +
+                           chunks_size;
+                }
+
+                void set(const TId id, const TValue value) final {
+                    if (block(id) != m_open_block) {
+                        open_block(block(id));
+                    }
+                    m_open[offset(id)] = value;
+                }
+
+                TValue get_noexcept(const TId id) const noexcept final {
+                    const auto num = block(id);
+                    if (num == m_open_block) {
+                        return m_open[offset(id)];
+                    }
+                    if (num >= m_block_offsets.size() || m_block_offsets[num] == 0) {
+                        return osmium::index::empty_value<TValue>();
+                    }
+
+                    auto& entry = cache()[num & (cache_size - 1)];
+                    if (entry.stamp != m_stamp || entry.block != num) {
+                        decode_block(num, entry.values);
+                        entry.stamp = m_stamp;
+                        entry.block = num;
+                    }
+                    return entry.values[offset(id)];
+                }
+
+                TValue get(const TId id) const final {
+                    const auto value = get_noexcept(id);
+                    if (value == osmium::index::empty_value<TValue>()) {
+                        throw osmium::not_found{id};
+                    }
+                    return value;
+                }
+
+                void clear() final {
+                    m_chunks.clear();
+                    m_chunks.shrink_to_fit();
+                    m_block_offsets.clear();
+                    m_block_offsets.shrink_to_fit();
+                    m_open_block = no_block;
+                    m_size = 0;
+                    m_stamp = new_stamp();
+                }
+
+            }; // class CompressedMem
+
+        } // namespace map
+
+    } // namespace index
+
+} // namespace osmium
+
+#ifdef OSMIUM_WANT_NODE_LOCATION_MAPS
+    REGISTER_MAP(osmium::unsigned_object_id_type, osmium::Location, osmium::index::map::CompressedMem, compressed_mem)
+#endif
+
+#endif // OSMIUM_INDEX_MAP_COMPRESSED_MEM_HPP
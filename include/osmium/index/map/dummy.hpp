@@ -62,6 +62,14 @@ namespace osmium {
                     // intentionally left blank
                 }
 
+                void prepare_concurrent_set(const TId) final {
+                    // intentionally left blank
+                }
+
+                void set_concurrently(const TId, const TValue) final {
+                    // intentionally left blank
+                }
+
                 TValue get(const TId id) const final {
                     throw osmium::not_found{id};
                 }
@@ -36,6 +36,7 @@ DEALINGS IN THE SOFTWARE.
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <stdexcept>
 #include <utility>
 #include <vector>
 
@@ -206,6 +207,25 @@ namespace osmium {
                     }
                 }
 
+                /**
+                 * Switches to dense mode and allocates all blocks for ids up
+                 * to max_id, so that set_concurrently() never has to change
+                 * the block structure and can work without locking.
+                 */
+                void prepare_concurrent_set(const TId max_id) final {
+                    switch_to_dense();
+                    for (uint64_t num = 0; num <= block(max_id); ++num) {
+                        assure_block(num);
+                    }
+                }
+
+                void set_concurrently(const TId id, const TValue value) final {
+                    if (!m_dense || m_dense_blocks.size() <= block(id) || m_dense_blocks[block(id)].empty()) {
+                        throw std::out_of_range{"id larger than max_id given to prepare_concurrent_set()"};
+                    }
+                    m_dense_blocks[block(id)][offset(id)] = value;
+                }
+
                 TValue get_noexcept(const TId id) const noexcept final {
                     if (m_dense) {
                         return get_dense(id);
@@ -73,4 +73,8 @@ DEALINGS IN THE SOFTWARE.
     REGISTER_MAP(osmium::unsigned_object_id_type, osmium::Location, osmium::index::map::FlexMem, flex_mem)
 #endif
 
+#ifdef OSMIUM_HAS_INDEX_MAP_COMPRESSED_MEM
+    REGISTER_MAP(osmium::unsigned_object_id_type, osmium::Location, osmium::index::map::CompressedMem, compressed_mem)
+#endif
+
 #endif // OSMIUM_INDEX_NODE_LOCATIONS_MAP_HPP
@@ -0,0 +1,286 @@
+#ifndef OSMIUM_IO_BLOB_INDEX_HPP
+#define OSMIUM_IO_BLOB_INDEX_HPP
+
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/types.hpp>
+
+namespace osmium {
+
+    namespace io {
+
+        /**
+         * Entry in a BlobIndex describing one data blob of a PBF file.
+         */
+        struct blob_index_entry {
+
+            /// Offset of the blob in the file (including the size field
+            /// and the BlobHeader).
+            uint64_t offset = 0;
+
+            /// Size of the blob in the file (including the size field and
+            /// the BlobHeader).
+            uint64_t size = 0;
+
+            /// The types of OSM entities in the blob.
+            osmium::osm_entity_bits::type types = osmium::osm_entity_bits::nothing;
+
+            /// The smallest ID of any object in the blob.
+            osmium::object_id_type min_id = std::numeric_limits<osmium::object_id_type>::max();
+
+            /// The largest ID of any object in the blob.
+            osmium::object_id_type max_id = std::numeric_limits<osmium::object_id_type>::min();
+
+            void add(osmium::osm_entity_bits::type type, osmium::object_id_type id) noexcept {
+                types |= type;
+                min_id = std::min(min_id, id);
+                max_id = std::max(max_id, id);
+            }
+
+        }; // struct blob_index_entry
+
+        /**
+         * Index of the data blobs in a PBF file. For each blob it records
+         * the position in the file, the types of OSM entities in it and
+         * the range of their IDs. This can be used together with a
+         * blob_filter to only read those blobs from the file that contain
+         * interesting objects.
+         *
+         * Use the functions in osmium/io/pbf_blob_index.hpp to create an
+         * index from a PBF file and to write it to or read it from a
+         * sidecar file.
+         */
+        class BlobIndex {
+
+            uint64_t m_file_size = 0;
+            std::vector<blob_index_entry> m_entries;
+
+        public:
+
+            using const_iterator = std::vector<blob_index_entry>::const_iterator;
+
+            BlobIndex() = default;
+
+            /**
+             * Create an empty index for a file of the given size.
+             */
+            explicit BlobIndex(uint64_t file_size) :
+                m_file_size(file_size) {
+            }
+
+            /**
+             * Size of the file this index was created for.
+             */
+            uint64_t file_size() const noexcept {
+                return m_file_size;
+            }
+
+            /**
+             * Add an entry to the index. Entries must be added in the
+             * order of their offsets.
+             */
+            void add(const blob_index_entry& entry) {
+                assert(m_entries.empty() || m_entries.back().offset < entry.offset);
+                m_entries.push_back(entry);
+            }
+
+            std::size_t size() const noexcept {
+                return m_entries.size();
+            }
+
+            bool empty() const noexcept {
+                return m_entries.empty();
+            }
+
+            const_iterator begin() const noexcept {
+                return m_entries.cbegin();
+            }
+
+            const_iterator end() const noexcept {
+                return m_entries.cend();
+            }
+
+            /**
+             * Return an iterator to the first entry with an offset not less
+             * than the given offset.
+             */
+            const_iterator lower_bound(uint64_t offset) const {
+                return std::lower_bound(m_entries.cbegin(), m_entries.cend(), offset, [](const blob_index_entry& entry, uint64_t value) {
+                    return entry.offset < value;
+                });
+            }
+
+            /**
+             * Find the entry for the blob at the given offset.
+             *
+             * @returns Pointer to the entry or nullptr if there is no blob
+             *          at this offset in the index.
+             */
+            const blob_index_entry* find(uint64_t offset) const {
+                const auto it = lower_bound(offset);
+                if (it == m_entries.cend() || it->offset != offset) {
+                    return nullptr;
+                }
+                return &*it;
+            }
+
+        }; // class BlobIndex
+
+        /**
+         * Add this as an option to the Reader to only read the data blobs
+         * of a PBF file that can contain the OSM entity types and IDs you
+         * are interested in. Blobs that don't match are skipped without
+         * decompressing or decoding them. When the PBF file is read through
+         * a memory mapping they are not even read from disk.
+         *
+         * Note that the filter works on whole blobs, so the Reader will
+         * still return objects with other types or IDs if they are in the
+         * same blob as matching objects.
+         *
+         * The filter is ignored for file formats other than PBF.
+         */
+        class blob_filter {
+
+            std::shared_ptr<const BlobIndex> m_index;
+            osmium::osm_entity_bits::type m_types = osmium::osm_entity_bits::all;
+            osmium::object_id_type m_min_id = std::numeric_limits<osmium::object_id_type>::min();
+            osmium::object_id_type m_max_id = std::numeric_limits<osmium::object_id_type>::max();
+
+        public:
+
+            /// Offset returned by next_wanted() if there are no more blobs.
+            static constexpr const uint64_t no_more_blobs = std::numeric_limits<uint64_t>::max();
+
+            /**
+             * Default constructed filter matches all blobs.
+             */
+            blob_filter() = default;
+
+            /**
+             * Create filter.
+             *
+             * @param index The index of the file to be read.
+             * @param types Only read blobs containing these types.
+             * @param min_id Only read blobs containing objects with IDs
+             *               not smaller than this.
+             * @param max_id Only read blobs containing objects with IDs
+             *               not larger than this.
+             */
+            explicit blob_filter(std::shared_ptr<const BlobIndex> index,
+                                 osmium::osm_entity_bits::type types = osmium::osm_entity_bits::all,
+                                 osmium::object_id_type min_id = std::numeric_limits<osmium::object_id_type>::min(),
+                                 osmium::object_id_type max_id = std::numeric_limits<osmium::object_id_type>::max()) :
+                m_index(std::move(index)),
+                m_types(types),
+                m_min_id(min_id),
+                m_max_id(max_id) {
+            }
+
+            /**
+             * Does this filter have an index, ie. can it filter anything?
+             */
+            explicit operator bool() const noexcept {
+                return bool(m_index);
+            }
+
+            const BlobIndex* index() const noexcept {
+                return m_index.get();
+            }
+
+            osmium::osm_entity_bits::type types() const noexcept {
+                return m_types;
+            }
+
+            /**
+             * Does the blob described by this entry match the filter?
+             */
+            bool wanted(const blob_index_entry& entry) const noexcept {
+                return (entry.types & m_types) &&
+                       entry.min_id <= m_max_id &&
+                       entry.max_id >= m_min_id;
+            }
+
+            /**
+             * Should the blob at the given offset be read? Blobs not found
+             * in the index are always read.
+             */
+            bool wanted(uint64_t offset) const {
+                if (!m_index) {
+                    return true;
+                }
+                const auto* entry = m_index->find(offset);
+                return !entry || wanted(*entry);
+            }
+
+            /**
+             * Get the offset of the next blob at or after the given offset
+             * that should be read. The given offset must be the start of a
+             * blob. Only unwanted blobs directly following each other in
+             * the index are skipped, the first blob not found in the index
+             * is always returned.
+             *
+             * @returns Offset or no_more_blobs if there is none.
+             */
+            uint64_t next_wanted(uint64_t offset) const {
+                if (!m_index) {
+                    return offset;
+                }
+                for (auto it = m_index->lower_bound(offset); it != m_index->end() && it->offset == offset && it->size > 0; ++it) {
+                    if (wanted(*it)) {
+                        return offset;
+                    }
+                    offset += it->size;
+                }
+                if (offset >= m_index->file_size()) {
+                    return no_more_blobs;
+                }
+                return offset;
+            }
+
+        }; // class blob_filter
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_BLOB_INDEX_HPP
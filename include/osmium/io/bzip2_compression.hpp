@@ -42,8 +42,10 @@ DEALINGS IN THE SOFTWARE.
  * @attention If you include this file, you'll need to link with `libbz2`.
  */
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
+#include <cstring>
 #include <string>
 #include <system_error>
 
@@ -55,6 +57,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include <osmium/io/compression.hpp>
 #include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/detail/stream_splitter.hpp>
 #include <osmium/io/error.hpp>
 #include <osmium/io/file_compression.hpp>
 #include <osmium/io/writer_options.hpp>
@@ -97,23 +100,64 @@ namespace osmium {
                 throw osmium::bzip2_error{error, errnum};
             }
 
+            /**
+             * Does a bzip2 stream start here? Checks the "BZh" magic, the
+             * block size, and the magic number of the first block (or of
+             * the end of stream marker). Needs 10 bytes of data.
+             */
+            inline bool is_bzip2_stream_start(const char* data) noexcept {
+                return data[0] == 'B' && data[1] == 'Z' && data[2] == 'h' &&
+                       data[3] >= '1' && data[3] <= '9' &&
+                       (std::memcmp(data + 4, "\x31\x41\x59\x26\x53\x59", 6) == 0 ||
+                        std::memcmp(data + 4, "\x17\x72\x45\x38\x50\x90", 6) == 0);
+            }
+
+            /**
+             * Start decompressing the next bzip2 stream in the input
+             * keeping the input and output pointers.
+             */
+            inline int restart_bzip2_decompress(bz_stream& bzstream) noexcept {
+                char* next_in = bzstream.next_in;
+                const unsigned int avail_in = bzstream.avail_in;
+                char* next_out = bzstream.next_out;
+                const unsigned int avail_out = bzstream.avail_out;
+                BZ2_bzDecompressEnd(&bzstream);
+                const int result = BZ2_bzDecompressInit(&bzstream, 0, 0);
+                bzstream.next_in = next_in;
+                bzstream.avail_in = avail_in;
+                bzstream.next_out = next_out;
+                bzstream.avail_out = avail_out;
+                return result;
+            }
+
         } // namespace detail
 
         class Bzip2Compressor : public Compressor {
 
             FILE* m_file;
             int m_bzerror;
-            BZFILE* m_bzfile;
+
+            // Only opened on the first call to write(). If all data is
+            // written with write_compressed(), it is never needed.
+            BZFILE* m_bzfile = nullptr;
+
+            bool m_wrote_compressed = false;
+
+            void open_bzfile() {
+                m_bzfile = ::BZ2_bzWriteOpen(&m_bzerror, m_file, 6, 0, 0);
+                if (!m_bzfile) {
+                    detail::throw_bzip2_error(m_bzfile, "write open failed", m_bzerror);
+                }
+            }
 
         public:
 
             explicit Bzip2Compressor(int fd, fsync sync) :
                 Compressor(sync),
                 m_file(fdopen(::dup(fd), "wb")),
-                m_bzerror(BZ_OK),
-                m_bzfile(::BZ2_bzWriteOpen(&m_bzerror, m_file, 6, 0, 0)) {
-                if (!m_bzfile) {
-                    detail::throw_bzip2_error(m_bzfile, "write open failed", m_bzerror);
+                m_bzerror(BZ_OK) {
+                if (!m_file) {
+                    throw std::system_error{errno, std::system_category(), "Open failed"};
                 }
             }
 
@@ -126,6 +170,9 @@ namespace osmium {
             }
 
             void write(const std::string& data) final {
+                if (!m_bzfile) {
+                    open_bzfile();
+                }
                 int error;
                 ::BZ2_bzWrite(&error, m_bzfile, const_cast<char*>(data.data()), static_cast_with_assert<int>(data.size()));
                 if (error != BZ_OK && error != BZ_STREAM_END) {
@@ -133,21 +180,59 @@ namespace osmium {
                 }
             }
 
+            bool can_compress_blocks() const noexcept final {
+                return true;
+            }
+
+            /**
+             * Compress the data into a complete bzip2 stream. Files with
+             * several streams are read by bzip2 and the bzip2 decompressors
+             * in Osmium as if they had been compressed in one go.
+             */
+            std::string compress_block(const std::string& data) const final {
+                // Maximum size of the compressed data as documented in bzlib
+                std::string output(data.size() + data.size() / 100 + 600, '\0');
+                auto size = static_cast_with_assert<unsigned int>(output.size());
+                const int result = ::BZ2_bzBuffToBuffCompress(&output[0], &size,
+                                                              const_cast<char*>(data.data()),
+                                                              static_cast_with_assert<unsigned int>(data.size()),
+                                                              6, 0, 0);
+                if (result != BZ_OK) {
+                    detail::throw_bzip2_error(nullptr, "compression failed", result);
+                }
+                output.resize(size);
+                return output;
+            }
+
+            void write_compressed(const std::string& data) final {
+                if (std::fwrite(data.data(), 1, data.size(), m_file) != data.size()) {
+                    throw std::system_error{errno, std::system_category(), "Write failed"};
+                }
+                m_wrote_compressed = true;
+            }
+
             void close() final {
-                if (m_bzfile) {
-                    int error;
-                    ::BZ2_bzWriteClose(&error, m_bzfile, 0, nullptr, nullptr);
-                    m_bzfile = nullptr;
-                    if (m_file) {
-                        if (do_fsync()) {
-                            osmium::io::detail::reliable_fsync(::fileno(m_file));
-                        }
-                        if (fclose(m_file) != 0) {
-                            throw std::system_error{errno, std::system_category(), "Close failed"};
-                        }
+                if (m_file) {
+                    if (!m_bzfile && !m_wrote_compressed) {
+                        // Nothing was written, create a valid empty bzip2 file.
+                        open_bzfile();
+                    }
+                    int error = BZ_OK;
+                    if (m_bzfile) {
+                        ::BZ2_bzWriteClose(&error, m_bzfile, 0, nullptr, nullptr);
+                        m_bzfile = nullptr;
+                    }
+                    FILE* file = m_file;
+                    m_file = nullptr;
+                    if (do_fsync()) {
+                        std::fflush(file);
+                        osmium::io::detail::reliable_fsync(::fileno(file));
+                    }
+                    if (fclose(file) != 0) {
+                        throw std::system_error{errno, std::system_category(), "Close failed"};
                     }
                     if (error != BZ_OK) {
-                        detail::throw_bzip2_error(m_bzfile, "write close failed", error);
+                        detail::throw_bzip2_error(nullptr, "write close failed", error);
                     }
                 }
             }
@@ -160,6 +245,8 @@ namespace osmium {
             int m_bzerror;
             BZFILE* m_bzfile;
             bool m_stream_end {false};
+            bool m_after_stream_end {false};
+            detail::StreamSplitter m_splitter;
 
         public:
 
@@ -167,7 +254,8 @@ namespace osmium {
                 Decompressor(),
                 m_file(fdopen(::dup(fd), "rb")),
                 m_bzerror(BZ_OK),
-                m_bzfile(::BZ2_bzReadOpen(&m_bzerror, m_file, 0, 0, nullptr, 0)) {
+                m_bzfile(::BZ2_bzReadOpen(&m_bzerror, m_file, 0, 0, nullptr, 0)),
+                m_splitter(fd, 'B', 10, detail::is_bzip2_stream_start) {
                 if (!m_bzfile) {
                     detail::throw_bzip2_error(m_bzfile, "read open failed", m_bzerror);
                 }
@@ -188,9 +276,18 @@ namespace osmium {
                     buffer.resize(osmium::io::Decompressor::input_buffer_size);
                     int error;
                     const int nread = ::BZ2_bzRead(&error, m_bzfile, const_cast<char*>(buffer.data()), static_cast_with_assert<int>(buffer.size()));
+                    if (error == BZ_DATA_ERROR_MAGIC && m_after_stream_end) {
+                        // Like the bzip2 program and the gzip decompressor
+                        // this ignores trailing garbage after the last
+                        // stream.
+                        m_stream_end = true;
+                        set_offset(size_t(ftell(m_file)));
+                        return std::string{};
+                    }
                     if (error != BZ_OK && error != BZ_STREAM_END) {
                         detail::throw_bzip2_error(m_bzfile, "read failed", error);
                     }
+                    m_after_stream_end = false;
                     if (error == BZ_STREAM_END) {
                         void* unused;
                         int nunused;
@@ -208,6 +305,7 @@ namespace osmium {
                             if (error != BZ_OK) {
                                 detail::throw_bzip2_error(m_bzfile, "read open failed", error);
                             }
+                            m_after_stream_end = true;
                         } else {
                             m_stream_end = true;
                         }
@@ -220,6 +318,78 @@ namespace osmium {
                 return buffer;
             }
 
+            /**
+             * Only regular files are split into blocks, because the file
+             * is read again from the start of the current block if no
+             * stream boundaries are found.
+             */
+            bool can_decompress_blocks() const noexcept final {
+                return file_size() > 0;
+            }
+
+            std::string read_compressed_block() final {
+                std::string block{m_splitter.next_block()};
+                if (block.empty() && !m_splitter.gave_up()) {
+                    m_stream_end = true;
+                }
+                set_offset(m_splitter.offset());
+                return block;
+            }
+
+            void read_sequentially_from(std::size_t offset) final {
+                m_splitter.give_up_at(offset);
+                m_stream_end = false;
+                set_offset(offset);
+            }
+
+            /**
+             * Decompress a block consisting of one or more complete bzip2
+             * streams. Like read() and the gzip decompressor, this ignores
+             * trailing garbage after the last stream.
+             */
+            std::string decompress_block(const std::string& data) const final {
+                bz_stream bzstream{};
+                int result = BZ2_bzDecompressInit(&bzstream, 0, 0);
+                if (result != BZ_OK) {
+                    detail::throw_bzip2_error(nullptr, "decompression init failed", result);
+                }
+
+                bzstream.next_in = const_cast<char*>(data.data());
+                bzstream.avail_in = static_cast_with_assert<unsigned int>(data.size());
+
+                std::string output;
+                std::size_t size = 0;
+                while (true) {
+                    if (size == output.size()) {
+                        // Compression ratio of OSM XML is usually about 1:10
+                        output.resize(std::max(output.size() * 2, data.size() * 8));
+                    }
+                    bzstream.next_out = &output[size];
+                    bzstream.avail_out = static_cast_with_assert<unsigned int>(output.size() - size);
+                    result = BZ2_bzDecompress(&bzstream);
+                    size = static_cast<std::size_t>(bzstream.next_out - output.data());
+
+                    if (result == BZ_STREAM_END) {
+                        if (bzstream.avail_in < 10 ||
+                            !detail::is_bzip2_stream_start(bzstream.next_in)) {
+                            break;
+                        }
+                        result = detail::restart_bzip2_decompress(bzstream);
+                    } else if (result == BZ_OK && bzstream.avail_in == 0 && bzstream.avail_out > 0) {
+                        result = BZ_UNEXPECTED_EOF;
+                    }
+
+                    if (result != BZ_OK) {
+                        BZ2_bzDecompressEnd(&bzstream);
+                        detail::throw_bzip2_error(nullptr, "decompress block failed", result);
+                    }
+                }
+
+                BZ2_bzDecompressEnd(&bzstream);
+                output.resize(size);
+                return output;
+            }
+
             void close() final {
                 if (m_bzfile) {
                     int error;
@@ -244,6 +414,15 @@ namespace osmium {
             size_t m_buffer_size;
             bz_stream m_bzstream;
 
+            // Files can consist of several bzip2 streams one after the
+            // other, for instance if they were written in parallel.
+            bool another_stream_follows() const noexcept {
+                return m_bzstream.avail_in >= 3 &&
+                       m_bzstream.next_in[0] == 'B' &&
+                       m_bzstream.next_in[1] == 'Z' &&
+                       m_bzstream.next_in[2] == 'h';
+            }
+
         public:
 
             Bzip2BufferDecompressor(const char* buffer, size_t size) :
@@ -275,7 +454,13 @@ namespace osmium {
                     output.resize(buffer_size);
                     m_bzstream.next_out = const_cast<char*>(output.data());
                     m_bzstream.avail_out = buffer_size;
-                    const int result = BZ2_bzDecompress(&m_bzstream);
+                    int result;
+                    do {
+                        result = BZ2_bzDecompress(&m_bzstream);
+                        if (result == BZ_STREAM_END && another_stream_follows()) {
+                            result = detail::restart_bzip2_decompress(m_bzstream);
+                        }
+                    } while (result == BZ_OK && m_bzstream.avail_out == buffer_size && m_bzstream.avail_in > 0);
 
                     if (result != BZ_OK) {
                         m_buffer = nullptr;
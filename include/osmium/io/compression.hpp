@@ -33,9 +33,11 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
@@ -50,11 +52,17 @@ DEALINGS IN THE SOFTWARE.
 # include <io.h>
 #endif
 
+#ifndef _WIN32
+# include <sys/mman.h>
+#endif
+
 #include <osmium/io/detail/read_write.hpp>
 #include <osmium/io/error.hpp>
 #include <osmium/io/file_compression.hpp>
 #include <osmium/io/writer_options.hpp>
+#include <osmium/util/config.hpp>
 #include <osmium/util/file.hpp>
+#include <osmium/util/memory_mapping.hpp>
 
 namespace osmium {
 
@@ -82,6 +90,36 @@ namespace osmium {
 
             virtual void close() = 0;
 
+            /**
+             * Can this compressor compress blocks of data independently of
+             * each other? If so, the Writer compresses blocks in the thread
+             * pool with compress_block() and writes the results in order
+             * with write_compressed() instead of calling write(). The
+             * output is a valid compressed file consisting of several
+             * streams (or members).
+             */
+            virtual bool can_compress_blocks() const noexcept {
+                return false;
+            }
+
+            /**
+             * Compress the data into a complete compressed stream. This is
+             * called from the pool threads, several calls can run at the
+             * same time. Only called if can_compress_blocks() is true.
+             */
+            virtual std::string compress_block(const std::string& data) const {
+                return data;
+            }
+
+            /**
+             * Write data compressed with compress_block() to the output.
+             * Only called if can_compress_blocks() is true. Must not be
+             * mixed with calls to write().
+             */
+            virtual void write_compressed(const std::string& data) {
+                write(data);
+            }
+
         }; // class Compressor
 
         class Decompressor {
@@ -107,6 +145,67 @@ namespace osmium {
 
             virtual void close() = 0;
 
+            /**
+             * Some decompressors have the complete uncompressed input
+             * available in memory. Calling this switches them into direct
+             * access mode: They return a pointer to the data, which is kept
+             * alive as long as the pointer (or any copy of it) exists, and
+             * read() will not return any data. The size of the data is
+             * file_size(). The caller should report its progress through
+             * set_offset().
+             *
+             * Must be called before the first call to read(). The default
+             * implementation doesn't support direct access and returns an
+             * empty pointer.
+             */
+            virtual std::shared_ptr<const char> enable_direct_access() {
+                return std::shared_ptr<const char>{};
+            }
+
+            /**
+             * Can this decompressor split its input into blocks that can
+             * be decompressed independently of each other? If so, the
+             * Reader gets blocks with read_compressed_block() and
+             * decompresses them in the thread pool with decompress_block().
+             * When read_compressed_block() returns an empty string, the
+             * rest of the input (if any) is read with read() as usual.
+             */
+            virtual bool can_decompress_blocks() const noexcept {
+                return false;
+            }
+
+            /**
+             * Read the next block of compressed data. Returns an empty
+             * string at the end of the input or if the input can not be
+             * split (any more). Must be called before the first call to
+             * read(). Only called if can_decompress_blocks() is true.
+             */
+            virtual std::string read_compressed_block() {
+                return std::string{};
+            }
+
+            /**
+             * Decompress a block returned by read_compressed_block(). This
+             * is called from the pool threads, several calls can run at the
+             * same time. Block boundaries can be wrong, this must throw if
+             * the block does not consist of complete compressed streams.
+             * The caller will then retry with the next block appended and,
+             * if that doesn't help, call read_sequentially_from().
+             */
+            virtual std::string decompress_block(const std::string& data) const {
+                return data;
+            }
+
+            /**
+             * Stop reading blocks and continue reading the input with
+             * read() from the given file offset. The offset is the start
+             * of a block returned by read_compressed_block() which could
+             * not be decompressed. Only called if can_decompress_blocks()
+             * is true.
+             */
+            virtual void read_sequentially_from(std::size_t /*offset*/) {
+            }
+
             std::size_t file_size() const noexcept {
                 return m_file_size;
             }
@@ -313,13 +412,149 @@ namespace osmium {
 
         }; // class NoDecompressor
 
+        /**
+         * Decompressor for uncompressed files that memory maps the whole
+         * file instead of reading it with read(2) system calls. The kernel
+         * is told that the file will be read sequentially and that the
+         * next few chunks will be needed soon, so it can read ahead. Chunks
+         * already handed out are released from the mapping again.
+         *
+         * This decompressor supports direct access to the mapped file, see
+         * enable_direct_access().
+         *
+         * This only works for regular files, use NoDecompressor for pipes
+         * etc.
+         */
+        class MmapDecompressor : public Decompressor {
+
+            // Number of chunks of input_buffer_size bytes we ask the
+            // kernel to read ahead.
+            static constexpr std::size_t readahead_chunks = 8;
+
+            std::shared_ptr<osmium::util::MemoryMapping> m_mapping;
+            int m_fd;
+            std::size_t m_size;
+            std::size_t m_offset = 0;
+            bool m_direct_access = false;
+
+            void advise(std::size_t offset, std::size_t length, int advice) noexcept {
+#ifndef _WIN32
+                if (offset >= m_size || length == 0) {
+                    return;
+                }
+                length = std::min(length, m_size - offset);
+
+                // madvise() needs a page-aligned address
+                const std::size_t pagesize = osmium::util::get_pagesize();
+                const std::size_t aligned_offset = offset - (offset % pagesize);
+                char* addr = m_mapping->get_addr<char>() + aligned_offset;
+
+                // Errors are ignored, this is only a hint.
+                ::madvise(addr, length + (offset - aligned_offset), advice);
+#else
+                (void)offset;
+                (void)length;
+                (void)advice;
+#endif
+            }
+
+        public:
+
+            /**
+             * Create a decompressor for the file with the given file
+             * descriptor. The file descriptor is closed in close().
+             *
+             * @throws std::system_error If the file can not be mapped.
+             */
+            explicit MmapDecompressor(int fd) :
+                Decompressor(),
+                m_mapping(std::make_shared<osmium::util::MemoryMapping>(osmium::util::file_size(fd), osmium::util::MemoryMapping::mapping_mode::readonly, fd)),
+                m_fd(fd),
+                m_size(m_mapping->size()) {
+#ifndef _WIN32
+                advise(0, m_size, MADV_SEQUENTIAL);
+                advise(0, readahead_chunks * input_buffer_size, MADV_WILLNEED);
+#endif
+            }
+
+            ~MmapDecompressor() noexcept final {
+                try {
+                    close();
+                } catch (...) {
+                    // Ignore any exceptions because destructor must not throw.
+                }
+            }
+
+            std::string read() final {
+                std::string buffer;
+
+                if (m_mapping && !m_direct_access && m_offset < m_size) {
+                    const std::size_t size = std::min(m_size - m_offset, std::size_t(input_buffer_size));
+                    buffer.assign(m_mapping->get_addr<const char>() + m_offset, size);
+
+#ifndef _WIN32
+                    advise(m_offset, size, MADV_DONTNEED);
+                    advise(m_offset + readahead_chunks * input_buffer_size, size, MADV_WILLNEED);
+#endif
+
+                    m_offset += size;
+                    set_offset(m_offset);
+                }
+
+                return buffer;
+            }
+
+            /**
+             * Switch to direct access mode. The mapping will stay alive as
+             * long as the returned pointer or any copy of it does, even
+             * after this decompressor was closed.
+             */
+            std::shared_ptr<const char> enable_direct_access() final {
+                if (!m_mapping || m_offset != 0) {
+                    return std::shared_ptr<const char>{};
+                }
+                m_direct_access = true;
+                return std::shared_ptr<const char>{m_mapping, m_mapping->get_addr<const char>()};
+            }
+
+            void close() final {
+                m_mapping.reset();
+                if (m_fd >= 0) {
+                    const int fd = m_fd;
+                    m_fd = -1;
+                    osmium::io::detail::reliable_close(fd);
+                }
+            }
+
+        }; // class MmapDecompressor
+
         namespace detail {
 
+            /**
+             * Create the decompressor for uncompressed data read from the
+             * given file descriptor. Regular files are memory mapped if
+             * possible, everything else (and everything on 32bit systems
+             * where the address space might not be large enough) is read
+             * using read(2).
+             */
+            inline osmium::io::Decompressor* create_no_decompressor(int fd) {
+                if (sizeof(void*) >= 8 && osmium::config::use_mmap_for_reading()) {
+                    try {
+                        if (osmium::util::file_size(fd) > 0) {
+                            return new osmium::io::MmapDecompressor{fd};
+                        }
+                    } catch (const std::system_error&) {
+                        // fall back to using read(2)
+                    }
+                }
+                return new osmium::io::NoDecompressor{fd};
+            }
+
             // we want the register_compression() function to run, setting
             // the variable is only a side-effect, it will never be used
             const bool registered_no_compression = osmium::io::CompressionFactory::instance().register_compression(osmium::io::file_compression::none,
                 [](int fd, fsync sync) { return new osmium::io::NoCompressor{fd, sync}; },
-                [](int fd) { return new osmium::io::NoDecompressor{fd}; },
+                [](int fd) { return create_no_decompressor(fd); },
                 [](const char* buffer, std::size_t size) { return new osmium::io::NoDecompressor{buffer, size}; }
             );
 
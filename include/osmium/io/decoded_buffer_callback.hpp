@@ -0,0 +1,94 @@
+#ifndef OSMIUM_IO_DECODED_BUFFER_CALLBACK_HPP
+#define OSMIUM_IO_DECODED_BUFFER_CALLBACK_HPP
+
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#include <functional>
+#include <utility>
+
+#include <osmium/memory/buffer.hpp>
+
+namespace osmium {
+
+    namespace io {
+
+        /**
+         * Reader option: A function that is called for every buffer right
+         * after it was decoded and before it is returned from
+         * Reader::read(). For file formats that are decoded in the pool
+         * threads the function is called in those threads, otherwise in the
+         * parser thread.
+         *
+         * This can be used to do work on the data in parallel to the
+         * decoding of the rest of the file, for instance to fill a node
+         * location index (see NodeLocationsForWays::nodes_concurrently()).
+         *
+         * The function can be called for several buffers at the same time
+         * and in any order, so it must be thread safe. When Reader::read()
+         * returns a buffer, the call for this buffer and all earlier
+         * buffers has finished.
+         */
+        class decoded_buffer_callback {
+
+            std::function<void(const osmium::memory::Buffer&)> m_function;
+
+        public:
+
+            /**
+             * Default constructed callback does nothing.
+             */
+            decoded_buffer_callback() = default;
+
+            explicit decoded_buffer_callback(std::function<void(const osmium::memory::Buffer&)> function) :
+                m_function(std::move(function)) {
+            }
+
+            explicit operator bool() const noexcept {
+                return static_cast<bool>(m_function);
+            }
+
+            void operator()(const osmium::memory::Buffer& buffer) const {
+                if (m_function) {
+                    m_function(buffer);
+                }
+            }
+
+        }; // class decoded_buffer_callback
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_DECODED_BUFFER_CALLBACK_HPP
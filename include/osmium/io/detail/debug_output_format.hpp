@@ -316,15 +316,18 @@ namespace osmium {
 
             public:
 
-                DebugOutputBlock(osmium::memory::Buffer&& buffer, const debug_output_options& options) :
-                    OutputBlock(std::move(buffer)),
+                DebugOutputBlock(const std::shared_ptr<osmium::memory::Buffer>& buffer,
+                                 osmium::memory::Buffer::const_iterator begin,
+                                 osmium::memory::Buffer::const_iterator end,
+                                 const debug_output_options& options) :
+                    OutputBlock(buffer, begin, end),
                     m_options(options),
                     m_utf8_prefix(options.use_color ? color_red  : ""),
                     m_utf8_suffix(options.use_color ? color_blue : "") {
                 }
 
                 std::string operator()() {
-                    osmium::apply(m_input_buffer->cbegin(), m_input_buffer->cend(), *this);
+                    osmium::apply(m_begin, m_end, *this);
 
                     std::string out;
                     using std::swap;
@@ -570,7 +573,7 @@ namespace osmium {
                 }
 
                 void write_buffer(osmium::memory::Buffer&& buffer) final {
-                    m_output_queue.push(m_pool.submit(DebugOutputBlock{std::move(buffer), m_options}));
+                    encode_in_blocks<DebugOutputBlock>(std::move(buffer), m_options);
                 }
 
             }; // class DebugOutputFormat
@@ -34,19 +34,25 @@ DEALINGS IN THE SOFTWARE.
 */
 
 #include <array>
+#include <cstddef>
 #include <exception>
 #include <functional>
 #include <future>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <utility>
 
+#include <osmium/io/blob_index.hpp>
+#include <osmium/io/compression.hpp>
+#include <osmium/io/decoded_buffer_callback.hpp>
 #include <osmium/io/detail/queue_util.hpp>
 #include <osmium/io/error.hpp>
 #include <osmium/io/file.hpp>
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/memory/buffer_pool.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/thread/pool.hpp>
 
@@ -63,8 +69,49 @@ namespace osmium {
                 std::promise<osmium::io::Header>& header_promise;
                 osmium::osm_entity_bits::type read_which_entities;
                 osmium::io::read_meta read_metadata;
+
+                // Set if the decompressor was switched into direct access
+                // mode (see Decompressor::enable_direct_access()), in that
+                // case the input queue will not contain any data.
+                std::shared_ptr<const char> direct_input;
+                osmium::io::Decompressor* decompressor;
+
+                // Blobs to skip when reading PBF files.
+                osmium::io::blob_filter blob_filter;
+
+                // Pool to get the output buffers from, can be nullptr.
+                osmium::memory::BufferPool* buffer_pool;
+
+                // Called for every decoded buffer.
+                osmium::io::decoded_buffer_callback buffer_callback;
             };
 
+            /**
+             * Wraps a function returning a buffer, so that the decoded buffer
+             * callback is called on the buffer in the thread running the
+             * function.
+             */
+            template <typename TFunction>
+            class buffer_callback_task {
+
+                TFunction m_function;
+                osmium::io::decoded_buffer_callback m_callback;
+
+            public:
+
+                buffer_callback_task(TFunction&& function, const osmium::io::decoded_buffer_callback& callback) :
+                    m_function(std::move(function)),
+                    m_callback(callback) {
+                }
+
+                osmium::memory::Buffer operator()() {
+                    osmium::memory::Buffer buffer{m_function()};
+                    m_callback(buffer);
+                    return buffer;
+                }
+
+            }; // class buffer_callback_task
+
             class Parser {
 
                 osmium::thread::Pool& m_pool;
@@ -73,6 +120,11 @@ namespace osmium {
                 queue_wrapper<std::string> m_input_queue;
                 osmium::osm_entity_bits::type m_read_which_entities;
                 osmium::io::read_meta m_read_metadata;
+                std::shared_ptr<const char> m_direct_input;
+                osmium::io::Decompressor* m_decompressor;
+                osmium::io::blob_filter m_blob_filter;
+                osmium::memory::BufferPool* m_buffer_pool;
+                osmium::io::decoded_buffer_callback m_buffer_callback;
                 bool m_header_is_done;
 
             protected:
@@ -89,6 +141,55 @@ namespace osmium {
                     return m_read_metadata;
                 }
 
+                /**
+                 * The complete input data if the parser has direct access
+                 * to it, an empty pointer otherwise. Parsers must use either
+                 * this or the input queue (get_input()).
+                 */
+                const std::shared_ptr<const char>& direct_input() const noexcept {
+                    return m_direct_input;
+                }
+
+                /**
+                 * Size of the input data available through direct_input().
+                 */
+                std::size_t direct_input_size() const noexcept {
+                    return m_decompressor ? m_decompressor->file_size() : 0;
+                }
+
+                /**
+                 * Report how far the parser has read into the data available
+                 * through direct_input(). This is used for progress
+                 * reporting.
+                 */
+                void set_direct_input_offset(std::size_t offset) noexcept {
+                    if (m_decompressor) {
+                        m_decompressor->set_offset(offset);
+                    }
+                }
+
+                const osmium::io::blob_filter& blob_filter() const noexcept {
+                    return m_blob_filter;
+                }
+
+                /**
+                 * The buffer pool set by the user, nullptr if there is none.
+                 */
+                osmium::memory::BufferPool* buffer_pool() const noexcept {
+                    return m_buffer_pool;
+                }
+
+                /**
+                 * Get a new empty buffer for the output. It comes from the
+                 * buffer pool if there is one.
+                 */
+                osmium::memory::Buffer new_buffer(std::size_t capacity) {
+                    if (m_buffer_pool) {
+                        return m_buffer_pool->get(capacity);
+                    }
+                    return osmium::memory::Buffer{capacity, osmium::memory::Buffer::auto_grow::yes};
+                }
+
                 bool header_is_done() const noexcept {
                     return m_header_is_done;
                 }
@@ -111,6 +212,7 @@ namespace osmium {
                  * Wrap the buffer into a future and add it to the output queue.
                  */
                 void send_to_output_queue(osmium::memory::Buffer&& buffer) {
+                    m_buffer_callback(buffer);
                     add_to_queue(m_output_queue, std::move(buffer));
                 }
 
@@ -118,6 +220,17 @@ namespace osmium {
                     m_output_queue.push(std::move(future));
                 }
 
+                /**
+                 * Run the function creating a buffer in the pool and add the
+                 * future for the buffer to the output queue. The decoded
+                 * buffer callback is called in the pool thread.
+                 */
+                template <typename TFunction>
+                void send_to_output_queue_from_pool(TFunction&& function) {
+                    using function_type = typename std::decay<TFunction>::type;
+                    send_to_output_queue(m_pool.submit(buffer_callback_task<function_type>{std::forward<TFunction>(function), m_buffer_callback}));
+                }
+
             public:
 
                 explicit Parser(parser_arguments& args) :
@@ -127,6 +240,11 @@ namespace osmium {
                     m_input_queue(args.input_queue),
                     m_read_which_entities(args.read_which_entities),
                     m_read_metadata(args.read_metadata),
+                    m_direct_input(args.direct_input),
+                    m_decompressor(args.decompressor),
+                    m_blob_filter(args.blob_filter),
+                    m_buffer_pool(args.buffer_pool),
+                    m_buffer_callback(args.buffer_callback),
                     m_header_is_done(false) {
                 }
 
@@ -41,6 +41,7 @@ DEALINGS IN THE SOFTWARE.
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <protozero/exception.hpp>
 #include <protozero/varint.hpp>
@@ -52,6 +53,7 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/memory/buffer_pool.hpp>
 #include <osmium/osm/box.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/item_type.hpp>
@@ -62,8 +64,10 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/osm/timestamp.hpp>
 #include <osmium/osm/types.hpp>
 #include <osmium/osm/way.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/thread/util.hpp>
 #include <osmium/util/cast.hpp>
+#include <osmium/util/config.hpp>
 #include <osmium/util/delta.hpp>
 
 namespace osmium {
@@ -143,13 +147,213 @@ namespace osmium {
 
             }; // class ReferenceTable
 
+            /**
+             * A block of o5m node, way, and relation datasets in a compact
+             * intermediate form. All delta coded values are resolved to
+             * absolute values and all string references to copies of the
+             * strings. The O5mParser creates these blocks in a sequential
+             * pass over the input. They don't depend on any decoder state,
+             * so the O5mBlockBuilder can turn them into OSM objects in the
+             * pool threads.
+             *
+             * For each object the values are: item type, id, version,
+             * timestamp, changeset, uid, offset of the user name, visible
+             * flag. Then, for nodes, longitude and latitude (only if
+             * visible), for ways the number of node refs followed by the
+             * refs, for relations the number of members followed by type,
+             * ref, and offset of the role for each member. At the end
+             * the number of tags followed by the offsets of key and value
+             * for each tag. Offsets are into the strings, which are stored
+             * one after the other, each with a terminating null byte.
+             */
+            class O5mBlock {
+
+                std::vector<int64_t> m_values;
+                std::string m_strings;
+
+            public:
+
+                void add(int64_t value) {
+                    m_values.push_back(value);
+                }
+
+                /**
+                 * Add a value which is set later with set().
+                 *
+                 * @returns The index of the value.
+                 */
+                std::size_t add_placeholder() {
+                    m_values.push_back(0);
+                    return m_values.size() - 1;
+                }
+
+                void set(std::size_t index, int64_t value) noexcept {
+                    m_values[index] = value;
+                }
+
+                void add_string(const char* str) {
+                    m_values.push_back(static_cast<int64_t>(m_strings.size()));
+                    m_strings.append(str);
+                    m_strings += '\0';
+                }
+
+                const std::vector<int64_t>& values() const noexcept {
+                    return m_values;
+                }
+
+                const char* string(int64_t offset) const noexcept {
+                    return m_strings.data() + offset;
+                }
+
+                /**
+                 * The number of bytes used by the block.
+                 */
+                std::size_t size() const noexcept {
+                    return m_values.size() * sizeof(int64_t) + m_strings.size();
+                }
+
+                bool empty() const noexcept {
+                    return m_values.empty();
+                }
+
+            }; // class O5mBlock
+
+            /**
+             * Builds the OSM objects from an O5mBlock into a buffer.
+             */
+            class O5mBlockBuilder {
+
+                static constexpr const std::size_t buffer_size = 2 * 1000 * 1000;
+
+                O5mBlock m_block;
+                osmium::memory::BufferPool* m_buffer_pool;
+
+                const int64_t* m_value = nullptr;
+
+                int64_t next() noexcept {
+                    return *m_value++;
+                }
+
+                const char* next_string() noexcept {
+                    return m_block.string(next());
+                }
+
+                // Sets the attributes and returns the visible flag.
+                template <typename TBuilder>
+                bool set_attributes(TBuilder& builder) {
+                    builder.set_id(next());
+                    auto& object = builder.object();
+                    object.set_version(static_cast<osmium::object_version_type>(next()));
+                    object.set_timestamp(next());
+                    object.set_changeset(static_cast<osmium::changeset_id_type>(next()));
+                    object.set_uid(static_cast<osmium::user_id_type>(next()));
+                    builder.set_user(next_string());
+                    const bool visible = next() != 0;
+                    if (!visible) {
+                        builder.set_visible(false);
+                    }
+                    return visible;
+                }
+
+                void add_tags(osmium::builder::Builder& parent) {
+                    const auto count = next();
+                    if (count == 0) {
+                        return;
+                    }
+                    osmium::builder::TagListBuilder builder{parent};
+                    for (int64_t i = 0; i < count; ++i) {
+                        const char* key = next_string();
+                        builder.add_tag(key, next_string());
+                    }
+                }
+
+                void build_node(osmium::memory::Buffer& buffer) {
+                    osmium::builder::NodeBuilder builder{buffer};
+                    if (set_attributes(builder)) {
+                        const auto lon = next();
+                        builder.set_location(osmium::Location{lon, next()});
+                    } else {
+                        builder.set_location(osmium::Location{});
+                    }
+                    add_tags(builder);
+                }
+
+                void build_way(osmium::memory::Buffer& buffer) {
+                    osmium::builder::WayBuilder builder{buffer};
+                    set_attributes(builder);
+                    const auto count = next();
+                    if (count > 0) {
+                        osmium::builder::WayNodeListBuilder wn_builder{builder};
+                        for (int64_t i = 0; i < count; ++i) {
+                            wn_builder.add_node_ref(next());
+                        }
+                    }
+                    add_tags(builder);
+                }
+
+                void build_relation(osmium::memory::Buffer& buffer) {
+                    osmium::builder::RelationBuilder builder{buffer};
+                    set_attributes(builder);
+                    const auto count = next();
+                    if (count > 0) {
+                        osmium::builder::RelationMemberListBuilder rml_builder{builder};
+                        for (int64_t i = 0; i < count; ++i) {
+                            const auto type = static_cast<osmium::item_type>(next());
+                            const auto ref = next();
+                            rml_builder.add_member(type, ref, next_string());
+                        }
+                    }
+                    add_tags(builder);
+                }
+
+            public:
+
+                /**
+                 * @param block The block with the data.
+                 * @param buffer_pool Pool to get the output buffer from.
+                 *                    If this is nullptr, a new buffer is
+                 *                    created.
+                 */
+                O5mBlockBuilder(O5mBlock&& block, osmium::memory::BufferPool* buffer_pool = nullptr) :
+                    m_block(std::move(block)),
+                    m_buffer_pool(buffer_pool) {
+                }
+
+                osmium::memory::Buffer operator()() {
+                    osmium::memory::Buffer buffer{m_buffer_pool ? m_buffer_pool->get(buffer_size)
+                                                                : osmium::memory::Buffer{buffer_size, osmium::memory::Buffer::auto_grow::yes}};
+
+                    m_value = m_block.values().data();
+                    const int64_t* const end = m_value + m_block.values().size();
+                    while (m_value != end) {
+                        switch (static_cast<osmium::item_type>(next())) {
+                            case osmium::item_type::node:
+                                build_node(buffer);
+                                break;
+                            case osmium::item_type::way:
+                                build_way(buffer);
+                                break;
+                            default:
+                                build_relation(buffer);
+                                break;
+                        }
+                        buffer.commit();
+                    }
+
+                    return buffer;
+                }
+
+            }; // class O5mBlockBuilder
+
             class O5mParser : public Parser {
 
-                static constexpr int buffer_size = 2 * 1000 * 1000;
+                // A block is handed to the O5mBlockBuilder when it reaches
+                // this size.
+                static constexpr const std::size_t block_size = 1024 * 1024;
 
                 osmium::io::Header m_header;
 
-                osmium::memory::Buffer m_buffer;
+                O5mBlock m_block;
 
                 std::string m_input;
 
@@ -302,8 +506,9 @@ namespace osmium {
                     return std::make_pair(static_cast_with_assert<osmium::user_id_type>(uid), user);
                 }
 
-                void decode_tags(osmium::builder::Builder& parent, const char** dataptr, const char* const end) {
-                    osmium::builder::TagListBuilder builder{parent};
+                void decode_tags(const char** dataptr, const char* const end) {
+                    const auto count_index = m_block.add_placeholder();
+                    int64_t count = 0;
 
                     while (*dataptr != end) {
                         bool update_pointer = (**dataptr == 0x00);
@@ -328,67 +533,78 @@ namespace osmium {
                             *dataptr = data;
                         }
 
-                        builder.add_tag(start, value);
+                        m_block.add_string(start);
+                        m_block.add_string(value);
+                        ++count;
                     }
+
+                    m_block.set(count_index, count);
                 }
 
-                const char* decode_info(osmium::OSMObject& object, const char** dataptr, const char* const end) {
+                // Adds version, timestamp, changeset, uid, and user to the
+                // block.
+                void decode_info(const char** dataptr, const char* const end) {
+                    object_version_type version = 0;
+                    int64_t timestamp = 0;
+                    osmium::changeset_id_type changeset = 0;
+                    osmium::user_id_type uid = 0;
                     const char* user = "";
 
                     if (**dataptr == 0x00) { // no info section
                         ++*dataptr;
                     } else { // has info section
-                        object.set_version(static_cast_with_assert<object_version_type>(protozero::decode_varint(dataptr, end)));
-                        auto timestamp = m_delta_timestamp.update(zvarint(dataptr, end));
+                        version = static_cast_with_assert<object_version_type>(protozero::decode_varint(dataptr, end));
+                        timestamp = m_delta_timestamp.update(zvarint(dataptr, end));
                         if (timestamp != 0) { // has timestamp
-                            object.set_timestamp(timestamp);
-                            object.set_changeset(m_delta_changeset.update(zvarint(dataptr, end)));
+                            changeset = m_delta_changeset.update(zvarint(dataptr, end));
                             if (*dataptr != end) {
                                 auto uid_user = decode_user(dataptr, end);
-                                object.set_uid(uid_user.first);
+                                uid = uid_user.first;
                                 user = uid_user.second;
-                            } else {
-                                object.set_uid(user_id_type(0));
                             }
                         }
                     }
 
-                    return user;
+                    m_block.add(version);
+                    m_block.add(timestamp);
+                    m_block.add(changeset);
+                    m_block.add(uid);
+                    m_block.add_string(user);
                 }
 
                 void decode_node(const char* data, const char* const end) {
-                    osmium::builder::NodeBuilder builder{m_buffer};
+                    m_block.add(static_cast<int64_t>(osmium::item_type::node));
+                    m_block.add(m_delta_id.update(zvarint(&data, end)));
 
-                    builder.set_id(m_delta_id.update(zvarint(&data, end)));
-
-                    builder.set_user(decode_info(builder.object(), &data, end));
+                    decode_info(&data, end);
 
                     if (data == end) {
                         // no location, object is deleted
-                        builder.set_visible(false);
-                        builder.set_location(osmium::Location{});
+                        m_block.add(0); // not visible
                     } else {
-                        auto lon = m_delta_lon.update(zvarint(&data, end));
-                        auto lat = m_delta_lat.update(zvarint(&data, end));
-                        builder.set_location(osmium::Location{lon, lat});
-
-                        if (data != end) {
-                            decode_tags(builder, &data, end);
-                        }
+                        m_block.add(1); // visible
+                        m_block.add(m_delta_lon.update(zvarint(&data, end)));
+                        m_block.add(m_delta_lat.update(zvarint(&data, end)));
                     }
+
+                    decode_tags(&data, end);
                 }
 
                 void decode_way(const char* data, const char* const end) {
-                    osmium::builder::WayBuilder builder{m_buffer};
+                    m_block.add(static_cast<int64_t>(osmium::item_type::way));
+                    m_block.add(m_delta_id.update(zvarint(&data, end)));
 
-                    builder.set_id(m_delta_id.update(zvarint(&data, end)));
-
-                    builder.set_user(decode_info(builder.object(), &data, end));
+                    decode_info(&data, end);
 
                     if (data == end) {
                         // no reference section, object is deleted
-                        builder.set_visible(false);
+                        m_block.add(0); // not visible
+                        m_block.add(0); // no node refs
                     } else {
+                        m_block.add(1); // visible
+                        const auto count_index = m_block.add_placeholder();
+                        int64_t count = 0;
+
                         auto reference_section_length = protozero::decode_varint(&data, end);
                         if (reference_section_length > 0) {
                             const char* const end_refs = data + reference_section_length;
@@ -396,17 +612,16 @@ namespace osmium {
                                 throw o5m_error{"way nodes ref section too long"};
                             }
 
-                            osmium::builder::WayNodeListBuilder wn_builder{builder};
-
                             while (data < end_refs) {
-                                wn_builder.add_node_ref(m_delta_way_node_id.update(zvarint(&data, end)));
+                                m_block.add(m_delta_way_node_id.update(zvarint(&data, end)));
+                                ++count;
                             }
                         }
 
-                        if (data != end) {
-                            decode_tags(builder, &data, end);
-                        }
+                        m_block.set(count_index, count);
                     }
+
+                    decode_tags(&data, end);
                 }
 
                 osmium::item_type decode_member_type(char c) {
@@ -442,16 +657,20 @@ namespace osmium {
                 }
 
                 void decode_relation(const char* data, const char* const end) {
-                    osmium::builder::RelationBuilder builder{m_buffer};
-
-                    builder.set_id(m_delta_id.update(zvarint(&data, end)));
+                    m_block.add(static_cast<int64_t>(osmium::item_type::relation));
+                    m_block.add(m_delta_id.update(zvarint(&data, end)));
 
-                    builder.set_user(decode_info(builder.object(), &data, end));
+                    decode_info(&data, end);
 
                     if (data == end) {
                         // no reference section, object is deleted
-                        builder.set_visible(false);
+                        m_block.add(0); // not visible
+                        m_block.add(0); // no members
                     } else {
+                        m_block.add(1); // visible
+                        const auto count_index = m_block.add_placeholder();
+                        int64_t count = 0;
+
                         auto reference_section_length = protozero::decode_varint(&data, end);
                         if (reference_section_length > 0) {
                             const char* const end_refs = data + reference_section_length;
@@ -459,8 +678,6 @@ namespace osmium {
                                 throw o5m_error{"relation format error"};
                             }
 
-                            osmium::builder::RelationMemberListBuilder rml_builder{builder};
-
                             while (data < end_refs) {
                                 auto delta_id = zvarint(&data, end);
                                 if (data == end) {
@@ -468,15 +685,17 @@ namespace osmium {
                                 }
                                 auto type_role = decode_role(&data, end);
                                 auto i = osmium::item_type_to_nwr_index(type_role.first);
-                                auto ref = m_delta_member_ids[i].update(delta_id);
-                                rml_builder.add_member(type_role.first, ref, type_role.second);
+                                m_block.add(static_cast<int64_t>(type_role.first));
+                                m_block.add(m_delta_member_ids[i].update(delta_id));
+                                m_block.add_string(type_role.second);
+                                ++count;
                             }
                         }
 
-                        if (data != end) {
-                            decode_tags(builder, &data, end);
-                        }
+                        m_block.set(count_index, count);
                     }
+
+                    decode_tags(&data, end);
                 }
 
                 void decode_bbox(const char* data, const char* const end) {
@@ -495,11 +714,17 @@ namespace osmium {
                     m_header.set("timestamp", timestamp);
                 }
 
+                // Hand the block to the O5mBlockBuilder which runs in the
+                // pool threads (or in this thread if so configured).
                 void flush() {
-                    osmium::memory::Buffer buffer(buffer_size);
-                    using std::swap;
-                    swap(m_buffer, buffer);
-                    send_to_output_queue(std::move(buffer));
+                    O5mBlockBuilder builder{std::move(m_block), buffer_pool()};
+                    m_block = O5mBlock{};
+
+                    if (osmium::config::use_pool_threads_for_o5m_parsing()) {
+                        send_to_output_queue_from_pool(std::move(builder));
+                    } else {
+                        send_to_output_queue(builder());
+                    }
                 }
 
                 enum class dataset_type : unsigned char {
@@ -540,21 +765,18 @@ namespace osmium {
                                     mark_header_as_done();
                                     if (read_types() & osmium::osm_entity_bits::node) {
                                         decode_node(m_data, m_data + length);
-                                        m_buffer.commit();
                                     }
                                     break;
                                 case dataset_type::way:
                                     mark_header_as_done();
                                     if (read_types() & osmium::osm_entity_bits::way) {
                                         decode_way(m_data, m_data + length);
-                                        m_buffer.commit();
                                     }
                                     break;
                                 case dataset_type::relation:
                                     mark_header_as_done();
                                     if (read_types() & osmium::osm_entity_bits::relation) {
                                         decode_relation(m_data, m_data + length);
-                                        m_buffer.commit();
                                     }
                                     break;
                                 case dataset_type::bounding_box:
@@ -574,13 +796,13 @@ namespace osmium {
 
                             m_data += length;
 
-                            if (m_buffer.committed() > buffer_size / 10 * 9) {
+                            if (m_block.size() > block_size) {
                                 flush();
                             }
                         }
                     }
 
-                    if (m_buffer.committed()) {
+                    if (!m_block.empty()) {
                         flush();
                     }
 
@@ -592,7 +814,7 @@ namespace osmium {
                 explicit O5mParser(parser_arguments& args) :
                     Parser(args),
                     m_header(),
-                    m_buffer(buffer_size),
+                    m_block(),
                     m_input(),
                     m_data(m_input.data()),
                     m_end(m_data) {
@@ -0,0 +1,407 @@
+#ifndef OSMIUM_IO_DETAIL_O5M_OUTPUT_FORMAT_HPP
+#define OSMIUM_IO_DETAIL_O5M_OUTPUT_FORMAT_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <protozero/varint.hpp>
+
+#include <osmium/io/detail/output_format.hpp>
+#include <osmium/io/detail/queue_util.hpp>
+#include <osmium/io/file.hpp>
+#include <osmium/io/file_format.hpp>
+#include <osmium/io/header.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/object.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/tag.hpp>
+#include <osmium/osm/timestamp.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/osm/way.hpp>
+#include <osmium/thread/pool.hpp>
+#include <osmium/util/delta.hpp>
+#include <osmium/visitor.hpp>
+
+namespace osmium {
+
+    namespace io {
+
+        namespace detail {
+
+            struct o5m_output_options {
+
+                /// Should metadata of objects be added?
+                bool add_metadata;
+
+            }; // struct o5m_output_options
+
+            /**
+             * Encodes a range of objects into o5m datasets. Each block
+             * starts with a reset marker and has its own string table and
+             * delta coding state, so blocks can be encoded independently
+             * and concatenated in order. A reset is also written whenever
+             * the object type changes, so readers can skip the objects of
+             * a type they are not interested in. Changesets are ignored,
+             * they can't be stored in o5m files.
+             */
+            class O5mOutputBlock : public OutputBlock {
+
+                static constexpr const uint64_t number_of_string_table_entries = 15000;
+                static constexpr const std::size_t max_string_table_entry_size = 250 + 2;
+
+                enum class dataset_type : unsigned char {
+                    node     = 0x10,
+                    way      = 0x11,
+                    relation = 0x12
+                };
+
+                o5m_output_options m_options;
+
+                // The data of the current dataset.
+                std::string m_data;
+
+                // Used for the reference section of ways and relations.
+                std::string m_refs;
+
+                // Maps strings to their position in the string table. The
+                // position is the number of strings added to the table
+                // before it.
+                std::unordered_map<std::string, uint64_t> m_string_table;
+                uint64_t m_string_table_size = 0;
+
+                osmium::item_type m_current_type = osmium::item_type::undefined;
+
+                osmium::util::DeltaEncode<osmium::object_id_type> m_delta_id;
+
+                osmium::util::DeltaEncode<int64_t> m_delta_timestamp;
+                osmium::util::DeltaEncode<osmium::changeset_id_type> m_delta_changeset;
+                osmium::util::DeltaEncode<int64_t> m_delta_lon;
+                osmium::util::DeltaEncode<int64_t> m_delta_lat;
+
+                osmium::util::DeltaEncode<osmium::object_id_type> m_delta_way_node_id;
+                osmium::util::DeltaEncode<osmium::object_id_type> m_delta_member_ids[3];
+
+                static void write_varint(std::string& out, uint64_t value) {
+                    protozero::write_varint(std::back_inserter(out), value);
+                }
+
+                static void write_zvarint(std::string& out, int64_t value) {
+                    write_varint(out, protozero::encode_zigzag64(value));
+                }
+
+                void reset() {
+                    *m_out += '\xff';
+
+                    m_string_table.clear();
+                    m_string_table_size = 0;
+
+                    m_delta_id.clear();
+                    m_delta_timestamp.clear();
+                    m_delta_changeset.clear();
+                    m_delta_lon.clear();
+                    m_delta_lat.clear();
+
+                    m_delta_way_node_id.clear();
+                    m_delta_member_ids[0].clear();
+                    m_delta_member_ids[1].clear();
+                    m_delta_member_ids[2].clear();
+                }
+
+                /**
+                 * Write a string (which must include its terminating null
+                 * bytes) either as reference into the string table or
+                 * inline. Strings written inline are added to the table
+                 * using the same rules as the reader.
+                 */
+                void write_string(std::string& out, const std::string& str) {
+                    const auto it = m_string_table.find(str);
+                    if (it != m_string_table.end()) {
+                        const auto index = m_string_table_size - it->second;
+                        if (index <= number_of_string_table_entries) {
+                            write_varint(out, index);
+                            return;
+                        }
+                    }
+
+                    out += '\0';
+                    out += str;
+
+                    if (str.size() <= max_string_table_entry_size) {
+                        m_string_table[str] = m_string_table_size++;
+                    }
+                }
+
+                void write_user(const osmium::OSMObject& object) {
+                    // Anonymous users are always written inline, because
+                    // the reader can't handle references to them.
+                    if (object.uid() == 0) {
+                        m_data.append(3, '\0');
+                        ++m_string_table_size;
+                        return;
+                    }
+
+                    std::string str;
+                    write_varint(str, object.uid());
+                    str += '\0';
+                    str += object.user();
+                    str += '\0';
+                    write_string(m_data, str);
+                }
+
+                void write_info(const osmium::OSMObject& object) {
+                    if (!m_options.add_metadata || object.version() == 0) {
+                        m_data += '\0';
+                        return;
+                    }
+
+                    write_varint(m_data, object.version());
+                    const auto timestamp = object.timestamp().seconds_since_epoch();
+                    write_zvarint(m_data, m_delta_timestamp.update(timestamp));
+                    if (timestamp != 0) {
+                        write_zvarint(m_data, m_delta_changeset.update(object.changeset()));
+                        write_user(object);
+                    }
+                }
+
+                void write_tags(const osmium::TagList& tags) {
+                    std::string str;
+                    for (const auto& tag : tags) {
+                        str.assign(tag.key());
+                        str += '\0';
+                        str += tag.value();
+                        str += '\0';
+                        write_string(m_data, str);
+                    }
+                }
+
+                // Start a dataset for an object, writing a reset first if
+                // the type of the object is different from the last one.
+                void start_object(const osmium::OSMObject& object) {
+                    if (object.type() != m_current_type) {
+                        reset();
+                        m_current_type = object.type();
+                    }
+
+                    m_data.clear();
+                    write_zvarint(m_data, m_delta_id.update(object.id()));
+                    write_info(object);
+                }
+
+                void write_dataset(dataset_type type) {
+                    *m_out += static_cast<char>(type);
+                    write_varint(*m_out, m_data.size());
+                    *m_out += m_data;
+                }
+
+                void write_refs() {
+                    write_varint(m_data, m_refs.size());
+                    m_data += m_refs;
+                }
+
+            public:
+
+                O5mOutputBlock(const std::shared_ptr<osmium::memory::Buffer>& buffer,
+                               osmium::memory::Buffer::const_iterator begin,
+                               osmium::memory::Buffer::const_iterator end,
+                               const o5m_output_options& options) :
+                    OutputBlock(buffer, begin, end),
+                    m_options(options) {
+                }
+
+                std::string operator()() {
+                    osmium::apply(m_begin, m_end, *this);
+
+                    std::string out;
+                    using std::swap;
+                    swap(out, *m_out);
+
+                    return out;
+                }
+
+                void node(const osmium::Node& node) {
+                    start_object(node);
+
+                    if (node.visible()) {
+                        write_zvarint(m_data, m_delta_lon.update(node.location().x()));
+                        write_zvarint(m_data, m_delta_lat.update(node.location().y()));
+                        write_tags(node.tags());
+                    }
+
+                    write_dataset(dataset_type::node);
+                }
+
+                void way(const osmium::Way& way) {
+                    start_object(way);
+
+                    if (way.visible()) {
+                        m_refs.clear();
+                        for (const auto& node_ref : way.nodes()) {
+                            write_zvarint(m_refs, m_delta_way_node_id.update(node_ref.ref()));
+                        }
+                        write_refs();
+                        write_tags(way.tags());
+                    }
+
+                    write_dataset(dataset_type::way);
+                }
+
+                void relation(const osmium::Relation& relation) {
+                    start_object(relation);
+
+                    if (relation.visible()) {
+                        m_refs.clear();
+                        std::string str;
+                        for (const auto& member : relation.members()) {
+                            const auto i = osmium::item_type_to_nwr_index(member.type());
+                            write_zvarint(m_refs, m_delta_member_ids[i].update(member.ref()));
+                            str.assign(1, static_cast<char>('0' + i));
+                            str += member.role();
+                            str += '\0';
+                            write_string(m_refs, str);
+                        }
+                        write_refs();
+                        write_tags(relation.tags());
+                    }
+
+                    write_dataset(dataset_type::relation);
+                }
+
+            }; // class O5mOutputBlock
+
+            /**
+             * Writes o5m and o5c files. The two only differ in the file
+             * type in the header. Deleted objects (visible flag not set)
+             * are written in both, as datasets with only the id and the
+             * metadata, because o5m history files can contain them, too.
+             * Filter out deleted objects before writing if they are not
+             * wanted in an o5m file.
+             */
+            class O5mOutputFormat : public osmium::io::detail::OutputFormat {
+
+                o5m_output_options m_options;
+                bool m_change_format;
+
+                static void write_zvarint(std::string& out, int64_t value) {
+                    protozero::write_varint(std::back_inserter(out), protozero::encode_zigzag64(value));
+                }
+
+                static void write_dataset(std::string& out, unsigned char type, const std::string& data) {
+                    out += static_cast<char>(type);
+                    protozero::write_varint(std::back_inserter(out), data.size());
+                    out += data;
+                }
+
+            public:
+
+                O5mOutputFormat(osmium::thread::Pool& pool, const osmium::io::File& file, future_string_queue_type& output_queue) :
+                    OutputFormat(pool, output_queue),
+                    m_options(),
+                    m_change_format(file.is_true("o5c_change_format")) {
+                    m_options.add_metadata = file.is_not_false("add_metadata");
+                }
+
+                O5mOutputFormat(const O5mOutputFormat&) = delete;
+                O5mOutputFormat& operator=(const O5mOutputFormat&) = delete;
+
+                ~O5mOutputFormat() noexcept final = default;
+
+                void write_header(const osmium::io::Header& header) final {
+                    std::string out{"\xff\xe0\x04o5"};
+                    out += m_change_format ? 'c' : 'm';
+                    out += '2';
+
+                    const auto box = header.joined_boxes();
+                    if (box.valid()) {
+                        std::string data;
+                        write_zvarint(data, box.bottom_left().x());
+                        write_zvarint(data, box.bottom_left().y());
+                        write_zvarint(data, box.top_right().x());
+                        write_zvarint(data, box.top_right().y());
+                        write_dataset(out, 0xdb, data);
+                    }
+
+                    const auto timestamp = header.get("timestamp");
+                    if (!timestamp.empty()) {
+                        try {
+                            std::string data;
+                            write_zvarint(data, osmium::Timestamp{timestamp}.seconds_since_epoch());
+                            write_dataset(out, 0xdc, data);
+                        } catch (const std::invalid_argument&) {
+                            // ignore timestamps in the wrong format
+                        }
+                    }
+
+                    send_to_output_queue(std::move(out));
+                }
+
+                void write_buffer(osmium::memory::Buffer&& buffer) final {
+                    encode_in_blocks<O5mOutputBlock>(std::move(buffer), m_options);
+                }
+
+                void write_end() final {
+                    send_to_output_queue(std::string(1, '\xfe'));
+                }
+
+            }; // class O5mOutputFormat
+
+            // we want the register_output_format() function to run, setting
+            // the variable is only a side-effect, it will never be used
+            const bool registered_o5m_output = osmium::io::detail::OutputFormatFactory::instance().register_output_format(osmium::io::file_format::o5m,
+                [](osmium::thread::Pool& pool, const osmium::io::File& file, future_string_queue_type& output_queue) {
+                    return new osmium::io::detail::O5mOutputFormat(pool, file, output_queue);
+            });
+
+            // dummy function to silence the unused variable warning from above
+            inline bool get_registered_o5m_output() noexcept {
+                return registered_o5m_output;
+            }
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_DETAIL_O5M_OUTPUT_FORMAT_HPP
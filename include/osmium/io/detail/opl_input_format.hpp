@@ -33,6 +33,8 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -43,7 +45,11 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/memory/buffer_pool.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/thread/util.hpp>
+#include <osmium/util/config.hpp>
 
 namespace osmium {
 
@@ -51,65 +57,100 @@ namespace osmium {
 
         namespace detail {
 
-            // Feed data coming in blocks line by line to the OPL parser
-            // function. This has been broken out of the OPLParser class
-            // where it belongs into a standalone template function to be
-            // better testable.
-            template <typename T>
-            void line_by_line(T& worker) {
-                std::string rest;
+            /**
+             * Count the lines in the data that are not empty. The OPL
+             * parser counts lines this way for error messages.
+             */
+            inline uint64_t count_nonempty_lines(const std::string& data) noexcept {
+                uint64_t count = 0;
+                bool at_start_of_line = true;
+                for (const char c : data) {
+                    if (c == '\n' || c == '\r') {
+                        at_start_of_line = true;
+                    } else if (at_start_of_line) {
+                        ++count;
+                        at_start_of_line = false;
+                    }
+                }
+                return count;
+            }
 
-                while (!worker.input_done()) {
-                    std::string input{worker.get_input()};
-                    std::string::size_type ppos = 0;
+            /**
+             * Parses a chunk of OPL data consisting of complete lines into
+             * a buffer. Chunks are independent of each other, so this can
+             * run in the pool threads.
+             */
+            class OPLChunkParser {
 
-                    if (!rest.empty()) {
-                        ppos = input.find_first_of("\n\r");
-                        if (ppos == std::string::npos) {
-                            rest.append(input);
-                            continue;
-                        }
-                        rest.append(input, 0, ppos);
-                        if (!rest.empty()) {
-                            worker.parse_line(rest.data());
-                            rest.clear();
-                        }
-                        ++ppos;
-                    }
+                static constexpr const std::size_t buffer_size = 1024 * 1024;
 
-                    for (auto pos = input.find_first_of("\n\r", ppos);
-                         pos != std::string::npos;
-                         pos = input.find_first_of("\n\r", ppos)) {
-                        const char* data = &input[ppos];
-                        input[pos] = '\0';
-                        if (data[0] != '\0') {
-                            worker.parse_line(data);
+                std::string m_data;
+                uint64_t m_first_line;
+                osmium::osm_entity_bits::type m_read_types;
+                osmium::memory::BufferPool* m_buffer_pool;
+
+            public:
+
+                /**
+                 * @param data The OPL data. Must start at the beginning of
+                 *             a line and end at the end of a line.
+                 * @param first_line Line number of the first (non-empty)
+                 *                   line in the data for error messages.
+                 * @param read_types Which entities should be parsed?
+                 * @param buffer_pool Pool to get the output buffer from.
+                 *                    If this is nullptr, a new buffer is
+                 *                    created.
+                 */
+                OPLChunkParser(std::string&& data, uint64_t first_line, osmium::osm_entity_bits::type read_types, osmium::memory::BufferPool* buffer_pool = nullptr) :
+                    m_data(std::move(data)),
+                    m_first_line(first_line),
+                    m_read_types(read_types),
+                    m_buffer_pool(buffer_pool) {
+                }
+
+                osmium::memory::Buffer operator()() {
+                    osmium::memory::Buffer buffer{m_buffer_pool ? m_buffer_pool->get(buffer_size)
+                                                                : osmium::memory::Buffer{buffer_size, osmium::memory::Buffer::auto_grow::yes}};
+
+                    uint64_t line_count = m_first_line;
+                    char* data = &m_data[0];
+                    char* const end = data + m_data.size();
+                    while (data != end) {
+                        char* eol = std::find_if(data, end, [](char c) {
+                            return c == '\n' || c == '\r';
+                        });
+                        if (eol != end) {
+                            *eol++ = '\0';
                         }
-                        ppos = pos + 1;
-                        if (ppos >= input.size()) {
-                            break;
+                        if (data[0] != '\0') {
+                            opl_parse_line(line_count, data, buffer, m_read_types);
+                            ++line_count;
                         }
+                        data = eol;
                     }
-                    rest.assign(input, ppos, std::string::npos);
-                }
 
-                if (!rest.empty()) {
-                    worker.parse_line(rest.data());
+                    return buffer;
                 }
-            }
+
+            }; // class OPLChunkParser
 
             class OPLParser : public Parser {
 
-                osmium::memory::Buffer m_buffer{1024*1024};
+                // The input is cut into chunks of about this size at line
+                // boundaries. The chunks are parsed in parallel.
+                static constexpr const std::size_t chunk_size = 1024 * 1024;
+
                 uint64_t m_line_count = 0;
 
-                void maybe_flush() {
-                    if (m_buffer.committed() > 800*1024) {
-                        osmium::memory::Buffer buffer{1024*1024};
-                        using std::swap;
-                        swap(m_buffer, buffer);
-                        send_to_output_queue(std::move(buffer));
+                void parse_chunk(std::string&& data) {
+                    const auto lines = count_nonempty_lines(data);
+                    OPLChunkParser chunk_parser{std::move(data), m_line_count, read_types(), buffer_pool()};
+                    m_line_count += lines;
 
+                    if (osmium::config::use_pool_threads_for_opl_parsing()) {
+                        send_to_output_queue_from_pool(std::move(chunk_parser));
+                    } else {
+                        send_to_output_queue(chunk_parser());
                     }
                 }
 
@@ -122,20 +163,35 @@ namespace osmium {
 
                 ~OPLParser() noexcept final = default;
 
-                void parse_line(const char* data) {
-                    if (opl_parse_line(m_line_count, data, m_buffer, read_types())) {
-                        maybe_flush();
-                    }
-                    ++m_line_count;
-                }
-
                 void run() final {
                     osmium::thread::set_thread_name("_osmium_opl_in");
 
-                    line_by_line(*this);
+                    // Data not yet handed to a chunk parser. It always
+                    // starts at the beginning of a line.
+                    std::string rest;
 
-                    if (m_buffer.committed() > 0) {
-                        send_to_output_queue(std::move(m_buffer));
+                    while (!input_done()) {
+                        std::string input{get_input()};
+                        if (rest.empty()) {
+                            rest = std::move(input);
+                        } else {
+                            rest.append(input);
+                        }
+
+                        std::string::size_type start = 0;
+                        while (rest.size() - start >= chunk_size) {
+                            const auto pos = rest.find_first_of("\n\r", start + chunk_size - 1);
+                            if (pos == std::string::npos) {
+                                break;
+                            }
+                            parse_chunk(rest.substr(start, pos + 1 - start));
+                            start = pos + 1;
+                        }
+                        rest.erase(0, start);
+                    }
+
+                    if (!rest.empty()) {
+                        parse_chunk(std::move(rest));
                     }
                 }
 
@@ -162,13 +162,16 @@ namespace osmium {
 
             public:
 
-                OPLOutputBlock(osmium::memory::Buffer&& buffer, const opl_output_options& options) :
-                    OutputBlock(std::move(buffer)),
+                OPLOutputBlock(const std::shared_ptr<osmium::memory::Buffer>& buffer,
+                               osmium::memory::Buffer::const_iterator begin,
+                               osmium::memory::Buffer::const_iterator end,
+                               const opl_output_options& options) :
+                    OutputBlock(buffer, begin, end),
                     m_options(options) {
                 }
 
                 std::string operator()() {
-                    osmium::apply(m_input_buffer->cbegin(), m_input_buffer->cend(), *this);
+                    osmium::apply(m_begin, m_end, *this);
 
                     std::string out;
                     using std::swap;
@@ -290,7 +293,7 @@ namespace osmium {
                 ~OPLOutputFormat() noexcept final = default;
 
                 void write_buffer(osmium::memory::Buffer&& buffer) final {
-                    m_output_queue.push(m_pool.submit(OPLOutputBlock{std::move(buffer), m_options}));
+                    encode_in_blocks<OPLOutputBlock>(std::move(buffer), m_options);
                 }
 
             }; // class OPLOutputFormat
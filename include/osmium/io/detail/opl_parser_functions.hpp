@@ -43,6 +43,7 @@ DEALINGS IN THE SOFTWARE.
 #include <utf8.h>
 
 #include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/io/detail/opl_scan.hpp>
 #include <osmium/io/error.hpp>
 #include <osmium/memory/buffer.hpp>
 #include <osmium/osm/box.hpp>
@@ -132,9 +133,7 @@ namespace osmium {
              * string.
              */
             inline const char* opl_skip_section(const char** s) noexcept {
-                while (opl_non_empty(*s)) {
-                    ++*s;
-                }
+                *s = opl_scan::find_section_end(*s);
                 return *s;
             }
 
@@ -185,17 +184,15 @@ namespace osmium {
             inline void opl_parse_string(const char** data, std::string& result) {
                 const char* s = *data;
                 while (true) {
-                    if (*s == '\0' || *s == ' ' || *s == '\t' || *s == ',' || *s == '=') {
-                        break;
-                    } else if (*s == '%') {
-                        ++s;
-                        opl_parse_escaped(&s, result);
-                    } else {
-                        result += *s;
-                        ++s;
+                    const char* end = opl_scan::find_string_end(s);
+                    result.append(s, end);
+                    if (*end != '%') {
+                        *data = end;
+                        return;
                     }
+                    s = end + 1;
+                    opl_parse_escaped(&s, result);
                 }
-                *data = s;
             }
 
             // Arbitrary limit how long integers can get
@@ -211,21 +208,16 @@ namespace osmium {
                     ++*s;
                 }
 
-                int64_t value = 0;
-
-                int n = max_int_len;
-                while (**s >= '0' && **s <= '9') {
-                    if (--n == 0) {
-                        throw opl_error{"integer too long", *s};
-                    }
-                    value *= 10;
-                    value += **s - '0';
-                    ++*s;
-                }
-
-                if (n == max_int_len) {
+                const char* end = opl_scan::find_digits_end(*s);
+                if (end == *s) {
                     throw opl_error{"expected integer", *s};
                 }
+                if (end - *s >= max_int_len) {
+                    throw opl_error{"integer too long", *s + max_int_len - 1};
+                }
+
+                auto value = static_cast<int64_t>(opl_scan::digits_to_uint(*s, end));
+                *s = end;
 
                 if (negative) {
                     value = -value;
@@ -0,0 +1,218 @@
+#ifndef OSMIUM_IO_DETAIL_OPL_SCAN_HPP
+#define OSMIUM_IO_DETAIL_OPL_SCAN_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <cstdint>
+#include <cstring>
+
+#include <osmium/io/detail/simd_scan.hpp>
+#include <osmium/util/endian.hpp>
+
+namespace osmium {
+
+    namespace io {
+
+        namespace detail {
+
+            /**
+             * Functions to find the end of fields in OPL data and to
+             * convert runs of digits into integers. There are scalar
+             * versions which work everywhere and vector versions using
+             * SSE2 which are used if the compiler supports them (which
+             * is always the case on x86_64). Define OSMIUM_NO_SIMD to
+             * always use the scalar versions.
+             *
+             * All functions work on null-terminated strings.
+             */
+            namespace opl_scan {
+
+                inline bool is_string_end(char c) noexcept {
+                    return c == '\0' || c == ' ' || c == '\t' || c == ',' || c == '=' || c == '%';
+                }
+
+                inline bool is_section_end(char c) noexcept {
+                    return c == '\0' || c == ' ' || c == '\t';
+                }
+
+                inline bool is_digit(char c) noexcept {
+                    return c >= '0' && c <= '9';
+                }
+
+                inline const char* scalar_find_string_end(const char* s) noexcept {
+                    while (!is_string_end(*s)) {
+                        ++s;
+                    }
+                    return s;
+                }
+
+                inline const char* scalar_find_section_end(const char* s) noexcept {
+                    while (!is_section_end(*s)) {
+                        ++s;
+                    }
+                    return s;
+                }
+
+                inline const char* scalar_find_digits_end(const char* s) noexcept {
+                    while (is_digit(*s)) {
+                        ++s;
+                    }
+                    return s;
+                }
+
+                inline uint64_t scalar_digits_to_uint(const char* s, const char* e) noexcept {
+                    uint64_t value = 0;
+                    for (; s != e; ++s) {
+                        value = value * 10 + static_cast<uint64_t>(*s - '0');
+                    }
+                    return value;
+                }
+
+#ifdef OSMIUM_SIMD_SCAN_SSE2
+
+                // Returns a bit mask with a bit set for each byte in the
+                // block which is one of the characters marking the end of
+                // a string.
+                inline uint32_t string_end_mask(__m128i block) noexcept {
+                    __m128i m = _mm_cmpeq_epi8(block, _mm_setzero_si128());
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8(' ')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\t')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8(',')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('=')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('%')));
+                    return static_cast<uint32_t>(_mm_movemask_epi8(m));
+                }
+
+                inline uint32_t section_end_mask(__m128i block) noexcept {
+                    __m128i m = _mm_cmpeq_epi8(block, _mm_setzero_si128());
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8(' ')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\t')));
+                    return static_cast<uint32_t>(_mm_movemask_epi8(m));
+                }
+
+                // Bytes with the high bit set are negative and compare as
+                // less than '0', so they are correctly treated as non-digits.
+                inline uint32_t non_digit_mask(__m128i block) noexcept {
+                    const __m128i m = _mm_or_si128(_mm_cmplt_epi8(block, _mm_set1_epi8('0')),
+                                                   _mm_cmpgt_epi8(block, _mm_set1_epi8('9')));
+                    return static_cast<uint32_t>(_mm_movemask_epi8(m));
+                }
+
+#endif
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+
+                /**
+                 * Convert exactly eight digits into an integer using SWAR
+                 * (SIMD within a register): Neighbouring digits are
+                 * combined into two-digit, then four-digit, then the full
+                 * number with three multiplications.
+                 */
+                inline uint64_t eight_digits_to_uint(const char* s) noexcept {
+                    uint64_t chunk;
+                    std::memcpy(&chunk, s, sizeof(chunk));
+                    chunk &= 0x0f0f0f0f0f0f0f0fULL;
+                    chunk = ((chunk * 10) + (chunk >> 8)) & 0x00ff00ff00ff00ffULL;
+                    chunk = ((chunk * 100) + (chunk >> 16)) & 0x0000ffff0000ffffULL;
+                    chunk = ((chunk * 10000) + (chunk >> 32)) & 0x00000000ffffffffULL;
+                    return chunk;
+                }
+
+#endif
+
+                /**
+                 * Find the first character in s which ends an OPL string,
+                 * ie. one of '\0', ' ', '\t', ',', '=', or the start of an
+                 * escape sequence '%'.
+                 */
+                inline const char* find_string_end(const char* s) noexcept {
+#ifdef OSMIUM_SIMD_SCAN_SSE2
+                    return simd_scan::find<string_end_mask>(s);
+#else
+                    return scalar_find_string_end(s);
+#endif
+                }
+
+                /**
+                 * Find the first character in s which ends an OPL section,
+                 * ie. one of '\0', ' ', or '\t'.
+                 */
+                inline const char* find_section_end(const char* s) noexcept {
+#ifdef OSMIUM_SIMD_SCAN_SSE2
+                    return simd_scan::find<section_end_mask>(s);
+#else
+                    return scalar_find_section_end(s);
+#endif
+                }
+
+                /**
+                 * Find the first character in s which is not a digit.
+                 */
+                inline const char* find_digits_end(const char* s) noexcept {
+#ifdef OSMIUM_SIMD_SCAN_SSE2
+                    return simd_scan::find<non_digit_mask>(s);
+#else
+                    return scalar_find_digits_end(s);
+#endif
+                }
+
+                /**
+                 * Convert the digits in the range [s, e) into an integer.
+                 * All characters in the range must be digits, there must
+                 * not be more than 19 of them.
+                 */
+                inline uint64_t digits_to_uint(const char* s, const char* e) noexcept {
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+                    uint64_t value = 0;
+                    while (e - s >= 8) {
+                        value = value * 100000000ULL + eight_digits_to_uint(s);
+                        s += 8;
+                    }
+                    for (; s != e; ++s) {
+                        value = value * 10 + static_cast<uint64_t>(*s - '0');
+                    }
+                    return value;
+#else
+                    return scalar_digits_to_uint(s, e);
+#endif
+                }
+
+            } // namespace opl_scan
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_DETAIL_OPL_SCAN_HPP
@@ -34,6 +34,7 @@ DEALINGS IN THE SOFTWARE.
 */
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -58,16 +59,27 @@ namespace osmium {
 
         namespace detail {
 
+            /**
+             * Base class for the blocks of the text output formats. A block
+             * encodes a range of objects from an input buffer into a
+             * string. Several blocks can share the same buffer.
+             */
             class OutputBlock : public osmium::handler::Handler {
 
             protected:
 
                 std::shared_ptr<osmium::memory::Buffer> m_input_buffer;
+                osmium::memory::Buffer::const_iterator m_begin;
+                osmium::memory::Buffer::const_iterator m_end;
 
                 std::shared_ptr<std::string> m_out;
 
-                explicit OutputBlock(osmium::memory::Buffer&& buffer) :
-                    m_input_buffer(std::make_shared<osmium::memory::Buffer>(std::move(buffer))),
+                OutputBlock(const std::shared_ptr<osmium::memory::Buffer>& buffer,
+                            osmium::memory::Buffer::const_iterator begin,
+                            osmium::memory::Buffer::const_iterator end) :
+                    m_input_buffer(buffer),
+                    m_begin(begin),
+                    m_end(end),
                     m_out(std::make_shared<std::string>()) {
                 }
 
@@ -108,6 +120,10 @@ namespace osmium {
 
             protected:
 
+                // Buffers are split into ranges of about this many bytes
+                // which are encoded in parallel by the text formats.
+                static constexpr const std::size_t max_block_input_size = 1024 * 1024;
+
                 osmium::thread::Pool& m_pool;
                 future_string_queue_type& m_output_queue;
 
@@ -119,6 +135,47 @@ namespace osmium {
                     add_to_queue(m_output_queue, std::move(data));
                 }
 
+                /**
+                 * Split the buffer into ranges of objects with about
+                 * max_block_input_size bytes each and call
+                 * func(begin, end) for each range in order.
+                 */
+                template <typename TFunction>
+                static void for_each_block(const osmium::memory::Buffer& buffer, TFunction&& func) {
+                    auto begin = buffer.cbegin();
+                    const auto end = buffer.cend();
+                    while (begin != end) {
+                        auto it = begin;
+                        std::size_t size = 0;
+                        do {
+                            size += it->byte_size();
+                            ++it;
+                        } while (it != end && size < max_block_input_size);
+                        func(begin, it);
+                        begin = it;
+                    }
+                }
+
+                /**
+                 * Encode the objects in the buffer in the pool threads.
+                 *
+                 * The buffer is split into ranges of objects with about
+                 * max_block_input_size bytes each. A TBlock is created for
+                 * each range with the range and the args, and submitted to
+                 * the pool. The resulting futures are added to the output
+                 * queue in order, so the output is in the same order as the
+                 * input. Because adding to the output queue blocks when it
+                 * is full, the amount of data in flight is bounded.
+                 */
+                template <typename TBlock, typename... TArgs>
+                void encode_in_blocks(osmium::memory::Buffer&& buffer, const TArgs&... args) {
+                    const auto input = std::make_shared<osmium::memory::Buffer>(std::move(buffer));
+
+                    for_each_block(*input, [&](osmium::memory::Buffer::const_iterator begin, osmium::memory::Buffer::const_iterator end) {
+                        m_output_queue.push(m_pool.submit(TBlock{input, begin, end, args...}));
+                    });
+                }
+
             public:
 
                 OutputFormat(osmium::thread::Pool& pool, future_string_queue_type& output_queue) noexcept :
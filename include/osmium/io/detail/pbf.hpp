@@ -80,6 +80,11 @@ namespace osmium {
 
             const int64_t resolution_convert = lonlat_resolution / osmium::detail::coordinate_precision;
 
+            // magic string and format version identifying the contents of
+            // the BlobHeader indexdata field written by Osmium
+            const char* const indexdata_magic = "osmium-indexdata";
+            const uint32_t indexdata_version = 1;
+
         } // namespace detail
 
     } // namespace io
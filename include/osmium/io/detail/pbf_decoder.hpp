@@ -47,12 +47,20 @@ DEALINGS IN THE SOFTWARE.
 #include <protozero/types.hpp>
 
 #include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/io/blob_index.hpp>
 #include <osmium/io/detail/pbf.hpp> // IWYU pragma: export
 #include <osmium/io/detail/protobuf_tags.hpp>
 #include <osmium/io/detail/zlib.hpp>
+#ifdef OSMIUM_WITH_LZ4
+# include <osmium/io/detail/lz4.hpp>
+#endif
+#ifdef OSMIUM_WITH_ZSTD
+# include <osmium/io/detail/zstd.hpp>
+#endif
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/memory/buffer_pool.hpp>
 #include <osmium/osm/box.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/item_type.hpp>
@@ -79,12 +87,33 @@ namespace osmium {
             using protozero::data_view;
             using osm_string_len_type = std::pair<const char*, osmium::string_size_type>;
 
+            /**
+             * Scratch space needed while decoding a data blob: The
+             * uncompressed blob and the string table. The memory allocated
+             * for these is kept around and reused for the next blob decoded
+             * in the same thread, so we don't have to allocate and free
+             * (and page fault) several megabytes for every blob.
+             */
+            struct pbf_decode_scratch {
+                std::string uncompressed;
+                std::vector<osm_string_len_type> stringtable;
+            }; // struct pbf_decode_scratch
+
+            /**
+             * Get the scratch space for decoding blobs in the current
+             * thread. Each thread (usually the pool threads) has its own.
+             */
+            inline pbf_decode_scratch& thread_decode_scratch() {
+                static thread_local pbf_decode_scratch scratch;
+                return scratch;
+            }
+
             class PBFPrimitiveBlockDecoder {
 
                 static constexpr const size_t initial_buffer_size = 2 * 1024 * 1024;
 
                 data_view m_data;
-                std::vector<osm_string_len_type> m_stringtable;
+                std::vector<osm_string_len_type>& m_stringtable;
 
                 int64_t m_lon_offset = 0;
                 int64_t m_lat_offset = 0;
@@ -93,7 +122,7 @@ namespace osmium {
 
                 osmium::osm_entity_bits::type m_read_types;
 
-                osmium::memory::Buffer m_buffer { initial_buffer_size };
+                osmium::memory::Buffer m_buffer;
 
                 osmium::io::read_meta m_read_metadata;
 
@@ -689,10 +718,26 @@ namespace osmium {
 
             public:
 
-                PBFPrimitiveBlockDecoder(const data_view& data, osmium::osm_entity_bits::type read_types, osmium::io::read_meta read_metadata) :
+                /**
+                 * Construct decoder for a primitive block.
+                 *
+                 * @param data The uncompressed primitive block.
+                 * @param stringtable Vector used to store the string table.
+                 *                    It will be cleared, its memory is
+                 *                    reused.
+                 * @param read_types Which entities should be decoded?
+                 * @param read_metadata Should metadata be decoded?
+                 * @param buffer_pool Pool to get the output buffer from.
+                 *                    If this is nullptr, a new buffer is
+                 *                    created.
+                 */
+                PBFPrimitiveBlockDecoder(const data_view& data, std::vector<osm_string_len_type>& stringtable, osmium::osm_entity_bits::type read_types, osmium::io::read_meta read_metadata, osmium::memory::BufferPool* buffer_pool = nullptr) :
                     m_data(data),
+                    m_stringtable(stringtable),
                     m_read_types(read_types),
+                    m_buffer(buffer_pool ? buffer_pool->get(initial_buffer_size) : osmium::memory::Buffer{initial_buffer_size}),
                     m_read_metadata(read_metadata) {
+                    m_stringtable.clear();
                 }
 
                 PBFPrimitiveBlockDecoder(const PBFPrimitiveBlockDecoder&) = delete;
@@ -716,9 +761,15 @@ namespace osmium {
 
             }; // class PBFPrimitiveBlockDecoder
 
-            inline data_view decode_blob(const std::string& blob_data, std::string& output) {
+            inline data_view decode_blob(const data_view& blob_data, std::string& output) {
                 int32_t raw_size = 0;
                 protozero::data_view zlib_data;
+#ifdef OSMIUM_WITH_LZ4
+                protozero::data_view lz4_data;
+#endif
+#ifdef OSMIUM_WITH_ZSTD
+                protozero::data_view zstd_data;
+#endif
 
                 protozero::pbf_message<FileFormat::Blob> pbf_blob{blob_data};
                 while (pbf_blob.next()) {
@@ -742,18 +793,54 @@ namespace osmium {
                             break;
                         case FileFormat::Blob::optional_bytes_lzma_data:
                             throw osmium::pbf_error{"lzma blobs not implemented"};
+                        case FileFormat::Blob::optional_bytes_lz4_data:
+#ifdef OSMIUM_WITH_LZ4
+                            lz4_data = pbf_blob.get_view();
+                            break;
+#else
+                            throw osmium::pbf_error{"lz4 blobs not supported (libosmium was compiled without lz4)"};
+#endif
+                        case FileFormat::Blob::optional_bytes_zstd_data:
+#ifdef OSMIUM_WITH_ZSTD
+                            zstd_data = pbf_blob.get_view();
+                            break;
+#else
+                            throw osmium::pbf_error{"zstd blobs not supported (libosmium was compiled without zstd)"};
+#endif
                         default:
                             throw osmium::pbf_error{"unknown compression"};
                     }
                 }
 
-                if (!zlib_data.empty() && raw_size != 0) {
-                    return osmium::io::detail::zlib_uncompress_string(
-                        zlib_data.data(),
-                        static_cast<unsigned long>(zlib_data.size()),
-                        static_cast<unsigned long>(raw_size),
-                        output
-                    );
+                if (raw_size != 0) {
+                    if (!zlib_data.empty()) {
+                        return osmium::io::detail::zlib_uncompress_string(
+                            zlib_data.data(),
+                            static_cast<unsigned long>(zlib_data.size()),
+                            static_cast<unsigned long>(raw_size),
+                            output
+                        );
+                    }
+#ifdef OSMIUM_WITH_LZ4
+                    if (!lz4_data.empty()) {
+                        return osmium::io::detail::lz4_uncompress_string(
+                            lz4_data.data(),
+                            lz4_data.size(),
+                            static_cast<std::size_t>(raw_size),
+                            output
+                        );
+                    }
+#endif
+#ifdef OSMIUM_WITH_ZSTD
+                    if (!zstd_data.empty()) {
+                        return osmium::io::detail::zstd_uncompress_string(
+                            zstd_data.data(),
+                            zstd_data.size(),
+                            static_cast<std::size_t>(raw_size),
+                            output
+                        );
+                    }
+#endif
                 }
 
                 throw osmium::pbf_error{"blob contains no data"};
@@ -826,7 +913,13 @@ namespace osmium {
                             }
                             break;
                         case OSMFormat::HeaderBlock::repeated_string_optional_features:
-                            header.set("pbf_optional_feature_" + std::to_string(i++), pbf_header_block.get_string());
+                            {
+                                const auto feature = pbf_header_block.get_string();
+                                if (feature == "Sort.Type_then_ID") {
+                                    header.set("sorting", "Type_then_ID");
+                                }
+                                header.set("pbf_optional_feature_" + std::to_string(i++), feature);
+                            }
                             break;
                         case OSMFormat::HeaderBlock::optional_string_writingprogram:
                             header.set("generator", pbf_header_block.get_string());
@@ -859,29 +952,146 @@ namespace osmium {
              * @returns Header object
              * @throws osmium::pbf_error If there was a parsing error
              */
-            inline osmium::io::Header decode_header(const std::string& header_block_data) {
+            inline osmium::io::Header decode_header(const data_view& header_block_data) {
                 std::string output;
 
                 return decode_header_block(decode_blob(header_block_data, output));
             }
 
+            /**
+             * Decode the BlobHeader. Make sure it contains the expected
+             * type. Return the size of the following Blob.
+             *
+             * If indexdata is not nullptr, it is set to the contents of the
+             * optional indexdata field (or an empty view if there is none).
+             */
+            inline size_t decode_blob_header(protozero::pbf_message<FileFormat::BlobHeader>&& pbf_blob_header, const char* expected_type, protozero::data_view* indexdata = nullptr) {
+                protozero::data_view blob_header_type;
+                size_t blob_header_datasize = 0;
+
+                if (indexdata) {
+                    *indexdata = protozero::data_view{};
+                }
+
+                while (pbf_blob_header.next()) {
+                    switch (pbf_blob_header.tag()) {
+                        case FileFormat::BlobHeader::required_string_type:
+                            blob_header_type = pbf_blob_header.get_view();
+                            break;
+                        case FileFormat::BlobHeader::optional_bytes_indexdata:
+                            if (indexdata) {
+                                *indexdata = pbf_blob_header.get_view();
+                            } else {
+                                pbf_blob_header.skip();
+                            }
+                            break;
+                        case FileFormat::BlobHeader::required_int32_datasize:
+                            blob_header_datasize = pbf_blob_header.get_int32();
+                            break;
+                        default:
+                            pbf_blob_header.skip();
+                    }
+                }
+
+                if (blob_header_datasize == 0) {
+                    throw osmium::pbf_error{"PBF format error: BlobHeader.datasize missing or zero."};
+                }
+
+                if (std::strncmp(expected_type, blob_header_type.data(), blob_header_type.size())) {
+                    throw osmium::pbf_error{"blob does not have expected type (OSMHeader in first blob, OSMData in following blobs)"};
+                }
+
+                return blob_header_datasize;
+            }
+
+            /**
+             * Decode the contents of the BlobHeader indexdata field as
+             * written by Osmium into the entry. The indexdata field can
+             * contain anything, so this only succeeds if it has Osmium's
+             * magic string, a known version, and contains the entity
+             * types. Otherwise the entry is not changed and the blob has
+             * to be treated as unknown.
+             *
+             * @returns true if the types (and maybe the id range) could be
+             *          decoded, false otherwise.
+             */
+            inline bool decode_blob_indexdata(const protozero::data_view& data, blob_index_entry& entry) noexcept {
+                if (data.empty()) {
+                    return false;
+                }
+
+                blob_index_entry result = entry;
+                bool has_magic = false;
+                bool has_version = false;
+                bool has_types = false;
+                try {
+                    protozero::pbf_message<FileFormat::IndexData> pbf_indexdata{data};
+                    while (pbf_indexdata.next()) {
+                        switch (pbf_indexdata.tag_and_type()) {
+                            case protozero::tag_and_type(FileFormat::IndexData::optional_uint32_types, protozero::pbf_wire_type::varint):
+                                result.types = static_cast<osmium::osm_entity_bits::type>(pbf_indexdata.get_uint32() & osmium::osm_entity_bits::all);
+                                has_types = true;
+                                break;
+                            case protozero::tag_and_type(FileFormat::IndexData::optional_sint64_min_id, protozero::pbf_wire_type::varint):
+                                result.min_id = pbf_indexdata.get_sint64();
+                                break;
+                            case protozero::tag_and_type(FileFormat::IndexData::optional_sint64_max_id, protozero::pbf_wire_type::varint):
+                                result.max_id = pbf_indexdata.get_sint64();
+                                break;
+                            case protozero::tag_and_type(FileFormat::IndexData::optional_string_magic, protozero::pbf_wire_type::length_delimited):
+                                has_magic = pbf_indexdata.get_view() == protozero::data_view{indexdata_magic};
+                                break;
+                            case protozero::tag_and_type(FileFormat::IndexData::optional_uint32_version, protozero::pbf_wire_type::varint):
+                                has_version = pbf_indexdata.get_uint32() == indexdata_version;
+                                break;
+                            default:
+                                pbf_indexdata.skip();
+                        }
+                    }
+                } catch (const protozero::exception&) {
+                    return false;
+                }
+
+                if (!has_magic || !has_version || !has_types) {
+                    return false;
+                }
+
+                entry = result;
+                return true;
+            }
+
+            /**
+             * A view on some data (usually a blob) together with a
+             * reference-counted handle to the storage the view points into
+             * (a chunk of input data or a memory mapping of the whole
+             * file). The storage is kept alive as long as any of the views
+             * into it are alive, so the data doesn't have to be copied when
+             * it is handed over to another thread.
+             */
+            struct pbf_blob_data {
+                std::shared_ptr<const void> storage;
+                data_view data;
+            }; // struct pbf_blob_data
+
             class PBFDataBlobDecoder {
 
-                std::shared_ptr<std::string> m_input_buffer;
+                pbf_blob_data m_input;
                 osmium::osm_entity_bits::type m_read_types;
                 osmium::io::read_meta m_read_metadata;
+                osmium::memory::BufferPool* m_buffer_pool;
 
             public:
 
-                PBFDataBlobDecoder(std::string&& input_buffer, osmium::osm_entity_bits::type read_types, osmium::io::read_meta read_metadata) :
-                    m_input_buffer(std::make_shared<std::string>(std::move(input_buffer))),
+                PBFDataBlobDecoder(pbf_blob_data&& input, osmium::osm_entity_bits::type read_types, osmium::io::read_meta read_metadata, osmium::memory::BufferPool* buffer_pool = nullptr) :
+                    m_input(std::move(input)),
                     m_read_types(read_types),
-                    m_read_metadata(read_metadata) {
+                    m_read_metadata(read_metadata),
+                    m_buffer_pool(buffer_pool) {
                 }
 
                 osmium::memory::Buffer operator()() {
-                    std::string output;
-                    PBFPrimitiveBlockDecoder decoder{decode_blob(*m_input_buffer, output), m_read_types, m_read_metadata};
+                    auto& scratch = thread_decode_scratch();
+                    PBFPrimitiveBlockDecoder decoder{decode_blob(m_input.data, scratch.uncompressed), scratch.stringtable, m_read_types, m_read_metadata, m_buffer_pool};
                     return decoder();
                 }
 
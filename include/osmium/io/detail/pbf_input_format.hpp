@@ -45,6 +45,7 @@ DEALINGS IN THE SOFTWARE.
 #include <protozero/pbf_message.hpp>
 #include <protozero/types.hpp>
 
+#include <osmium/io/blob_index.hpp>
 #include <osmium/io/detail/input_format.hpp>
 #include <osmium/io/detail/pbf.hpp> // IWYU pragma: export
 #include <osmium/io/detail/pbf_decoder.hpp>
@@ -64,31 +65,103 @@ namespace osmium {
 
             class PBFParser : public Parser {
 
-                std::string m_input_buffer;
+                // The chunk of input data we are currently working on and
+                // the offset of the first byte in it not yet consumed. Not
+                // used when the parser has direct access to the input.
+                std::shared_ptr<std::string> m_input_buffer;
+                std::size_t m_input_offset = 0;
+
+                // Offset of the first byte not yet consumed in the complete
+                // (uncompressed) input. Blob indexes refer to this.
+                std::size_t m_file_offset = 0;
+
+                // Set if the header says the file is sorted by type and id.
+                bool m_sorted_by_type = false;
+
+                std::size_t input_available() const noexcept {
+                    return m_input_buffer ? m_input_buffer->size() - m_input_offset : 0;
+                }
+
+                /**
+                 * Get the next chunk of data from the input queue.
+                 *
+                 * @throws osmium::pbf_error If there is no more data
+                 */
+                void next_input_chunk() {
+                    std::string new_data{get_input()};
+                    if (input_done()) {
+                        throw osmium::pbf_error{"truncated data (EOF encountered)"};
+                    }
+                    m_input_buffer = std::make_shared<std::string>(std::move(new_data));
+                    m_input_offset = 0;
+                }
+
+                /**
+                 * Read the given number of bytes from the input if the
+                 * parser has direct access to it. Nothing is copied, the
+                 * blob data is only read when the blob is decoded which
+                 * can happen in parallel in the pool threads.
+                 *
+                 * @param size Number of bytes to read
+                 * @returns View on the data and its storage
+                 * @throws osmium::pbf_error If size bytes can't be read
+                 */
+                pbf_blob_data read_from_direct_input(size_t size) {
+                    if (direct_input_size() - m_file_offset < size) {
+                        throw osmium::pbf_error{"truncated data (EOF encountered)"};
+                    }
+
+                    const data_view data{direct_input().get() + m_file_offset, size};
+                    m_file_offset += size;
+                    set_direct_input_offset(m_file_offset);
+
+                    return pbf_blob_data{direct_input(), data};
+                }
 
                 /**
                  * Read the given number of bytes from the input queue.
                  *
+                 * If the data is completely contained in the current input
+                 * chunk, it is not copied. The result refers to the chunk
+                 * and keeps it alive. Only data spanning several chunks is
+                 * assembled into newly allocated storage.
+                 *
                  * @param size Number of bytes to read
-                 * @returns String with the data
+                 * @returns View on the data and its storage
                  * @throws osmium::pbf_error If size bytes can't be read
                  */
-                std::string read_from_input_queue(size_t size) {
-                    while (m_input_buffer.size() < size) {
-                        const std::string new_data{get_input()};
-                        if (input_done()) {
-                            throw osmium::pbf_error{"truncated data (EOF encountered)"};
-                        }
-                        m_input_buffer += new_data;
+                pbf_blob_data read_from_input_queue(size_t size) {
+                    if (direct_input()) {
+                        return read_from_direct_input(size);
                     }
 
-                    std::string output{m_input_buffer.substr(size)};
-                    m_input_buffer.resize(size);
+                    if (input_available() == 0) {
+                        next_input_chunk();
+                    }
 
-                    using std::swap;
-                    swap(output, m_input_buffer);
+                    if (input_available() >= size) {
+                        const data_view data{m_input_buffer->data() + m_input_offset, size};
+                        m_input_offset += size;
+                        m_file_offset += size;
+                        return pbf_blob_data{m_input_buffer, data};
+                    }
+
+                    auto storage = std::make_shared<std::string>();
+                    storage->reserve(size);
+                    while (true) {
+                        const std::size_t missing = size - storage->size();
+                        if (input_available() >= missing) {
+                            storage->append(m_input_buffer->data() + m_input_offset, missing);
+                            m_input_offset += missing;
+                            break;
+                        }
+                        storage->append(m_input_buffer->data() + m_input_offset, input_available());
+                        next_input_chunk();
+                    }
 
-                    return output;
+                    m_file_offset += size;
+                    const data_view data{storage->data(), storage->size()};
+                    return pbf_blob_data{std::move(storage), data};
                 }
 
                 /**
@@ -99,8 +172,8 @@ namespace osmium {
                     uint32_t size_in_network_byte_order;
 
                     try {
-                        const std::string input_data{read_from_input_queue(sizeof(size_in_network_byte_order))};
-                        size_in_network_byte_order = *reinterpret_cast<const uint32_t*>(input_data.data());
+                        const auto input = read_from_input_queue(sizeof(size_in_network_byte_order));
+                        std::memcpy(&size_in_network_byte_order, input.data.data(), sizeof(size_in_network_byte_order));
                     } catch (const osmium::pbf_error&) {
                         return 0; // EOF
                     }
@@ -120,38 +193,12 @@ namespace osmium {
                 }
 
                 /**
-                 * Decode the BlobHeader. Make sure it contains the expected
-                 * type. Return the size of the following Blob.
+                 * Read the BlobHeader, check its type and return the size of
+                 * the following Blob. If entry is not nullptr, the types and
+                 * id range from the indexdata field of the BlobHeader are
+                 * written into it (if there is any).
                  */
-                size_t decode_blob_header(protozero::pbf_message<FileFormat::BlobHeader>&& pbf_blob_header, const char* expected_type) {
-                    protozero::data_view blob_header_type;
-                    size_t blob_header_datasize = 0;
-
-                    while (pbf_blob_header.next()) {
-                        switch (pbf_blob_header.tag()) {
-                            case FileFormat::BlobHeader::required_string_type:
-                                blob_header_type = pbf_blob_header.get_view();
-                                break;
-                            case FileFormat::BlobHeader::required_int32_datasize:
-                                blob_header_datasize = pbf_blob_header.get_int32();
-                                break;
-                            default:
-                                pbf_blob_header.skip();
-                        }
-                    }
-
-                    if (blob_header_datasize == 0) {
-                        throw osmium::pbf_error{"PBF format error: BlobHeader.datasize missing or zero."};
-                    }
-
-                    if (std::strncmp(expected_type, blob_header_type.data(), blob_header_type.size())) {
-                        throw osmium::pbf_error{"blob does not have expected type (OSMHeader in first blob, OSMData in following blobs)"};
-                    }
-
-                    return blob_header_datasize;
-                }
-
-                size_t check_type_and_get_blob_size(const char* expected_type) {
+                size_t check_type_and_get_blob_size(const char* expected_type, blob_index_entry* entry = nullptr) {
                     assert(expected_type);
 
                     const auto size = read_blob_header_size_from_file();
@@ -159,12 +206,18 @@ namespace osmium {
                         return 0;
                     }
 
-                    const std::string blob_header{read_from_input_queue(size)};
+                    const auto blob_header = read_from_input_queue(size);
 
-                    return decode_blob_header(protozero::pbf_message<FileFormat::BlobHeader>(blob_header), expected_type);
+                    protozero::data_view indexdata;
+                    const auto blob_size = decode_blob_header(protozero::pbf_message<FileFormat::BlobHeader>(blob_header.data), expected_type, &indexdata);
+                    if (entry) {
+                        decode_blob_indexdata(indexdata, *entry);
+                    }
+
+                    return blob_size;
                 }
 
-                std::string read_from_input_queue_with_check(size_t size) {
+                pbf_blob_data read_from_input_queue_with_check(size_t size) {
                     if (size > max_uncompressed_blob_size) {
                         throw osmium::pbf_error{std::string{"invalid blob size: "} +
                                                 std::to_string(size)};
@@ -175,18 +228,107 @@ namespace osmium {
                 // Parse the header in the PBF OSMHeader blob.
                 void parse_header_blob() {
                     const auto size = check_type_and_get_blob_size("OSMHeader");
-                    osmium::io::Header header{decode_header(read_from_input_queue_with_check(size))};
+                    osmium::io::Header header{decode_header(read_from_input_queue_with_check(size).data)};
+                    m_sorted_by_type = header.get("sorting") == "Type_then_ID";
                     set_header_value(header);
                 }
 
+                /**
+                 * With direct access to the input, blobs the blob filter
+                 * doesn't want can be skipped without reading them. Move
+                 * the file offset to the next wanted blob.
+                 *
+                 * @returns false if there are no more wanted blobs.
+                 */
+                bool skip_to_next_wanted_blob() {
+                    const auto next = blob_filter().next_wanted(m_file_offset);
+                    if (next == osmium::io::blob_filter::no_more_blobs || next >= direct_input_size()) {
+                        m_file_offset = direct_input_size();
+                        set_direct_input_offset(m_file_offset);
+                        return false;
+                    }
+                    m_file_offset = static_cast<std::size_t>(next);
+                    set_direct_input_offset(m_file_offset);
+                    return true;
+                }
+
+                /**
+                 * Can a blob with objects of the given types be followed by
+                 * any blobs with objects we want to read? Only in files
+                 * sorted by type we know that all nodes come before all
+                 * ways which come before all relations.
+                 */
+                bool past_wanted_types(osmium::osm_entity_bits::type types) const noexcept {
+                    if (!m_sorted_by_type || ((read_types() | types) & osmium::osm_entity_bits::changeset)) {
+                        return false;
+                    }
+
+                    osmium::osm_entity_bits::type wanted_or_before = osmium::osm_entity_bits::node;
+                    if (read_types() & osmium::osm_entity_bits::relation) {
+                        wanted_or_before = osmium::osm_entity_bits::nwr;
+                    } else if (read_types() & osmium::osm_entity_bits::way) {
+                        wanted_or_before = osmium::osm_entity_bits::node | osmium::osm_entity_bits::way;
+                    }
+
+                    return (types & wanted_or_before) == osmium::osm_entity_bits::nothing;
+                }
+
+                /**
+                 * Do we need to decode the blob at the given offset? Blobs
+                 * are skipped if we know the types of the objects in it
+                 * (from the BlobHeader indexdata or the blob index) and
+                 * none of them are wanted or if the blob filter doesn't
+                 * want them.
+                 */
+                bool blob_wanted(uint64_t offset, const blob_index_entry& entry) const {
+                    if (entry.types != osmium::osm_entity_bits::nothing &&
+                        !(entry.types & read_types())) {
+                        return false;
+                    }
+                    return blob_filter().wanted(offset);
+                }
+
                 void parse_data_blobs() {
-                    while (const auto size = check_type_and_get_blob_size("OSMData")) {
-                        std::string input_buffer{read_from_input_queue_with_check(size)};
+                    bool at_end_of_wanted_data = false;
+
+                    while (true) {
+                        if (direct_input() && blob_filter() && !skip_to_next_wanted_blob()) {
+                            break;
+                        }
+
+                        const auto blob_offset = m_file_offset;
+                        blob_index_entry entry;
+                        const auto size = check_type_and_get_blob_size("OSMData", &entry);
+                        if (size == 0) { // EOF
+                            break;
+                        }
 
-                        PBFDataBlobDecoder data_blob_parser{std::move(input_buffer), read_types(), read_metadata()};
+                        if (entry.types == osmium::osm_entity_bits::nothing && blob_filter()) {
+                            if (const auto* index_entry = blob_filter().index()->find(blob_offset)) {
+                                entry = *index_entry;
+                            }
+                        }
+
+                        if (entry.types != osmium::osm_entity_bits::nothing && past_wanted_types(entry.types)) {
+                            if (direct_input()) {
+                                m_file_offset = direct_input_size();
+                                set_direct_input_offset(m_file_offset);
+                                break;
+                            }
+                            // The rest of the input still has to be consumed,
+                            // but none of it needs to be decoded.
+                            at_end_of_wanted_data = true;
+                        }
+
+                        auto blob_data = read_from_input_queue_with_check(size);
+                        if (at_end_of_wanted_data || !blob_wanted(blob_offset, entry)) {
+                            continue;
+                        }
+
+                        PBFDataBlobDecoder data_blob_parser{std::move(blob_data), read_types(), read_metadata(), buffer_pool()};
 
                         if (osmium::config::use_pool_threads_for_pbf_parsing()) {
-                            send_to_output_queue(get_pool().submit(std::move(data_blob_parser)));
+                            send_to_output_queue_from_pool(std::move(data_blob_parser));
                         } else {
                             send_to_output_queue(data_blob_parser());
                         }
@@ -196,8 +338,7 @@ namespace osmium {
             public:
 
                 explicit PBFParser(parser_arguments& args) :
-                    Parser(args),
-                    m_input_buffer() {
+                    Parser(args) {
                 }
 
                 ~PBFParser() noexcept final = default;
@@ -205,6 +346,11 @@ namespace osmium {
                 void run() final {
                     osmium::thread::set_thread_name("_osmium_pbf_in");
 
+                    if (blob_filter() && direct_input() &&
+                        blob_filter().index()->file_size() != direct_input_size()) {
+                        throw osmium::pbf_error{"blob index does not match input file (file size differs)"};
+                    }
+
                     parse_header_blob();
 
                     if (read_types() != osmium::osm_entity_bits::nothing) {
@@ -33,10 +33,12 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
@@ -46,19 +48,26 @@ DEALINGS IN THE SOFTWARE.
 #include <protozero/pbf_writer.hpp>
 #include <protozero/types.hpp>
 
-#include <osmium/handler.hpp>
 #include <osmium/io/detail/output_format.hpp>
 #include <osmium/io/detail/pbf.hpp> // IWYU pragma: export
 #include <osmium/io/detail/protobuf_tags.hpp>
 #include <osmium/io/detail/queue_util.hpp>
 #include <osmium/io/detail/string_table.hpp>
 #include <osmium/io/detail/zlib.hpp>
+#ifdef OSMIUM_WITH_LZ4
+# include <osmium/io/detail/lz4.hpp>
+#endif
+#ifdef OSMIUM_WITH_ZSTD
+# include <osmium/io/detail/zstd.hpp>
+#endif
+#include <osmium/io/error.hpp>
 #include <osmium/io/file.hpp>
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/memory/buffer.hpp>
 #include <osmium/memory/item_iterator.hpp>
 #include <osmium/osm/box.hpp>
+#include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/item_type.hpp>
 #include <osmium/osm/location.hpp>
 #include <osmium/osm/node.hpp>
@@ -72,7 +81,6 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/thread/pool.hpp>
 #include <osmium/util/cast.hpp>
 #include <osmium/util/delta.hpp>
-#include <osmium/visitor.hpp>
 
 namespace osmium {
 
@@ -80,20 +88,105 @@ namespace osmium {
 
         namespace detail {
 
+            /**
+             * Compression used for the PBF blobs. Only zlib (the default)
+             * and none are part of the original PBF format, lz4 and zstd
+             * are newer additions not supported by all readers.
+             */
+            enum class pbf_compression {
+                none = 0,
+                zlib = 1,
+                lz4  = 2,
+                zstd = 3
+            };
+
+            /**
+             * Get the compression from the value of the "pbf_compression"
+             * file option.
+             *
+             * @throws osmium::io_error If the value is unknown or the
+             *         compression is not supported in this build.
+             */
+            inline pbf_compression get_pbf_compression(const std::string& value) {
+                if (value.empty() || value == "true" || value == "yes" || value == "zlib") {
+                    return pbf_compression::zlib;
+                }
+                if (value == "none" || value == "false" || value == "no") {
+                    return pbf_compression::none;
+                }
+                if (value == "lz4") {
+#ifdef OSMIUM_WITH_LZ4
+                    return pbf_compression::lz4;
+#else
+                    throw io_error{"PBF compression 'lz4' not supported (libosmium was compiled without lz4)"};
+#endif
+                }
+                if (value == "zstd") {
+#ifdef OSMIUM_WITH_ZSTD
+                    return pbf_compression::zstd;
+#else
+                    throw io_error{"PBF compression 'zstd' not supported (libosmium was compiled without zstd)"};
+#endif
+                }
+                throw io_error{"unknown value for pbf_compression option: '" + value + "'"};
+            }
+
+            /**
+             * Get the compression level from the value of the
+             * "pbf_compression_level" file option. Returns -1 (use the
+             * default level of the compression) if the value is empty.
+             *
+             * @throws osmium::io_error If the value is not a valid level
+             *         for the compression.
+             */
+            inline int get_pbf_compression_level(pbf_compression compression, const std::string& value) {
+                if (value.empty()) {
+                    return -1;
+                }
+
+                int max_level = 0;
+                switch (compression) {
+                    case pbf_compression::none:
+                        break;
+                    case pbf_compression::zlib:
+                        max_level = 9;
+                        break;
+                    case pbf_compression::lz4:
+                        max_level = 12;
+                        break;
+                    case pbf_compression::zstd:
+                        max_level = 22;
+                        break;
+                }
+
+                char* end = nullptr;
+                const long level = std::strtol(value.c_str(), &end, 10);
+                if (*end != '\0' || level < 0 || level > max_level) {
+                    throw io_error{"invalid value for pbf_compression_level option: '" + value + "'"};
+                }
+
+                return static_cast<int>(level);
+            }
+
             struct pbf_output_options {
 
                 /// Should nodes be encoded in DenseNodes?
                 bool use_dense_nodes;
 
                 /**
-                 * Should the PBF blobs contain zlib compressed data?
+                 * How should the PBF blobs be compressed?
                  *
-                 * The zlib compression is optional, it's possible to store the
+                 * The compression is optional, it's possible to store the
                  * blobs in raw format. Disabling the compression can improve
                  * the writing speed a little but the output will be 2x to 3x
-                 * bigger.
+                 * bigger. The lz4 and zstd compressions are much faster than
+                 * zlib, especially when reading, but not all programs can
+                 * read files using them.
                  */
-                bool use_compression;
+                pbf_compression compression;
+
+                /// Compression level, -1 for the default of the compression.
+                int compression_level;
 
                 /// Should metadata of objects be written?
                 bool add_metadata;
@@ -107,6 +200,14 @@ namespace osmium {
                 /// Should node locations be added to ways?
                 bool locations_on_ways;
 
+                /**
+                 * Should the entity types and id range of the objects in
+                 * each blob be written into the BlobHeader indexdata field?
+                 * This allows readers to skip blobs without decompressing
+                 * them.
+                 */
+                bool add_indexdata;
+
             };
 
             /**
@@ -141,9 +242,13 @@ namespace osmium {
 
                 std::string m_msg;
 
+                std::string m_indexdata;
+
                 pbf_blob_type m_blob_type;
 
-                bool m_use_compression;
+                pbf_compression m_compression;
+
+                int m_compression_level;
 
             public:
 
@@ -152,13 +257,18 @@ namespace osmium {
                  *
                  * @param msg Protobuf-message containing the blob data
                  * @param type Type of blob.
-                 * @param use_compression Should the output be compressed using
-                 *        zlib?
+                 * @param compression Compression to use for the blob data.
+                 * @param compression_level Compression level, -1 for the
+                 *        default level.
+                 * @param indexdata Contents of the BlobHeader indexdata field,
+                 *        not written if empty.
                  */
-                SerializeBlob(std::string&& msg, pbf_blob_type type, bool use_compression) :
+                SerializeBlob(std::string&& msg, pbf_blob_type type, pbf_compression compression, int compression_level, std::string&& indexdata = std::string{}) :
                     m_msg(std::move(msg)),
+                    m_indexdata(std::move(indexdata)),
                     m_blob_type(type),
-                    m_use_compression(use_compression) {
+                    m_compression(compression),
+                    m_compression_level(compression_level) {
                 }
 
                 /**
@@ -172,17 +282,37 @@ namespace osmium {
                     std::string blob_data;
                     protozero::pbf_builder<FileFormat::Blob> pbf_blob{blob_data};
 
-                    if (m_use_compression) {
-                        pbf_blob.add_int32(FileFormat::Blob::optional_int32_raw_size, int32_t(m_msg.size()));
-                        pbf_blob.add_bytes(FileFormat::Blob::optional_bytes_zlib_data, osmium::io::detail::zlib_compress(m_msg));
-                    } else {
-                        pbf_blob.add_bytes(FileFormat::Blob::optional_bytes_raw, m_msg);
+                    switch (m_compression) {
+                        case pbf_compression::none:
+                            pbf_blob.add_bytes(FileFormat::Blob::optional_bytes_raw, m_msg);
+                            break;
+                        case pbf_compression::zlib:
+                            pbf_blob.add_int32(FileFormat::Blob::optional_int32_raw_size, int32_t(m_msg.size()));
+                            pbf_blob.add_bytes(FileFormat::Blob::optional_bytes_zlib_data, osmium::io::detail::zlib_compress(m_msg, m_compression_level));
+                            break;
+#ifdef OSMIUM_WITH_LZ4
+                        case pbf_compression::lz4:
+                            pbf_blob.add_int32(FileFormat::Blob::optional_int32_raw_size, int32_t(m_msg.size()));
+                            pbf_blob.add_bytes(FileFormat::Blob::optional_bytes_lz4_data, osmium::io::detail::lz4_compress(m_msg, m_compression_level));
+                            break;
+#endif
+#ifdef OSMIUM_WITH_ZSTD
+                        case pbf_compression::zstd:
+                            pbf_blob.add_int32(FileFormat::Blob::optional_int32_raw_size, int32_t(m_msg.size()));
+                            pbf_blob.add_bytes(FileFormat::Blob::optional_bytes_zstd_data, osmium::io::detail::zstd_compress(m_msg, m_compression_level));
+                            break;
+#endif
+                        default:
+                            throw io_error{"PBF compression not supported"};
                     }
 
                     std::string blob_header_data;
                     protozero::pbf_builder<FileFormat::BlobHeader> pbf_blob_header{blob_header_data};
 
                     pbf_blob_header.add_string(FileFormat::BlobHeader::required_string_type, m_blob_type == pbf_blob_type::data ? "OSMData" : "OSMHeader");
+                    if (!m_indexdata.empty()) {
+                        pbf_blob_header.add_bytes(FileFormat::BlobHeader::optional_bytes_indexdata, m_indexdata);
+                    }
                     pbf_blob_header.add_int32(FileFormat::BlobHeader::required_int32_datasize, static_cast_with_assert<int32_t>(blob_data.size()));
 
                     #ifndef _WIN32
@@ -339,6 +469,8 @@ namespace osmium {
                 DenseNodes m_dense_nodes;
                 OSMFormat::PrimitiveGroup m_type;
                 int m_count;
+                osmium::object_id_type m_min_id;
+                osmium::object_id_type m_max_id;
 
             public:
 
@@ -348,7 +480,9 @@ namespace osmium {
                     m_stringtable(),
                     m_dense_nodes(m_stringtable, options),
                     m_type(OSMFormat::PrimitiveGroup::unknown),
-                    m_count(0) {
+                    m_count(0),
+                    m_min_id(std::numeric_limits<osmium::object_id_type>::max()),
+                    m_max_id(std::numeric_limits<osmium::object_id_type>::min()) {
                 }
 
                 const std::string& group_data() {
@@ -364,6 +498,8 @@ namespace osmium {
                     m_dense_nodes.clear();
                     m_type = type;
                     m_count = 0;
+                    m_min_id = std::numeric_limits<osmium::object_id_type>::max();
+                    m_max_id = std::numeric_limits<osmium::object_id_type>::min();
                 }
 
                 void write_stringtable(protozero::pbf_builder<OSMFormat::StringTable>& pbf_string_table) {
@@ -382,6 +518,42 @@ namespace osmium {
                     ++m_count;
                 }
 
+                void add_id(osmium::object_id_type id) noexcept {
+                    m_min_id = std::min(m_min_id, id);
+                    m_max_id = std::max(m_max_id, id);
+                }
+
+                /**
+                 * Serialize entity type and id range of the objects in this
+                 * block for the BlobHeader indexdata field.
+                 */
+                std::string indexdata() const {
+                    osmium::osm_entity_bits::type types = osmium::osm_entity_bits::nothing;
+                    switch (m_type) {
+                        case OSMFormat::PrimitiveGroup::repeated_Node_nodes:
+                        case OSMFormat::PrimitiveGroup::optional_DenseNodes_dense:
+                            types = osmium::osm_entity_bits::node;
+                            break;
+                        case OSMFormat::PrimitiveGroup::repeated_Way_ways:
+                            types = osmium::osm_entity_bits::way;
+                            break;
+                        case OSMFormat::PrimitiveGroup::repeated_Relation_relations:
+                            types = osmium::osm_entity_bits::relation;
+                            break;
+                        default:
+                            return std::string{};
+                    }
+
+                    std::string data;
+                    protozero::pbf_builder<FileFormat::IndexData> pbf_indexdata{data};
+                    pbf_indexdata.add_string(FileFormat::IndexData::optional_string_magic, indexdata_magic);
+                    pbf_indexdata.add_uint32(FileFormat::IndexData::optional_uint32_version, indexdata_version);
+                    pbf_indexdata.add_uint32(FileFormat::IndexData::optional_uint32_types, types);
+                    pbf_indexdata.add_sint64(FileFormat::IndexData::optional_sint64_min_id, m_min_id);
+                    pbf_indexdata.add_sint64(FileFormat::IndexData::optional_sint64_max_id, m_max_id);
+                    return data;
+                }
+
                 uint32_t store_in_stringtable(const char* s) {
                     return m_stringtable.add(s);
                 }
@@ -418,47 +590,61 @@ namespace osmium {
 
             }; // class PrimitiveBlock
 
-            class PBFOutputFormat : public osmium::io::detail::OutputFormat, public osmium::handler::Handler {
+            /**
+             * Encodes a run of OSM objects into PrimitiveBlocks and
+             * serializes them into blobs ready to be written out. This is
+             * the expensive part of writing a PBF file (string table, delta
+             * encoding, protobuf building, and compression), so it runs in
+             * the pool threads.
+             *
+             * All objects must belong into the same type of PrimitiveGroup.
+             * Usually they fit into one PrimitiveBlock, if not, several
+             * blobs are created one after the other.
+             */
+            class PrimitiveBlockEncoder {
 
                 pbf_output_options m_options;
+                OSMFormat::PrimitiveGroup m_type;
+                std::vector<const osmium::OSMObject*> m_objects;
 
-                PrimitiveBlock m_primitive_block;
+                // The buffers containing the objects. They are kept alive
+                // until the objects have been encoded.
+                std::vector<std::shared_ptr<const osmium::memory::Buffer>> m_buffers;
 
-                void store_primitive_block() {
-                    if (m_primitive_block.count() == 0) {
-                        return;
-                    }
+                // Sum of the sizes of the objects in their buffers.
+                std::size_t m_bytes;
 
+                std::string serialize(PrimitiveBlock& block) const {
                     std::string primitive_block_data;
                     protozero::pbf_builder<OSMFormat::PrimitiveBlock> primitive_block{primitive_block_data};
 
                     {
                         protozero::pbf_builder<OSMFormat::StringTable> pbf_string_table{primitive_block, OSMFormat::PrimitiveBlock::required_StringTable_stringtable};
-                        m_primitive_block.write_stringtable(pbf_string_table);
+                        block.write_stringtable(pbf_string_table);
                     }
 
-                    primitive_block.add_message(OSMFormat::PrimitiveBlock::repeated_PrimitiveGroup_primitivegroup, m_primitive_block.group_data());
+                    primitive_block.add_message(OSMFormat::PrimitiveBlock::repeated_PrimitiveGroup_primitivegroup, block.group_data());
 
-                    m_output_queue.push(m_pool.submit(
-                        SerializeBlob{std::move(primitive_block_data),
-                                      pbf_blob_type::data,
-                                      m_options.use_compression}
-                    ));
+                    return SerializeBlob{std::move(primitive_block_data),
+                                         pbf_blob_type::data,
+                                         m_options.compression,
+                                         m_options.compression_level,
+                                         m_options.add_indexdata ? block.indexdata() : std::string{}}();
                 }
 
                 template <typename T>
-                void add_meta(const osmium::OSMObject& object, T& pbf_object) {
+                void add_meta(PrimitiveBlock& block, const osmium::OSMObject& object, T& pbf_object) const {
                     {
                         protozero::packed_field_uint32 field{pbf_object, protozero::pbf_tag_type(T::enum_type::packed_uint32_keys)};
                         for (const auto& tag : object.tags()) {
-                            field.add_element(m_primitive_block.store_in_stringtable(tag.key()));
+                            field.add_element(block.store_in_stringtable(tag.key()));
                         }
                     }
 
                     {
                         protozero::packed_field_uint32 field{pbf_object, protozero::pbf_tag_type(T::enum_type::packed_uint32_vals)};
                         for (const auto& tag : object.tags()) {
-                            field.add_element(m_primitive_block.store_in_stringtable(tag.value()));
+                            field.add_element(block.store_in_stringtable(tag.value()));
                         }
                     }
 
@@ -469,32 +655,218 @@ namespace osmium {
                         pbf_info.add_int64(OSMFormat::Info::optional_int64_timestamp, uint32_t(object.timestamp()));
                         pbf_info.add_int64(OSMFormat::Info::optional_int64_changeset, object.changeset());
                         pbf_info.add_int32(OSMFormat::Info::optional_int32_uid, static_cast_with_assert<int32_t>(object.uid()));
-                        pbf_info.add_uint32(OSMFormat::Info::optional_uint32_user_sid, m_primitive_block.store_in_stringtable(object.user()));
+                        pbf_info.add_uint32(OSMFormat::Info::optional_uint32_user_sid, block.store_in_stringtable(object.user()));
                         if (m_options.add_visible_flag) {
                             pbf_info.add_bool(OSMFormat::Info::optional_bool_visible, object.visible());
                         }
                     }
                 }
 
-                void switch_primitive_block_type(OSMFormat::PrimitiveGroup type) {
-                    if (!m_primitive_block.can_add(type)) {
-                        store_primitive_block();
-                        m_primitive_block.reset(type);
+                void add_node(PrimitiveBlock& block, const osmium::Node& node) const {
+                    if (m_options.use_dense_nodes) {
+                        block.add_dense_node(node);
+                        block.add_id(node.id());
+                        return;
+                    }
+
+                    protozero::pbf_builder<OSMFormat::Node> pbf_node{block.group(), OSMFormat::PrimitiveGroup::repeated_Node_nodes};
+
+                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_id, node.id());
+                    block.add_id(node.id());
+                    add_meta(block, node, pbf_node);
+
+                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_lat, lonlat2int(node.location().lat_without_check()));
+                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_lon, lonlat2int(node.location().lon_without_check()));
+                }
+
+                void add_way(PrimitiveBlock& block, const osmium::Way& way) const {
+                    protozero::pbf_builder<OSMFormat::Way> pbf_way{block.group(), OSMFormat::PrimitiveGroup::repeated_Way_ways};
+
+                    pbf_way.add_int64(OSMFormat::Way::required_int64_id, way.id());
+                    block.add_id(way.id());
+                    add_meta(block, way, pbf_way);
+
+                    {
+                        osmium::util::DeltaEncode<object_id_type, int64_t> delta_id;
+                        protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_refs)};
+                        for (const auto& node_ref : way.nodes()) {
+                            field.add_element(delta_id.update(node_ref.ref()));
+                        }
+                    }
+
+                    if (m_options.locations_on_ways) {
+                        {
+                            osmium::util::DeltaEncode<int64_t, int64_t> delta_id;
+                            protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_lon)};
+                            for (const auto& node_ref : way.nodes()) {
+                                field.add_element(delta_id.update(lonlat2int(node_ref.location().lon_without_check())));
+                            }
+                        }
+                        {
+                            osmium::util::DeltaEncode<int64_t, int64_t> delta_id;
+                            protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_lat)};
+                            for (const auto& node_ref : way.nodes()) {
+                                field.add_element(delta_id.update(lonlat2int(node_ref.location().lat_without_check())));
+                            }
+                        }
+                    }
+                }
+
+                void add_relation(PrimitiveBlock& block, const osmium::Relation& relation) const {
+                    protozero::pbf_builder<OSMFormat::Relation> pbf_relation{block.group(), OSMFormat::PrimitiveGroup::repeated_Relation_relations};
+
+                    pbf_relation.add_int64(OSMFormat::Relation::required_int64_id, relation.id());
+                    block.add_id(relation.id());
+                    add_meta(block, relation, pbf_relation);
+
+                    {
+                        protozero::packed_field_int32 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_int32_roles_sid)};
+                        for (const auto& member : relation.members()) {
+                            field.add_element(block.store_in_stringtable(member.role()));
+                        }
+                    }
+
+                    {
+                        osmium::util::DeltaEncode<object_id_type, int64_t> delta_id;
+                        protozero::packed_field_sint64 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_sint64_memids)};
+                        for (const auto& member : relation.members()) {
+                            field.add_element(delta_id.update(member.ref()));
+                        }
+                    }
+
+                    {
+                        protozero::packed_field_int32 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_MemberType_types)};
+                        for (const auto& member : relation.members()) {
+                            field.add_element(int32_t(osmium::item_type_to_nwr_index(member.type())));
+                        }
+                    }
+                }
+
+            public:
+
+                explicit PrimitiveBlockEncoder(const pbf_output_options& options, OSMFormat::PrimitiveGroup type = OSMFormat::PrimitiveGroup::unknown) :
+                    m_options(options),
+                    m_type(type),
+                    m_objects(),
+                    m_buffers(),
+                    m_bytes(0) {
+                }
+
+                OSMFormat::PrimitiveGroup type() const noexcept {
+                    return m_type;
+                }
+
+                std::size_t count() const noexcept {
+                    return m_objects.size();
+                }
+
+                std::size_t bytes() const noexcept {
+                    return m_bytes;
+                }
+
+                bool empty() const noexcept {
+                    return m_objects.empty();
+                }
+
+                void add(const osmium::OSMObject& object, const std::shared_ptr<const osmium::memory::Buffer>& buffer) {
+                    if (m_buffers.empty() || m_buffers.back() != buffer) {
+                        m_buffers.push_back(buffer);
+                    }
+                    m_objects.push_back(&object);
+                    m_bytes += object.byte_size();
+                }
+
+                std::string operator()() const {
+                    PrimitiveBlock block{m_options};
+                    block.reset(m_type);
+
+                    std::string output;
+                    for (const osmium::OSMObject* object : m_objects) {
+                        if (!block.can_add(m_type)) {
+                            output.append(serialize(block));
+                            block.reset(m_type);
+                        }
+                        switch (object->type()) {
+                            case osmium::item_type::node:
+                                add_node(block, static_cast<const osmium::Node&>(*object));
+                                break;
+                            case osmium::item_type::way:
+                                add_way(block, static_cast<const osmium::Way&>(*object));
+                                break;
+                            case osmium::item_type::relation:
+                                add_relation(block, static_cast<const osmium::Relation&>(*object));
+                                break;
+                            default:
+                                break;
+                        }
+                    }
+
+                    if (output.empty()) {
+                        return serialize(block);
+                    }
+                    output.append(serialize(block));
+                    return output;
+                }
+
+            }; // class PrimitiveBlockEncoder
+
+            /**
+             * The PBF output format. The thread calling write_buffer() only
+             * cuts the data into runs of objects that go into one
+             * PrimitiveBlock each. Those runs are encoded in the pool
+             * threads by the PrimitiveBlockEncoder. The futures for the
+             * results are queued in order, so the output doesn't depend on
+             * the number of threads or how the data was split into buffers.
+             */
+            class PBFOutputFormat : public osmium::io::detail::OutputFormat {
+
+                pbf_output_options m_options;
+
+                // Objects collected for the next PrimitiveBlock.
+                PrimitiveBlockEncoder m_encoder;
+
+                void store_primitive_block() {
+                    if (m_encoder.empty()) {
+                        return;
+                    }
+
+                    m_output_queue.push(m_pool.submit(std::move(m_encoder)));
+                }
+
+                OSMFormat::PrimitiveGroup group_type(osmium::item_type type) const noexcept {
+                    switch (type) {
+                        case osmium::item_type::node:
+                            return m_options.use_dense_nodes ? OSMFormat::PrimitiveGroup::optional_DenseNodes_dense
+                                                             : OSMFormat::PrimitiveGroup::repeated_Node_nodes;
+                        case osmium::item_type::way:
+                            return OSMFormat::PrimitiveGroup::repeated_Way_ways;
+                        case osmium::item_type::relation:
+                            return OSMFormat::PrimitiveGroup::repeated_Relation_relations;
+                        default:
+                            break;
                     }
+                    return OSMFormat::PrimitiveGroup::unknown;
+                }
+
+                static pbf_output_options get_options(const osmium::io::File& file) {
+                    pbf_output_options options;
+                    options.use_dense_nodes = file.is_not_false("pbf_dense_nodes");
+                    options.compression = get_pbf_compression(file.get("pbf_compression"));
+                    options.compression_level = get_pbf_compression_level(options.compression, file.get("pbf_compression_level"));
+                    options.add_metadata = file.is_not_false("pbf_add_metadata") && file.is_not_false("add_metadata");
+                    options.add_historical_information_flag = file.has_multiple_object_versions();
+                    options.add_visible_flag = file.has_multiple_object_versions();
+                    options.locations_on_ways = file.is_true("locations_on_ways");
+                    options.add_indexdata = file.is_not_false("pbf_add_indexdata");
+                    return options;
                 }
 
             public:
 
                 PBFOutputFormat(osmium::thread::Pool& pool, const osmium::io::File& file, future_string_queue_type& output_queue) :
                     OutputFormat(pool, output_queue),
-                    m_options(),
-                    m_primitive_block(m_options) {
-                    m_options.use_dense_nodes = file.is_not_false("pbf_dense_nodes");
-                    m_options.use_compression = file.get("pbf_compression") != "none" && file.is_not_false("pbf_compression");
-                    m_options.add_metadata = file.is_not_false("pbf_add_metadata") && file.is_not_false("add_metadata");
-                    m_options.add_historical_information_flag = file.has_multiple_object_versions();
-                    m_options.add_visible_flag = file.has_multiple_object_versions();
-                    m_options.locations_on_ways = file.is_true("locations_on_ways");
+                    m_options(get_options(file)),
+                    m_encoder(m_options) {
                 }
 
                 PBFOutputFormat(const PBFOutputFormat&) = delete;
@@ -530,6 +902,10 @@ namespace osmium {
                         pbf_header_block.add_string(OSMFormat::HeaderBlock::repeated_string_optional_features, "LocationsOnWays");
                     }
 
+                    if (header.get("sorting") == "Type_then_ID") {
+                        pbf_header_block.add_string(OSMFormat::HeaderBlock::repeated_string_optional_features, "Sort.Type_then_ID");
+                    }
+
                     pbf_header_block.add_string(OSMFormat::HeaderBlock::optional_string_writingprogram, header.get("generator"));
 
                     const std::string osmosis_replication_timestamp{header.get("osmosis_replication_timestamp")};
@@ -551,96 +927,38 @@ namespace osmium {
                     m_output_queue.push(m_pool.submit(
                         SerializeBlob{std::move(data),
                                       pbf_blob_type::header,
-                                      m_options.use_compression}
+                                      m_options.compression,
+                                      m_options.compression_level}
                         ));
                 }
 
                 void write_buffer(osmium::memory::Buffer&& buffer) final {
-                    osmium::apply(buffer.cbegin(), buffer.cend(), *this);
-                }
-
-                void write_end() final {
-                    store_primitive_block();
-                }
-
-                void node(const osmium::Node& node) {
-                    if (m_options.use_dense_nodes) {
-                        switch_primitive_block_type(OSMFormat::PrimitiveGroup::optional_DenseNodes_dense);
-                        m_primitive_block.add_dense_node(node);
-                        return;
-                    }
-
-                    switch_primitive_block_type(OSMFormat::PrimitiveGroup::repeated_Node_nodes);
-                    protozero::pbf_builder<OSMFormat::Node> pbf_node{m_primitive_block.group(), OSMFormat::PrimitiveGroup::repeated_Node_nodes};
+                    const std::shared_ptr<const osmium::memory::Buffer> shared_buffer{std::make_shared<osmium::memory::Buffer>(std::move(buffer))};
 
-                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_id, node.id());
-                    add_meta(node, pbf_node);
-
-                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_lat, lonlat2int(node.location().lat_without_check()));
-                    pbf_node.add_sint64(OSMFormat::Node::required_sint64_lon, lonlat2int(node.location().lon_without_check()));
-                }
-
-                void way(const osmium::Way& way) {
-                    switch_primitive_block_type(OSMFormat::PrimitiveGroup::repeated_Way_ways);
-                    protozero::pbf_builder<OSMFormat::Way> pbf_way{m_primitive_block.group(), OSMFormat::PrimitiveGroup::repeated_Way_ways};
-
-                    pbf_way.add_int64(OSMFormat::Way::required_int64_id, way.id());
-                    add_meta(way, pbf_way);
-
-                    {
-                        osmium::util::DeltaEncode<object_id_type, int64_t> delta_id;
-                        protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_refs)};
-                        for (const auto& node_ref : way.nodes()) {
-                            field.add_element(delta_id.update(node_ref.ref()));
+                    for (const auto& object : shared_buffer->select<osmium::OSMObject>()) {
+                        const auto type = group_type(object.type());
+                        if (type == OSMFormat::PrimitiveGroup::unknown) {
+                            continue;
                         }
-                    }
 
-                    if (m_options.locations_on_ways) {
-                        {
-                            osmium::util::DeltaEncode<int64_t, int64_t> delta_id;
-                            protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_lon)};
-                            for (const auto& node_ref : way.nodes()) {
-                                field.add_element(delta_id.update(lonlat2int(node_ref.location().lon_without_check())));
-                            }
+                        // The PrimitiveBlockEncoder splits the run into
+                        // several blocks if it doesn't fit into one. Limiting
+                        // the run by the size of the objects in the buffer
+                        // (which is usually larger than the encoded size)
+                        // only keeps the tasks reasonably small.
+                        if (type != m_encoder.type() ||
+                            m_encoder.count() >= std::size_t(max_entities_per_block) ||
+                            m_encoder.bytes() + object.byte_size() > PrimitiveBlock::max_used_blob_size) {
+                            store_primitive_block();
+                            m_encoder = PrimitiveBlockEncoder{m_options, type};
                         }
-                        {
-                            osmium::util::DeltaEncode<int64_t, int64_t> delta_id;
-                            protozero::packed_field_sint64 field{pbf_way, protozero::pbf_tag_type(OSMFormat::Way::packed_sint64_lat)};
-                            for (const auto& node_ref : way.nodes()) {
-                                field.add_element(delta_id.update(lonlat2int(node_ref.location().lat_without_check())));
-                            }
-                        }
-                    }
-                }
-
-                void relation(const osmium::Relation& relation) {
-                    switch_primitive_block_type(OSMFormat::PrimitiveGroup::repeated_Relation_relations);
-                    protozero::pbf_builder<OSMFormat::Relation> pbf_relation{m_primitive_block.group(), OSMFormat::PrimitiveGroup::repeated_Relation_relations};
 
-                    pbf_relation.add_int64(OSMFormat::Relation::required_int64_id, relation.id());
-                    add_meta(relation, pbf_relation);
-
-                    {
-                        protozero::packed_field_int32 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_int32_roles_sid)};
-                        for (const auto& member : relation.members()) {
-                            field.add_element(m_primitive_block.store_in_stringtable(member.role()));
-                        }
-                    }
-
-                    {
-                        osmium::util::DeltaEncode<object_id_type, int64_t> delta_id;
-                        protozero::packed_field_sint64 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_sint64_memids)};
-                        for (const auto& member : relation.members()) {
-                            field.add_element(delta_id.update(member.ref()));
-                        }
+                        m_encoder.add(object, shared_buffer);
                     }
+                }
 
-                    {
-                        protozero::packed_field_int32 field{pbf_relation, protozero::pbf_tag_type(OSMFormat::Relation::packed_MemberType_types)};
-                        for (const auto& member : relation.members()) {
-                            field.add_element(int32_t(osmium::item_type_to_nwr_index(member.type())));
-                        }
-                    }
+                void write_end() final {
+                    store_primitive_block();
                 }
 
             }; // class PBFOutputFormat
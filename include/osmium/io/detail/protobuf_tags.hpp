@@ -47,10 +47,13 @@ namespace osmium {
             namespace FileFormat {
 
                 enum class Blob : protozero::pbf_tag_type {
-                    optional_bytes_raw       = 1,
-                    optional_int32_raw_size  = 2,
-                    optional_bytes_zlib_data = 3,
-                    optional_bytes_lzma_data = 4
+                    optional_bytes_raw                 = 1,
+                    optional_int32_raw_size            = 2,
+                    optional_bytes_zlib_data           = 3,
+                    optional_bytes_lzma_data           = 4,
+                    optional_bytes_obsolete_bzip2_data = 5,
+                    optional_bytes_lz4_data            = 6,
+                    optional_bytes_zstd_data           = 7
                 };
 
                 enum class BlobHeader : protozero::pbf_tag_type {
@@ -59,6 +62,21 @@ namespace osmium {
                     required_int32_datasize  = 3
                 };
 
+                // Not part of the OSM PBF format. The format allows any
+                // data in BlobHeader.indexdata, Osmium writes a message
+                // with the entity types and the id range of the objects
+                // in the blob so that readers can skip blobs they don't
+                // need without decompressing them. Readers must check the
+                // magic string and the version before using the data,
+                // because other writers can put anything into the field.
+                enum class IndexData : protozero::pbf_tag_type {
+                    optional_uint32_types   = 1,
+                    optional_sint64_min_id  = 2,
+                    optional_sint64_max_id  = 3,
+                    optional_string_magic   = 4,
+                    optional_uint32_version = 5
+                };
+
             } // namespace FileFormat
 
             // directly translated from
@@ -40,7 +40,7 @@ DEALINGS IN THE SOFTWARE.
 #include <utility>
 
 #include <osmium/memory/buffer.hpp>
-#include <osmium/thread/queue.hpp>
+#include <osmium/thread/lockfree_queue.hpp>
 
 namespace osmium {
 
@@ -48,8 +48,14 @@ namespace osmium {
 
         namespace detail {
 
+            /**
+             * All these queues link exactly two threads (read thread and
+             * parser, parser and the thread calling Reader::read(), the
+             * thread using the Writer and the write thread), so they use the
+             * lock-free single-producer single-consumer queue.
+             */
             template <typename T>
-            using future_queue_type = osmium::thread::Queue<std::future<T>>;
+            using future_queue_type = osmium::thread::SPSCQueue<std::future<T>>;
 
             /**
              * This type of queue contains buffers with OSM data in them.
@@ -34,14 +34,21 @@ DEALINGS IN THE SOFTWARE.
 */
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
 #include <exception>
+#include <future>
+#include <memory>
 #include <string>
 #include <thread>
 #include <utility>
 
 #include <osmium/io/compression.hpp>
 #include <osmium/io/detail/queue_util.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/thread/util.hpp>
+#include <osmium/util/config.hpp>
 
 namespace osmium {
 
@@ -54,12 +61,32 @@ namespace osmium {
              * the input file and (optionally) decompress it. The result is
              * sent to the given queue. Any exceptions will also be send to
              * the queue.
+             *
+             * If the decompressor can split the input into blocks that can
+             * be decompressed independently of each other, the blocks are
+             * decompressed in the thread pool and the results are sent to
+             * the queue in order. At most a few blocks per pool thread are
+             * in flight at any time.
              */
             class ReadThreadManager {
 
+                // A block of compressed data, its offset in the file, and its
+                // decompressed result.
+                struct block_type {
+                    std::shared_ptr<const std::string> data;
+                    std::size_t offset;
+                    std::future<std::string> result;
+                };
+
+                // How often a block that could not be decompressed on its
+                // own is merged with the next block before giving up.
+                static constexpr const int max_merges = 4;
+
                 // only used in the sub-thread
                 osmium::io::Decompressor& m_decompressor;
                 future_string_queue_type& m_queue;
+                osmium::thread::Pool* m_pool;
+                std::deque<block_type> m_blocks;
 
                 // used in both threads
                 std::atomic<bool> m_done;
@@ -67,20 +94,139 @@ namespace osmium {
                 // only used in the main thread
                 std::thread m_thread;
 
+                std::size_t max_blocks_in_flight() const noexcept {
+                    return static_cast<std::size_t>(m_pool->num_threads()) * 2;
+                }
+
+                void submit_block(std::string&& data, std::size_t offset) {
+                    const osmium::io::Decompressor* decompressor = &m_decompressor;
+                    auto input = std::make_shared<const std::string>(std::move(data));
+                    auto result = m_pool->submit([decompressor, input]() {
+                        return decompressor->decompress_block(*input);
+                    });
+                    m_blocks.push_back(block_type{std::move(input), offset, std::move(result)});
+                }
+
+                // Block boundaries are only guessed from the stream headers
+                // and can be wrong. In that case the block can not be
+                // decompressed on its own, so try again with the following
+                // block(s) appended. Returns false if that didn't work
+                // either.
+                bool decompress_merged(std::string data, std::string& result) {
+                    for (int i = 0; i < max_merges; ++i) {
+                        if (m_blocks.empty()) {
+                            const std::string next{m_decompressor.read_compressed_block()};
+                            if (next.empty()) {
+                                break;
+                            }
+                            data.append(next);
+                        } else {
+                            m_blocks.front().result.wait();
+                            data.append(*m_blocks.front().data);
+                            m_blocks.pop_front();
+                        }
+                        try {
+                            result = m_decompressor.decompress_block(data);
+                            return true;
+                        } catch (...) {
+                            // try again with the next block
+                        }
+                    }
+                    return false;
+                }
+
+                // Returns false if the oldest block could not be
+                // decompressed. The rest of the input, starting with that
+                // block, then has to be read sequentially.
+                bool forward_oldest_block() {
+                    block_type block{std::move(m_blocks.front())};
+                    m_blocks.pop_front();
+
+                    std::string data;
+                    bool okay = true;
+                    try {
+                        data = block.result.get();
+                    } catch (...) {
+                        okay = false;
+                    }
+                    if (!okay && !decompress_merged(*block.data, data)) {
+                        wait_for_blocks();
+                        m_decompressor.read_sequentially_from(block.offset);
+                        return false;
+                    }
+
+                    // An empty string would mark the end of data.
+                    if (!data.empty()) {
+                        add_to_queue(m_queue, std::move(data));
+                    }
+                    return true;
+                }
+
+                void read_in_blocks() {
+                    while (!m_done) {
+                        const std::size_t offset = m_decompressor.offset();
+                        std::string data{m_decompressor.read_compressed_block()};
+                        if (data.empty()) {
+                            break;
+                        }
+                        submit_block(std::move(data), offset);
+
+                        // Forward the blocks that are done, but don't wait
+                        // for them unless there are too many in flight.
+                        while (!m_blocks.empty() &&
+                               (m_blocks.size() > max_blocks_in_flight() ||
+                                m_blocks.front().result.wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+                            if (!forward_oldest_block()) {
+                                return;
+                            }
+                        }
+                    }
+                    while (!m_done && !m_blocks.empty()) {
+                        if (!forward_oldest_block()) {
+                            return;
+                        }
+                    }
+                }
+
+                void read_sequentially() {
+                    while (!m_done) {
+                        std::string data {m_decompressor.read()};
+                        if (at_end_of_data(data)) {
+                            break;
+                        }
+                        add_to_queue(m_queue, std::move(data));
+                    }
+                }
+
+                // The decompression tasks use the decompressor, they must be
+                // done before it is closed or destroyed.
+                void wait_for_blocks() noexcept {
+                    for (auto& block : m_blocks) {
+                        if (block.result.valid()) {
+                            block.result.wait();
+                        }
+                    }
+                    m_blocks.clear();
+                }
+
                 void run_in_thread() {
                     osmium::thread::set_thread_name("_osmium_read");
 
                     try {
-                        while (!m_done) {
-                            std::string data {m_decompressor.read()};
-                            if (at_end_of_data(data)) {
-                                break;
-                            }
-                            add_to_queue(m_queue, std::move(data));
+                        if (m_pool && m_decompressor.can_decompress_blocks() &&
+                            osmium::config::use_pool_threads_for_decompression()) {
+                            read_in_blocks();
+                            wait_for_blocks();
                         }
 
+                        // Reads the rest of the input if the decompressor
+                        // could not split it into blocks or a block could
+                        // not be decompressed.
+                        read_sequentially();
+
                         m_decompressor.close();
                     } catch (...) {
+                        wait_for_blocks();
                         add_to_queue(m_queue, std::current_exception());
                     }
 
@@ -89,10 +235,18 @@ namespace osmium {
 
             public:
 
+                /**
+                 * Start the thread reading the input. If a pool is given,
+                 * it is used for decompressing blocks of the input in
+                 * parallel if the decompressor supports that.
+                 */
                 ReadThreadManager(osmium::io::Decompressor& decompressor,
-                                  future_string_queue_type& queue) :
+                                  future_string_queue_type& queue,
+                                  osmium::thread::Pool* pool = nullptr) :
                     m_decompressor(decompressor),
                     m_queue(queue),
+                    m_pool(pool),
+                    m_blocks(),
                     m_done(false),
                     m_thread(std::thread(&ReadThreadManager::run_in_thread, this)) {
                 }
@@ -0,0 +1,120 @@
+#ifndef OSMIUM_IO_DETAIL_SIMD_SCAN_HPP
+#define OSMIUM_IO_DETAIL_SIMD_SCAN_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <cstdint>
+
+#if !defined(OSMIUM_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+# define OSMIUM_SIMD_SCAN_SSE2
+# include <emmintrin.h>
+# ifdef _MSC_VER
+#  include <intrin.h>
+# endif
+#endif
+
+// The vector kernels read whole aligned 16 byte blocks. This can read up
+// to 15 bytes before the start or after the end of a string, but never
+// crosses into another page, so it is safe. The address sanitizer doesn't
+// know that.
+#if defined(__clang__) || defined(__GNUC__)
+# define OSMIUM_SIMD_SCAN_NO_SANITIZE __attribute__((no_sanitize_address))
+#else
+# define OSMIUM_SIMD_SCAN_NO_SANITIZE
+#endif
+
+namespace osmium {
+
+    namespace io {
+
+        namespace detail {
+
+            /**
+             * Building blocks for the vector scanning functions in
+             * opl_scan.hpp and xml_scan.hpp. They are only available if
+             * OSMIUM_SIMD_SCAN_SSE2 is defined, which is the case if the
+             * compiler supports SSE2 (always on x86_64) and OSMIUM_NO_SIMD
+             * is not defined.
+             */
+            namespace simd_scan {
+
+#ifdef OSMIUM_SIMD_SCAN_SSE2
+
+                inline int count_trailing_zeros(uint32_t mask) noexcept {
+# ifdef _MSC_VER
+                    unsigned long index;
+                    _BitScanForward(&index, mask);
+                    return static_cast<int>(index);
+# else
+                    return __builtin_ctz(mask);
+# endif
+                }
+
+                /**
+                 * Find the first character in s for which TMask sets a
+                 * bit. The mask function must set a bit for '\0', so the
+                 * search never goes beyond the 16 byte block containing
+                 * the end of the string.
+                 */
+                template <uint32_t (*TMask)(__m128i)>
+                OSMIUM_SIMD_SCAN_NO_SANITIZE
+                inline const char* find(const char* s) noexcept {
+                    const auto address = reinterpret_cast<std::uintptr_t>(s);
+                    const auto offset = static_cast<unsigned>(address & 15u);
+                    const auto* block = reinterpret_cast<const __m128i*>(address - offset);
+
+                    uint32_t mask = TMask(_mm_load_si128(block)) >> offset;
+                    if (mask) {
+                        return s + count_trailing_zeros(mask);
+                    }
+
+                    while (true) {
+                        ++block;
+                        mask = TMask(_mm_load_si128(block));
+                        if (mask) {
+                            return reinterpret_cast<const char*>(block) + count_trailing_zeros(mask);
+                        }
+                    }
+                }
+
+#endif
+
+            } // namespace simd_scan
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_DETAIL_SIMD_SCAN_HPP
@@ -0,0 +1,254 @@
+#ifndef OSMIUM_IO_DETAIL_STREAM_SPLITTER_HPP
+#define OSMIUM_IO_DETAIL_STREAM_SPLITTER_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+#ifndef _MSC_VER
+# include <unistd.h>
+#else
+# include <io.h>
+#endif
+
+#include <osmium/util/file.hpp>
+
+namespace osmium {
+
+    namespace io {
+
+        namespace detail {
+
+            /**
+             * Reads a compressed file consisting of several independent
+             * streams (bzip2) or members (gzip) one after the other and
+             * splits it into blocks of at least min_block_size bytes at
+             * stream boundaries, so that the blocks can be decompressed
+             * in parallel.
+             *
+             * Stream boundaries are found by looking for the magic bytes
+             * at the beginning of each stream. Because those bytes can
+             * also appear inside the compressed data, a boundary might be
+             * wrong. The user of this class has to check that each block
+             * decompresses completely and, if not, retry with the next
+             * block appended.
+             *
+             * If the file doesn't start with a stream header or if no
+             * boundary is found within max_block_size bytes (the file
+             * probably consists of a single stream), the splitter gives
+             * up. The file descriptor is then positioned at the
+             * beginning of the data not yet returned, so it can be read
+             * in the usual sequential way from there.
+             */
+            class StreamSplitter {
+
+            public:
+
+                /**
+                 * Function checking whether a stream starts at the given
+                 * position. There are at least header_size bytes available.
+                 */
+                using is_stream_start_func = bool (*)(const char* data);
+
+                static constexpr const std::size_t min_block_size = 1024 * 1024;
+                static constexpr const std::size_t max_block_size = 16 * 1024 * 1024;
+
+            private:
+
+                static constexpr const std::size_t read_size = 1024 * 1024;
+
+                int m_fd;
+                char m_first_byte;
+                std::size_t m_header_size;
+                is_stream_start_func m_is_stream_start;
+
+                // Data read from the file but not returned yet.
+                std::string m_input;
+
+                // File offset of the beginning of m_input.
+                std::size_t m_offset;
+
+                // m_input has been searched for stream starts up to here.
+                std::size_t m_searched = min_block_size;
+
+                bool m_eof = false;
+                bool m_checked_start = false;
+                bool m_gave_up = false;
+
+                // Returns the position of the next stream start after
+                // min_block_size bytes or 0 if there is none (yet).
+                std::size_t find_stream_start() noexcept {
+                    while (m_searched + m_header_size <= m_input.size()) {
+                        const auto* start = m_input.data() + m_searched;
+                        const auto* pos = static_cast<const char*>(std::memchr(start, m_first_byte, m_input.size() - m_header_size + 1 - m_searched));
+                        if (!pos) {
+                            m_searched = m_input.size() - m_header_size + 1;
+                            break;
+                        }
+                        m_searched = static_cast<std::size_t>(pos - m_input.data());
+                        if (m_is_stream_start(pos)) {
+                            return m_searched;
+                        }
+                        ++m_searched;
+                    }
+                    return 0;
+                }
+
+                void give_up() {
+                    give_up_at(m_offset);
+                }
+
+                bool read_more() {
+                    const std::size_t old_size = m_input.size();
+                    m_input.resize(old_size + read_size);
+                    const auto nread = ::read(m_fd, &m_input[old_size], static_cast<unsigned int>(read_size));
+                    if (nread < 0) {
+                        m_input.resize(old_size);
+                        throw std::system_error{errno, std::system_category(), "Read failed"};
+                    }
+                    m_input.resize(old_size + static_cast<std::size_t>(nread));
+                    return nread > 0;
+                }
+
+            public:
+
+                /**
+                 * @param fd File descriptor to read from.
+                 * @param first_byte First byte of the stream header.
+                 * @param header_size Number of bytes is_stream_start needs.
+                 * @param is_stream_start Function checking for a stream header.
+                 */
+                StreamSplitter(int fd, char first_byte, std::size_t header_size, is_stream_start_func is_stream_start) :
+                    m_fd(fd),
+                    m_first_byte(first_byte),
+                    m_header_size(header_size),
+                    m_is_stream_start(is_stream_start),
+                    m_offset(osmium::util::file_offset(fd)) {
+                }
+
+                /**
+                 * File offset of the data not returned yet.
+                 */
+                std::size_t offset() const noexcept {
+                    return m_offset;
+                }
+
+                /**
+                 * Stop splitting the input and position the file descriptor
+                 * at the given offset, so that the input can be read in the
+                 * usual sequential way from there. This is used if a block
+                 * could not be decompressed, the offset is then the start
+                 * of that block.
+                 *
+                 * @throws std::system_error If seeking failed.
+                 */
+                void give_up_at(std::size_t offset) {
+                    m_gave_up = true;
+                    m_input.clear();
+                    m_offset = offset;
+#ifdef _MSC_VER
+                    if (_lseeki64(m_fd, static_cast<__int64>(m_offset), SEEK_SET) < 0) {
+#else
+                    if (::lseek(m_fd, static_cast<off_t>(m_offset), SEEK_SET) < 0) {
+#endif
+                        throw std::system_error{errno, std::system_category(), "Seek failed"};
+                    }
+                }
+
+                /**
+                 * Has the splitter given up on finding stream boundaries?
+                 */
+                bool gave_up() const noexcept {
+                    return m_gave_up;
+                }
+
+                /**
+                 * Get the next block. Returns an empty string at the end of
+                 * the file or if no stream boundary was found (see gave_up()).
+                 *
+                 * @throws std::system_error If reading or seeking failed.
+                 */
+                std::string next_block() {
+                    if (m_gave_up) {
+                        return std::string{};
+                    }
+
+                    while (true) {
+                        const std::size_t pos = find_stream_start();
+                        if (pos > 0) {
+                            std::string block{m_input.substr(0, pos)};
+                            m_input.erase(0, pos);
+                            m_offset += pos;
+                            m_searched = min_block_size;
+                            return block;
+                        }
+
+                        if (m_eof) {
+                            std::string block;
+                            std::swap(block, m_input);
+                            m_offset += block.size();
+                            return block;
+                        }
+
+                        if (m_input.size() >= max_block_size) {
+                            give_up();
+                            return std::string{};
+                        }
+
+                        m_eof = !read_more();
+
+                        // Data not starting with a stream header is
+                        // handled by the sequential decompressor.
+                        if (!m_checked_start && m_input.size() >= m_header_size) {
+                            m_checked_start = true;
+                            if (!m_is_stream_start(m_input.data())) {
+                                give_up();
+                                return std::string{};
+                            }
+                        }
+                    }
+                }
+
+            }; // class StreamSplitter
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_DETAIL_STREAM_SPLITTER_HPP
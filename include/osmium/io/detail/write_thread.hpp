@@ -33,6 +33,9 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <chrono>
+#include <cstddef>
+#include <deque>
 #include <exception>
 #include <future>
 #include <memory>
@@ -41,7 +44,9 @@ DEALINGS IN THE SOFTWARE.
 
 #include <osmium/io/compression.hpp>
 #include <osmium/io/detail/queue_util.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/thread/util.hpp>
+#include <osmium/util/config.hpp>
 
 namespace osmium {
 
@@ -53,21 +58,96 @@ namespace osmium {
              * This codes runs in its own thread, getting data from the given
              * queue, (optionally) compressing it, and writing it to the output
              * file.
+             *
+             * If the compressor can compress blocks independently of each
+             * other, the data is collected into blocks of at least
+             * compression_block_size bytes which are compressed in the
+             * thread pool. The compressed blocks are written in order. At
+             * most a few blocks per pool thread are in flight at any time.
              */
             class WriteThread {
 
+                static constexpr const std::size_t compression_block_size = 1024 * 1024;
+
                 queue_wrapper<std::string> m_queue;
                 std::unique_ptr<osmium::io::Compressor> m_compressor;
                 std::promise<bool> m_promise;
+                osmium::thread::Pool* m_pool;
+
+                // Compressed blocks not yet written out, oldest first.
+                std::deque<std::future<std::string>> m_compressed;
+
+                std::size_t max_blocks_in_flight() const noexcept {
+                    return static_cast<std::size_t>(m_pool->num_threads()) * 2;
+                }
+
+                void write_oldest_block() {
+                    const std::string data{m_compressed.front().get()};
+                    m_compressed.pop_front();
+                    m_compressor->write_compressed(data);
+                }
+
+                void submit_block(std::string&& data) {
+                    auto* compressor = m_compressor.get();
+                    auto block = std::make_shared<std::string>(std::move(data));
+                    m_compressed.push_back(m_pool->submit([compressor, block]() {
+                        return compressor->compress_block(*block);
+                    }));
+
+                    // Write out the blocks that are done, but don't wait for
+                    // them unless there are too many in flight.
+                    while (!m_compressed.empty() &&
+                           (m_compressed.size() > max_blocks_in_flight() ||
+                            m_compressed.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+                        write_oldest_block();
+                    }
+                }
+
+                void write_in_blocks() {
+                    std::string block;
+                    while (true) {
+                        std::string data{m_queue.pop()};
+                        if (at_end_of_data(data)) {
+                            break;
+                        }
+                        if (block.empty()) {
+                            block = std::move(data);
+                        } else {
+                            block.append(data);
+                        }
+                        if (block.size() >= compression_block_size) {
+                            submit_block(std::move(block));
+                            block.clear();
+                        }
+                    }
+                    if (!block.empty()) {
+                        submit_block(std::move(block));
+                    }
+                    while (!m_compressed.empty()) {
+                        write_oldest_block();
+                    }
+                }
+
+                void write_in_one_stream() {
+                    while (true) {
+                        const std::string data{m_queue.pop()};
+                        if (at_end_of_data(data)) {
+                            break;
+                        }
+                        m_compressor->write(data);
+                    }
+                }
 
             public:
 
                 WriteThread(future_string_queue_type& input_queue,
                             std::unique_ptr<osmium::io::Compressor>&& compressor,
-                            std::promise<bool>&& promise) :
+                            std::promise<bool>&& promise,
+                            osmium::thread::Pool* pool = nullptr) :
                     m_queue(input_queue),
                     m_compressor(std::move(compressor)),
-                    m_promise(std::move(promise)) {
+                    m_promise(std::move(promise)),
+                    m_pool(pool) {
                 }
 
                 WriteThread(const WriteThread&) = delete;
@@ -82,18 +162,24 @@ namespace osmium {
                     osmium::thread::set_thread_name("_osmium_write");
 
                     try {
-                        while (true) {
-                            const std::string data{m_queue.pop()};
-                            if (at_end_of_data(data)) {
-                                break;
-                            }
-                            m_compressor->write(data);
+                        if (m_pool && m_compressor->can_compress_blocks() &&
+                            osmium::config::use_pool_threads_for_compression()) {
+                            write_in_blocks();
+                        } else {
+                            write_in_one_stream();
                         }
                         m_compressor->close();
                         m_promise.set_value(true);
                     } catch (...) {
                         m_promise.set_exception(std::current_exception());
                         m_queue.drain();
+                        // The compression tasks use the compressor, they
+                        // must be done before it is destroyed.
+                        for (auto& future : m_compressed) {
+                            if (future.valid()) {
+                                future.wait();
+                            }
+                        }
                     }
                 }
 
@@ -33,23 +33,31 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <deque>
 #include <future>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <expat.h>
+#include <utf8.h>
 
 #include <osmium/builder/builder.hpp>
 #include <osmium/builder/osm_object_builder.hpp>
 #include <osmium/io/detail/input_format.hpp>
 #include <osmium/io/detail/queue_util.hpp>
+#include <osmium/io/detail/xml_scan.hpp>
 #include <osmium/io/error.hpp>
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/memory/buffer_pool.hpp>
 #include <osmium/osm/box.hpp>
 #include <osmium/osm/changeset.hpp>
 #include <osmium/osm/entity_bits.hpp>
@@ -63,8 +71,10 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/osm/types.hpp>
 #include <osmium/osm/types_from_string.hpp>
 #include <osmium/osm/way.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/thread/util.hpp>
 #include <osmium/util/cast.hpp>
+#include <osmium/util/config.hpp>
 
 namespace osmium {
 
@@ -101,6 +111,19 @@ namespace osmium {
             error_string(message) {
         }
 
+        xml_error(unsigned long line_number, unsigned long column_number, XML_Error code) :
+            io_error(std::string{"XML parsing error at line "}
+                    + std::to_string(line_number)
+                    + ", column "
+                    + std::to_string(column_number)
+                    + ": "
+                    + XML_ErrorString(code)),
+            line(line_number),
+            column(column_number),
+            error_code(code),
+            error_string(XML_ErrorString(code)) {
+        }
+
     }; // struct xml_error
 
     /**
@@ -127,9 +150,662 @@ namespace osmium {
 
         namespace detail {
 
-            class XMLParser : public Parser {
+            /**
+             * A streaming tokenizer for the subset of XML used in OSM files.
+             * It calls the same start_element(), end_element(), and
+             * characters() functions on the callback object as the Expat
+             * wrapper does, but it parses the data in place and uses the
+             * vector functions from xml_scan.hpp to find the ends of names
+             * and attribute values, so it is a lot faster.
+             *
+             * The tokenizer doesn't handle DOCTYPE declarations, encodings
+             * other than UTF-8 (or ASCII), and UTF-16 input. If any of these
+             * are found in the prolog, ie. before anything was reported to
+             * the callback object, operator() returns false and the caller
+             * should parse the input with Expat instead. It also does not
+             * check that names are valid XML names, that the input is valid
+             * UTF-8, or that attribute names are unique.
+             *
+             * Element and attribute names are reported as null-terminated
+             * strings and not as pre-classified tokens, because the
+             * XMLHandler gets the same calls from Expat when the fallback
+             * is used. This costs little: The handler only compares the
+             * names valid in the current context, and most comparisons
+             * of these short names fail on the first character.
+             */
+            template <typename T>
+            class XMLTokenizer {
+
+                struct attribute {
+                    char* name;
+                    char* name_end;
+                    char* value;
+                    char* value_end;
+                    bool needs_decoding;
+                };
+
+                enum class state {
+                    start,   // nothing seen yet, check for byte order mark
+                    prolog,  // before the root element
+                    content, // inside the root element
+                    epilog   // after the end of the root element
+                };
+
+                T* m_callback;
+
+                // Data not parsed yet. The first part of it is the last
+                // (incomplete) token from the previous call.
+                std::string m_data;
+
+                const char* m_begin = nullptr;
+
+                // Names of the currently open elements.
+                std::vector<std::string> m_elements;
+                std::size_t m_depth = 0;
+
+                std::vector<attribute> m_attributes;
+                std::vector<const char*> m_attrs;
+
+                // Current line number and offset of the start of the
+                // current line relative to the start of m_data.
+                unsigned long m_line = 1;
+                std::ptrdiff_t m_line_start = 0;
+
+                state m_state = state::start;
+                bool m_needs_fallback = false;
+
+                [[noreturn]] void throw_error(const char* pos, XML_Error code) const {
+                    throw osmium::xml_error{m_line,
+                                            static_cast<unsigned long>((pos - m_begin) - m_line_start),
+                                            code};
+                }
 
-                static constexpr int buffer_size = 2 * 1000 * 1000;
+                void count_lines(const char* begin, const char* end) noexcept {
+                    for (; begin != end; ++begin) {
+                        if (*begin == '\n') {
+                            ++m_line;
+                            m_line_start = begin + 1 - m_begin;
+                        }
+                    }
+                }
+
+                // Most calls find no or a single space, so check that
+                // before using the vector function. Lines are only counted
+                // in the whitespace actually skipped. The data always ends
+                // in a '\0' which stops the search at the end.
+                char* skip_space(char* s, const char* end) noexcept {
+                    if (s == end || !xml_scan::is_space(*s)) {
+                        return s;
+                    }
+                    if (*s == ' ' && !xml_scan::is_space(s[1])) {
+                        return s + 1;
+                    }
+                    char* p = const_cast<char*>(xml_scan::find_non_space(s));
+                    count_lines(s, p);
+                    return p;
+                }
+
+                // Returns 1 if the data at s starts with str, 0 if it does
+                // not, and -1 if there isn't enough data to decide.
+                static int match(const char* s, const char* end, const char* str) noexcept {
+                    for (; *str; ++s, ++str) {
+                        if (s == end) {
+                            return -1;
+                        }
+                        if (*s != *str) {
+                            return 0;
+                        }
+                    }
+                    return 1;
+                }
+
+                static char* find(char* s, char* end, const char* str) noexcept {
+                    return std::search(s, end, str, str + std::strlen(str));
+                }
+
+                static bool is_utf8_encoding(const char* s, const char* end) noexcept {
+                    std::string encoding{s, end};
+                    for (auto& c : encoding) {
+                        if (c >= 'a' && c <= 'z') {
+                            c = static_cast<char>(c - 'a' + 'A');
+                        }
+                    }
+                    return encoding == "UTF-8" || encoding == "UTF8" || encoding == "US-ASCII";
+                }
+
+                // Decode a character or entity reference starting after
+                // the '&' at s. Writes the decoded character to out and
+                // returns a pointer to the character after the reference.
+                const char* decode_reference(const char* s, const char* end, char*& out) const {
+                    const char* semicolon = static_cast<const char*>(std::memchr(s, ';', static_cast<std::size_t>(end - s)));
+                    if (!semicolon || semicolon == s) {
+                        throw_error(s - 1, XML_ERROR_INVALID_TOKEN);
+                    }
+
+                    if (*s != '#') {
+                        static const char* const entities[] = {"lt<", "gt>", "amp&", "quot\"", "apos'"};
+                        const auto len = static_cast<std::size_t>(semicolon - s);
+                        for (const char* entity : entities) {
+                            if (std::strlen(entity) == len + 1 && !std::strncmp(entity, s, len)) {
+                                *out++ = entity[len];
+                                return semicolon + 1;
+                            }
+                        }
+                        throw_error(s - 1, XML_ERROR_UNDEFINED_ENTITY);
+                    }
+
+                    ++s;
+                    const bool hex = (*s == 'x');
+                    if (hex) {
+                        ++s;
+                    }
+                    if (s == semicolon) {
+                        throw_error(s - 1, XML_ERROR_INVALID_TOKEN);
+                    }
+
+                    uint32_t value = 0;
+                    for (; s != semicolon; ++s) {
+                        uint32_t digit;
+                        if (*s >= '0' && *s <= '9') {
+                            digit = static_cast<uint32_t>(*s - '0');
+                        } else if (hex && *s >= 'a' && *s <= 'f') {
+                            digit = static_cast<uint32_t>(*s - 'a' + 10);
+                        } else if (hex && *s >= 'A' && *s <= 'F') {
+                            digit = static_cast<uint32_t>(*s - 'A' + 10);
+                        } else {
+                            throw_error(s, XML_ERROR_INVALID_TOKEN);
+                        }
+                        value = value * (hex ? 16 : 10) + digit;
+                        if (value > 0x10ffff) {
+                            throw_error(s, XML_ERROR_BAD_CHAR_REF);
+                        }
+                    }
+
+                    const bool is_xml_char = value == 0x9 || value == 0xa || value == 0xd ||
+                                             (value >= 0x20 && value <= 0xd7ff) ||
+                                             (value >= 0xe000 && value <= 0xfffd) ||
+                                             value >= 0x10000;
+                    if (!is_xml_char) {
+                        throw_error(s, XML_ERROR_BAD_CHAR_REF);
+                    }
+
+                    out = utf8::append(value, out);
+                    return semicolon + 1;
+                }
+
+                // Decode references and normalize line ends in the range
+                // [begin, end) in place the same way Expat does. In
+                // attribute values whitespace characters are replaced by
+                // spaces. Returns the new end of the data.
+                char* decode(char* begin, const char* end, bool in_attribute) const {
+                    char* out = begin;
+                    const char* s = begin;
+                    while (s != end) {
+                        const char c = *s;
+                        if (c == '&') {
+                            s = decode_reference(s + 1, end, out);
+                        } else if (c == '\r') {
+                            *out++ = in_attribute ? ' ' : '\n';
+                            ++s;
+                            if (s != end && *s == '\n') {
+                                ++s;
+                            }
+                        } else {
+                            *out++ = (in_attribute && (c == '\n' || c == '\t')) ? ' ' : c;
+                            ++s;
+                        }
+                    }
+                    return out;
+                }
+
+                char* parse_text(char* s, char* end) {
+                    char* text_end = static_cast<char*>(std::memchr(s, '<', static_cast<std::size_t>(end - s)));
+                    if (!text_end) {
+                        return nullptr;
+                    }
+
+                    bool needs_decoding = false;
+                    for (char* p = s; p != text_end; ++p) {
+                        switch (*p) {
+                            case '\n':
+                                ++m_line;
+                                m_line_start = p + 1 - m_begin;
+                                break;
+                            case '&':
+                            case '\r':
+                                needs_decoding = true;
+                                break;
+                            case '\0':
+                                throw_error(p, XML_ERROR_INVALID_TOKEN);
+                            default:
+                                break;
+                        }
+                    }
+
+                    const char* data_end = needs_decoding ? decode(s, text_end, false) : text_end;
+                    m_callback->characters(s, static_cast<int>(data_end - s));
+
+                    return text_end;
+                }
+
+                // Parse a start tag or empty element tag. Nothing is changed
+                // in the data before it is known that the tag is complete.
+                char* parse_start_tag(char* s, char* end) {
+                    if (m_state == state::epilog) {
+                        throw_error(s, XML_ERROR_JUNK_AFTER_DOC_ELEMENT);
+                    }
+
+                    char* name = s + 1;
+                    char* name_end = const_cast<char*>(xml_scan::find_name_end(name));
+                    if (name_end == end) {
+                        return nullptr;
+                    }
+                    if (name_end == name || *name_end == '\0' || *name_end == '=') {
+                        throw_error(s, XML_ERROR_INVALID_TOKEN);
+                    }
+
+                    m_attributes.clear();
+                    bool empty_element = false;
+                    char* p = name_end;
+                    while (true) {
+                        char* q = skip_space(p, end);
+                        if (q == end) {
+                            return nullptr;
+                        }
+                        if (*q == '>') {
+                            p = q + 1;
+                            break;
+                        }
+                        if (*q == '/') {
+                            if (q + 1 == end) {
+                                return nullptr;
+                            }
+                            if (q[1] != '>') {
+                                throw_error(q, XML_ERROR_INVALID_TOKEN);
+                            }
+                            empty_element = true;
+                            p = q + 2;
+                            break;
+                        }
+                        if (q == p) { // no space before attribute
+                            throw_error(q, XML_ERROR_INVALID_TOKEN);
+                        }
+
+                        attribute attr;
+                        attr.name = q;
+                        attr.name_end = const_cast<char*>(xml_scan::find_name_end(q));
+                        if (attr.name_end == end) {
+                            return nullptr;
+                        }
+                        if (attr.name_end == attr.name) {
+                            throw_error(q, XML_ERROR_INVALID_TOKEN);
+                        }
+
+                        q = skip_space(attr.name_end, end);
+                        if (q == end) {
+                            return nullptr;
+                        }
+                        if (*q != '=') {
+                            throw_error(q, XML_ERROR_INVALID_TOKEN);
+                        }
+                        q = skip_space(q + 1, end);
+                        if (q == end) {
+                            return nullptr;
+                        }
+                        const char quote = *q;
+                        if (quote != '"' && quote != '\'') {
+                            throw_error(q, XML_ERROR_INVALID_TOKEN);
+                        }
+
+                        attr.value = q + 1;
+                        attr.needs_decoding = false;
+                        q = attr.value;
+                        while (true) {
+                            q = const_cast<char*>(quote == '"' ? xml_scan::find_value_special<'"'>(q)
+                                                               : xml_scan::find_value_special<'\''>(q));
+                            if (*q == quote) {
+                                break;
+                            }
+                            if (*q == '\0') {
+                                if (q == end) {
+                                    return nullptr;
+                                }
+                                throw_error(q, XML_ERROR_INVALID_TOKEN);
+                            }
+                            if (*q == '<') {
+                                throw_error(q, XML_ERROR_INVALID_TOKEN);
+                            }
+                            if (*q == '\n') {
+                                ++m_line;
+                                m_line_start = q + 1 - m_begin;
+                            }
+                            attr.needs_decoding = true;
+                            ++q;
+                        }
+                        attr.value_end = q;
+
+                        m_attributes.push_back(attr);
+                        p = q + 1;
+                    }
+
+                    // The tag is complete, now terminate and decode the
+                    // names and values in place.
+                    m_attrs.clear();
+                    for (const auto& attr : m_attributes) {
+                        *attr.name_end = '\0';
+                        char* value_end = attr.needs_decoding ? decode(attr.value, attr.value_end, true) : attr.value_end;
+                        *value_end = '\0';
+                        m_attrs.push_back(attr.name);
+                        m_attrs.push_back(attr.value);
+                    }
+                    m_attrs.push_back(nullptr);
+
+                    const auto name_length = static_cast<std::size_t>(name_end - name);
+                    *name_end = '\0';
+
+                    m_state = state::content;
+                    m_callback->start_element(name, m_attrs.data());
+                    if (empty_element) {
+                        m_callback->end_element(name);
+                        if (m_depth == 0) {
+                            m_state = state::epilog;
+                        }
+                    } else {
+                        if (m_depth == m_elements.size()) {
+                            m_elements.emplace_back();
+                        }
+                        m_elements[m_depth++].assign(name, name_length);
+                    }
+
+                    return p;
+                }
+
+                char* parse_end_tag(char* s, char* end) {
+                    char* name = s + 2;
+                    char* name_end = const_cast<char*>(xml_scan::find_name_end(name));
+                    if (name_end == end) {
+                        return nullptr;
+                    }
+                    char* p = skip_space(name_end, end);
+                    if (p == end) {
+                        return nullptr;
+                    }
+                    if (*p != '>' || name_end == name) {
+                        throw_error(s, XML_ERROR_INVALID_TOKEN);
+                    }
+                    if (m_depth == 0) {
+                        throw_error(s, m_state == state::epilog ? XML_ERROR_JUNK_AFTER_DOC_ELEMENT
+                                                                : XML_ERROR_INVALID_TOKEN);
+                    }
+
+                    const auto& open_element = m_elements[m_depth - 1];
+                    const auto name_length = static_cast<std::size_t>(name_end - name);
+                    if (open_element.size() != name_length || std::memcmp(open_element.data(), name, name_length)) {
+                        throw_error(s, XML_ERROR_TAG_MISMATCH);
+                    }
+
+                    *name_end = '\0';
+                    m_callback->end_element(name);
+                    if (--m_depth == 0) {
+                        m_state = state::epilog;
+                    }
+
+                    return p + 1;
+                }
+
+                // Parse processing instruction (including the XML
+                // declaration).
+                char* parse_processing_instruction(char* s, char* end) {
+                    char* pi_end = find(s + 2, end, "?>");
+                    if (pi_end == end) {
+                        return nullptr;
+                    }
+
+                    if (m_state == state::prolog && match(s, end, "<?xml") == 1 && xml_scan::is_space(s[5])) {
+                        const auto not_space = [](char c) {
+                            return !xml_scan::is_space(c);
+                        };
+                        char* encoding = find(s + 5, pi_end, "encoding");
+                        if (encoding != pi_end) {
+                            char* p = std::find_if(encoding + 8, pi_end, not_space);
+                            if (p != pi_end && *p == '=') {
+                                p = std::find_if(p + 1, pi_end, not_space);
+                            }
+                            if (p != pi_end && (*p == '"' || *p == '\'')) {
+                                char* value_end = std::find(p + 1, pi_end, *p);
+                                if (!is_utf8_encoding(p + 1, value_end)) {
+                                    m_needs_fallback = true;
+                                    return nullptr;
+                                }
+                            }
+                        }
+                    }
+
+                    count_lines(s, pi_end);
+                    return pi_end + 2;
+                }
+
+                // Parse comments, CDATA sections, and DOCTYPE declarations.
+                char* parse_markup_declaration(char* s, char* end) {
+                    int m = match(s, end, "<!--");
+                    if (m == -1) {
+                        return nullptr;
+                    }
+                    if (m == 1) {
+                        char* comment_end = find(s + 4, end, "-->");
+                        if (comment_end == end) {
+                            return nullptr;
+                        }
+                        count_lines(s, comment_end);
+                        return comment_end + 3;
+                    }
+
+                    if (m_state == state::content) {
+                        m = match(s, end, "<![CDATA[");
+                        if (m == -1) {
+                            return nullptr;
+                        }
+                        if (m == 1) {
+                            char* data = s + 9;
+                            char* data_end = find(data, end, "]]>");
+                            if (data_end == end) {
+                                return nullptr;
+                            }
+                            count_lines(data, data_end);
+                            m_callback->characters(data, static_cast<int>(data_end - data));
+                            return data_end + 3;
+                        }
+                    } else if (m_state == state::prolog) {
+                        m = match(s, end, "<!DOCTYPE");
+                        if (m == -1) {
+                            return nullptr;
+                        }
+                        if (m == 1) {
+                            m_needs_fallback = true;
+                            return nullptr;
+                        }
+                    }
+
+                    throw_error(s, m_state == state::epilog ? XML_ERROR_JUNK_AFTER_DOC_ELEMENT
+                                                            : XML_ERROR_INVALID_TOKEN);
+                }
+
+                // Parse the token starting at s. Returns the start of the
+                // next token or nullptr if the token is incomplete.
+                char* parse_token(char* s, char* end) {
+                    if (*s != '<') {
+                        if (m_state == state::content) {
+                            return parse_text(s, end);
+                        }
+                        char* p = skip_space(s, end);
+                        if (p != end && *p != '<') {
+                            throw_error(p, m_state == state::epilog ? XML_ERROR_JUNK_AFTER_DOC_ELEMENT
+                                                                    : XML_ERROR_INVALID_TOKEN);
+                        }
+                        return p;
+                    }
+
+                    if (s + 1 == end) {
+                        return nullptr;
+                    }
+
+                    switch (s[1]) {
+                        case '/':
+                            return parse_end_tag(s, end);
+                        case '?':
+                            return parse_processing_instruction(s, end);
+                        case '!':
+                            return parse_markup_declaration(s, end);
+                        default:
+                            break;
+                    }
+
+                    return parse_start_tag(s, end);
+                }
+
+                // Check the start of the document for byte order marks.
+                // Returns the number of bytes to skip or -1 if the input
+                // is not UTF-8.
+                int check_start() const noexcept {
+                    const auto* s = reinterpret_cast<const unsigned char*>(m_data.data());
+                    const auto size = m_data.size();
+                    if (size >= 3 && s[0] == 0xef && s[1] == 0xbb && s[2] == 0xbf) {
+                        return 3;
+                    }
+                    if (size >= 2 && ((s[0] == 0xfe && s[1] == 0xff) || (s[0] == 0xff && s[1] == 0xfe))) {
+                        return -1;
+                    }
+                    if ((size >= 1 && s[0] == 0) || (size >= 2 && s[1] == 0)) {
+                        return -1;
+                    }
+                    return 0;
+                }
+
+            public:
+
+                explicit XMLTokenizer(T* callback_object) :
+                    m_callback(callback_object) {
+                }
+
+                /**
+                 * Create a tokenizer for parsing a fragment of a document
+                 * starting inside the root element.
+                 *
+                 * @param callback_object Object the callbacks are called on.
+                 * @param root_element Name of the root element.
+                 * @param line Line number of the start of the fragment.
+                 */
+                XMLTokenizer(T* callback_object, const char* root_element, unsigned long line) :
+                    m_callback(callback_object),
+                    m_elements(1, root_element),
+                    m_depth(1),
+                    m_line(line),
+                    m_state(state::content) {
+                }
+
+                /**
+                 * Is the tokenizer still in the prolog of the document, ie.
+                 * has nothing been reported to the callback object yet?
+                 */
+                bool in_prolog() const noexcept {
+                    return m_state == state::start || m_state == state::prolog;
+                }
+
+                /**
+                 * Has all data been parsed and is the tokenizer inside the
+                 * root element, but not inside any other element? Data at
+                 * the end which can only be character data is ignored.
+                 */
+                bool at_top_level() const noexcept {
+                    return m_state == state::content &&
+                           m_depth == 1 &&
+                           m_data.find('<') == std::string::npos;
+                }
+
+                /**
+                 * The line number at the end of the data parsed so far.
+                 */
+                unsigned long line() const noexcept {
+                    return m_line + static_cast<unsigned long>(std::count(m_data.begin(), m_data.end(), '\n'));
+                }
+
+                /**
+                 * Parse the next chunk of data. The contents of the data
+                 * string will be changed. Set last to true for the last chunk.
+                 *
+                 * @returns false if the input can not be handled by the
+                 *          tokenizer. This can only happen while in_prolog()
+                 *          is true.
+                 * @throws osmium::xml_error if the input is not well-formed.
+                 */
+                bool operator()(std::string& data, bool last) {
+                    if (m_data.empty()) {
+                        using std::swap;
+                        swap(m_data, data);
+                    } else {
+                        m_data.append(data);
+                    }
+
+                    char* const begin = &m_data[0];
+                    char* const end = begin + m_data.size();
+                    m_begin = begin;
+                    char* s = begin;
+
+                    if (m_state == state::start) {
+                        if (m_data.size() < 3 && !last) {
+                            return true;
+                        }
+                        const int skip = check_start();
+                        if (skip < 0) {
+                            return false;
+                        }
+                        s += skip;
+                        m_state = state::prolog;
+                    }
+
+                    while (s != end) {
+                        const auto line = m_line;
+                        const auto line_start = m_line_start;
+                        char* next = parse_token(s, end);
+                        if (!next) {
+                            if (m_needs_fallback) {
+                                return false;
+                            }
+                            m_line = line;
+                            m_line_start = line_start;
+                            break;
+                        }
+                        s = next;
+                    }
+
+                    if (last) {
+                        if (s != end) {
+                            if (*s == '<' || m_state != state::content) {
+                                throw_error(s, XML_ERROR_UNCLOSED_TOKEN);
+                            }
+                            count_lines(s, end);
+                        }
+                        if (m_state != state::epilog) {
+                            throw_error(end, XML_ERROR_NO_ELEMENTS);
+                        }
+                    }
+
+                    const auto consumed = s - begin;
+                    m_line_start -= consumed;
+                    m_data.erase(0, static_cast<std::size_t>(consumed));
+
+                    return true;
+                }
+
+            }; // class XMLTokenizer
+
+            /**
+             * Handles the elements reported by the XMLTokenizer or Expat and
+             * builds the header and the OSM objects from them. The XMLParser
+             * uses it for the whole input, the XMLChunkParser for chunks of
+             * it.
+             */
+            class XMLHandler {
 
                 enum class context {
                     root,
@@ -173,67 +849,7 @@ namespace osmium {
 
                 std::string m_comment_text;
 
-                /**
-                 * A C++ wrapper for the Expat parser that makes sure no memory is leaked.
-                 */
-                template <typename T>
-                class ExpatXMLParser {
-
-                    XML_Parser m_parser;
-
-                    static void XMLCALL start_element_wrapper(void* data, const XML_Char* element, const XML_Char** attrs) {
-                        static_cast<XMLParser*>(data)->start_element(element, attrs);
-                    }
-
-                    static void XMLCALL end_element_wrapper(void* data, const XML_Char* element) {
-                        static_cast<XMLParser*>(data)->end_element(element);
-                    }
-
-                    static void XMLCALL character_data_wrapper(void* data, const XML_Char* text, int len) {
-                        static_cast<XMLParser*>(data)->characters(text, len);
-                    }
-
-                    // This handler is called when there are any XML entities
-                    // declared in the OSM file. Entities are normally not used,
-                    // but they can be misused. See
-                    // https://en.wikipedia.org/wiki/Billion_laughs
-                    // The handler will just throw an error.
-                    static void entity_declaration_handler(void*,
-                            const XML_Char*, int, const XML_Char*, int, const XML_Char*,
-                            const XML_Char*, const XML_Char*, const XML_Char*) {
-                        throw osmium::xml_error{"XML entities are not supported"};
-                    }
-
-                public:
-
-                    explicit ExpatXMLParser(T* callback_object) :
-                        m_parser(XML_ParserCreate(nullptr)) {
-                        if (!m_parser) {
-                            throw osmium::io_error{"Internal error: Can not create parser"};
-                        }
-                        XML_SetUserData(m_parser, callback_object);
-                        XML_SetElementHandler(m_parser, start_element_wrapper, end_element_wrapper);
-                        XML_SetCharacterDataHandler(m_parser, character_data_wrapper);
-                        XML_SetEntityDeclHandler(m_parser, entity_declaration_handler);
-                    }
-
-                    ExpatXMLParser(const ExpatXMLParser&) = delete;
-                    ExpatXMLParser(ExpatXMLParser&&) = delete;
-
-                    ExpatXMLParser& operator=(const ExpatXMLParser&) = delete;
-                    ExpatXMLParser& operator=(ExpatXMLParser&&) = delete;
-
-                    ~ExpatXMLParser() noexcept {
-                        XML_ParserFree(m_parser);
-                    }
-
-                    void operator()(const std::string& data, bool last) {
-                        if (XML_Parse(m_parser, data.data(), static_cast_with_assert<int>(data.size()), last) == XML_STATUS_ERROR) {
-                            throw osmium::xml_error{m_parser};
-                        }
-                    }
-
-                }; // class ExpatXMLParser
+                osmium::osm_entity_bits::type m_read_types;
 
                 template <typename T>
                 static void check_attributes(const XML_Char** attrs, T check) {
@@ -312,7 +928,72 @@ namespace osmium {
                 }
 
                 void mark_header_as_done() {
-                    set_header_value(m_header);
+                    header_done(m_header);
+                }
+
+            protected:
+
+                /**
+                 * Called when the header is complete, ie. when the first OSM
+                 * object or the end of the root element is found.
+                 */
+                virtual void header_done(const osmium::io::Header& /*header*/) {
+                }
+
+                /**
+                 * Called after each OSM object was committed to the buffer.
+                 */
+                virtual void object_done() {
+                }
+
+            public:
+
+                /**
+                 * @param read_types Which entities should be parsed?
+                 * @param buffer The buffer the objects are added to.
+                 * @param in_root_element Set to true if parsing starts
+                 *                        inside the root (osm) element.
+                 */
+                XMLHandler(osmium::osm_entity_bits::type read_types, osmium::memory::Buffer&& buffer, bool in_root_element = false) :
+                    m_context(in_root_element ? context::top : context::root),
+                    m_last_context(context::root),
+                    m_in_delete_section(false),
+                    m_header(),
+                    m_buffer(std::move(buffer)),
+                    m_node_builder(),
+                    m_way_builder(),
+                    m_relation_builder(),
+                    m_changeset_builder(),
+                    m_changeset_discussion_builder(),
+                    m_tl_builder(),
+                    m_wnl_builder(),
+                    m_rml_builder(),
+                    m_comment_text(),
+                    m_read_types(read_types) {
+                }
+
+                XMLHandler(const XMLHandler&) = delete;
+                XMLHandler& operator=(const XMLHandler&) = delete;
+
+                XMLHandler(XMLHandler&&) = delete;
+                XMLHandler& operator=(XMLHandler&&) = delete;
+
+                virtual ~XMLHandler() noexcept = default;
+
+                const osmium::io::Header& header() const noexcept {
+                    return m_header;
+                }
+
+                osmium::memory::Buffer& buffer() noexcept {
+                    return m_buffer;
+                }
+
+                /**
+                 * Is the handler inside the root element of an OSM file
+                 * (not an OSM change file), but outside of any object?
+                 */
+                bool at_top_level() const noexcept {
+                    return m_context == context::top && !m_header.has_multiple_object_versions();
                 }
 
                 void start_element(const XML_Char* element, const XML_Char** attrs) {
@@ -344,7 +1025,7 @@ namespace osmium {
                             assert(!m_tl_builder);
                             if (!std::strcmp(element, "node")) {
                                 mark_header_as_done();
-                                if (read_types() & osmium::osm_entity_bits::node) {
+                                if (m_read_types & osmium::osm_entity_bits::node) {
                                     m_node_builder.reset(new osmium::builder::NodeBuilder{m_buffer});
                                     m_node_builder->set_user(init_object(m_node_builder->object(), attrs));
                                     m_context = context::node;
@@ -353,7 +1034,7 @@ namespace osmium {
                                 }
                             } else if (!std::strcmp(element, "way")) {
                                 mark_header_as_done();
-                                if (read_types() & osmium::osm_entity_bits::way) {
+                                if (m_read_types & osmium::osm_entity_bits::way) {
                                     m_way_builder.reset(new osmium::builder::WayBuilder{m_buffer});
                                     m_way_builder->set_user(init_object(m_way_builder->object(), attrs));
                                     m_context = context::way;
@@ -362,7 +1043,7 @@ namespace osmium {
                                 }
                             } else if (!std::strcmp(element, "relation")) {
                                 mark_header_as_done();
-                                if (read_types() & osmium::osm_entity_bits::relation) {
+                                if (m_read_types & osmium::osm_entity_bits::relation) {
                                     m_relation_builder.reset(new osmium::builder::RelationBuilder{m_buffer});
                                     m_relation_builder->set_user(init_object(m_relation_builder->object(), attrs));
                                     m_context = context::relation;
@@ -371,7 +1052,7 @@ namespace osmium {
                                 }
                             } else if (!std::strcmp(element, "changeset")) {
                                 mark_header_as_done();
-                                if (read_types() & osmium::osm_entity_bits::changeset) {
+                                if (m_read_types & osmium::osm_entity_bits::changeset) {
                                     m_changeset_builder.reset(new osmium::builder::ChangesetBuilder{m_buffer});
                                     init_changeset(*m_changeset_builder, attrs);
                                     m_context = context::changeset;
@@ -540,7 +1221,7 @@ namespace osmium {
                             m_node_builder.reset();
                             m_buffer.commit();
                             m_context = context::top;
-                            flush_buffer();
+                            object_done();
                             break;
                         case context::way:
                             assert(!std::strcmp(element, "way"));
@@ -549,7 +1230,7 @@ namespace osmium {
                             m_way_builder.reset();
                             m_buffer.commit();
                             m_context = context::top;
-                            flush_buffer();
+                            object_done();
                             break;
                         case context::relation:
                             assert(!std::strcmp(element, "relation"));
@@ -558,7 +1239,7 @@ namespace osmium {
                             m_relation_builder.reset();
                             m_buffer.commit();
                             m_context = context::top;
-                            flush_buffer();
+                            object_done();
                             break;
                         case context::changeset:
                             assert(!std::strcmp(element, "changeset"));
@@ -567,7 +1248,7 @@ namespace osmium {
                             m_changeset_builder.reset();
                             m_buffer.commit();
                             m_context = context::top;
-                            flush_buffer();
+                            object_done();
                             break;
                         case context::discussion:
                             assert(!std::strcmp(element, "discussion"));
@@ -616,40 +1297,402 @@ namespace osmium {
                     }
                 }
 
+            }; // class XMLHandler
+
+            /**
+             * Find the next possible start of a top-level OSM object (node,
+             * way, relation, or changeset element) in the data at or after
+             * pos. This is only a guess, the tag found could also be inside
+             * a comment or CDATA section, for instance.
+             *
+             * @returns Position of the '<' or std::string::npos if nothing
+             *          was found.
+             */
+            inline std::string::size_type find_xml_object_start(const std::string& data, std::string::size_type pos) {
+                static const char* const names[] = {"node", "way", "relation", "changeset"};
+                while ((pos = data.find('<', pos)) != std::string::npos) {
+                    ++pos;
+                    for (const char* name : names) {
+                        const auto len = std::strlen(name);
+                        if (pos + len < data.size() &&
+                            !data.compare(pos, len, name) &&
+                            xml_scan::is_space(data[pos + len])) {
+                            return pos - 1;
+                        }
+                    }
+                }
+                return std::string::npos;
+            }
+
+            /**
+             * The result of parsing a chunk with the XMLChunkParser.
+             */
+            struct xml_chunk_result {
+                osmium::memory::Buffer buffer;
+                unsigned long lines = 0; // number of newlines in the chunk
+            };
+
+            /**
+             * Parses a chunk of OSM XML data into a buffer. The chunk must
+             * start inside the osm root element at the beginning of a
+             * top-level element. Chunks are independent of each other, so
+             * this can run in the pool threads.
+             */
+            class XMLChunkParser {
+
+                static constexpr const std::size_t buffer_size = 2 * 1024 * 1024;
+
+                std::shared_ptr<const std::string> m_input;
+                std::size_t m_offset;
+                std::size_t m_size;
+                osmium::osm_entity_bits::type m_read_types;
+                osmium::memory::BufferPool* m_buffer_pool;
+                bool m_last;
+
+            public:
+
+                /**
+                 * @param input The input the chunk is part of.
+                 * @param offset Offset of the chunk in the input.
+                 * @param size Size of the chunk.
+                 * @param read_types Which entities should be parsed?
+                 * @param buffer_pool Pool to get the output buffer from.
+                 *                    If this is nullptr, a new buffer is
+                 *                    created.
+                 * @param last Is this the last chunk? It must contain the
+                 *             end of the root element then.
+                 */
+                XMLChunkParser(std::shared_ptr<const std::string> input, std::size_t offset, std::size_t size, osmium::osm_entity_bits::type read_types, osmium::memory::BufferPool* buffer_pool, bool last) :
+                    m_input(std::move(input)),
+                    m_offset(offset),
+                    m_size(size),
+                    m_read_types(read_types),
+                    m_buffer_pool(buffer_pool),
+                    m_last(last) {
+                }
+
+                /**
+                 * @throws osmium::xml_error If the data is not well-formed or
+                 *         (unless this is the last chunk) does not end
+                 *         between two top-level elements.
+                 */
+                xml_chunk_result operator()() {
+                    XMLHandler handler{m_read_types,
+                                       m_buffer_pool ? m_buffer_pool->get(buffer_size)
+                                                     : osmium::memory::Buffer{buffer_size, osmium::memory::Buffer::auto_grow::yes},
+                                       true};
+                    XMLTokenizer<XMLHandler> tokenizer{&handler, "osm", 1};
+
+                    // The tokenizer changes the data in place, so this is
+                    // the only copy of the chunk made.
+                    std::string data{*m_input, m_offset, m_size};
+                    tokenizer(data, m_last);
+                    if (!m_last && !(tokenizer.at_top_level() && handler.at_top_level())) {
+                        throw osmium::xml_error{"XML chunk does not end between top-level elements"};
+                    }
+
+                    xml_chunk_result result;
+                    result.buffer = std::move(handler.buffer());
+                    result.lines = tokenizer.line() - 1;
+                    return result;
+                }
+
+            }; // class XMLChunkParser
+
+            class XMLParser : public Parser {
+
+                static constexpr int buffer_size = 2 * 1000 * 1000;
+
+                // In parallel mode the input is cut into chunks of about this
+                // size at the start of top-level elements.
+                static constexpr const std::size_t chunk_size = 2 * 1024 * 1024;
+
+                /**
+                 * A C++ wrapper for the Expat parser that makes sure no memory is leaked.
+                 */
+                template <typename T>
+                class ExpatXMLParser {
+
+                    XML_Parser m_parser;
+
+                    static void XMLCALL start_element_wrapper(void* data, const XML_Char* element, const XML_Char** attrs) {
+                        static_cast<T*>(data)->start_element(element, attrs);
+                    }
+
+                    static void XMLCALL end_element_wrapper(void* data, const XML_Char* element) {
+                        static_cast<T*>(data)->end_element(element);
+                    }
+
+                    static void XMLCALL character_data_wrapper(void* data, const XML_Char* text, int len) {
+                        static_cast<T*>(data)->characters(text, len);
+                    }
+
+                    // This handler is called when there are any XML entities
+                    // declared in the OSM file. Entities are normally not used,
+                    // but they can be misused. See
+                    // https://en.wikipedia.org/wiki/Billion_laughs
+                    // The handler will just throw an error.
+                    static void entity_declaration_handler(void*,
+                            const XML_Char*, int, const XML_Char*, int, const XML_Char*,
+                            const XML_Char*, const XML_Char*, const XML_Char*) {
+                        throw osmium::xml_error{"XML entities are not supported"};
+                    }
+
+                public:
+
+                    explicit ExpatXMLParser(T* callback_object) :
+                        m_parser(XML_ParserCreate(nullptr)) {
+                        if (!m_parser) {
+                            throw osmium::io_error{"Internal error: Can not create parser"};
+                        }
+                        XML_SetUserData(m_parser, callback_object);
+                        XML_SetElementHandler(m_parser, start_element_wrapper, end_element_wrapper);
+                        XML_SetCharacterDataHandler(m_parser, character_data_wrapper);
+                        XML_SetEntityDeclHandler(m_parser, entity_declaration_handler);
+                    }
+
+                    ExpatXMLParser(const ExpatXMLParser&) = delete;
+                    ExpatXMLParser(ExpatXMLParser&&) = delete;
+
+                    ExpatXMLParser& operator=(const ExpatXMLParser&) = delete;
+                    ExpatXMLParser& operator=(ExpatXMLParser&&) = delete;
+
+                    ~ExpatXMLParser() noexcept {
+                        XML_ParserFree(m_parser);
+                    }
+
+                    void operator()(const std::string& data, bool last) {
+                        if (XML_Parse(m_parser, data.data(), static_cast_with_assert<int>(data.size()), last) == XML_STATUS_ERROR) {
+                            throw osmium::xml_error{m_parser};
+                        }
+                    }
+
+                }; // class ExpatXMLParser
+
+                // Handler for the parts of the input parsed in this thread.
+                class Handler : public XMLHandler {
+
+                    XMLParser& m_parser;
+
+                    void header_done(const osmium::io::Header& header) final {
+                        m_parser.set_header_value(header);
+                    }
+
+                    void object_done() final {
+                        m_parser.flush_buffer();
+                    }
+
+                public:
+
+                    explicit Handler(XMLParser& parser) :
+                        XMLHandler(parser.read_types(), parser.new_buffer(buffer_size)),
+                        m_parser(parser) {
+                    }
+
+                }; // class Handler
+
+                // A chunk is a part of an input string shared by all chunks
+                // cut from it.
+                struct chunk_type {
+                    std::shared_ptr<const std::string> input;
+                    std::size_t offset;
+                    std::size_t size;
+                    std::future<xml_chunk_result> result;
+                };
+
+                Handler m_handler;
+
+                // Chunks submitted to the pool in parallel mode.
+                std::deque<chunk_type> m_chunks;
+
                 void flush_buffer() {
-                    if (m_buffer.committed() > buffer_size / 10 * 9) {
-                        send_to_output_queue(std::move(m_buffer));
-                        osmium::memory::Buffer buffer(buffer_size);
+                    if (m_handler.buffer().committed() > buffer_size / 10 * 9) {
+                        send_to_output_queue(std::move(m_handler.buffer()));
+                        osmium::memory::Buffer buffer{new_buffer(buffer_size)};
                         using std::swap;
-                        swap(m_buffer, buffer);
+                        swap(m_handler.buffer(), buffer);
                     }
                 }
 
-            public:
+                void submit_chunk(const std::shared_ptr<const std::string>& input, std::size_t offset, std::size_t size, bool last) {
+                    XMLChunkParser chunk_parser{input, offset, size, read_types(), buffer_pool(), last};
+                    m_chunks.push_back(chunk_type{input, offset, size, get_pool().submit(std::move(chunk_parser))});
+                }
 
-                explicit XMLParser(parser_arguments& args) :
-                    Parser(args),
-                    m_context(context::root),
-                    m_last_context(context::root),
-                    m_in_delete_section(false),
-                    m_header(),
-                    m_buffer(buffer_size),
-                    m_node_builder(),
-                    m_way_builder(),
-                    m_relation_builder(),
-                    m_changeset_builder(),
-                    m_changeset_discussion_builder(),
-                    m_tl_builder(),
-                    m_wnl_builder(),
-                    m_rml_builder() {
+                // The chunk parsers use the buffer pool, they must be done
+                // before the chunks are dropped and the parser is destroyed.
+                void wait_for_chunks() noexcept {
+                    for (auto& chunk : m_chunks) {
+                        if (chunk.result.valid()) {
+                            chunk.result.wait();
+                        }
+                    }
+                    m_chunks.clear();
                 }
 
-                ~XMLParser() noexcept final = default;
+                // Wait for the oldest chunk and send its objects to the
+                // output queue. Returns false (and keeps the chunk) if it
+                // could not be parsed on its own.
+                bool forward_oldest_chunk(unsigned long& line) {
+                    xml_chunk_result result;
+                    try {
+                        result = m_chunks.front().result.get();
+                    } catch (...) {
+                        return false;
+                    }
+                    line += result.lines;
+                    send_to_output_queue(std::move(result.buffer));
+                    m_chunks.pop_front();
+                    return true;
+                }
 
-                void run() final {
-                    osmium::thread::set_thread_name("_osmium_xml_in");
+                // All data of the chunks not yet forwarded followed by rest.
+                std::string unparsed_data(const char* rest, std::size_t rest_size) {
+                    std::string data;
+                    for (const auto& chunk : m_chunks) {
+                        data.append(*chunk.input, chunk.offset, chunk.size);
+                    }
+                    data.append(rest, rest_size);
+                    wait_for_chunks();
+                    return data;
+                }
 
-                    ExpatXMLParser<XMLParser> parser(this);
+                /**
+                 * Parse the data and the rest of the input in chunks in the
+                 * pool threads. The data must start with a top-level element.
+                 *
+                 * @param data The input data not parsed yet.
+                 * @param line The line number of the start of the data.
+                 * @returns true if all input was parsed, false if a chunk
+                 *          could not be parsed on its own. Data then contains
+                 *          all input from the start of that chunk which has
+                 *          to be parsed in this thread, and line is set to
+                 *          its line number.
+                 */
+                bool parse_in_chunks(std::string& data, unsigned long& line) {
+                    if (m_handler.buffer().committed() > 0) {
+                        send_to_output_queue(std::move(m_handler.buffer()));
+                        m_handler.buffer() = new_buffer(buffer_size);
+                    }
+                    set_header_value(m_handler.header());
+
+                    const auto max_chunks_in_flight = static_cast<std::size_t>(get_pool().num_threads()) * 2;
+
+                    std::string rest{std::move(data)};
+                    while (true) {
+                        if (rest.size() >= chunk_size) {
+                            const auto input = std::make_shared<std::string>(std::move(rest));
+                            std::string::size_type start = 0;
+                            while (input->size() - start >= chunk_size) {
+                                const auto pos = find_xml_object_start(*input, start + chunk_size);
+                                if (pos == std::string::npos) {
+                                    break;
+                                }
+                                submit_chunk(input, start, pos - start, false);
+                                start = pos;
+                                while (m_chunks.size() > max_chunks_in_flight) {
+                                    if (!forward_oldest_chunk(line)) {
+                                        data = unparsed_data(input->data() + start, input->size() - start);
+                                        return false;
+                                    }
+                                }
+                            }
+                            if (start == 0) {
+                                rest = std::move(*input);
+                            } else {
+                                rest.assign(*input, start, std::string::npos);
+                            }
+                        }
+                        if (input_done()) {
+                            break;
+                        }
+                        rest.append(get_input());
+                    }
+
+                    const auto size = rest.size();
+                    submit_chunk(std::make_shared<const std::string>(std::move(rest)), 0, size, true);
+                    while (!m_chunks.empty()) {
+                        if (!forward_oldest_chunk(line)) {
+                            data = unparsed_data("", 0);
+                            return false;
+                        }
+                    }
+
+                    return true;
+                }
+
+                /**
+                 * Parse the input using the XMLTokenizer. All input read
+                 * while the tokenizer is still in the prolog of the document
+                 * is appended to the prolog string.
+                 *
+                 * In parallel mode, as soon as the tokenizer is between two
+                 * top-level elements, the rest of the input is parsed in
+                 * chunks in the pool threads. If that fails for a chunk,
+                 * parsing goes on in this thread from the start of that
+                 * chunk.
+                 *
+                 * @returns false if the input has to be parsed with Expat.
+                 */
+                bool parse_with_tokenizer(std::string& prolog) {
+                    XMLTokenizer<XMLHandler> tokenizer{&m_handler};
+                    const bool parallel = osmium::config::use_pool_threads_for_xml_parsing() &&
+                                          read_types() != osmium::osm_entity_bits::nothing;
+
+                    while (!input_done()) {
+                        std::string data{get_input()};
+                        if (tokenizer.in_prolog()) {
+                            prolog.append(data);
+                        } else if (!prolog.empty()) {
+                            std::string{}.swap(prolog);
+                        }
+
+                        if (parallel) {
+                            const auto pos = find_xml_object_start(data, 0);
+                            if (pos != std::string::npos) {
+                                std::string head{data, 0, pos};
+                                if (!tokenizer(head, false)) {
+                                    return false;
+                                }
+                                data.erase(0, pos);
+                                if (tokenizer.at_top_level() && m_handler.at_top_level()) {
+                                    auto line = tokenizer.line();
+                                    bool all_parsed = false;
+                                    try {
+                                        all_parsed = parse_in_chunks(data, line);
+                                    } catch (...) {
+                                        wait_for_chunks();
+                                        throw;
+                                    }
+                                    if (all_parsed) {
+                                        return true;
+                                    }
+                                    tokenizer = XMLTokenizer<XMLHandler>{&m_handler, "osm", line};
+                                }
+                            }
+                        }
+
+                        if (!tokenizer(data, input_done())) {
+                            return false;
+                        }
+                        if (read_types() == osmium::osm_entity_bits::nothing && header_is_done()) {
+                            break;
+                        }
+                    }
+
+                    return true;
+                }
+
+                /**
+                 * Parse the input using Expat. The prolog string contains
+                 * the input already read from the queue (if any).
+                 */
+                void parse_with_expat(const std::string& prolog) {
+                    ExpatXMLParser<XMLHandler> parser(&m_handler);
+
+                    if (!prolog.empty()) {
+                        parser(prolog, input_done());
+                    }
 
                     while (!input_done()) {
                         const std::string data{get_input()};
@@ -658,11 +1701,32 @@ namespace osmium {
                             break;
                         }
                     }
+                }
+
+            public:
+
+                explicit XMLParser(parser_arguments& args) :
+                    Parser(args),
+                    m_handler(*this),
+                    m_chunks() {
+                }
+
+                ~XMLParser() noexcept final {
+                    wait_for_chunks();
+                }
+
+                void run() final {
+                    osmium::thread::set_thread_name("_osmium_xml_in");
+
+                    std::string prolog;
+                    if (!osmium::config::use_xml_tokenizer() || !parse_with_tokenizer(prolog)) {
+                        parse_with_expat(prolog);
+                    }
 
-                    mark_header_as_done();
+                    set_header_value(m_handler.header());
 
-                    if (m_buffer.committed() > 0) {
-                        send_to_output_queue(std::move(m_buffer));
+                    if (m_handler.buffer().committed() > 0) {
+                        send_to_output_queue(std::move(m_handler.buffer()));
                     }
                 }
 
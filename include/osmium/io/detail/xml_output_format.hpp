@@ -106,6 +106,8 @@ namespace osmium {
 
             class XMLOutputBlock : public OutputBlock {
 
+            public:
+
                 // operation (create, modify, delete) for osc files
                 enum class operation {
                     op_none   = 0,
@@ -114,7 +116,16 @@ namespace osmium {
                     op_delete = 3
                 }; // enum class operation
 
-                operation m_last_op {operation::op_none};
+                static operation get_operation(const osmium::OSMObject& object) noexcept {
+                    return object.visible() ? (object.version() == 1 ? operation::op_create : operation::op_modify) : operation::op_delete;
+                }
+
+            private:
+
+                operation m_last_op;
+
+                // Close the open operation at the end of the block?
+                bool m_close_op;
 
                 xml_output_options m_options;
 
@@ -242,15 +253,29 @@ namespace osmium {
 
             public:
 
-                XMLOutputBlock(osmium::memory::Buffer&& buffer, const xml_output_options& options) :
-                    OutputBlock(std::move(buffer)),
+                /**
+                 * In osmChange output a block starts with the operation
+                 * left open by the previous block of the same buffer
+                 * (open_op) and only closes the operation at its end if
+                 * close_op is set. This way blocks from one buffer produce
+                 * the same output as if the buffer was encoded as a whole.
+                 */
+                XMLOutputBlock(const std::shared_ptr<osmium::memory::Buffer>& buffer,
+                               osmium::memory::Buffer::const_iterator begin,
+                               osmium::memory::Buffer::const_iterator end,
+                               const xml_output_options& options,
+                               operation open_op = operation::op_none,
+                               bool close_op = true) :
+                    OutputBlock(buffer, begin, end),
+                    m_last_op(open_op),
+                    m_close_op(close_op),
                     m_options(options) {
                 }
 
                 std::string operator()() {
-                    osmium::apply(m_input_buffer->cbegin(), m_input_buffer->cend(), *this);
+                    osmium::apply(m_begin, m_end, *this);
 
-                    if (m_options.use_change_ops) {
+                    if (m_options.use_change_ops && m_close_op) {
                         open_close_op_tag();
                     }
 
@@ -263,7 +288,7 @@ namespace osmium {
 
                 void node(const osmium::Node& node) {
                     if (m_options.use_change_ops) {
-                        open_close_op_tag(node.visible() ? (node.version() == 1 ? operation::op_create : operation::op_modify) : operation::op_delete);
+                        open_close_op_tag(get_operation(node));
                     }
 
                     write_prefix();
@@ -290,7 +315,7 @@ namespace osmium {
 
                 void way(const osmium::Way& way) {
                     if (m_options.use_change_ops) {
-                        open_close_op_tag(way.visible() ? (way.version() == 1 ? operation::op_create : operation::op_modify) : operation::op_delete);
+                        open_close_op_tag(get_operation(way));
                     }
 
                     write_prefix();
@@ -331,7 +356,7 @@ namespace osmium {
 
                 void relation(const osmium::Relation& relation) {
                     if (m_options.use_change_ops) {
-                        open_close_op_tag(relation.visible() ? (relation.version() == 1 ? operation::op_create : operation::op_modify) : operation::op_delete);
+                        open_close_op_tag(get_operation(relation));
                     }
 
                     write_prefix();
@@ -467,7 +492,26 @@ namespace osmium {
                 }
 
                 void write_buffer(osmium::memory::Buffer&& buffer) final {
-                    m_output_queue.push(m_pool.submit(XMLOutputBlock{std::move(buffer), m_options}));
+                    if (!m_options.use_change_ops) {
+                        encode_in_blocks<XMLOutputBlock>(std::move(buffer), m_options);
+                        return;
+                    }
+
+                    // The <create>, <modify>, and <delete> sections are
+                    // carried over from one block to the next.
+                    const auto input = std::make_shared<osmium::memory::Buffer>(std::move(buffer));
+                    auto op = XMLOutputBlock::operation::op_none;
+                    for_each_block(*input, [&](osmium::memory::Buffer::const_iterator begin, osmium::memory::Buffer::const_iterator end) {
+                        const auto open_op = op;
+                        for (auto it = begin; it != end; ++it) {
+                            if (it->type() == osmium::item_type::node ||
+                                it->type() == osmium::item_type::way ||
+                                it->type() == osmium::item_type::relation) {
+                                op = XMLOutputBlock::get_operation(static_cast<const osmium::OSMObject&>(*it));
+                            }
+                        }
+                        m_output_queue.push(m_pool.submit(XMLOutputBlock{input, begin, end, m_options, open_op, end == input->cend()}));
+                    });
                 }
 
                 void write_end() final {
@@ -0,0 +1,183 @@
+#ifndef OSMIUM_IO_DETAIL_XML_SCAN_HPP
+#define OSMIUM_IO_DETAIL_XML_SCAN_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <cstdint>
+
+#include <osmium/io/detail/simd_scan.hpp>
+
+namespace osmium {
+
+    namespace io {
+
+        namespace detail {
+
+            /**
+             * Functions to find the end of whitespace, names, and attribute
+             * values in XML data. There are scalar versions which work everywhere
+             * and vector versions using SSE2 which are used if the compiler
+             * supports them. Define OSMIUM_NO_SIMD to always use the scalar
+             * versions.
+             *
+             * All functions work on null-terminated strings.
+             */
+            namespace xml_scan {
+
+                inline bool is_space(char c) noexcept {
+                    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+                }
+
+                inline bool is_name_end(char c) noexcept {
+                    return c == '\0' || is_space(c) || c == '=' || c == '/' || c == '>';
+                }
+
+                /**
+                 * Characters which end an attribute value enclosed in
+                 * TQuote or need special handling: Entity references,
+                 * whitespace other than the space character which has to
+                 * be normalized, and '<' which is not allowed.
+                 */
+                template <char TQuote>
+                inline bool is_value_special(char c) noexcept {
+                    return c == '\0' || c == TQuote || c == '&' || c == '<' ||
+                           c == '\t' || c == '\n' || c == '\r';
+                }
+
+                inline const char* scalar_find_name_end(const char* s) noexcept {
+                    while (!is_name_end(*s)) {
+                        ++s;
+                    }
+                    return s;
+                }
+
+                inline const char* scalar_find_non_space(const char* s) noexcept {
+                    while (is_space(*s)) {
+                        ++s;
+                    }
+                    return s;
+                }
+
+                template <char TQuote>
+                inline const char* scalar_find_value_special(const char* s) noexcept {
+                    while (!is_value_special<TQuote>(*s)) {
+                        ++s;
+                    }
+                    return s;
+                }
+
+#ifdef OSMIUM_SIMD_SCAN_SSE2
+
+                inline __m128i space_mask(__m128i block) noexcept {
+                    __m128i m = _mm_cmpeq_epi8(block, _mm_set1_epi8(' '));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\t')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+                    return _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\r')));
+                }
+
+                // The '\0' at the end of the string is not whitespace, so
+                // this always sets a bit for it.
+                inline uint32_t non_space_mask(__m128i block) noexcept {
+                    return ~static_cast<uint32_t>(_mm_movemask_epi8(space_mask(block))) & 0xffffu;
+                }
+
+                inline uint32_t name_end_mask(__m128i block) noexcept {
+                    __m128i m = space_mask(block);
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_setzero_si128()));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('=')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('/')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('>')));
+                    return static_cast<uint32_t>(_mm_movemask_epi8(m));
+                }
+
+                template <char TQuote>
+                inline uint32_t value_special_mask(__m128i block) noexcept {
+                    __m128i m = _mm_cmpeq_epi8(block, _mm_setzero_si128());
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8(TQuote)));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('&')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('<')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\t')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+                    m = _mm_or_si128(m, _mm_cmpeq_epi8(block, _mm_set1_epi8('\r')));
+                    return static_cast<uint32_t>(_mm_movemask_epi8(m));
+                }
+
+#endif
+
+                /**
+                 * Find the first character in s which ends an element or
+                 * attribute name, ie. one of '\0', whitespace, '=', '/',
+                 * or '>'.
+                 */
+                inline const char* find_name_end(const char* s) noexcept {
+#ifdef OSMIUM_SIMD_SCAN_SSE2
+                    return simd_scan::find<name_end_mask>(s);
+#else
+                    return scalar_find_name_end(s);
+#endif
+                }
+
+                /**
+                 * Find the first character in s which is not whitespace.
+                 */
+                inline const char* find_non_space(const char* s) noexcept {
+#ifdef OSMIUM_SIMD_SCAN_SSE2
+                    return simd_scan::find<non_space_mask>(s);
+#else
+                    return scalar_find_non_space(s);
+#endif
+                }
+
+                /**
+                 * Find the first character in s which ends an attribute
+                 * value enclosed in TQuote or needs special handling, ie.
+                 * one of '\0', TQuote, '&', '<', '\t', '\n', or '\r'.
+                 */
+                template <char TQuote>
+                inline const char* find_value_special(const char* s) noexcept {
+#ifdef OSMIUM_SIMD_SCAN_SSE2
+                    return simd_scan::find<value_special_mask<TQuote>>(s);
+#else
+                    return scalar_find_value_special<TQuote>(s);
+#endif
+                }
+
+            } // namespace xml_scan
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_DETAIL_XML_SCAN_HPP
@@ -55,18 +55,20 @@ namespace osmium {
              * what fits in an unsigned long, on Windows this is usually 32bit.
              *
              * @param input Data to compress.
+             * @param level Compression level (0 to 9 or Z_DEFAULT_COMPRESSION).
              * @returns Compressed data.
              */
-            inline std::string zlib_compress(const std::string& input) {
+            inline std::string zlib_compress(const std::string& input, int level = Z_DEFAULT_COMPRESSION) {
                 unsigned long output_size = ::compressBound(osmium::static_cast_with_assert<unsigned long>(input.size()));
 
                 std::string output(output_size, '\0');
 
-                const auto result = ::compress(
+                const auto result = ::compress2(
                     reinterpret_cast<unsigned char*>(const_cast<char *>(output.data())),
                     &output_size,
                     reinterpret_cast<const unsigned char*>(input.data()),
-                    osmium::static_cast_with_assert<unsigned long>(input.size())
+                    osmium::static_cast_with_assert<unsigned long>(input.size()),
+                    level
                 );
 
                 if (result != Z_OK) {
@@ -0,0 +1,123 @@
+#ifndef OSMIUM_IO_DETAIL_ZSTD_HPP
+#define OSMIUM_IO_DETAIL_ZSTD_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+/**
+ * @file
+ *
+ * Include this file only if libosmium was configured with zstd support
+ * (OSMIUM_WITH_ZSTD is defined).
+ *
+ * @attention If you include this file, you'll need to link with `libzstd`.
+ */
+
+#include <cstddef>
+#include <string>
+
+#include <zstd.h>
+
+#include <protozero/types.hpp>
+
+#include <osmium/io/error.hpp>
+
+namespace osmium {
+
+    namespace io {
+
+        namespace detail {
+
+            /**
+             * Compress data using zstd.
+             *
+             * @param input Data to compress.
+             * @param level Compression level. Use 0 for the zstd default.
+             * @returns Compressed data.
+             */
+            inline std::string zstd_compress(const std::string& input, int level = 0) {
+                std::string output(::ZSTD_compressBound(input.size()), '\0');
+
+                const std::size_t result = ::ZSTD_compress(
+                    &*output.begin(),
+                    output.size(),
+                    input.data(),
+                    input.size(),
+                    level > 0 ? level : ZSTD_CLEVEL_DEFAULT
+                );
+
+                if (::ZSTD_isError(result)) {
+                    throw io_error{std::string{"failed to compress data: "} + ::ZSTD_getErrorName(result)};
+                }
+
+                output.resize(result);
+
+                return output;
+            }
+
+            /**
+             * Uncompress data using zstd.
+             *
+             * @param input Compressed input data.
+             * @param input_size Size of compressed input data.
+             * @param raw_size Size of uncompressed data.
+             * @param output Uncompressed result data.
+             * @returns Pointer and size to uncompressed data.
+             */
+            inline protozero::data_view zstd_uncompress_string(const char* input, std::size_t input_size, std::size_t raw_size, std::string& output) {
+                output.resize(raw_size);
+
+                const std::size_t result = ::ZSTD_decompress(
+                    &*output.begin(),
+                    raw_size,
+                    input,
+                    input_size
+                );
+
+                if (::ZSTD_isError(result)) {
+                    throw io_error{std::string{"failed to uncompress data: "} + ::ZSTD_getErrorName(result)};
+                }
+
+                if (result != raw_size) {
+                    throw io_error{"failed to uncompress data: wrong size"};
+                }
+
+                return protozero::data_view{output.data(), output.size()};
+            }
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_DETAIL_ZSTD_HPP
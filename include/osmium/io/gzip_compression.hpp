@@ -42,6 +42,7 @@ DEALINGS IN THE SOFTWARE.
  * @attention If you include this file, you'll need to link with `libz`.
  */
 
+#include <algorithm>
 #include <cerrno>
 #include <cstddef>
 #include <string>
@@ -56,6 +57,7 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/error.hpp>
 #include <osmium/io/file_compression.hpp>
 #include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/detail/stream_splitter.hpp>
 #include <osmium/io/writer_options.hpp>
 #include <osmium/util/cast.hpp>
 #include <osmium/util/compatibility.hpp>
@@ -96,24 +98,57 @@ namespace osmium {
                 throw osmium::gzip_error{error, errnum};
             }
 
+            /**
+             * Does the data start with the gzip magic bytes and the deflate
+             * compression method? This is what zlib checks when it decides
+             * whether another member follows. Needs 3 bytes of data.
+             */
+            inline bool has_gzip_magic(const char* data) noexcept {
+                const auto* d = reinterpret_cast<const unsigned char*>(data);
+                return d[0] == 0x1f && d[1] == 0x8b && d[2] == 0x08;
+            }
+
+            /**
+             * Does a gzip member start here? Checks the magic bytes, the
+             * compression method, the reserved flags, and the plausibility
+             * of the extra flags and operating system fields. Needs 10
+             * bytes of data. This strict check is only used for guessing
+             * where the input can be split.
+             */
+            inline bool is_gzip_member_start(const char* data) noexcept {
+                const auto* d = reinterpret_cast<const unsigned char*>(data);
+                return has_gzip_magic(data) &&
+                       (d[3] & 0xe0) == 0 &&
+                       (d[8] == 0 || d[8] == 2 || d[8] == 4) &&
+                       (d[9] <= 13 || d[9] == 255);
+            }
+
         } // namespace detail
 
         class GzipCompressor : public Compressor {
 
             int m_fd;
-            gzFile m_gzfile;
 
-        public:
+            // Only opened on the first call to write(). If all data is
+            // written with write_compressed(), it is never needed.
+            gzFile m_gzfile = nullptr;
 
-            explicit GzipCompressor(int fd, fsync sync) :
-                Compressor(sync),
-                m_fd(::dup(fd)),
-                m_gzfile(::gzdopen(fd, "w")) {
+            bool m_wrote_compressed = false;
+
+            void open_gzfile() {
+                m_gzfile = ::gzdopen(::dup(m_fd), "w");
                 if (!m_gzfile) {
                     detail::throw_gzip_error(m_gzfile, "write initialization failed");
                 }
             }
 
+        public:
+
+            explicit GzipCompressor(int fd, fsync sync) :
+                Compressor(sync),
+                m_fd(fd) {
+            }
+
             ~GzipCompressor() noexcept final {
                 try {
                     close();
@@ -123,6 +158,9 @@ namespace osmium {
             }
 
             void write(const std::string& data) final {
+                if (!m_gzfile) {
+                    open_gzfile();
+                }
                 if (!data.empty()) {
                     const int nwrite = ::gzwrite(m_gzfile, data.data(), static_cast_with_assert<unsigned int>(data.size()));
                     if (nwrite == 0) {
@@ -131,17 +169,63 @@ namespace osmium {
                 }
             }
 
+            bool can_compress_blocks() const noexcept final {
+                return true;
+            }
+
+            /**
+             * Compress the data into a complete gzip member. Files with
+             * several members are read by gzip and zlib as if they had
+             * been compressed in one go.
+             */
+            std::string compress_block(const std::string& data) const final {
+                z_stream zstream{};
+                int result = deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16 /* gzip header */, 8, Z_DEFAULT_STRATEGY);
+                if (result != Z_OK) {
+                    throw osmium::gzip_error{"gzip error: compression init failed", result};
+                }
+
+                std::string output(deflateBound(&zstream, static_cast_with_assert<unsigned long>(data.size())), '\0');
+                zstream.next_in = reinterpret_cast<unsigned char*>(const_cast<char*>(data.data()));
+                zstream.avail_in = static_cast_with_assert<unsigned int>(data.size());
+                zstream.next_out = reinterpret_cast<unsigned char*>(&output[0]);
+                zstream.avail_out = static_cast_with_assert<unsigned int>(output.size());
+
+                result = deflate(&zstream, Z_FINISH);
+                output.resize(zstream.total_out);
+                deflateEnd(&zstream);
+
+                if (result != Z_STREAM_END) {
+                    throw osmium::gzip_error{"gzip error: compression failed", result};
+                }
+
+                return output;
+            }
+
+            void write_compressed(const std::string& data) final {
+                osmium::io::detail::reliable_write(m_fd, data.data(), data.size());
+                m_wrote_compressed = true;
+            }
+
             void close() final {
+                if (m_fd >= 0 && !m_gzfile && !m_wrote_compressed) {
+                    // Nothing was written, create a valid empty gzip file.
+                    open_gzfile();
+                }
                 if (m_gzfile) {
                     const int result = ::gzclose(m_gzfile);
                     m_gzfile = nullptr;
                     if (result != Z_OK) {
                         detail::throw_gzip_error(m_gzfile, "write close failed", result);
                     }
+                }
+                if (m_fd >= 0) {
+                    const int fd = m_fd;
+                    m_fd = -1;
                     if (do_fsync()) {
-                        osmium::io::detail::reliable_fsync(m_fd);
+                        osmium::io::detail::reliable_fsync(fd);
                     }
-                    osmium::io::detail::reliable_close(m_fd);
+                    osmium::io::detail::reliable_close(fd);
                 }
             }
 
@@ -150,12 +234,14 @@ namespace osmium {
         class GzipDecompressor : public Decompressor {
 
             gzFile m_gzfile;
+            detail::StreamSplitter m_splitter;
 
         public:
 
             explicit GzipDecompressor(int fd) :
                 Decompressor(),
-                m_gzfile(::gzdopen(fd, "r")) {
+                m_gzfile(::gzdopen(fd, "r")),
+                m_splitter(fd, '\x1f', 10, detail::is_gzip_member_start) {
                 if (!m_gzfile) {
                     detail::throw_gzip_error(m_gzfile, "read initialization failed");
                 }
@@ -182,6 +268,77 @@ namespace osmium {
                 return buffer;
             }
 
+            /**
+             * Only regular files are split into blocks, because the file
+             * is read again from the start of the current block if no
+             * member boundaries are found.
+             */
+            bool can_decompress_blocks() const noexcept final {
+                return file_size() > 0;
+            }
+
+            std::string read_compressed_block() final {
+                std::string block{m_splitter.next_block()};
+                set_offset(m_splitter.offset());
+                return block;
+            }
+
+            void read_sequentially_from(std::size_t offset) final {
+                m_splitter.give_up_at(offset);
+                set_offset(offset);
+            }
+
+            /**
+             * Decompress a block consisting of one or more complete gzip
+             * members. Like gzread(), this decodes every following member
+             * starting with the gzip magic bytes and ignores other trailing
+             * garbage after the last member.
+             */
+            std::string decompress_block(const std::string& data) const final {
+                z_stream zstream{};
+                int result = inflateInit2(&zstream, MAX_WBITS + 16 /* gzip header */);
+                if (result != Z_OK) {
+                    throw osmium::gzip_error{"gzip error: decompression init failed", result};
+                }
+
+                zstream.next_in = reinterpret_cast<unsigned char*>(const_cast<char*>(data.data()));
+                zstream.avail_in = static_cast_with_assert<unsigned int>(data.size());
+
+                std::string output;
+                std::size_t size = 0;
+                while (true) {
+                    if (size == output.size()) {
+                        // Compression ratio of OSM XML is usually about 1:10
+                        output.resize(std::max(output.size() * 2, data.size() * 8));
+                    }
+                    zstream.next_out = reinterpret_cast<unsigned char*>(&output[size]);
+                    zstream.avail_out = static_cast_with_assert<unsigned int>(output.size() - size);
+                    result = inflate(&zstream, Z_NO_FLUSH);
+                    size = static_cast<std::size_t>(zstream.next_out - reinterpret_cast<const unsigned char*>(output.data()));
+
+                    if (result == Z_STREAM_END) {
+                        if (zstream.avail_in < 3 ||
+                            !detail::has_gzip_magic(reinterpret_cast<const char*>(zstream.next_in))) {
+                            break;
+                        }
+                        result = inflateReset(&zstream);
+                    } else if ((result == Z_OK || result == Z_BUF_ERROR) && zstream.avail_in == 0 && zstream.avail_out > 0) {
+                        result = Z_DATA_ERROR;
+                    } else if (result == Z_BUF_ERROR) {
+                        result = Z_OK;
+                    }
+
+                    if (result != Z_OK) {
+                        inflateEnd(&zstream);
+                        throw osmium::gzip_error{"gzip error: decompress block failed", result};
+                    }
+                }
+
+                inflateEnd(&zstream);
+                output.resize(size);
+                return output;
+            }
+
             void close() final {
                 if (m_gzfile) {
                     const int result = ::gzclose(m_gzfile);
@@ -200,6 +357,14 @@ namespace osmium {
             size_t m_buffer_size;
             z_stream m_zstream;
 
+            // Files can consist of several gzip members one after the
+            // other, for instance if they were written in parallel.
+            bool another_member_follows() const noexcept {
+                return m_zstream.avail_in >= 2 &&
+                       m_zstream.next_in[0] == 0x1f &&
+                       m_zstream.next_in[1] == 0x8b;
+            }
+
         public:
 
             GzipBufferDecompressor(const char* buffer, size_t size) :
@@ -234,7 +399,13 @@ namespace osmium {
                     output.append(buffer_size, '\0');
                     m_zstream.next_out = reinterpret_cast<unsigned char*>(const_cast<char*>(output.data()));
                     m_zstream.avail_out = buffer_size;
-                    const int result = inflate(&m_zstream, Z_SYNC_FLUSH);
+                    int result;
+                    do {
+                        result = inflate(&m_zstream, Z_SYNC_FLUSH);
+                        if (result == Z_STREAM_END && another_member_follows()) {
+                            result = inflateReset(&m_zstream);
+                        }
+                    } while (result == Z_OK && m_zstream.avail_out == buffer_size && m_zstream.avail_in > 0);
 
                     if (result != Z_OK) {
                         m_buffer = nullptr;
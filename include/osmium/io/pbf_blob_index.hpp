@@ -0,0 +1,438 @@
+#ifndef OSMIUM_IO_PBF_BLOB_INDEX_HPP
+#define OSMIUM_IO_PBF_BLOB_INDEX_HPP
+
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+/**
+ * @file
+ *
+ * Include this file if you want to create, write, or read a BlobIndex
+ * for a PBF file.
+ *
+ * @attention If you include this file, you'll need to link with
+ *            `libz`, and enable multithreading.
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <limits>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#ifndef _MSC_VER
+# include <unistd.h>
+#else
+# include <io.h>
+#endif
+
+#include <protozero/pbf_builder.hpp>
+#include <protozero/pbf_message.hpp>
+#include <protozero/types.hpp>
+
+#include <osmium/io/blob_index.hpp>
+#include <osmium/io/detail/pbf.hpp> // IWYU pragma: export
+#include <osmium/io/detail/pbf_decoder.hpp>
+#include <osmium/io/detail/protobuf_tags.hpp>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/error.hpp>
+#include <osmium/io/writer_options.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/thread/pool.hpp>
+#include <osmium/util/delta.hpp>
+#include <osmium/util/file.hpp>
+
+namespace osmium {
+
+    namespace io {
+
+        namespace detail {
+
+            namespace BlobIndexFormat {
+
+                enum class BlobIndex : protozero::pbf_tag_type {
+                    required_string_magic     = 1,
+                    required_uint64_file_size = 2,
+                    repeated_Entry_entries    = 3
+                };
+
+                enum class Entry : protozero::pbf_tag_type {
+                    required_uint64_offset = 1,
+                    required_uint64_size   = 2,
+                    required_uint32_types  = 3,
+                    required_sint64_min_id = 4,
+                    required_sint64_max_id = 5
+                };
+
+            } // namespace BlobIndexFormat
+
+            inline const char* blob_index_magic() noexcept {
+                return "osmium-pbf-blob-index-1";
+            }
+
+            /**
+             * Read exactly size bytes from the file descriptor.
+             *
+             * @returns false if we are at the end of the file, true otherwise
+             * @throws osmium::pbf_error If the file ends in the middle of
+             *         the data
+             * @throws std::system_error If the read fails
+             */
+            inline bool read_exactly(int fd, char* buffer, std::size_t size) {
+                std::size_t offset = 0;
+                while (offset < size) {
+                    const auto length = ::read(fd, buffer + offset, static_cast<unsigned int>(size - offset));
+                    if (length < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        throw std::system_error{errno, std::system_category(), "Read failed"};
+                    }
+                    if (length == 0) {
+                        if (offset == 0) {
+                            return false;
+                        }
+                        throw osmium::pbf_error{"truncated data (EOF encountered)"};
+                    }
+                    offset += static_cast<std::size_t>(length);
+                }
+                return true;
+            }
+
+            /**
+             * Find out which types of OSM objects and which range of IDs
+             * are in the given (uncompressed) PrimitiveBlock. Only the IDs
+             * are decoded, everything else is skipped.
+             */
+            inline void scan_primitive_block(const data_view& data, blob_index_entry& entry) {
+                protozero::pbf_message<OSMFormat::PrimitiveBlock> pbf_primitive_block{data};
+                while (pbf_primitive_block.next(OSMFormat::PrimitiveBlock::repeated_PrimitiveGroup_primitivegroup)) {
+                    protozero::pbf_message<OSMFormat::PrimitiveGroup> pbf_primitive_group = pbf_primitive_block.get_message();
+                    while (pbf_primitive_group.next()) {
+                        switch (pbf_primitive_group.tag()) {
+                            case OSMFormat::PrimitiveGroup::repeated_Node_nodes:
+                                {
+                                    protozero::pbf_message<OSMFormat::Node> pbf_node = pbf_primitive_group.get_message();
+                                    if (pbf_node.next(OSMFormat::Node::required_sint64_id)) {
+                                        entry.add(osmium::osm_entity_bits::node, pbf_node.get_sint64());
+                                    }
+                                }
+                                break;
+                            case OSMFormat::PrimitiveGroup::optional_DenseNodes_dense:
+                                {
+                                    protozero::pbf_message<OSMFormat::DenseNodes> pbf_dense_nodes = pbf_primitive_group.get_message();
+                                    if (pbf_dense_nodes.next(OSMFormat::DenseNodes::packed_sint64_id)) {
+                                        osmium::util::DeltaDecode<osmium::object_id_type> dense_id;
+                                        for (const auto id : pbf_dense_nodes.get_packed_sint64()) {
+                                            entry.add(osmium::osm_entity_bits::node, dense_id.update(id));
+                                        }
+                                    }
+                                }
+                                break;
+                            case OSMFormat::PrimitiveGroup::repeated_Way_ways:
+                                {
+                                    protozero::pbf_message<OSMFormat::Way> pbf_way = pbf_primitive_group.get_message();
+                                    if (pbf_way.next(OSMFormat::Way::required_int64_id)) {
+                                        entry.add(osmium::osm_entity_bits::way, pbf_way.get_int64());
+                                    }
+                                }
+                                break;
+                            case OSMFormat::PrimitiveGroup::repeated_Relation_relations:
+                                {
+                                    protozero::pbf_message<OSMFormat::Relation> pbf_relation = pbf_primitive_group.get_message();
+                                    if (pbf_relation.next(OSMFormat::Relation::required_int64_id)) {
+                                        entry.add(osmium::osm_entity_bits::relation, pbf_relation.get_int64());
+                                    }
+                                }
+                                break;
+                            case OSMFormat::PrimitiveGroup::repeated_ChangeSet_changesets:
+                                // IDs of changesets are not decoded, so this
+                                // blob has to match any ID range.
+                                pbf_primitive_group.skip();
+                                entry.add(osmium::osm_entity_bits::changeset, std::numeric_limits<osmium::object_id_type>::min());
+                                entry.add(osmium::osm_entity_bits::changeset, std::numeric_limits<osmium::object_id_type>::max());
+                                break;
+                            default:
+                                pbf_primitive_group.skip();
+                        }
+                    }
+                }
+            }
+
+            /**
+             * Read the next blob from the file descriptor.
+             *
+             * @param fd File descriptor to read from.
+             * @param expected_type Type of blob expected.
+             * @param blob Will be filled with the blob data.
+             * @param entry If not nullptr and the BlobHeader contains
+             *              indexdata written by Osmium, the entry is
+             *              filled from it and the blob data is skipped
+             *              instead of read into blob.
+             * @returns Number of bytes read or 0 if at end of file.
+             */
+            inline std::size_t read_blob(int fd, const char* expected_type, std::string& blob, blob_index_entry* entry = nullptr) {
+                uint32_t size_in_network_byte_order;
+                if (!read_exactly(fd, reinterpret_cast<char*>(&size_in_network_byte_order), sizeof(size_in_network_byte_order))) {
+                    return 0;
+                }
+
+#ifndef _WIN32
+                const uint32_t size = ntohl(size_in_network_byte_order);
+#else
+                uint32_t size = size_in_network_byte_order;
+                protozero::detail::byteswap_inplace(&size);
+#endif
+
+                if (size > static_cast<uint32_t>(max_blob_header_size)) {
+                    throw osmium::pbf_error{"invalid BlobHeader size (> max_blob_header_size)"};
+                }
+
+                std::string blob_header(size, '\0');
+                if (!read_exactly(fd, &blob_header[0], size)) {
+                    throw osmium::pbf_error{"truncated data (EOF encountered)"};
+                }
+
+                protozero::data_view indexdata;
+                const auto blob_size = decode_blob_header(protozero::pbf_message<FileFormat::BlobHeader>(blob_header), expected_type, &indexdata);
+                if (blob_size > max_uncompressed_blob_size) {
+                    throw osmium::pbf_error{std::string{"invalid blob size: "} + std::to_string(blob_size)};
+                }
+
+                if (entry && decode_blob_indexdata(indexdata, *entry)) {
+                    blob.clear();
+#ifdef _MSC_VER
+                    if (_lseeki64(fd, static_cast<__int64>(blob_size), SEEK_CUR) < 0) {
+#else
+                    if (::lseek(fd, static_cast<off_t>(blob_size), SEEK_CUR) < 0) {
+#endif
+                        throw std::system_error{errno, std::system_category(), "Seek failed"};
+                    }
+                    return sizeof(size_in_network_byte_order) + size + blob_size;
+                }
+
+                blob.resize(blob_size);
+                if (!read_exactly(fd, &blob[0], blob_size)) {
+                    throw osmium::pbf_error{"truncated data (EOF encountered)"};
+                }
+
+                return sizeof(size_in_network_byte_order) + size + blob_size;
+            }
+
+            inline BlobIndex create_pbf_blob_index(int fd, osmium::thread::Pool& pool) {
+                BlobIndex index{osmium::util::file_size(fd)};
+
+                std::string blob;
+                uint64_t offset = read_blob(fd, "OSMHeader", blob);
+                if (offset == 0) {
+                    throw osmium::pbf_error{"missing OSMHeader blob"};
+                }
+
+                // Decompressing and scanning the blobs happens in the pool,
+                // make sure we don't read too far ahead.
+                const std::size_t max_in_flight = static_cast<std::size_t>(pool.num_threads()) * 2 + 2;
+                std::deque<std::future<blob_index_entry>> in_flight;
+
+                while (true) {
+                    auto data = std::make_shared<std::string>();
+                    blob_index_entry entry;
+                    const auto size = read_blob(fd, "OSMData", *data, &entry);
+                    if (size == 0) {
+                        break;
+                    }
+
+                    entry.offset = offset;
+                    entry.size = size;
+                    offset += size;
+
+                    if (entry.types != osmium::osm_entity_bits::nothing) {
+                        // already known from the BlobHeader indexdata
+                        std::promise<blob_index_entry> promise;
+                        promise.set_value(entry);
+                        in_flight.push_back(promise.get_future());
+                    } else {
+                        in_flight.push_back(pool.submit([entry, data]() {
+                            blob_index_entry result{entry};
+                            scan_primitive_block(decode_blob(*data, thread_decode_scratch().uncompressed), result);
+                            return result;
+                        }));
+                    }
+
+                    if (in_flight.size() >= max_in_flight) {
+                        index.add(in_flight.front().get());
+                        in_flight.pop_front();
+                    }
+                }
+
+                for (auto& future : in_flight) {
+                    index.add(future.get());
+                }
+
+                return index;
+            }
+
+        } // namespace detail
+
+        /**
+         * Create a BlobIndex for the given PBF file. This reads the whole
+         * file and decompresses all blobs, but only the IDs of the objects
+         * are decoded. Decompression and decoding is done in the pool
+         * threads. Blobs with Osmium indexdata in their BlobHeader are
+         * not read at all, the index entry is created from the indexdata.
+         *
+         * @param filename Name of an uncompressed PBF file.
+         * @param pool Thread pool to use.
+         * @returns The index.
+         * @throws osmium::pbf_error If the file can't be parsed.
+         * @throws std::system_error If the file can't be read.
+         */
+        inline BlobIndex create_pbf_blob_index(const std::string& filename, osmium::thread::Pool& pool = osmium::thread::Pool::default_instance()) {
+            const int fd = osmium::io::detail::open_for_reading(filename);
+            try {
+                auto index = detail::create_pbf_blob_index(fd, pool);
+                osmium::io::detail::reliable_close(fd);
+                return index;
+            } catch (...) {
+                ::close(fd);
+                throw;
+            }
+        }
+
+        /**
+         * Write the BlobIndex to a (sidecar) file. The format is a simple
+         * protobuf message with one submessage per blob.
+         *
+         * @param index The index.
+         * @param filename Name of the index file.
+         * @param allow_overwrite Allow overwriting of existing file?
+         * @throws std::system_error If the file can't be written.
+         */
+        inline void write_blob_index(const BlobIndex& index, const std::string& filename, osmium::io::overwrite allow_overwrite = osmium::io::overwrite::no) {
+            std::string data;
+            protozero::pbf_builder<detail::BlobIndexFormat::BlobIndex> pbf_index{data};
+
+            pbf_index.add_string(detail::BlobIndexFormat::BlobIndex::required_string_magic, detail::blob_index_magic());
+            pbf_index.add_uint64(detail::BlobIndexFormat::BlobIndex::required_uint64_file_size, index.file_size());
+
+            for (const auto& entry : index) {
+                protozero::pbf_builder<detail::BlobIndexFormat::Entry> pbf_entry{pbf_index, detail::BlobIndexFormat::BlobIndex::repeated_Entry_entries};
+                pbf_entry.add_uint64(detail::BlobIndexFormat::Entry::required_uint64_offset, entry.offset);
+                pbf_entry.add_uint64(detail::BlobIndexFormat::Entry::required_uint64_size, entry.size);
+                pbf_entry.add_uint32(detail::BlobIndexFormat::Entry::required_uint32_types, entry.types);
+                pbf_entry.add_sint64(detail::BlobIndexFormat::Entry::required_sint64_min_id, entry.min_id);
+                pbf_entry.add_sint64(detail::BlobIndexFormat::Entry::required_sint64_max_id, entry.max_id);
+            }
+
+            const int fd = osmium::io::detail::open_for_writing(filename, allow_overwrite);
+            osmium::io::detail::reliable_write(fd, data.data(), data.size());
+            osmium::io::detail::reliable_close(fd);
+        }
+
+        /**
+         * Read a BlobIndex from a file written with write_blob_index().
+         *
+         * @param filename Name of the index file.
+         * @returns The index.
+         * @throws osmium::io_error If the file is not a valid index file.
+         * @throws std::system_error If the file can't be read.
+         */
+        inline BlobIndex read_blob_index(const std::string& filename) {
+            const int fd = osmium::io::detail::open_for_reading(filename);
+            std::string data;
+            try {
+                data.resize(osmium::util::file_size(fd));
+                if (!data.empty()) {
+                    detail::read_exactly(fd, &data[0], data.size());
+                }
+                osmium::io::detail::reliable_close(fd);
+            } catch (...) {
+                ::close(fd);
+                throw;
+            }
+
+            protozero::pbf_message<detail::BlobIndexFormat::BlobIndex> pbf_index{data};
+            if (!pbf_index.next(detail::BlobIndexFormat::BlobIndex::required_string_magic) ||
+                pbf_index.get_string() != detail::blob_index_magic()) {
+                throw osmium::io_error{"not a blob index file: '" + filename + "'"};
+            }
+
+            if (!pbf_index.next(detail::BlobIndexFormat::BlobIndex::required_uint64_file_size)) {
+                throw osmium::io_error{"blob index file without file size: '" + filename + "'"};
+            }
+            BlobIndex index{pbf_index.get_uint64()};
+
+            while (pbf_index.next(detail::BlobIndexFormat::BlobIndex::repeated_Entry_entries)) {
+                protozero::pbf_message<detail::BlobIndexFormat::Entry> pbf_entry = pbf_index.get_message();
+                blob_index_entry entry;
+                while (pbf_entry.next()) {
+                    switch (pbf_entry.tag()) {
+                        case detail::BlobIndexFormat::Entry::required_uint64_offset:
+                            entry.offset = pbf_entry.get_uint64();
+                            break;
+                        case detail::BlobIndexFormat::Entry::required_uint64_size:
+                            entry.size = pbf_entry.get_uint64();
+                            break;
+                        case detail::BlobIndexFormat::Entry::required_uint32_types:
+                            entry.types = static_cast<osmium::osm_entity_bits::type>(pbf_entry.get_uint32() & osmium::osm_entity_bits::all);
+                            break;
+                        case detail::BlobIndexFormat::Entry::required_sint64_min_id:
+                            entry.min_id = pbf_entry.get_sint64();
+                            break;
+                        case detail::BlobIndexFormat::Entry::required_sint64_max_id:
+                            entry.max_id = pbf_entry.get_sint64();
+                            break;
+                        default:
+                            pbf_entry.skip();
+                    }
+                }
+                if (!index.empty() && (index.end() - 1)->offset >= entry.offset) {
+                    throw osmium::io_error{"blob index entries out of order in file '" + filename + "'"};
+                }
+                index.add(entry);
+            }
+
+            return index;
+        }
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_PBF_BLOB_INDEX_HPP
@@ -51,7 +51,9 @@ DEALINGS IN THE SOFTWARE.
 # include <unistd.h>
 #endif
 
+#include <osmium/io/blob_index.hpp>
 #include <osmium/io/compression.hpp>
+#include <osmium/io/decoded_buffer_callback.hpp>
 #include <osmium/io/detail/input_format.hpp>
 #include <osmium/io/detail/read_thread.hpp>
 #include <osmium/io/detail/read_write.hpp>
@@ -60,6 +62,7 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/file.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/memory/buffer_pool.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/thread/pool.hpp>
 #include <osmium/thread/util.hpp>
@@ -110,7 +113,11 @@ namespace osmium {
 
             std::unique_ptr<osmium::io::Decompressor> m_decompressor;
 
-            osmium::io::detail::ReadThreadManager m_read_thread_manager;
+            // Only set if the parser reads directly from the decompressor.
+            std::shared_ptr<const char> m_direct_input;
+
+            // Created after the options are set, because it needs the pool.
+            std::unique_ptr<osmium::io::detail::ReadThreadManager> m_read_thread_manager;
 
             detail::future_buffer_queue_type m_osmdata_queue;
             detail::queue_wrapper<osmium::memory::Buffer> m_osmdata_queue_wrapper;
@@ -125,6 +132,12 @@ namespace osmium {
             osmium::osm_entity_bits::type m_read_which_entities = osmium::osm_entity_bits::all;
             osmium::io::read_meta m_read_metadata = osmium::io::read_meta::yes;
 
+            osmium::io::blob_filter m_blob_filter;
+
+            osmium::memory::BufferPool* m_buffer_pool = nullptr;
+
+            osmium::io::decoded_buffer_callback m_buffer_callback;
+
             void set_option(osmium::thread::Pool& pool) noexcept {
                 m_pool = &pool;
             }
@@ -137,6 +150,18 @@ namespace osmium {
                 m_read_metadata = value;
             }
 
+            void set_option(const osmium::io::blob_filter& value) {
+                m_blob_filter = value;
+            }
+
+            void set_option(osmium::memory::BufferPool& buffer_pool) noexcept {
+                m_buffer_pool = &buffer_pool;
+            }
+
+            void set_option(const osmium::io::decoded_buffer_callback& value) {
+                m_buffer_callback = value;
+            }
+
             // This function will run in a separate thread.
             static void parser_thread(osmium::thread::Pool& pool,
                                       const detail::ParserFactory::create_parser_type& creator,
@@ -144,7 +169,12 @@ namespace osmium {
                                       detail::future_buffer_queue_type& osmdata_queue,
                                       std::promise<osmium::io::Header>&& header_promise,
                                       osmium::osm_entity_bits::type read_which_entities,
-                                      osmium::io::read_meta read_metadata) {
+                                      osmium::io::read_meta read_metadata,
+                                      const std::shared_ptr<const char>& direct_input,
+                                      osmium::io::Decompressor* decompressor,
+                                      const osmium::io::blob_filter& blob_filter,
+                                      osmium::memory::BufferPool* buffer_pool,
+                                      const osmium::io::decoded_buffer_callback& buffer_callback) {
                 std::promise<osmium::io::Header> promise{std::move(header_promise)};
                 osmium::io::detail::parser_arguments args = {
                     pool,
@@ -152,7 +182,12 @@ namespace osmium {
                     osmdata_queue,
                     promise,
                     read_which_entities,
-                    read_metadata
+                    read_metadata,
+                    direct_input,
+                    decompressor,
+                    blob_filter,
+                    buffer_pool,
+                    buffer_callback
                 };
                 creator(args)->parse();
             }
@@ -226,6 +261,20 @@ namespace osmium {
                 return osmium::io::detail::open_for_reading(filename);
             }
 
+            /**
+             * The PBF parser can read blobs directly from memory (instead
+             * of getting the data through the input queue) which allows
+             * reading, decompressing, and decoding them in parallel in the
+             * pool threads. Ask the decompressor for direct access if this
+             * is a PBF file.
+             */
+            static std::shared_ptr<const char> get_direct_input(const osmium::io::File& file, osmium::io::Decompressor& decompressor) {
+                if (file.format() == file_format::pbf) {
+                    return decompressor.enable_direct_access();
+                }
+                return std::shared_ptr<const char>{};
+            }
+
         public:
 
             /**
@@ -247,6 +296,24 @@ namespace osmium {
              *      etc.) is not read possibly speeding up the read. Not all
              *      file formats use this setting.
              *
+             * * osmium::io::blob_filter: Only decode those blobs of a PBF
+             *      file which, according to the blob index in the filter,
+             *      contain objects of the requested types and id range.
+             *      When the file is read directly from memory, unwanted
+             *      blobs are not even read. The index must have been
+             *      created for this file. See blob_index.hpp. Ignored
+             *      for other file formats.
+             *
+             * * osmium::memory::BufferPool&: Get the buffers returned from
+             *      read() from this pool. Give them back to the pool with
+             *      BufferPool::put() or BufferPool::wrap() when you are
+             *      done with them so their memory is reused. The pool must
+             *      outlive the Reader.
+             *
+             * * osmium::io::decoded_buffer_callback: Call this function for
+             *      every buffer right after it was decoded, usually in the
+             *      pool threads. See decoded_buffer_callback.hpp.
+             *
              * @throws osmium::io_error If there was an error.
              * @throws std::system_error If the file could not be opened.
              */
@@ -260,7 +327,8 @@ namespace osmium {
                 m_decompressor(m_file.buffer() ?
                     osmium::io::CompressionFactory::instance().create_decompressor(file.compression(), m_file.buffer(), m_file.buffer_size()) :
                     osmium::io::CompressionFactory::instance().create_decompressor(file.compression(), open_input_file_or_url(m_file.filename(), &m_childpid))),
-                m_read_thread_manager(*m_decompressor, m_input_queue),
+                m_direct_input(get_direct_input(m_file, *m_decompressor)),
+                m_read_thread_manager(),
                 m_osmdata_queue(detail::get_osmdata_queue_size(), "parser_results"),
                 m_osmdata_queue_wrapper(m_osmdata_queue),
                 m_header_future(),
@@ -276,9 +344,11 @@ namespace osmium {
                     m_pool = &thread::Pool::default_instance();
                 }
 
+                m_read_thread_manager.reset(new detail::ReadThreadManager{*m_decompressor, m_input_queue, m_pool});
+
                 std::promise<osmium::io::Header> header_promise;
                 m_header_future = header_promise.get_future();
-                m_thread = osmium::thread::thread_handler{parser_thread, std::ref(*m_pool), std::ref(m_creator), std::ref(m_input_queue), std::ref(m_osmdata_queue), std::move(header_promise), m_read_which_entities, m_read_metadata};
+                m_thread = osmium::thread::thread_handler{parser_thread, std::ref(*m_pool), std::ref(m_creator), std::ref(m_input_queue), std::ref(m_osmdata_queue), std::move(header_promise), m_read_which_entities, m_read_metadata, m_direct_input, m_decompressor.get(), m_blob_filter, m_buffer_pool, m_buffer_callback};
             }
 
             template <typename... TArgs>
@@ -316,12 +386,16 @@ namespace osmium {
             void close() {
                 m_status = status::closed;
 
-                m_read_thread_manager.stop();
+                if (m_read_thread_manager) {
+                    m_read_thread_manager->stop();
+                }
 
                 m_osmdata_queue_wrapper.drain();
 
                 try {
-                    m_read_thread_manager.close();
+                    if (m_read_thread_manager) {
+                        m_read_thread_manager->close();
+                    }
                 } catch (...) {
                     // Ignore any exceptions.
                 }
@@ -394,12 +468,15 @@ namespace osmium {
                         buffer = m_osmdata_queue_wrapper.pop();
                         if (detail::at_end_of_data(buffer)) {
                             m_status = status::eof;
-                            m_read_thread_manager.close();
+                            m_read_thread_manager->close();
                             return buffer;
                         }
                         if (buffer.committed() > 0) {
                             return buffer;
                         }
+                        if (m_buffer_pool) {
+                            m_buffer_pool->put(std::move(buffer));
+                        }
                     }
                 } catch (...) {
                     close();
@@ -125,10 +125,12 @@ namespace osmium {
             // This function will run in a separate thread.
             static void write_thread(detail::future_string_queue_type& output_queue,
                                      std::unique_ptr<osmium::io::Compressor>&& compressor,
-                                     std::promise<bool>&& write_promise) {
+                                     std::promise<bool>&& write_promise,
+                                     osmium::thread::Pool* pool) {
                 detail::WriteThread write_thread{output_queue,
                                                  std::move(compressor),
-                                                 std::move(write_promise)};
+                                                 std::move(write_promise),
+                                                 pool};
                 write_thread();
             }
 
@@ -259,7 +261,7 @@ namespace osmium {
 
                 std::promise<bool> write_promise;
                 m_write_future = write_promise.get_future();
-                m_thread = osmium::thread::thread_handler{write_thread, std::ref(m_output_queue), std::move(compressor), std::move(write_promise)};
+                m_thread = osmium::thread::thread_handler{write_thread, std::ref(m_output_queue), std::move(compressor), std::move(write_promise), options.pool};
 
                 ensure_cleanup([&](){
                     m_output->write_header(options.header);
@@ -0,0 +1,214 @@
+#ifndef OSMIUM_MEMORY_BUFFER_POOL_HPP
+#define OSMIUM_MEMORY_BUFFER_POOL_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <osmium/memory/buffer.hpp>
+
+namespace osmium {
+
+    namespace memory {
+
+        /**
+         * A pool of buffers that can be reused. Getting a buffer from the
+         * pool instead of creating a new one saves the allocation and, more
+         * importantly, the page faults when the memory is written to for
+         * the first time.
+         *
+         * Buffers are returned to the pool either explicitly by calling
+         * put() or automatically by wrapping them with wrap(). The handle
+         * returned from wrap() will give the buffer back to the pool when
+         * it goes out of scope.
+         *
+         * Only buffers with internally managed memory are kept in the pool,
+         * all others are silently dropped. Buffers handed out from the pool
+         * are always empty and will grow automatically if needed.
+         *
+         * All member functions are thread-safe. The pool must outlive all
+         * handles created by wrap().
+         *
+         * Example:
+         * @code
+         *     osmium::memory::BufferPool pool;
+         *     osmium::io::Reader reader{"input.osm.pbf", pool};
+         *     while (auto buffer = pool.wrap(reader.read())) {
+         *         ...handle buffer...
+         *     } // buffer is returned to the pool here
+         * @endcode
+         */
+        class BufferPool {
+
+        public:
+
+            /**
+             * The deleter used for the handles returned from wrap(). It
+             * gives the buffer back to the pool.
+             */
+            class returner {
+
+                BufferPool* m_pool;
+
+            public:
+
+                explicit returner(BufferPool* pool = nullptr) noexcept :
+                    m_pool(pool) {
+                }
+
+                void operator()(Buffer* buffer) const {
+                    if (m_pool) {
+                        m_pool->put(std::move(*buffer));
+                    }
+                    delete buffer;
+                }
+
+            }; // class returner
+
+            using handle_type = std::unique_ptr<Buffer, returner>;
+
+        private:
+
+            static constexpr const std::size_t default_max_buffers = 32;
+
+            mutable std::mutex m_mutex;
+            std::vector<Buffer> m_buffers;
+            std::size_t m_max_buffers;
+
+        public:
+
+            /**
+             * Create an empty pool.
+             *
+             * @param max_buffers The maximum number of buffers kept in the
+             *                    pool. Buffers given back when the pool is
+             *                    full are freed.
+             */
+            explicit BufferPool(std::size_t max_buffers = default_max_buffers) :
+                m_mutex(),
+                m_buffers(),
+                m_max_buffers(max_buffers) {
+                m_buffers.reserve(max_buffers);
+            }
+
+            BufferPool(const BufferPool&) = delete;
+            BufferPool& operator=(const BufferPool&) = delete;
+
+            BufferPool(BufferPool&&) = delete;
+            BufferPool& operator=(BufferPool&&) = delete;
+
+            ~BufferPool() noexcept = default;
+
+            /**
+             * Get an empty buffer with at least the given capacity. The most
+             * recently returned buffer that is large enough is reused, if
+             * there is none, a new buffer is created.
+             *
+             * @param min_capacity The minimum capacity of the buffer.
+             */
+            Buffer get(std::size_t min_capacity) {
+                {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    for (auto it = m_buffers.rbegin(); it != m_buffers.rend(); ++it) {
+                        if (it->capacity() >= min_capacity) {
+                            Buffer buffer{std::move(*it)};
+                            m_buffers.erase(std::next(it).base());
+                            return buffer;
+                        }
+                    }
+                }
+                return Buffer{min_capacity, Buffer::auto_grow::yes};
+            }
+
+            /**
+             * Give a buffer back to the pool. The buffer is cleared. If it
+             * is invalid, doesn't manage its own memory, or the pool is
+             * full, the buffer is freed instead.
+             */
+            void put(Buffer&& buffer) {
+                if (!buffer.m_memory) {
+                    return;
+                }
+
+                buffer.clear();
+                buffer.m_auto_grow = Buffer::auto_grow::yes;
+                buffer.m_full = nullptr;
+
+                std::lock_guard<std::mutex> lock{m_mutex};
+                if (m_buffers.size() < m_max_buffers) {
+                    m_buffers.push_back(std::move(buffer));
+                }
+            }
+
+            /**
+             * Wrap a buffer into a handle that gives the buffer back to
+             * this pool when it is destroyed. An invalid buffer results in
+             * an empty handle, so this can be used directly in a loop
+             * condition with Reader::read().
+             */
+            handle_type wrap(Buffer&& buffer) {
+                if (!buffer) {
+                    return handle_type{nullptr, returner{this}};
+                }
+                return handle_type{new Buffer{std::move(buffer)}, returner{this}};
+            }
+
+            /// The number of buffers currently in the pool.
+            std::size_t size() const {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                return m_buffers.size();
+            }
+
+            /// The maximum number of buffers kept in the pool.
+            std::size_t max_size() const noexcept {
+                return m_max_buffers;
+            }
+
+            /// Free all buffers in the pool.
+            void clear() {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                m_buffers.clear();
+            }
+
+        }; // class BufferPool
+
+    } // namespace memory
+
+} // namespace osmium
+
+#endif // OSMIUM_MEMORY_BUFFER_POOL_HPP
@@ -0,0 +1,446 @@
+#ifndef OSMIUM_THREAD_LOCKFREE_QUEUE_HPP
+#define OSMIUM_THREAD_LOCKFREE_QUEUE_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2017 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef OSMIUM_DEBUG_QUEUE_SIZE
+# include <iostream>
+#endif
+
+namespace osmium {
+
+    namespace thread {
+
+        namespace detail {
+
+            constexpr const std::size_t cache_line_size = 64;
+
+            /**
+             * Round up to the next power of two, minimum is 2.
+             */
+            inline std::size_t ring_capacity(std::size_t max_size) noexcept {
+                std::size_t capacity = 2;
+                while (capacity < max_size) {
+                    capacity <<= 1U;
+                }
+                return capacity;
+            }
+
+            /**
+             * Blocks a thread until some condition is met. The waiting
+             * thread first spins for a while, only then it goes to sleep
+             * on a condition variable. The notifying thread only takes the
+             * mutex if somebody is actually sleeping, so in the common case
+             * no locks are involved on either side.
+             */
+            class queue_waiter {
+
+                static constexpr const int spin_count = 100;
+
+                std::atomic<int> m_sleeping{0};
+                std::atomic<int> m_sleep_count{0};
+                std::mutex m_mutex;
+                std::condition_variable m_condition;
+
+            public:
+
+                /**
+                 * Wait until ready() returns true. The function can be called
+                 * several times and concurrently with notify().
+                 */
+                template <typename TPredicate>
+                void wait(TPredicate&& ready) {
+                    for (int i = 0; i < spin_count; ++i) {
+                        if (ready()) {
+                            return;
+                        }
+                        std::this_thread::yield();
+                    }
+
+                    std::unique_lock<std::mutex> lock{m_mutex};
+                    ++m_sleep_count;
+                    m_sleeping.fetch_add(1);
+                    // Pairs with the fence in notify(): Either the notifying
+                    // thread sees m_sleeping > 0 or we see its data in ready().
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    m_condition.wait(lock, std::forward<TPredicate>(ready));
+                    m_sleeping.fetch_sub(1);
+                }
+
+                /**
+                 * Wake up one sleeping thread, if there is any. Call this
+                 * after changing the data ready() looks at.
+                 */
+                void notify() {
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (m_sleeping.load(std::memory_order_relaxed) > 0) {
+                        std::lock_guard<std::mutex> lock{m_mutex};
+                        m_condition.notify_one();
+                    }
+                }
+
+                /// How often threads had to go to sleep (for debugging only).
+                int sleep_count() const noexcept {
+                    return m_sleep_count.load(std::memory_order_relaxed);
+                }
+
+                /**
+                 * Wake up all sleeping threads.
+                 */
+                void notify_all() {
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (m_sleeping.load(std::memory_order_relaxed) > 0) {
+                        std::lock_guard<std::mutex> lock{m_mutex};
+                        m_condition.notify_all();
+                    }
+                }
+
+            }; // class queue_waiter
+
+        } // namespace detail
+
+        /**
+         * A thread-safe bounded queue for exactly one producer and one
+         * consumer thread. It has the same interface as osmium::thread::Queue,
+         * but is implemented as a lock-free ring buffer. Only if the queue
+         * is full (or empty) for more than a short time, the pushing (or
+         * popping) thread will go to sleep.
+         *
+         * Unlike osmium::thread::Queue this queue is always bounded: A
+         * max_size of 0 in the constructor means the default size of 1024,
+         * not unlimited.
+         *
+         * Only one thread may call push() and only one thread may call
+         * wait_and_pop() or try_pop() at any time. Use the MPMCQueue if you
+         * need more.
+         *
+         * T must be default constructible and move assignable.
+         */
+        template <typename T>
+        class SPSCQueue {
+
+            std::vector<T> m_ring;
+            const std::size_t m_mask;
+
+            /// Name of this queue (for debugging only).
+            const std::string m_name;
+
+            char m_pad0[detail::cache_line_size];
+
+            /// Index of the next element to pop. Only changed by the consumer.
+            std::atomic<std::size_t> m_head{0};
+
+            char m_pad1[detail::cache_line_size - sizeof(std::atomic<std::size_t>)];
+
+            /// Index of the next element to push. Only changed by the producer.
+            std::atomic<std::size_t> m_tail{0};
+
+            char m_pad2[detail::cache_line_size - sizeof(std::atomic<std::size_t>)];
+
+            /// Used to signal consumers when data is available in the queue.
+            detail::queue_waiter m_data_available;
+
+            /// Used to signal producers when queue is not full.
+            detail::queue_waiter m_space_available;
+
+            bool try_push_impl(T& value) {
+                const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+                if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+                    return false;
+                }
+                m_ring[tail & m_mask] = std::move(value);
+                m_tail.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool try_pop_impl(T& value) {
+                const std::size_t head = m_head.load(std::memory_order_relaxed);
+                if (head == m_tail.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                value = std::move(m_ring[head & m_mask]);
+                m_head.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+        public:
+
+            /**
+             * Construct a single-producer single-consumer queue.
+             *
+             * @param max_size Maximum number of elements in the queue. This
+             *                 is rounded up to the next power of two. As
+             *                 this queue can not grow, 0 means the default
+             *                 size of 1024.
+             * @param name Optional name for this queue. (Used for debugging.)
+             */
+            explicit SPSCQueue(std::size_t max_size = 0, const std::string& name = "") :
+                m_ring(detail::ring_capacity(max_size > 0 ? max_size : 1024)),
+                m_mask(m_ring.size() - 1),
+                m_name(name) {
+            }
+
+            SPSCQueue(const SPSCQueue&) = delete;
+            SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+            SPSCQueue(SPSCQueue&&) = delete;
+            SPSCQueue& operator=(SPSCQueue&&) = delete;
+
+            ~SPSCQueue() {
+#ifdef OSMIUM_DEBUG_QUEUE_SIZE
+                std::cerr << "queue '" << m_name
+                          << "' with capacity=" << m_ring.size()
+                          << " had producer sleeping " << m_space_available.sleep_count()
+                          << " times and consumer sleeping " << m_data_available.sleep_count()
+                          << " times\n";
+#endif
+            }
+
+            /**
+             * Push an element onto the queue. This call will block if the
+             * queue is full.
+             */
+            void push(T value) {
+                if (!try_push_impl(value)) {
+                    m_space_available.wait([&] { return try_push_impl(value); });
+                }
+                m_data_available.notify();
+            }
+
+            void wait_and_pop(T& value) {
+                if (!try_pop_impl(value)) {
+                    m_data_available.wait([&] { return try_pop_impl(value); });
+                }
+                m_space_available.notify();
+            }
+
+            bool try_pop(T& value) {
+                if (!try_pop_impl(value)) {
+                    return false;
+                }
+                m_space_available.notify();
+                return true;
+            }
+
+            bool empty() const {
+                return size() == 0;
+            }
+
+            std::size_t size() const {
+                const std::size_t head = m_head.load(std::memory_order_acquire);
+                return m_tail.load(std::memory_order_acquire) - head;
+            }
+
+        }; // class SPSCQueue
+
+        /**
+         * A thread-safe bounded queue for any number of producer and
+         * consumer threads. It has the same interface as
+         * osmium::thread::Queue, but is implemented as a lock-free ring
+         * buffer. (This is Dmitry Vyukov's bounded MPMC queue.) Only if
+         * the queue is full (or empty) for more than a short time, the
+         * pushing (or popping) thread will go to sleep.
+         *
+         * Unlike osmium::thread::Queue this queue is always bounded: A
+         * max_size of 0 in the constructor means the default size of 1024,
+         * not unlimited.
+         *
+         * This queue is not used by libosmium itself (the thread Pool has
+         * its own work-stealing queues), it is provided for applications.
+         *
+         * T must be default constructible and move assignable.
+         */
+        template <typename T>
+        class MPMCQueue {
+
+            struct cell {
+                std::atomic<std::size_t> sequence;
+                T data;
+            };
+
+            std::unique_ptr<cell[]> m_cells;
+            const std::size_t m_mask;
+
+            /// Name of this queue (for debugging only).
+            const std::string m_name;
+
+            char m_pad0[detail::cache_line_size];
+
+            std::atomic<std::size_t> m_enqueue_pos{0};
+
+            char m_pad1[detail::cache_line_size - sizeof(std::atomic<std::size_t>)];
+
+            std::atomic<std::size_t> m_dequeue_pos{0};
+
+            char m_pad2[detail::cache_line_size - sizeof(std::atomic<std::size_t>)];
+
+            /// Used to signal consumers when data is available in the queue.
+            detail::queue_waiter m_data_available;
+
+            /// Used to signal producers when queue is not full.
+            detail::queue_waiter m_space_available;
+
+            bool try_push_impl(T& value) {
+                std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                while (true) {
+                    cell& c = m_cells[pos & m_mask];
+                    const std::size_t seq = c.sequence.load(std::memory_order_acquire);
+                    const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+                    if (diff == 0) {
+                        if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            c.data = std::move(value);
+                            c.sequence.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;
+                    } else {
+                        pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool try_pop_impl(T& value) {
+                std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+                while (true) {
+                    cell& c = m_cells[pos & m_mask];
+                    const std::size_t seq = c.sequence.load(std::memory_order_acquire);
+                    const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+                    if (diff == 0) {
+                        if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            value = std::move(c.data);
+                            c.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;
+                    } else {
+                        pos = m_dequeue_pos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+        public:
+
+            /**
+             * Construct a multi-producer multi-consumer queue.
+             *
+             * @param max_size Maximum number of elements in the queue. This
+             *                 is rounded up to the next power of two. As
+             *                 this queue can not grow, 0 means the default
+             *                 size of 1024.
+             * @param name Optional name for this queue. (Used for debugging.)
+             */
+            explicit MPMCQueue(std::size_t max_size = 0, const std::string& name = "") :
+                m_cells(new cell[detail::ring_capacity(max_size > 0 ? max_size : 1024)]),
+                m_mask(detail::ring_capacity(max_size > 0 ? max_size : 1024) - 1),
+                m_name(name) {
+                for (std::size_t i = 0; i <= m_mask; ++i) {
+                    m_cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            MPMCQueue(const MPMCQueue&) = delete;
+            MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+            MPMCQueue(MPMCQueue&&) = delete;
+            MPMCQueue& operator=(MPMCQueue&&) = delete;
+
+            ~MPMCQueue() {
+#ifdef OSMIUM_DEBUG_QUEUE_SIZE
+                std::cerr << "queue '" << m_name
+                          << "' with capacity=" << (m_mask + 1)
+                          << " had producers sleeping " << m_space_available.sleep_count()
+                          << " times and consumers sleeping " << m_data_available.sleep_count()
+                          << " times\n";
+#endif
+            }
+
+            /**
+             * Push an element onto the queue. This call will block if the
+             * queue is full.
+             */
+            void push(T value) {
+                if (!try_push_impl(value)) {
+                    m_space_available.wait([&] { return try_push_impl(value); });
+                }
+                m_data_available.notify();
+            }
+
+            void wait_and_pop(T& value) {
+                if (!try_pop_impl(value)) {
+                    m_data_available.wait([&] { return try_pop_impl(value); });
+                }
+                m_space_available.notify();
+            }
+
+            bool try_pop(T& value) {
+                if (!try_pop_impl(value)) {
+                    return false;
+                }
+                m_space_available.notify();
+                return true;
+            }
+
+            bool empty() const {
+                return size() == 0;
+            }
+
+            /**
+             * The number of elements in the queue. This is only a snapshot
+             * if other threads are using the queue at the same time.
+             */
+            std::size_t size() const {
+                const std::size_t head = m_dequeue_pos.load(std::memory_order_acquire);
+                const std::size_t tail = m_enqueue_pos.load(std::memory_order_acquire);
+                return tail > head ? tail - head : 0;
+            }
+
+        }; // class MPMCQueue
+
+    } // namespace thread
+
+} // namespace osmium
+
+#endif // OSMIUM_THREAD_LOCKFREE_QUEUE_HPP
@@ -33,15 +33,23 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include <osmium/thread/function_wrapper.hpp>
-#include <osmium/thread/queue.hpp>
+#include <osmium/thread/lockfree_queue.hpp>
 #include <osmium/thread/util.hpp>
 #include <osmium/util/config.hpp>
 
@@ -52,10 +60,20 @@ namespace osmium {
      */
     namespace thread {
 
+        /**
+         * How the threads of a Pool are placed on the CPUs.
+         */
+        enum class pool_affinity {
+            none    = 0, ///< threads are not pinned to CPUs
+            compact = 1, ///< pin threads to CPUs filling one NUMA node after the other
+            spread  = 2  ///< pin threads to CPUs round-robin over the NUMA nodes
+        }; // enum class pool_affinity
+
         namespace detail {
 
-            // Maximum number of allowed pool threads (just to keep the user
-            // from setting something silly).
+            // Maximum number of allowed pool threads on machines with fewer
+            // cores than this (just to keep the user from setting something
+            // silly). On larger machines the number of cores is the limit.
             constexpr const int max_pool_threads = 32;
 
             inline int get_pool_size(int num_threads, int user_setting, unsigned hardware_concurrency) {
@@ -67,10 +85,11 @@ namespace osmium {
                     num_threads += int(hardware_concurrency);
                 }
 
+                const int max_threads = std::max(max_pool_threads, int(hardware_concurrency));
                 if (num_threads < 1) {
                     num_threads = 1;
-                } else if (num_threads > max_pool_threads) {
-                    num_threads = max_pool_threads;
+                } else if (num_threads > max_threads) {
+                    num_threads = max_threads;
                 }
 
                 return num_threads;
@@ -81,10 +100,72 @@ namespace osmium {
                 return n > 2 ? n : 2;
             }
 
+            inline pool_affinity get_pool_affinity(const char* value) noexcept {
+                if (value) {
+                    if (!std::strcmp(value, "compact")) {
+                        return pool_affinity::compact;
+                    }
+                    if (!std::strcmp(value, "spread")) {
+                        return pool_affinity::spread;
+                    }
+                }
+                return pool_affinity::none;
+            }
+
+            /**
+             * The task queue of one pool thread. The thread itself takes
+             * tasks from the front, other threads steal from the back.
+             */
+            class work_deque {
+
+                std::mutex m_mutex;
+                std::deque<function_wrapper> m_tasks;
+
+            public:
+
+                void push(function_wrapper&& task) {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    m_tasks.push_back(std::move(task));
+                }
+
+                template <typename TIterator>
+                void push(TIterator first, TIterator last) {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    m_tasks.insert(m_tasks.end(), std::make_move_iterator(first), std::make_move_iterator(last));
+                }
+
+                bool pop_front(function_wrapper& task) {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    if (m_tasks.empty()) {
+                        return false;
+                    }
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop_front();
+                    return true;
+                }
+
+                bool pop_back(function_wrapper& task) {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    if (m_tasks.empty()) {
+                        return false;
+                    }
+                    task = std::move(m_tasks.back());
+                    m_tasks.pop_back();
+                    return true;
+                }
+
+            }; // class work_deque
+
         } // namespace detail
 
         /**
-         *  Thread pool.
+         * Work-stealing thread pool.
+         *
+         * Each pool thread has its own task queue. Tasks submitted from
+         * outside the pool are distributed round-robin over those queues,
+         * tasks submitted from a pool thread go into the queue of that
+         * thread. A thread without work steals tasks from the other queues,
+         * preferring threads on the same NUMA node.
          */
         class Pool {
 
@@ -112,24 +193,136 @@ namespace osmium {
 
             }; // class thread_joiner
 
-            osmium::thread::Queue<function_wrapper> m_work_queue;
+            struct worker_id {
+                const Pool* pool;
+                std::size_t index;
+            };
+
+            int m_num_threads;
+            std::size_t m_max_queue_size;
+            std::vector<std::unique_ptr<detail::work_deque>> m_queues;
+
+            // For each thread the CPU it is pinned to (or -1) and the order
+            // in which it tries to steal from the other threads.
+            std::vector<int> m_cpus;
+            std::vector<std::vector<std::size_t>> m_steal_order;
+
+            std::atomic<std::size_t> m_queued{0};
+            std::atomic<std::size_t> m_next_queue{0};
+            std::atomic<bool> m_shutdown{false};
+
+            detail::queue_waiter m_work_available;
+            detail::queue_waiter m_space_available;
+
             std::vector<std::thread> m_threads;
             thread_joiner m_joiner;
-            int m_num_threads;
 
-            void worker_thread() {
+            static worker_id& current_worker() noexcept {
+                static thread_local worker_id id{nullptr, 0};
+                return id;
+            }
+
+            void place_threads(pool_affinity affinity) {
+                const auto num_threads = std::size_t(m_num_threads);
+                std::vector<int> node_of_thread(num_threads, 0);
+                m_cpus.assign(num_threads, -1);
+
+                if (affinity != pool_affinity::none) {
+                    const auto nodes = osmium::thread::get_numa_node_cpus();
+                    std::vector<std::pair<int, int>> cpus; // (cpu, node)
+                    if (affinity == pool_affinity::compact) {
+                        for (std::size_t n = 0; n < nodes.size(); ++n) {
+                            for (const int cpu : nodes[n]) {
+                                cpus.emplace_back(cpu, int(n));
+                            }
+                        }
+                    } else {
+                        for (std::size_t i = 0; cpus.size() < num_threads; ++i) {
+                            bool found = false;
+                            for (std::size_t n = 0; n < nodes.size(); ++n) {
+                                if (i < nodes[n].size()) {
+                                    cpus.emplace_back(nodes[n][i], int(n));
+                                    found = true;
+                                }
+                            }
+                            if (!found) {
+                                break;
+                            }
+                        }
+                    }
+                    if (!cpus.empty()) {
+                        for (std::size_t i = 0; i < m_cpus.size(); ++i) {
+                            m_cpus[i] = cpus[i % cpus.size()].first;
+                            node_of_thread[i] = cpus[i % cpus.size()].second;
+                        }
+                    }
+                }
+
+                m_steal_order.resize(num_threads);
+                for (std::size_t i = 0; i < m_steal_order.size(); ++i) {
+                    auto& order = m_steal_order[i];
+                    for (std::size_t j = 1; j < m_steal_order.size(); ++j) {
+                        order.push_back((i + j) % m_steal_order.size());
+                    }
+                    std::stable_partition(order.begin(), order.end(), [&](std::size_t victim) {
+                        return node_of_thread[victim] == node_of_thread[i];
+                    });
+                }
+            }
+
+            bool get_task(std::size_t index, function_wrapper& task) {
+                if (m_queues[index]->pop_front(task)) {
+                    return true;
+                }
+                for (const auto victim : m_steal_order[index]) {
+                    if (m_queues[victim]->pop_back(task)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void worker_thread(std::size_t index) {
                 osmium::thread::set_thread_name("_osmium_worker");
+                if (m_cpus[index] >= 0) {
+                    osmium::thread::set_thread_affinity(m_cpus[index]);
+                }
+                current_worker() = worker_id{this, index};
+
                 while (true) {
                     function_wrapper task;
-                    m_work_queue.wait_and_pop(task);
-                    if (task && task()) {
-                        // The called tasks returns true only when the
-                        // worker thread should shut down.
+                    m_work_available.wait([&] {
+                        return get_task(index, task) || m_shutdown.load();
+                    });
+                    if (!task) {
+                        // Shutdown and no more work to do.
                         return;
                     }
+                    --m_queued;
+                    m_space_available.notify();
+                    task();
                 }
             }
 
+            void wait_for_space() {
+                if (current_worker().pool == this) {
+                    // Pool threads never block on a full queue, that
+                    // could deadlock the pool.
+                    return;
+                }
+                m_space_available.wait([this] {
+                    return m_queued.load() < m_max_queue_size;
+                });
+            }
+
+            detail::work_deque& target_queue() noexcept {
+                const auto& worker = current_worker();
+                if (worker.pool == this) {
+                    return *m_queues[worker.index];
+                }
+                return *m_queues[m_next_queue++ % m_queues.size()];
+            }
+
         public:
 
             static constexpr int default_num_threads = 0;
@@ -145,20 +338,40 @@ namespace osmium {
              * set to the actual number of cores on the system plus the
              * given number, ie it will leave a number of cores unused.
              *
-             * In all cases the minimum number of threads in the pool is 1.
+             * In all cases the minimum number of threads in the pool is 1,
+             * the maximum is the number of cores, but at least 32.
              *
              * If max_queue_size is 0, the queue size is read from
-             * the environment variable OSMIUM_MAX_WORK_QUEUE_SIZE.
+             * the environment variable OSMIUM_MAX_WORK_QUEUE_SIZE. This is
+             * the number of queued tasks above which submit() blocks when
+             * called from outside the pool.
+             *
+             * The affinity defaults to the value of the environment
+             * variable OSMIUM_POOL_AFFINITY ("compact" or "spread"), if it
+             * isn't set the threads are not pinned to CPUs. Pinning only
+             * works on Linux.
              */
-            explicit Pool(int num_threads = default_num_threads, std::size_t max_queue_size = default_queue_size) :
-                m_work_queue(max_queue_size > 0 ? max_queue_size : detail::get_work_queue_size(), "work"),
+            explicit Pool(int num_threads = default_num_threads,
+                          std::size_t max_queue_size = default_queue_size,
+                          pool_affinity affinity = detail::get_pool_affinity(std::getenv("OSMIUM_POOL_AFFINITY"))) :
+                m_num_threads(detail::get_pool_size(num_threads, osmium::config::get_pool_threads(), std::thread::hardware_concurrency())),
+                m_max_queue_size(max_queue_size > 0 ? max_queue_size : detail::get_work_queue_size()),
+                m_queues(),
+                m_cpus(),
+                m_steal_order(),
+                m_work_available(),
+                m_space_available(),
                 m_threads(),
-                m_joiner(m_threads),
-                m_num_threads(detail::get_pool_size(num_threads, osmium::config::get_pool_threads(), std::thread::hardware_concurrency())) {
+                m_joiner(m_threads) {
+
+                for (int i = 0; i < m_num_threads; ++i) {
+                    m_queues.emplace_back(new detail::work_deque{});
+                }
+                place_threads(affinity);
 
                 try {
-                    for (int i = 0; i < m_num_threads; ++i) {
-                        m_threads.emplace_back(&Pool::worker_thread, this);
+                    for (std::size_t i = 0; i < m_queues.size(); ++i) {
+                        m_threads.emplace_back(&Pool::worker_thread, this, i);
                     }
                 } catch (...) {
                     shutdown_all_workers();
@@ -171,11 +384,12 @@ namespace osmium {
                 return pool;
             }
 
+            /**
+             * Tell all pool threads to stop once there is no more work.
+             */
             void shutdown_all_workers() {
-                for (int i = 0; i < m_num_threads; ++i) {
-                    // The special function wrapper makes a worker shut down.
-                    m_work_queue.push(function_wrapper{0});
-                }
+                m_shutdown = true;
+                m_work_available.notify_all();
             }
 
             ~Pool() {
@@ -186,12 +400,20 @@ namespace osmium {
                 return m_num_threads;
             }
 
+            /**
+             * The CPU the pool thread with the given index is pinned to or
+             * -1 if it isn't pinned.
+             */
+            int thread_cpu(int index) const noexcept {
+                return m_cpus[std::size_t(index)];
+            }
+
             std::size_t queue_size() const {
-                return m_work_queue.size();
+                return m_queued.load();
             }
 
             bool queue_empty() const {
-                return m_work_queue.empty();
+                return queue_size() == 0;
             }
 
             template <typename TFunction>
@@ -200,11 +422,61 @@ namespace osmium {
 
                 std::packaged_task<result_type()> task{std::forward<TFunction>(func)};
                 std::future<result_type> future_result{task.get_future()};
-                m_work_queue.push(std::move(task));
+
+                wait_for_space();
+                ++m_queued;
+                target_queue().push(function_wrapper{std::move(task)});
+                m_work_available.notify();
 
                 return future_result;
             }
 
+            /**
+             * Submit several tasks at once. The tasks are moved out of the
+             * range and spread over the queues of all pool threads taking
+             * each queue lock only once.
+             *
+             * Unlike submit() this only waits for the queue to drop below
+             * the maximum size once, so the whole batch is always added.
+             *
+             * @returns The futures for the results in the same order as
+             *          the tasks.
+             */
+            template <typename TIterator>
+            std::vector<std::future<typename std::result_of<typename std::iterator_traits<TIterator>::value_type()>::type>>
+            submit_batch(TIterator first, TIterator last) {
+                using result_type = typename std::result_of<typename std::iterator_traits<TIterator>::value_type()>::type;
+
+                std::vector<std::future<result_type>> futures;
+                std::vector<function_wrapper> tasks;
+                for (; first != last; ++first) {
+                    std::packaged_task<result_type()> task{std::move(*first)};
+                    futures.push_back(task.get_future());
+                    tasks.emplace_back(std::move(task));
+                }
+
+                if (tasks.empty()) {
+                    return futures;
+                }
+
+                wait_for_space();
+                m_queued += tasks.size();
+
+                if (current_worker().pool == this) {
+                    target_queue().push(tasks.begin(), tasks.end());
+                } else {
+                    const std::size_t chunk_size = (tasks.size() + m_queues.size() - 1) / m_queues.size();
+                    for (auto it = tasks.begin(); it != tasks.end();) {
+                        const auto end = it + std::min(chunk_size, std::size_t(tasks.end() - it));
+                        target_queue().push(it, end);
+                        it = end;
+                    }
+                }
+                m_work_available.notify_all();
+
+                return futures;
+            }
+
         }; // class Pool
 
     } // namespace thread
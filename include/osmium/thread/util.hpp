@@ -34,11 +34,17 @@ DEALINGS IN THE SOFTWARE.
 */
 
 #include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <future>
+#include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #ifdef __linux__
+# include <pthread.h>
+# include <sched.h>
 # include <sys/prctl.h>
 #endif
 
@@ -82,6 +88,105 @@ namespace osmium {
         }
 #endif
 
+        namespace detail {
+
+            /**
+             * Parse a list of CPUs in the format Linux uses in /sys, for
+             * instance "0-3,8,10-11".
+             */
+            inline std::vector<int> parse_cpu_list(const std::string& list) {
+                std::vector<int> cpus;
+                const char* str = list.c_str();
+                while (*str) {
+                    char* end = nullptr;
+                    const long first = std::strtol(str, &end, 10);
+                    if (end == str) {
+                        break;
+                    }
+                    long last = first;
+                    str = end;
+                    if (*str == '-') {
+                        ++str;
+                        last = std::strtol(str, &end, 10);
+                        if (end == str) {
+                            break;
+                        }
+                        str = end;
+                    }
+                    for (long cpu = first; cpu <= last; ++cpu) {
+                        cpus.push_back(static_cast<int>(cpu));
+                    }
+                    if (*str != ',') {
+                        break;
+                    }
+                    ++str;
+                }
+                return cpus;
+            }
+
+        } // namespace detail
+
+        /**
+         * Get the CPUs this process is allowed to run on grouped by NUMA
+         * node. On systems without NUMA information (and on all systems
+         * other than Linux) all CPUs are in one node.
+         */
+        inline std::vector<std::vector<int>> get_numa_node_cpus() {
+            std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+            constexpr const int max_numa_nodes = 256;
+
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            const bool have_allowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+            for (int node = 0; node < max_numa_nodes; ++node) {
+                std::ifstream file{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+                if (!file) {
+                    continue;
+                }
+                std::string list;
+                std::getline(file, list);
+                std::vector<int> cpus;
+                for (const int cpu : detail::parse_cpu_list(list)) {
+                    if (!have_allowed || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))) {
+                        cpus.push_back(cpu);
+                    }
+                }
+                if (!cpus.empty()) {
+                    nodes.push_back(std::move(cpus));
+                }
+            }
+#endif
+            if (nodes.empty()) {
+                nodes.emplace_back();
+                const unsigned num_cpus = std::thread::hardware_concurrency();
+                for (unsigned cpu = 0; cpu < num_cpus; ++cpu) {
+                    nodes.back().push_back(static_cast<int>(cpu));
+                }
+            }
+            return nodes;
+        }
+
+        /**
+         * Pin the current thread to the given CPU. This only works on
+         * Linux.
+         *
+         * @returns true if the thread was pinned.
+         */
+#ifdef __linux__
+        inline bool set_thread_affinity(int cpu) noexcept {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+        }
+#else
+        inline bool set_thread_affinity(int) noexcept {
+            return false;
+        }
+#endif
+
         class thread_handler {
 
             std::thread m_thread;
@@ -55,17 +55,47 @@ namespace osmium {
             return 0;
         }
 
-        inline bool use_pool_threads_for_pbf_parsing() noexcept {
-            const char* env = getenv("OSMIUM_USE_POOL_THREADS_FOR_PBF_PARSING");
-            if (env) {
-                if (!strcasecmp(env, "off") ||
-                    !strcasecmp(env, "false") ||
-                    !strcasecmp(env, "no") ||
-                    !strcasecmp(env, "0")) {
-                    return false;
-                }
+        namespace detail {
+
+            inline bool is_set_to_false(const char* env) noexcept {
+                return env && (!strcasecmp(env, "off") ||
+                               !strcasecmp(env, "false") ||
+                               !strcasecmp(env, "no") ||
+                               !strcasecmp(env, "0"));
             }
-            return true;
+
+        } // namespace detail
+
+        inline bool use_pool_threads_for_pbf_parsing() noexcept {
+            return !detail::is_set_to_false(getenv("OSMIUM_USE_POOL_THREADS_FOR_PBF_PARSING"));
+        }
+
+        inline bool use_pool_threads_for_opl_parsing() noexcept {
+            return !detail::is_set_to_false(getenv("OSMIUM_USE_POOL_THREADS_FOR_OPL_PARSING"));
+        }
+
+        inline bool use_pool_threads_for_o5m_parsing() noexcept {
+            return !detail::is_set_to_false(getenv("OSMIUM_USE_POOL_THREADS_FOR_O5M_PARSING"));
+        }
+
+        inline bool use_pool_threads_for_compression() noexcept {
+            return !detail::is_set_to_false(getenv("OSMIUM_USE_POOL_THREADS_FOR_COMPRESSION"));
+        }
+
+        inline bool use_pool_threads_for_decompression() noexcept {
+            return !detail::is_set_to_false(getenv("OSMIUM_USE_POOL_THREADS_FOR_DECOMPRESSION"));
+        }
+
+        inline bool use_pool_threads_for_xml_parsing() noexcept {
+            return !detail::is_set_to_false(getenv("OSMIUM_USE_POOL_THREADS_FOR_XML_PARSING"));
+        }
+
+        inline bool use_xml_tokenizer() noexcept {
+            return !detail::is_set_to_false(getenv("OSMIUM_USE_XML_TOKENIZER"));
+        }
+
+        inline bool use_mmap_for_reading() noexcept {
+            return !detail::is_set_to_false(getenv("OSMIUM_USE_MMAP_FOR_READING"));
         }
 
         inline std::size_t get_max_queue_size(const char* queue_name, std::size_t default_value) noexcept {
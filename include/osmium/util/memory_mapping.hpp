@@ -33,17 +33,28 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <stdexcept>
+#include <string>
 #include <system_error>
 
+#include <osmium/thread/util.hpp>
 #include <osmium/util/compatibility.hpp>
 #include <osmium/util/file.hpp>
 
 #ifndef _WIN32
 # include <sys/mman.h>
+# ifdef __linux__
+#  include <sys/syscall.h>
+#  include <unistd.h>
+# endif
 #else
 # include <fcntl.h>
 # include <io.h>
@@ -55,6 +66,140 @@ namespace osmium {
 
     namespace util {
 
+        /**
+         * How anonymous memory mappings should use huge pages.
+         */
+        enum class huge_pages {
+            none        = 0, ///< Use normal pages.
+            transparent = 1, ///< Ask for transparent huge pages (madvise(MADV_HUGEPAGE)).
+            hugetlb     = 2  ///< Use pages from the huge page pool (MAP_HUGETLB), fall back to transparent if none are available.
+        };
+
+        /**
+         * How the memory of anonymous memory mappings should be placed on
+         * the NUMA nodes of the system.
+         */
+        enum class numa_policy {
+            none       = 0, ///< Use the default policy of the process.
+            interleave = 1, ///< Interleave pages over all NUMA nodes.
+            bind       = 2  ///< Put all pages on one NUMA node.
+        };
+
+        /**
+         * Options for anonymous memory mappings. They are only hints: If
+         * the system doesn't support huge pages or NUMA, or if the kernel
+         * refuses the request, the mapping is created with normal pages
+         * and the default policy.
+         *
+         * All these options are only available on Linux, on other systems
+         * they are ignored.
+         */
+        struct anonymous_mapping_options {
+
+            huge_pages pages = huge_pages::none;
+
+            numa_policy numa = numa_policy::none;
+
+            /// The NUMA node used with numa_policy::bind.
+            int numa_node = 0;
+
+        }; // struct anonymous_mapping_options
+
+        namespace detail {
+
+            inline huge_pages get_huge_pages(const char* value) noexcept {
+                if (value) {
+                    if (!std::strcmp(value, "transparent")) {
+                        return huge_pages::transparent;
+                    }
+                    if (!std::strcmp(value, "hugetlb")) {
+                        return huge_pages::hugetlb;
+                    }
+                }
+                return huge_pages::none;
+            }
+
+            /**
+             * Parse the NUMA policy. The value is either "interleave" or
+             * "bind:N" with the number N of the NUMA node.
+             */
+            inline numa_policy get_numa_policy(const char* value, int* node) noexcept {
+                assert(node);
+                if (value) {
+                    if (!std::strcmp(value, "interleave")) {
+                        return numa_policy::interleave;
+                    }
+                    if (!std::strncmp(value, "bind:", 5) && value[5] >= '0' && value[5] <= '9') {
+                        *node = std::atoi(value + 5);
+                        return numa_policy::bind;
+                    }
+                }
+                return numa_policy::none;
+            }
+
+            /**
+             * Get the mask of the NUMA nodes which are online from
+             * /sys/devices/system/node/online. Nodes which don't fit
+             * into the mask are left out. Returns 0 if this information
+             * is not available.
+             */
+            inline unsigned long get_online_numa_nodes_mask() {
+                static const unsigned long mask = []() -> unsigned long {
+                    unsigned long nodes = 0;
+#ifdef __linux__
+                    std::ifstream file{"/sys/devices/system/node/online"};
+                    std::string list;
+                    if (std::getline(file, list)) {
+                        for (const int node : osmium::thread::detail::parse_cpu_list(list)) {
+                            if (node >= 0 && static_cast<std::size_t>(node) < sizeof(nodes) * 8) {
+                                nodes |= 1ul << node;
+                            }
+                        }
+                    }
+#endif
+                    return nodes;
+                }();
+                return mask;
+            }
+
+        } // namespace detail
+
+        /**
+         * Get the options for anonymous memory mappings from the
+         * environment variables OSMIUM_HUGE_PAGES ("transparent" or
+         * "hugetlb") and OSMIUM_NUMA_POLICY ("interleave" or "bind:N").
+         */
+        inline anonymous_mapping_options default_anonymous_mapping_options() noexcept {
+            anonymous_mapping_options options;
+            options.pages = detail::get_huge_pages(std::getenv("OSMIUM_HUGE_PAGES"));
+            options.numa = detail::get_numa_policy(std::getenv("OSMIUM_NUMA_POLICY"), &options.numa_node);
+            return options;
+        }
+
+        /**
+         * Get the size of huge pages used for MAP_HUGETLB mappings. This
+         * reads /proc/meminfo on Linux and returns 2 MB if that fails or
+         * on other systems.
+         */
+        inline std::size_t get_huge_page_size() {
+            static const std::size_t size = []() -> std::size_t {
+#ifdef __linux__
+                std::ifstream file{"/proc/meminfo"};
+                std::string line;
+                while (std::getline(file, line)) {
+                    if (!line.compare(0, 13, "Hugepagesize:")) {
+                        const auto kb = std::strtoul(line.c_str() + 13, nullptr, 10);
+                        if (kb > 0) {
+                            return kb * 1024;
+                        }
+                    }
+                }
+#endif
+                return 2 * 1024 * 1024;
+            }();
+            return size;
+        }
+
         /**
          * Class for wrapping memory mapping system calls.
          *
@@ -107,6 +252,10 @@ namespace osmium {
             /// The size of the mapping
             std::size_t m_size;
 
+            /// Number of bytes mapped from the huge page pool, can be
+            /// larger than m_size (only used with huge_pages::hugetlb)
+            std::size_t m_capacity = 0;
+
             /// Offset into the file
             off_t m_offset;
 
@@ -116,6 +265,9 @@ namespace osmium {
             /// Mapping mode
             mapping_mode m_mapping_mode;
 
+            /// Huge page and NUMA options (anonymous mappings only)
+            anonymous_mapping_options m_options;
+
 #ifdef _WIN32
             HANDLE m_handle;
 #endif
@@ -148,6 +300,10 @@ namespace osmium {
             HANDLE get_handle() const noexcept;
             HANDLE create_file_mapping() const noexcept;
             void* map_view_of_file() const noexcept;
+#else
+            std::size_t mapped_length() const noexcept;
+            void* map_anonymous(std::size_t capacity);
+            void apply_options() const;
 #endif
 
             int resize_fd(int fd) {
@@ -183,6 +339,16 @@ namespace osmium {
              */
             MemoryMapping(std::size_t size, mapping_mode mode, int fd=-1, off_t offset=0);
 
+            /**
+             * Create anonymous memory mapping of given size using huge
+             * pages and/or a NUMA policy as set in the options.
+             *
+             * @param size Size of the mapping in bytes
+             * @param options Huge page and NUMA options
+             * @throws std::system_error if the mapping fails
+             */
+            MemoryMapping(std::size_t size, const anonymous_mapping_options& options);
+
             /**
              * @deprecated
              * For backwards compatibility only. Use the constructor taking
@@ -236,12 +402,47 @@ namespace osmium {
              * systems it will unmap and remap the memory. This can only be
              * done for file-based mappings, not anonymous mappings!
              *
+             * Anonymous mappings with pages from the huge page pool can't
+             * be remapped, they are copied instead. To make this rare,
+             * they grow to at least twice their old capacity and don't
+             * shrink.
+             *
              * @param new_size Number of bytes to resize to (must be > 0).
              *
              * @throws std::system_error if the remapping fails.
              */
             void resize(std::size_t new_size);
 
+            /**
+             * Tell the operating system that the given byte range of the
+             * mapping will be accessed soon, so that it can read it in
+             * ahead of time (madvise(MADV_WILLNEED)). This is only a hint,
+             * errors are ignored. Does nothing on Windows.
+             *
+             * @param offset Offset of the range from the start of the
+             *               mapping in bytes.
+             * @param length Length of the range in bytes.
+             */
+            void will_need(std::size_t offset, std::size_t length) const noexcept;
+
+            /**
+             * The options this mapping uses. If huge pages from the pool
+             * (huge_pages::hugetlb) were requested but are not available,
+             * this will say huge_pages::transparent.
+             */
+            const anonymous_mapping_options& options() const noexcept {
+                return m_options;
+            }
+
+            /**
+             * The number of bytes of this mapping that are currently backed
+             * by huge pages. For transparent huge pages this is read from
+             * /proc/self/smaps and can include memory of neighbouring
+             * mappings the kernel merged with this one. Returns 0 on
+             * systems other than Linux.
+             */
+            std::size_t huge_page_bytes() const;
+
             /**
              * In a boolean context a MemoryMapping is true when it is a valid
              * existing mapping.
@@ -308,6 +509,10 @@ namespace osmium {
                 MemoryMapping(size, mapping_mode::write_private) {
             }
 
+            AnonymousMemoryMapping(std::size_t size, const anonymous_mapping_options& options) :
+                MemoryMapping(size, options) {
+            }
+
 #ifndef __linux__
             /**
              * On systems other than Linux anonymous mappings can not be
@@ -344,6 +549,18 @@ namespace osmium {
                 m_mapping(sizeof(T) * size, MemoryMapping::mapping_mode::write_private) {
             }
 
+            /**
+             * Create anonymous typed memory mapping of given size using
+             * huge pages and/or a NUMA policy as set in the options.
+             *
+             * @param size Number of objects of type T to be mapped
+             * @param options Huge page and NUMA options
+             * @throws std::system_error if the mapping fails
+             */
+            TypedMemoryMapping(std::size_t size, const anonymous_mapping_options& options) :
+                m_mapping(sizeof(T) * size, options) {
+            }
+
             /**
              * Create file-backed memory mapping of given size. The file must
              * contain at least `sizeof(T) * size` bytes!
@@ -417,6 +634,32 @@ namespace osmium {
                 m_mapping.resize(sizeof(T) * new_size);
             }
 
+            /**
+             * Tell the operating system that the objects in the given range
+             * will be accessed soon. See MemoryMapping::will_need().
+             *
+             * @param first Index of the first object in the range.
+             * @param count Number of objects in the range.
+             */
+            void will_need(std::size_t first, std::size_t count) const noexcept {
+                m_mapping.will_need(sizeof(T) * first, sizeof(T) * count);
+            }
+
+            /**
+             * The options this mapping uses. See MemoryMapping::options().
+             */
+            const anonymous_mapping_options& options() const noexcept {
+                return m_mapping.options();
+            }
+
+            /**
+             * The number of bytes of this mapping that are currently backed
+             * by huge pages. See MemoryMapping::huge_page_bytes().
+             */
+            std::size_t huge_page_bytes() const {
+                return m_mapping.huge_page_bytes();
+            }
+
             /**
              * In a boolean context a TypedMemoryMapping is true when it is
              * a valid existing mapping.
@@ -496,6 +739,10 @@ namespace osmium {
                 TypedMemoryMapping<T>(size) {
             }
 
+            AnonymousTypedMemoryMapping(std::size_t size, const anonymous_mapping_options& options) :
+                TypedMemoryMapping<T>(size, options) {
+            }
+
 #ifndef __linux__
             /**
              * On systems other than Linux anonymous mappings can not be
@@ -555,6 +802,7 @@ inline osmium::util::MemoryMapping::MemoryMapping(std::size_t size, mapping_mode
     m_offset(offset),
     m_fd(resize_fd(fd)),
     m_mapping_mode(mode),
+    m_options(),
     m_addr(::mmap(nullptr, m_size, get_protection(), get_flags(), m_fd, m_offset)) {
     assert(!(fd == -1 && mode == mapping_mode::readonly));
     if (!is_valid()) {
@@ -562,11 +810,26 @@ inline osmium::util::MemoryMapping::MemoryMapping(std::size_t size, mapping_mode
     }
 }
 
+inline osmium::util::MemoryMapping::MemoryMapping(std::size_t size, const anonymous_mapping_options& options) :
+    m_size(check_size(size)),
+    m_offset(0),
+    m_fd(-1),
+    m_mapping_mode(mapping_mode::write_private),
+    m_options(options),
+    m_addr(map_anonymous(m_size)) {
+    if (!is_valid()) {
+        throw std::system_error{errno, std::system_category(), "mmap failed"};
+    }
+    apply_options();
+}
+
 inline osmium::util::MemoryMapping::MemoryMapping(MemoryMapping&& other) noexcept :
     m_size(other.m_size),
+    m_capacity(other.m_capacity),
     m_offset(other.m_offset),
     m_fd(other.m_fd),
     m_mapping_mode(other.m_mapping_mode),
+    m_options(other.m_options),
     m_addr(other.m_addr) {
     other.make_invalid();
 }
@@ -574,9 +837,11 @@ inline osmium::util::MemoryMapping::MemoryMapping(MemoryMapping&& other) noexcep
 inline osmium::util::MemoryMapping& osmium::util::MemoryMapping::operator=(osmium::util::MemoryMapping&& other) noexcept {
     unmap();
     m_size         = other.m_size;
+    m_capacity     = other.m_capacity;
     m_offset       = other.m_offset;
     m_fd           = other.m_fd;
     m_mapping_mode = other.m_mapping_mode;
+    m_options      = other.m_options;
     m_addr         = other.m_addr;
     other.make_invalid();
     return *this;
@@ -584,7 +849,7 @@ inline osmium::util::MemoryMapping& osmium::util::MemoryMapping::operator=(osmiu
 
 inline void osmium::util::MemoryMapping::unmap() {
     if (is_valid()) {
-        if (::munmap(m_addr, m_size) != 0) {
+        if (::munmap(m_addr, mapped_length()) != 0) {
             throw std::system_error{errno, std::system_category(), "munmap failed"};
         }
         make_invalid();
@@ -595,11 +860,39 @@ inline void osmium::util::MemoryMapping::resize(std::size_t new_size) {
     assert(new_size > 0 && "can not resize to zero size");
     if (m_fd == -1) { // anonymous mapping
 #ifdef __linux__
-        m_addr = ::mremap(m_addr, m_size, new_size, MREMAP_MAYMOVE);
-        if (!is_valid()) {
-            throw std::system_error{errno, std::system_category(), "mremap failed"};
+        if (m_options.pages == huge_pages::hugetlb) {
+            if (new_size <= m_capacity) {
+                m_size = new_size;
+                return;
+            }
+            // mremap() doesn't work with pages from the huge page pool,
+            // so create a new mapping and copy the data over. The
+            // capacity is at least doubled, so that growing the mapping
+            // in small steps doesn't copy the data every time.
+            const std::size_t old_size = m_size;
+            const std::size_t old_capacity = m_capacity;
+            const anonymous_mapping_options old_options = m_options;
+            void* old_addr = m_addr;
+            m_size = new_size;
+            m_addr = map_anonymous(std::max(new_size, old_capacity * 2));
+            if (!is_valid()) {
+                const int error = errno;
+                m_size = old_size;
+                m_capacity = old_capacity;
+                m_options = old_options;
+                m_addr = old_addr;
+                throw std::system_error{error, std::system_category(), "mmap (remap) failed"};
+            }
+            std::memcpy(m_addr, old_addr, old_size);
+            ::munmap(old_addr, old_capacity);
+        } else {
+            m_addr = ::mremap(m_addr, m_size, new_size, MREMAP_MAYMOVE);
+            if (!is_valid()) {
+                throw std::system_error{errno, std::system_category(), "mremap failed"};
+            }
+            m_size = new_size;
         }
-        m_size = new_size;
+        apply_options();
 #else
         assert(false && "can't resize anonymous mappings on non-linux systems");
 #endif
@@ -614,6 +907,121 @@ inline void osmium::util::MemoryMapping::resize(std::size_t new_size) {
     }
 }
 
+inline void osmium::util::MemoryMapping::will_need(std::size_t offset, std::size_t length) const noexcept {
+    if (!is_valid() || offset >= m_size || length == 0) {
+        return;
+    }
+    if (length > m_size - offset) {
+        length = m_size - offset;
+    }
+
+    // madvise() needs a page-aligned address
+    const std::size_t pagesize = osmium::util::get_pagesize();
+    const std::size_t aligned_offset = offset - (offset % pagesize);
+
+    // Errors are ignored, this is only a hint.
+    ::madvise(static_cast<char*>(m_addr) + aligned_offset, length + (offset - aligned_offset), MADV_WILLNEED);
+}
+
+inline std::size_t osmium::util::MemoryMapping::mapped_length() const noexcept {
+    return m_options.pages == huge_pages::hugetlb ? m_capacity : m_size;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+
+// Mappings from the huge page pool always contain whole huge pages, so
+// the capacity is rounded up. Other mappings always have m_size bytes.
+inline void* osmium::util::MemoryMapping::map_anonymous(std::size_t capacity) {
+#ifdef MAP_HUGETLB
+    if (m_options.pages == huge_pages::hugetlb) {
+        const std::size_t huge_page_size = get_huge_page_size();
+        const std::size_t length = (capacity + huge_page_size - 1) / huge_page_size * huge_page_size;
+        void* addr = ::mmap(nullptr, length, get_protection(), get_flags() | MAP_HUGETLB, -1, 0);
+        if (addr != MAP_FAILED) {
+            m_capacity = length;
+            return addr;
+        }
+    }
+#endif
+    // The huge page pool is empty (or not available on this system).
+    if (m_options.pages == huge_pages::hugetlb) {
+        m_options.pages = huge_pages::transparent;
+    }
+    return ::mmap(nullptr, m_size, get_protection(), get_flags(), -1, 0);
+}
+
+#pragma GCC diagnostic pop
+
+inline void osmium::util::MemoryMapping::apply_options() const {
+    // Errors are ignored, these are only hints.
+#ifdef MADV_HUGEPAGE
+    if (m_options.pages == huge_pages::transparent) {
+        ::madvise(m_addr, m_size, MADV_HUGEPAGE);
+    }
+#endif
+#if defined(__linux__) && defined(SYS_mbind)
+    if (m_options.numa != numa_policy::none) {
+        // Values from <linux/mempolicy.h>. Calling the system call
+        // directly means we don't need libnuma.
+        constexpr const int mpol_bind = 2;
+        constexpr const int mpol_interleave = 3;
+        constexpr const unsigned long max_node = sizeof(unsigned long) * 8;
+
+        // For interleave all nodes which are online are used.
+        unsigned long mask = detail::get_online_numa_nodes_mask();
+        int mode = mpol_interleave;
+        if (m_options.numa == numa_policy::bind) {
+            if (m_options.numa_node < 0 || static_cast<unsigned long>(m_options.numa_node) >= max_node) {
+                return;
+            }
+            mask = 1ul << m_options.numa_node;
+            mode = mpol_bind;
+        }
+        if (mask == 0) {
+            return;
+        }
+
+        // The kernel expects the number of bits in the mask plus one.
+        ::syscall(SYS_mbind, m_addr, mapped_length(), mode, &mask, max_node + 1, 0);
+    }
+#endif
+}
+
+inline std::size_t osmium::util::MemoryMapping::huge_page_bytes() const {
+    if (!is_valid()) {
+        return 0;
+    }
+    if (m_options.pages == huge_pages::hugetlb) {
+        return mapped_length();
+    }
+#ifdef __linux__
+    const auto first = reinterpret_cast<std::uintptr_t>(m_addr);
+    const auto last = first + m_size;
+
+    // Each memory area in smaps starts with a line containing its address
+    // range ("7f12a0000000-7f12a8000000 rw-p ..."), followed by lines with
+    // details, among them the amount of transparent huge pages.
+    std::size_t bytes = 0;
+    bool in_mapping = false;
+    std::ifstream file{"/proc/self/smaps"};
+    std::string line;
+    while (std::getline(file, line)) {
+        char* end = nullptr;
+        const auto start = std::strtoull(line.c_str(), &end, 16);
+        if (end != line.c_str() && *end == '-') {
+            const auto stop = std::strtoull(end + 1, nullptr, 16);
+            in_mapping = start < last && stop > first;
+        } else if (in_mapping && !line.compare(0, 14, "AnonHugePages:")) {
+            bytes += static_cast<std::size_t>(std::strtoull(line.c_str() + 14, nullptr, 10)) * 1024;
+        }
+    }
+    return std::min(bytes, m_size);
+#else
+    return 0;
+#endif
+}
+
 #else
 
 // =========== Windows implementation =============
@@ -712,6 +1120,7 @@ inline osmium::util::MemoryMapping::MemoryMapping(std::size_t size, MemoryMappin
     m_offset(offset),
     m_fd(resize_fd(fd)),
     m_mapping_mode(mode),
+    m_options(),
     m_handle(create_file_mapping()),
     m_addr(nullptr) {
 
@@ -730,6 +1139,7 @@ inline osmium::util::MemoryMapping::MemoryMapping(MemoryMapping&& other) noexcep
     m_offset(other.m_offset),
     m_fd(other.m_fd),
     m_mapping_mode(other.m_mapping_mode),
+    m_options(other.m_options),
     m_handle(std::move(other.m_handle)),
     m_addr(other.m_addr) {
     other.make_invalid();
@@ -742,6 +1152,7 @@ inline osmium::util::MemoryMapping& osmium::util::MemoryMapping::operator=(osmiu
     m_offset       = other.m_offset;
     m_fd           = other.m_fd;
     m_mapping_mode = other.m_mapping_mode;
+    m_options      = other.m_options;
     m_handle       = std::move(other.m_handle);
     m_addr         = other.m_addr;
     other.make_invalid();
@@ -765,6 +1176,17 @@ inline void osmium::util::MemoryMapping::unmap() {
     }
 }
 
+inline osmium::util::MemoryMapping::MemoryMapping(std::size_t size, const anonymous_mapping_options& /*options*/) :
+    MemoryMapping(size, mapping_mode::write_private) {
+}
+
+inline void osmium::util::MemoryMapping::will_need(std::size_t /*offset*/, std::size_t /*length*/) const noexcept {
+}
+
+inline std::size_t osmium::util::MemoryMapping::huge_page_bytes() const {
+    return 0;
+}
+
 inline void osmium::util::MemoryMapping::resize(std::size_t new_size) {
     unmap();
 
@@ -90,7 +90,12 @@ static header_buffer_type parse_xml(std::string input) {
         output_queue,
         header_promise,
         osmium::osm_entity_bits::all,
-        osmium::io::read_meta::yes
+        osmium::io::read_meta::yes,
+        nullptr,
+        nullptr,
+        osmium::io::blob_filter{},
+        nullptr,
+        osmium::io::decoded_buffer_callback{}
     };
     osmium::io::detail::XMLParser parser{args};
     parser.parse();
@@ -1,6 +1,17 @@
 
+#include "catch.hpp"
+
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <string>
+#include <vector>
 
 inline std::string with_data_dir(const char* filename) {
     const char* data_dir = getenv("OSMIUM_TEST_DATA_DIR");
@@ -16,3 +27,86 @@ inline std::string with_data_dir(const char* filename) {
     return result;
 }
 
+inline std::string read_whole_file(const std::string& filename) {
+    std::ifstream in{filename, std::ios::binary};
+    return std::string{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+}
+
+// Read everything from a decompressor until it returns an empty string.
+template <typename TDecompressor>
+std::string read_all(TDecompressor& decompressor) {
+    std::string all;
+    for (std::string data = decompressor.read(); !data.empty(); data = decompressor.read()) {
+        all += data;
+    }
+    return all;
+}
+
+// Text data which compresses well.
+inline std::string make_test_data(int lines) {
+    std::string data;
+    for (int i = 0; i < lines; ++i) {
+        data += "line " + std::to_string(i) + "\n";
+    }
+    return data;
+}
+
+// Random digits don't compress well, so the compressed file is large
+// enough to be split into several blocks.
+inline std::string make_random_data(int lines) {
+    std::string data;
+    unsigned int state = 42;
+    for (int i = 0; i < lines; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            state = state * 1103515245u + 12345u;
+            data += std::to_string(state >> 8u);
+            data += ' ';
+        }
+        data += '\n';
+    }
+    return data;
+}
+
+// Copies the string to all possible offsets from a 16 byte boundary and at
+// the end of a buffer so that all code paths in the vector versions of the
+// scan functions are exercised.
+template <typename TFunc, typename TScalarFunc>
+void check_at_all_offsets(const std::string& str, TFunc func, TScalarFunc scalar_func) {
+    for (std::size_t offset = 0; offset < 32; ++offset) {
+        std::vector<char> buffer(offset + str.size() + 1, 'x');
+        char* s = buffer.data() + offset;
+        std::memcpy(s, str.c_str(), str.size() + 1);
+        REQUIRE(func(s) == scalar_func(s));
+    }
+}
+
+// Location for the given id to fill location indexes with. Mostly close to
+// the location of the previous id with some jumps thrown in.
+inline osmium::Location location_for(osmium::unsigned_object_id_type id) {
+    if (id % 97 == 0) {
+        return osmium::Location{static_cast<int32_t>(static_cast<int64_t>(id * 7919 % 3600000000ull) - 1800000000),
+                                static_cast<int32_t>(static_cast<int64_t>(id * 104729 % 1800000000ull) - 900000000)};
+    }
+    return osmium::Location{static_cast<int32_t>(id * 13 % 100000000), static_cast<int32_t>(id % 50000000) - 25000000};
+}
+
+// Set the locations from location_for() for all ids from 1 to max_id - 1
+// for which the predicate returns true. Returns the number of locations set.
+template <typename TIndex, typename TPredicate>
+std::size_t fill_location_index(TIndex& index, osmium::unsigned_object_id_type max_id, TPredicate&& predicate) {
+    std::size_t count = 0;
+    for (osmium::unsigned_object_id_type id = 1; id < max_id; ++id) {
+        if (predicate(id)) {
+            index.set(id, location_for(id));
+            ++count;
+        }
+    }
+    return count;
+}
+
+template <typename TIndex>
+std::size_t fill_location_index(TIndex& index, osmium::unsigned_object_id_type max_id) {
+    return fill_location_index(index, max_id, [](osmium::unsigned_object_id_type /*id*/) {
+        return true;
+    });
+}
@@ -0,0 +1,183 @@
+#include "catch.hpp"
+#include "utils.hpp"
+
+#include <osmium/builder/attr.hpp>
+#include <osmium/handler/node_locations_for_ways.hpp>
+#include <osmium/index/map/dense_mem_array.hpp>
+#include <osmium/index/map/sparse_mem_array.hpp>
+#include <osmium/io/opl_input.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/way.hpp>
+#include <osmium/thread/pool.hpp>
+#include <osmium/visitor.hpp>
+
+#include <atomic>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace osmium::builder::attr;
+
+using dense_index_type = osmium::index::map::DenseMemArray<osmium::unsigned_object_id_type, osmium::Location>;
+using sparse_index_type = osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmium::Location>;
+
+// Create a buffer with nodes 1 to num_nodes and ways referencing them. The
+// nodes are followed by num_ways ways with 10 nodes each, the first node of
+// each way is missing if with_missing is set.
+static osmium::memory::Buffer create_buffer(int num_nodes, int num_ways, bool with_missing = false) {
+    osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+
+    for (int i = 1; i <= num_nodes; ++i) {
+        osmium::builder::add_node(buffer, _id(i), _location(location_for(i)));
+    }
+
+    for (int i = 1; i <= num_ways; ++i) {
+        std::vector<osmium::object_id_type> nodes;
+        if (with_missing) {
+            nodes.push_back(num_nodes + i);
+        }
+        for (int j = 0; j < 10; ++j) {
+            nodes.push_back((i * 7919 + j * 13) % num_nodes + 1);
+        }
+        osmium::builder::add_way(buffer, _id(i), _nodes(nodes));
+    }
+
+    return buffer;
+}
+
+static void check_locations(const osmium::memory::Buffer& buffer, osmium::object_id_type max_id) {
+    for (const auto& way : buffer.select<osmium::Way>()) {
+        for (const auto& node_ref : way.nodes()) {
+            if (node_ref.ref() <= max_id) {
+                REQUIRE(node_ref.location() == location_for(node_ref.positive_ref()));
+            } else {
+                REQUIRE_FALSE(node_ref.location());
+            }
+        }
+    }
+}
+
+TEST_CASE("NodeLocationsForWays: handle small buffer") {
+    osmium::memory::Buffer buffer{10240, osmium::memory::Buffer::auto_grow::yes};
+    osmium::builder::add_node(buffer, _id(1), _location(1.0, 2.0));
+    osmium::builder::add_node(buffer, _id(2), _location(3.0, 4.0));
+    osmium::builder::add_way(buffer, _id(10), _nodes({1, 2, 1}));
+    osmium::builder::add_node(buffer, _id(-3), _location(5.0, 6.0));
+    osmium::builder::add_way(buffer, _id(11), _nodes({2, -3}));
+    osmium::builder::add_relation(buffer, _id(20), _member(osmium::item_type::way, 10));
+
+    dense_index_type index_pos;
+    dense_index_type index_neg;
+    osmium::handler::NodeLocationsForWays<dense_index_type, dense_index_type> handler{index_pos, index_neg};
+
+    osmium::thread::Pool pool{2};
+    handler.handle_buffer(buffer, pool);
+
+    auto it = buffer.select<osmium::Way>().cbegin();
+    REQUIRE(it->nodes()[0].location() == osmium::Location(1.0, 2.0));
+    REQUIRE(it->nodes()[1].location() == osmium::Location(3.0, 4.0));
+    REQUIRE(it->nodes()[2].location() == osmium::Location(1.0, 2.0));
+    ++it;
+    REQUIRE(it->nodes()[0].location() == osmium::Location(3.0, 4.0));
+    REQUIRE(it->nodes()[1].location() == osmium::Location(5.0, 6.0));
+}
+
+TEST_CASE("NodeLocationsForWays: handle large buffer in pool threads") {
+    const int num_nodes = 100000;
+    auto buffer = create_buffer(num_nodes, 20000);
+
+    sparse_index_type index;
+    osmium::handler::NodeLocationsForWays<sparse_index_type> handler{index};
+
+    osmium::thread::Pool pool{4};
+    handler.handle_buffer(buffer, pool);
+
+    check_locations(buffer, num_nodes);
+}
+
+TEST_CASE("NodeLocationsForWays: handle buffer gives same result as way()") {
+    const int num_nodes = 50000;
+    auto buffer1 = create_buffer(num_nodes, 10000);
+    auto buffer2 = create_buffer(num_nodes, 10000);
+
+    dense_index_type index1;
+    osmium::handler::NodeLocationsForWays<dense_index_type> handler1{index1};
+    osmium::apply(buffer1, handler1);
+
+    dense_index_type index2;
+    osmium::handler::NodeLocationsForWays<dense_index_type> handler2{index2};
+    osmium::thread::Pool pool{3};
+    handler2.handle_buffer(buffer2, pool);
+
+    auto it = buffer2.select<osmium::Way>().cbegin();
+    for (const auto& way : buffer1.select<osmium::Way>()) {
+        REQUIRE(way.nodes().size() == it->nodes().size());
+        for (std::size_t i = 0; i < way.nodes().size(); ++i) {
+            REQUIRE(way.nodes()[i].location() == it->nodes()[i].location());
+        }
+        ++it;
+    }
+}
+
+TEST_CASE("NodeLocationsForWays: handle buffer with missing locations") {
+    const int num_nodes = 50000;
+    auto buffer = create_buffer(num_nodes, 10000, true);
+
+    dense_index_type index;
+    osmium::handler::NodeLocationsForWays<dense_index_type> handler{index};
+    osmium::thread::Pool pool{4};
+
+    SECTION("throws by default") {
+        REQUIRE_THROWS_AS(handler.handle_buffer(buffer, pool), const osmium::not_found&);
+    }
+
+    SECTION("errors can be ignored") {
+        handler.ignore_errors();
+        handler.handle_buffer(buffer, pool);
+        check_locations(buffer, num_nodes);
+    }
+}
+
+// Locations which are written exactly with the 6 decimal places std::to_string() uses.
+static osmium::Location opl_location_for(int id) {
+    return osmium::Location{(id % 1800) * 1000000, -(id % 900) * 1000000};
+}
+
+TEST_CASE("NodeLocationsForWays: fill index from decoded buffer callback") {
+    const int num_nodes = 100000;
+    std::string data;
+    for (int i = 1; i <= num_nodes; ++i) {
+        const auto location = opl_location_for(i);
+        data += "n" + std::to_string(i) + " x" + std::to_string(location.lon()) + " y" + std::to_string(location.lat()) + "\n";
+    }
+    for (int i = 1; i <= 1000; ++i) {
+        data += "w" + std::to_string(i) + " Nn" + std::to_string(i) + ",n" + std::to_string(num_nodes + 1 - i) + "\n";
+    }
+
+    dense_index_type index;
+    osmium::handler::NodeLocationsForWays<dense_index_type> handler{index};
+    handler.prepare_concurrent_set(num_nodes);
+
+    std::atomic<int> count{0};
+    osmium::thread::Pool pool{4};
+    osmium::io::Reader reader{osmium::io::File{data.data(), data.size(), "opl"}, pool,
+        osmium::io::decoded_buffer_callback{[&handler, &count](const osmium::memory::Buffer& buffer) {
+            handler.nodes_concurrently(buffer);
+            count += static_cast<int>(std::distance(buffer.select<osmium::Node>().cbegin(), buffer.select<osmium::Node>().cend()));
+        }}};
+
+    int ways = 0;
+    while (auto buffer = reader.read()) {
+        for (auto& way : buffer.select<osmium::Way>()) {
+            handler.way(way);
+            ++ways;
+            REQUIRE(way.nodes()[0].location() == opl_location_for(ways));
+            REQUIRE(way.nodes()[1].location() == opl_location_for(num_nodes + 1 - ways));
+        }
+    }
+    reader.close();
+
+    REQUIRE(count == num_nodes);
+    REQUIRE(ways == 1000);
+}
@@ -0,0 +1,160 @@
+#include "catch.hpp"
+#include "utils.hpp"
+
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <osmium/index/map/compressed_mem.hpp>
+#include <osmium/index/node_locations_map.hpp>
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using index_type = osmium::index::map::CompressedMem<osmium::unsigned_object_id_type, osmium::Location>;
+
+TEST_CASE("CompressedMem: empty index") {
+    index_type index;
+
+    REQUIRE(index.size() == 0);
+    REQUIRE(index.get_noexcept(0) == osmium::Location{});
+    REQUIRE(index.get_noexcept(1000000) == osmium::Location{});
+    REQUIRE_THROWS_AS(index.get(17), const osmium::not_found&);
+}
+
+TEST_CASE("CompressedMem: set and get few locations") {
+    const osmium::Location loc1{1.2, 4.5};
+    const osmium::Location loc2{3.5, -7.2};
+    const osmium::Location loc3{-179.9999999, 89.9999999};
+
+    index_type index;
+    index.set(12, loc1);
+    index.set(3, loc2);
+    index.set(5000000000ull, loc3);
+
+    REQUIRE(index.size() == 3);
+
+    REQUIRE(index.get(12) == loc1);
+    REQUIRE(index.get(3) == loc2);
+    REQUIRE(index.get(5000000000ull) == loc3);
+    REQUIRE(index.get_noexcept(12) == loc1);
+
+    REQUIRE(index.get_noexcept(0) == osmium::Location{});
+    REQUIRE(index.get_noexcept(13) == osmium::Location{});
+    REQUIRE(index.get_noexcept(4999999999ull) == osmium::Location{});
+    REQUIRE_THROWS_WITH(index.get(1), "id 1 not found");
+
+    index.clear();
+
+    REQUIRE(index.size() == 0);
+    REQUIRE(index.get_noexcept(12) == osmium::Location{});
+    REQUIRE(index.get_noexcept(3) == osmium::Location{});
+    REQUIRE(index.get_noexcept(5000000000ull) == osmium::Location{});
+}
+
+TEST_CASE("CompressedMem: many locations in order") {
+    index_type index;
+
+    const osmium::unsigned_object_id_type max_id = 200000;
+    const std::size_t count = fill_location_index(index, max_id, [](osmium::unsigned_object_id_type id) {
+        return id % 5 != 0 && id % 1000 < 700;
+    });
+
+    REQUIRE(index.size() == count);
+
+    // Uses less than 8 bytes per location (dense index would need that).
+    REQUIRE(index.used_memory() < count * 8);
+
+    for (osmium::unsigned_object_id_type id = 0; id < max_id + 1000; ++id) {
+        if (id != 0 && id < max_id && id % 5 != 0 && id % 1000 < 700) {
+            REQUIRE(index.get_noexcept(id) == location_for(id));
+        } else {
+            REQUIRE(index.get_noexcept(id) == osmium::Location{});
+        }
+    }
+
+    // random access
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<osmium::unsigned_object_id_type> dist{1, max_id - 1};
+    for (int i = 0; i < 10000; ++i) {
+        const auto id = dist(gen);
+        if (id % 5 != 0 && id % 1000 < 700) {
+            REQUIRE(index.get(id) == location_for(id));
+        }
+    }
+}
+
+TEST_CASE("CompressedMem: locations in random order and overwritten") {
+    index_type index;
+
+    std::vector<osmium::unsigned_object_id_type> ids;
+    for (osmium::unsigned_object_id_type id = 1; id <= 20000; ++id) {
+        ids.push_back(id);
+    }
+    std::shuffle(ids.begin(), ids.end(), std::mt19937{17});
+
+    // Set the first half to a wrong location first, then to the right one.
+    for (std::size_t i = 0; i < ids.size() / 2; ++i) {
+        index.set(ids[i], osmium::Location{1, 1});
+    }
+    REQUIRE(index.get(ids[0]) == osmium::Location(1, 1));
+    for (const auto id : ids) {
+        index.set(id, location_for(id));
+    }
+
+    REQUIRE(index.size() == ids.size());
+
+    for (const auto id : ids) {
+        REQUIRE(index.get(id) == location_for(id));
+    }
+
+    // Remove some locations again.
+    for (osmium::unsigned_object_id_type id = 1; id <= 20000; id += 3) {
+        index.set(id, osmium::Location{});
+    }
+    for (osmium::unsigned_object_id_type id = 1; id <= 20000; ++id) {
+        if (id % 3 == 1) {
+            REQUIRE(index.get_noexcept(id) == osmium::Location{});
+        } else {
+            REQUIRE(index.get(id) == location_for(id));
+        }
+    }
+}
+
+TEST_CASE("CompressedMem: read from several threads") {
+    index_type index;
+
+    const osmium::unsigned_object_id_type max_id = 100000;
+    fill_location_index(index, max_id);
+
+    std::vector<std::future<bool>> results;
+    for (int t = 0; t < 4; ++t) {
+        results.push_back(std::async(std::launch::async, [&index, t]() {
+            for (osmium::unsigned_object_id_type id = 1 + t; id < max_id; id += 4) {
+                if (index.get_noexcept(id) != location_for(id)) {
+                    return false;
+                }
+            }
+            return true;
+        }));
+    }
+
+    for (auto& result : results) {
+        REQUIRE(result.get());
+    }
+}
+
+TEST_CASE("CompressedMem: registered with map factory") {
+    using map_type = osmium::index::map::Map<osmium::unsigned_object_id_type, osmium::Location>;
+    const auto& map_factory = osmium::index::MapFactory<osmium::unsigned_object_id_type, osmium::Location>::instance();
+
+    REQUIRE(map_factory.has_map_type("compressed_mem"));
+
+    std::unique_ptr<map_type> index = map_factory.create_map("compressed_mem");
+    index->set(17, osmium::Location{1.5, 2.5});
+    REQUIRE(index->get(17) == osmium::Location(1.5, 2.5));
+}
+
@@ -0,0 +1,78 @@
+#include "catch.hpp"
+#include "utils.hpp"
+
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <osmium/index/map/dense_mem_array.hpp>
+#include <osmium/index/map/dense_mmap_array.hpp>
+#include <osmium/index/map/flex_mem.hpp>
+#include <osmium/index/map/sparse_mem_array.hpp>
+
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+// Fill the index from four threads each writing every fourth id and
+// check the result.
+template <typename TIndex>
+void test_concurrent_set(TIndex& index) {
+    const osmium::unsigned_object_id_type max_id = 300000;
+
+    index.prepare_concurrent_set(max_id);
+
+    std::vector<std::future<void>> results;
+    for (osmium::unsigned_object_id_type t = 0; t < 4; ++t) {
+        results.push_back(std::async(std::launch::async, [&index, t, max_id]() {
+            for (osmium::unsigned_object_id_type id = 1 + t; id <= max_id; id += 4) {
+                if (id % 10 != 0) {
+                    index.set_concurrently(id, location_for(id));
+                }
+            }
+        }));
+    }
+    for (auto& result : results) {
+        result.get();
+    }
+
+    for (osmium::unsigned_object_id_type id = 0; id <= max_id; ++id) {
+        if (id != 0 && id % 10 != 0) {
+            REQUIRE(index.get(id) == location_for(id));
+        } else {
+            REQUIRE(index.get_noexcept(id) == osmium::Location{});
+        }
+    }
+
+    REQUIRE_THROWS_AS(index.set_concurrently(max_id + 1000000, osmium::Location{}), const std::out_of_range&);
+
+    // Normal set still works and grows the index.
+    index.set(max_id + 1000000, location_for(17));
+    REQUIRE(index.get(max_id + 1000000) == location_for(17));
+}
+
+TEST_CASE("Concurrent set: DenseMemArray") {
+    osmium::index::map::DenseMemArray<osmium::unsigned_object_id_type, osmium::Location> index;
+    test_concurrent_set(index);
+}
+
+#ifdef __linux__
+TEST_CASE("Concurrent set: DenseMmapArray") {
+    osmium::index::map::DenseMmapArray<osmium::unsigned_object_id_type, osmium::Location> index;
+    test_concurrent_set(index);
+}
+#endif
+
+TEST_CASE("Concurrent set: FlexMem") {
+    osmium::index::map::FlexMem<osmium::unsigned_object_id_type, osmium::Location> index;
+    index.set(5, location_for(5));
+    REQUIRE_FALSE(index.is_dense());
+
+    test_concurrent_set(index);
+    REQUIRE(index.is_dense());
+}
+
+TEST_CASE("Concurrent set: not supported by sparse index") {
+    osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmium::Location> index;
+    REQUIRE_THROWS_AS(index.prepare_concurrent_set(1000), const std::runtime_error&);
+    REQUIRE_THROWS_AS(index.set_concurrently(17, osmium::Location{}), const std::runtime_error&);
+}
@@ -0,0 +1,125 @@
+#include "catch.hpp"
+#include "utils.hpp"
+
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <osmium/index/map/dense_file_array.hpp>
+#include <osmium/index/map/dense_mem_array.hpp>
+#include <osmium/index/map/dense_mmap_array.hpp>
+#include <osmium/index/map/sparse_mem_array.hpp>
+#include <osmium/util/file.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+template <typename TIndex>
+void fill_index(TIndex& index) {
+    fill_location_index(index, 100000, [](osmium::unsigned_object_id_type id) {
+        return id % 7 != 0;
+    });
+}
+
+// The ids include some which are not in the index and some beyond the
+// end of the index.
+static std::vector<osmium::unsigned_object_id_type> get_ids(bool sorted) {
+    std::vector<osmium::unsigned_object_id_type> ids;
+    std::mt19937 gen{23};
+    std::uniform_int_distribution<osmium::unsigned_object_id_type> dist{0, 120000};
+    for (int i = 0; i < 20000; ++i) {
+        ids.push_back(dist(gen));
+    }
+    if (sorted) {
+        std::sort(ids.begin(), ids.end());
+    }
+    return ids;
+}
+
+template <typename TIndex>
+void check_batch(const TIndex& index, bool sorted) {
+    const auto ids = get_ids(sorted);
+    std::vector<osmium::Location> values(ids.size());
+    index.get_noexcept_batch(ids.data(), values.data(), ids.size());
+
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        REQUIRE(values[i] == index.get_noexcept(ids[i]));
+    }
+}
+
+template <typename TIndex>
+void test_get_batch(TIndex& index) {
+    fill_index(index);
+
+    SECTION("sorted ids") {
+        check_batch(index, true);
+    }
+
+    SECTION("unsorted ids") {
+        check_batch(index, false);
+    }
+
+    SECTION("no ids") {
+        index.get_noexcept_batch(nullptr, nullptr, 0);
+    }
+}
+
+// Locations of consecutive ids are next to each other, so sorted lookups
+// touch each page only once.
+template <typename TIndex>
+void test_pages_touched(TIndex& index) {
+    fill_index(index);
+
+    const std::size_t per_page = osmium::util::get_pagesize() / sizeof(osmium::Location);
+    REQUIRE(index.pages_touched() == 0);
+
+    std::vector<osmium::unsigned_object_id_type> ids;
+    for (osmium::unsigned_object_id_type id = 0; id < per_page * 3; id += 5) {
+        ids.push_back(id);
+    }
+    std::vector<osmium::Location> values(ids.size());
+    index.get_noexcept_batch(ids.data(), values.data(), ids.size());
+    REQUIRE(index.pages_touched() == 3);
+
+    std::reverse(ids.begin(), ids.end());
+    index.get_noexcept_batch(ids.data(), values.data(), ids.size());
+    REQUIRE(index.pages_touched() == 6);
+
+    const osmium::unsigned_object_id_type alternating[] = {1, per_page + 1, 2, per_page + 2};
+    index.get_noexcept_batch(alternating, values.data(), 4);
+    REQUIRE(index.pages_touched() == 10);
+}
+
+TEST_CASE("Get batch: DenseMemArray") {
+    osmium::index::map::DenseMemArray<osmium::unsigned_object_id_type, osmium::Location> index;
+    test_get_batch(index);
+}
+
+TEST_CASE("Get batch: DenseMemArray pages touched") {
+    osmium::index::map::DenseMemArray<osmium::unsigned_object_id_type, osmium::Location> index;
+    test_pages_touched(index);
+}
+
+#ifdef __linux__
+TEST_CASE("Get batch: DenseMmapArray") {
+    osmium::index::map::DenseMmapArray<osmium::unsigned_object_id_type, osmium::Location> index;
+    test_get_batch(index);
+}
+
+TEST_CASE("Get batch: DenseMmapArray pages touched") {
+    osmium::index::map::DenseMmapArray<osmium::unsigned_object_id_type, osmium::Location> index;
+    test_pages_touched(index);
+}
+#endif
+
+TEST_CASE("Get batch: DenseFileArray") {
+    osmium::index::map::DenseFileArray<osmium::unsigned_object_id_type, osmium::Location> index;
+    test_get_batch(index);
+}
+
+TEST_CASE("Get batch: SparseMemArray") {
+    osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmium::Location> index;
+    fill_index(index);
+    index.sort();
+    check_batch(index, true);
+}
@@ -127,6 +127,21 @@ TEST_CASE("Map Id to location: DenseMmapArray") {
     index_type index2;
     test_func_real<index_type>(index2);
 }
+
+TEST_CASE("Map Id to location: DenseMmapArray with huge pages") {
+    using index_type = osmium::index::map::DenseMmapArray<osmium::unsigned_object_id_type, osmium::Location>;
+
+    osmium::util::anonymous_mapping_options options;
+    options.pages = osmium::util::huge_pages::hugetlb;
+    options.numa = osmium::util::numa_policy::interleave;
+
+    index_type index1{options};
+    test_func_all<index_type>(index1);
+
+    index_type index2{options};
+    test_func_real<index_type>(index2);
+    REQUIRE(index2.huge_page_bytes() <= index2.size() * sizeof(osmium::Location) + osmium::util::get_huge_page_size());
+}
 #else
 # pragma message("not running 'DenseMapMmap' test case on this machine")
 #endif
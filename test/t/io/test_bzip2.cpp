@@ -5,7 +5,14 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include <fstream>
+#include <string>
+#include <vector>
+
 #include <osmium/io/bzip2_compression.hpp>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/writer_options.hpp>
+#include <osmium/util/file.hpp>
 
 TEST_CASE("Read bzip2-compressed file") {
     const std::string input_file = with_data_dir("t/io/data_bzip2.txt.bz2");
@@ -27,3 +34,128 @@ TEST_CASE("Read bzip2-compressed file") {
     REQUIRE("TESTDATA\n" == all);
 }
 
+TEST_CASE("Bzip2 compressor writes multi-stream file from blocks") {
+    const std::string filename{"test-bzip2-blocks.txt.bz2"};
+    const std::string block1{make_test_data(100000)};
+    const std::string block2{make_test_data(10)};
+    const std::string block3{make_test_data(50000)};
+
+    {
+        const int fd = osmium::io::detail::open_for_writing(filename, osmium::io::overwrite::allow);
+        osmium::io::Bzip2Compressor compressor{fd, osmium::io::fsync::no};
+        REQUIRE(compressor.can_compress_blocks());
+        compressor.write_compressed(compressor.compress_block(block1));
+        compressor.write_compressed(compressor.compress_block(block2));
+        compressor.write_compressed(compressor.compress_block(block3));
+        compressor.close();
+    }
+
+    const std::string compressed{read_whole_file(filename)};
+    REQUIRE(compressed.size() < block1.size());
+
+    SECTION("read from file") {
+        osmium::io::Bzip2Decompressor decompressor{osmium::io::detail::open_for_reading(filename)};
+        REQUIRE(read_all(decompressor) == block1 + block2 + block3);
+    }
+
+    SECTION("read from buffer") {
+        osmium::io::Bzip2BufferDecompressor decompressor{compressed.data(), compressed.size()};
+        REQUIRE(read_all(decompressor) == block1 + block2 + block3);
+    }
+}
+
+TEST_CASE("Bzip2 compressor writes valid file if nothing was written") {
+    const std::string filename{"test-bzip2-empty.txt.bz2"};
+
+    {
+        const int fd = osmium::io::detail::open_for_writing(filename, osmium::io::overwrite::allow);
+        osmium::io::Bzip2Compressor compressor{fd, osmium::io::fsync::no};
+        compressor.close();
+    }
+
+    const std::string compressed{read_whole_file(filename)};
+    REQUIRE(compressed.size() > 2);
+    REQUIRE(compressed.substr(0, 3) == "BZh");
+
+    osmium::io::Bzip2BufferDecompressor decompressor{compressed.data(), compressed.size()};
+    REQUIRE(read_all(decompressor).empty());
+}
+
+TEST_CASE("Bzip2 decompressor reads multi-stream file in blocks") {
+    const std::string filename{"test-bzip2-read-blocks.txt.bz2"};
+    const std::string data{make_random_data(60000)};
+
+    {
+        const int fd = osmium::io::detail::open_for_writing(filename, osmium::io::overwrite::allow);
+        osmium::io::Bzip2Compressor compressor{fd, osmium::io::fsync::no};
+        for (std::size_t offset = 0; offset < data.size(); offset += 100 * 1024) {
+            compressor.write_compressed(compressor.compress_block(data.substr(offset, 100 * 1024)));
+        }
+        compressor.close();
+    }
+
+    osmium::io::Bzip2Decompressor decompressor{osmium::io::detail::open_for_reading(filename)};
+    decompressor.set_file_size(osmium::util::file_size(filename));
+    REQUIRE(decompressor.can_decompress_blocks());
+
+    std::vector<std::string> blocks;
+    for (std::string block = decompressor.read_compressed_block(); !block.empty(); block = decompressor.read_compressed_block()) {
+        blocks.push_back(block);
+    }
+    REQUIRE(blocks.size() > 1);
+    REQUIRE(decompressor.read().empty());
+    decompressor.close();
+
+    std::string all;
+    for (const auto& block : blocks) {
+        all += decompressor.decompress_block(block);
+    }
+    REQUIRE(all == data);
+
+    SECTION("truncated block can not be decompressed") {
+        const std::string block{blocks[0].substr(0, blocks[0].size() - 100)};
+        REQUIRE_THROWS_AS(decompressor.decompress_block(block), const osmium::bzip2_error&);
+    }
+
+    SECTION("merged blocks can be decompressed") {
+        REQUIRE(decompressor.decompress_block(blocks[0] + blocks[1]) ==
+                decompressor.decompress_block(blocks[0]) + decompressor.decompress_block(blocks[1]));
+    }
+}
+
+TEST_CASE("Bzip2 decompressor ignores trailing garbage in serial and block mode") {
+    const std::string filename{"test-bzip2-trailing-garbage.txt.bz2"};
+    const std::string data{make_random_data(60000)};
+
+    {
+        const int fd = osmium::io::detail::open_for_writing(filename, osmium::io::overwrite::allow);
+        osmium::io::Bzip2Compressor compressor{fd, osmium::io::fsync::no};
+        for (std::size_t offset = 0; offset < data.size(); offset += 100 * 1024) {
+            compressor.write_compressed(compressor.compress_block(data.substr(offset, 100 * 1024)));
+        }
+        compressor.close();
+    }
+    {
+        std::ofstream out{filename, std::ios::binary | std::ios::app};
+        out << "some garbage at the end of the file" << std::string(100 * 1024, 'x');
+    }
+
+    SECTION("serial") {
+        osmium::io::Bzip2Decompressor decompressor{osmium::io::detail::open_for_reading(filename)};
+        REQUIRE(read_all(decompressor) == data);
+        decompressor.close();
+    }
+
+    SECTION("in blocks") {
+        osmium::io::Bzip2Decompressor decompressor{osmium::io::detail::open_for_reading(filename)};
+        decompressor.set_file_size(osmium::util::file_size(filename));
+        REQUIRE(decompressor.can_decompress_blocks());
+
+        std::string all;
+        for (std::string block = decompressor.read_compressed_block(); !block.empty(); block = decompressor.read_compressed_block()) {
+            all += decompressor.decompress_block(block);
+        }
+        REQUIRE(all == data);
+        decompressor.close();
+    }
+}
@@ -1,5 +1,10 @@
 
 #include "catch.hpp"
+#include "utils.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <string>
 
 #include <osmium/io/compression.hpp>
 
@@ -21,3 +26,27 @@ TEST_CASE("Compression factory fails on undefined compression") {
                         "Support for compression 'gzip' not compiled into this binary");
 }
 
+
+TEST_CASE("Mmap decompressor returns file contents") {
+    const std::string filename{with_data_dir("t/io/data.osm")};
+
+    std::ifstream stream{filename, std::ios::binary};
+    const std::string expected{std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+    REQUIRE_FALSE(expected.empty());
+
+    const int fd = osmium::io::detail::open_for_reading(filename);
+    REQUIRE(fd > 0);
+
+    osmium::io::MmapDecompressor decompressor{fd};
+    REQUIRE(decompressor.offset() == 0);
+
+    std::string data;
+    std::string chunk;
+    while (!(chunk = decompressor.read()).empty()) {
+        data += chunk;
+    }
+
+    REQUIRE(data == expected);
+    REQUIRE(decompressor.offset() == expected.size());
+    decompressor.close();
+}
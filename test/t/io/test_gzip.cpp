@@ -0,0 +1,198 @@
+#include "catch.hpp"
+#include "utils.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <osmium/io/detail/queue_util.hpp>
+#include <osmium/io/detail/read_thread.hpp>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/gzip_compression.hpp>
+#include <osmium/io/writer_options.hpp>
+#include <osmium/thread/pool.hpp>
+#include <osmium/util/file.hpp>
+
+TEST_CASE("Gzip compressor writes multi-member file from blocks") {
+    const std::string filename{"test-gzip-blocks.txt.gz"};
+    const std::string block1{make_test_data(100000)};
+    const std::string block2{make_test_data(10)};
+    const std::string block3{make_test_data(50000)};
+
+    {
+        const int fd = osmium::io::detail::open_for_writing(filename, osmium::io::overwrite::allow);
+        osmium::io::GzipCompressor compressor{fd, osmium::io::fsync::no};
+        REQUIRE(compressor.can_compress_blocks());
+        compressor.write_compressed(compressor.compress_block(block1));
+        compressor.write_compressed(compressor.compress_block(block2));
+        compressor.write_compressed(compressor.compress_block(block3));
+        compressor.close();
+    }
+
+    const std::string compressed{read_whole_file(filename)};
+    REQUIRE(compressed.size() < block1.size());
+
+    SECTION("read from file") {
+        osmium::io::GzipDecompressor decompressor{osmium::io::detail::open_for_reading(filename)};
+        REQUIRE(read_all(decompressor) == block1 + block2 + block3);
+    }
+
+    SECTION("read from buffer") {
+        osmium::io::GzipBufferDecompressor decompressor{compressed.data(), compressed.size()};
+        REQUIRE(read_all(decompressor) == block1 + block2 + block3);
+    }
+}
+
+TEST_CASE("Gzip compressor writes valid file if nothing was written") {
+    const std::string filename{"test-gzip-empty.txt.gz"};
+
+    {
+        const int fd = osmium::io::detail::open_for_writing(filename, osmium::io::overwrite::allow);
+        osmium::io::GzipCompressor compressor{fd, osmium::io::fsync::no};
+        compressor.close();
+    }
+
+    const std::string compressed{read_whole_file(filename)};
+    REQUIRE(compressed.size() > 2);
+    REQUIRE(static_cast<unsigned char>(compressed[0]) == 0x1f);
+
+    osmium::io::GzipBufferDecompressor decompressor{compressed.data(), compressed.size()};
+    REQUIRE(read_all(decompressor).empty());
+}
+
+TEST_CASE("Gzip decompressor reads multi-member file in blocks") {
+    const std::string filename{"test-gzip-read-blocks.txt.gz"};
+    const std::string data{make_random_data(60000)};
+
+    {
+        const int fd = osmium::io::detail::open_for_writing(filename, osmium::io::overwrite::allow);
+        osmium::io::GzipCompressor compressor{fd, osmium::io::fsync::no};
+        for (std::size_t offset = 0; offset < data.size(); offset += 100 * 1024) {
+            compressor.write_compressed(compressor.compress_block(data.substr(offset, 100 * 1024)));
+        }
+        compressor.close();
+    }
+
+    osmium::io::GzipDecompressor decompressor{osmium::io::detail::open_for_reading(filename)};
+    decompressor.set_file_size(osmium::util::file_size(filename));
+    REQUIRE(decompressor.can_decompress_blocks());
+
+    std::vector<std::string> blocks;
+    for (std::string block = decompressor.read_compressed_block(); !block.empty(); block = decompressor.read_compressed_block()) {
+        blocks.push_back(block);
+    }
+    REQUIRE(blocks.size() > 1);
+    REQUIRE(decompressor.read().empty());
+    decompressor.close();
+
+    std::string all;
+    for (const auto& block : blocks) {
+        all += decompressor.decompress_block(block);
+    }
+    REQUIRE(all == data);
+
+    SECTION("truncated block can not be decompressed") {
+        const std::string block{blocks[0].substr(0, blocks[0].size() - 100)};
+        REQUIRE_THROWS_AS(decompressor.decompress_block(block), const osmium::gzip_error&);
+    }
+
+    SECTION("merged blocks can be decompressed") {
+        REQUIRE(decompressor.decompress_block(blocks[0] + blocks[1]) ==
+                decompressor.decompress_block(blocks[0]) + decompressor.decompress_block(blocks[1]));
+    }
+}
+
+TEST_CASE("Gzip decompressor ignores trailing garbage in serial and block mode") {
+    const std::string filename{"test-gzip-trailing-garbage.txt.gz"};
+    const std::string data{make_random_data(60000)};
+
+    {
+        const int fd = osmium::io::detail::open_for_writing(filename, osmium::io::overwrite::allow);
+        osmium::io::GzipCompressor compressor{fd, osmium::io::fsync::no};
+        for (std::size_t offset = 0; offset < data.size(); offset += 100 * 1024) {
+            compressor.write_compressed(compressor.compress_block(data.substr(offset, 100 * 1024)));
+        }
+        compressor.close();
+    }
+    {
+        std::ofstream out{filename, std::ios::binary | std::ios::app};
+        out << "some garbage at the end of the file" << std::string(100 * 1024, 'x');
+    }
+
+    SECTION("serial") {
+        osmium::io::GzipDecompressor decompressor{osmium::io::detail::open_for_reading(filename)};
+        REQUIRE(read_all(decompressor) == data);
+        decompressor.close();
+    }
+
+    SECTION("in blocks") {
+        osmium::io::GzipDecompressor decompressor{osmium::io::detail::open_for_reading(filename)};
+        decompressor.set_file_size(osmium::util::file_size(filename));
+        REQUIRE(decompressor.can_decompress_blocks());
+
+        std::string all;
+        for (std::string block = decompressor.read_compressed_block(); !block.empty(); block = decompressor.read_compressed_block()) {
+            all += decompressor.decompress_block(block);
+        }
+        REQUIRE(all == data);
+        decompressor.close();
+    }
+}
+
+TEST_CASE("Gzip decompressor decodes members with unusual headers in blocks") {
+    osmium::io::GzipCompressor compressor{-1, osmium::io::fsync::no};
+    std::string second{compressor.compress_block("world\n")};
+    second[9] = 42; // unknown operating system
+
+    const std::string data{compressor.compress_block("hello ") + second};
+    osmium::io::GzipBufferDecompressor buffer_decompressor{data.data(), data.size()};
+    REQUIRE(read_all(buffer_decompressor) == "hello world\n");
+
+    osmium::io::GzipDecompressor decompressor{osmium::io::detail::open_for_reading(with_data_dir("t/io/data.osm.gz"))};
+    REQUIRE(decompressor.decompress_block(data) == "hello world\n");
+}
+
+TEST_CASE("Gzip decompressor reads single member file with fake member header") {
+    const std::string filename{"test-gzip-fake-header.txt.gz"};
+
+    // The data is stored uncompressed, so the fake header appears in the
+    // compressed data. It is repeated so that it isn't split by the
+    // headers of the stored deflate blocks.
+    std::string data(20 * 1024 * 1024, 'x');
+    const std::string fake_header{"\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\x03", 10};
+    for (std::size_t offset = 1536 * 1024; offset < 1546 * 1024; offset += 1000) {
+        data.replace(offset, fake_header.size(), fake_header);
+    }
+
+    {
+        z_stream zstream{};
+        REQUIRE(deflateInit2(&zstream, 0, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+        std::string output(deflateBound(&zstream, data.size()), '\0');
+        zstream.next_in = reinterpret_cast<unsigned char*>(&data[0]);
+        zstream.avail_in = static_cast<unsigned int>(data.size());
+        zstream.next_out = reinterpret_cast<unsigned char*>(&output[0]);
+        zstream.avail_out = static_cast<unsigned int>(output.size());
+        REQUIRE(deflate(&zstream, Z_FINISH) == Z_STREAM_END);
+        output.resize(zstream.total_out);
+        deflateEnd(&zstream);
+        REQUIRE(output.find(fake_header) != std::string::npos);
+
+        std::ofstream out{filename, std::ios::binary};
+        out << output;
+    }
+
+    osmium::io::GzipDecompressor decompressor{osmium::io::detail::open_for_reading(filename)};
+    decompressor.set_file_size(osmium::util::file_size(filename));
+
+    osmium::thread::Pool pool{2};
+    osmium::io::detail::future_string_queue_type queue{20, "test"};
+    osmium::io::detail::queue_wrapper<std::string> wrapper{queue};
+    osmium::io::detail::ReadThreadManager manager{decompressor, queue, &pool};
+
+    std::string all;
+    for (std::string block = wrapper.pop(); !block.empty(); block = wrapper.pop()) {
+        all += block;
+    }
+    REQUIRE(all.size() == data.size());
+    REQUIRE(all == data);
+}
@@ -1,10 +1,14 @@
 
 #include <algorithm>
 #include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
 
 #include "catch.hpp"
 #include "utils.hpp"
 
+#include <osmium/io/compression.hpp>
 #include <osmium/io/detail/opl_input_format.hpp>
 #include <osmium/io/opl_input.hpp>
 #include <osmium/opl.hpp>
@@ -1071,159 +1075,228 @@ TEST_CASE("Parse OPL with missing newline using Reader") {
     REQUIRE(node.id() == 1);
 }
 
-class lbl_tester {
+static std::string make_large_opl(int num_nodes) {
+    std::string data;
+    for (int i = 1; i <= num_nodes; ++i) {
+        data += "n";
+        data += std::to_string(i);
+        data += " v1 dV c1 t2017-01-01T00:00:00Z i1 utest Tname=node%20%number%20%";
+        data += std::to_string(i);
+        data += " x1.5 y2.5";
+        data += (i % 3 == 0) ? "\r\n" : "\n";
+        if (i % 1000 == 0) {
+            data += "\n# comment\n";
+        }
+    }
+    return data;
+}
 
-    std::vector<std::string> m_inputs;
-    std::vector<std::string> m_outputs;
+TEST_CASE("Parse large OPL data in chunks using Reader") {
+    const int num_nodes = 50000;
+    const std::string data = make_large_opl(num_nodes);
+    REQUIRE(data.size() > 3 * 1024 * 1024);
 
-public:
+    osmium::io::File file{data.data(), data.size(), "opl"};
+    osmium::io::Reader reader{file};
 
-    lbl_tester(const std::initializer_list<std::string>& inputs,
-               const std::initializer_list<std::string>& outputs) :
-        m_inputs(inputs),
-        m_outputs(outputs) {
+    int buffers = 0;
+    osmium::object_id_type id = 0;
+    while (const auto buffer = reader.read()) {
+        ++buffers;
+        for (const auto& node : buffer.select<osmium::Node>()) {
+            REQUIRE(node.id() == ++id);
+            REQUIRE(node.location() == osmium::Location(1.5, 2.5));
+            REQUIRE(std::string{node.tags()["name"]} == "node number " + std::to_string(id));
+        }
     }
+    reader.close();
+
+    REQUIRE(id == num_nodes);
+    REQUIRE(buffers > 1);
+}
+
+TEST_CASE("Line numbers in errors are counted over all chunks") {
+    std::string data = make_large_opl(50000);
+    data += "n1 x1.5 y2.5\nfoo\n";
+
+    osmium::io::File file{data.data(), data.size(), "opl"};
+    osmium::io::Reader reader{file};
 
-    bool input_done() {
-        return m_inputs.empty();
+    try {
+        while (reader.read()) {
+        }
+        REQUIRE(false);
+    } catch (const osmium::opl_error& e) {
+        // all nodes, the comment lines and the extra node
+        REQUIRE(e.line == 50000 + 50 + 1);
+        REQUIRE(e.column == 0);
     }
+}
 
-    std::string get_input() {
-        REQUIRE_FALSE(m_inputs.empty());
-        std::string data = std::move(m_inputs.front());
-        m_inputs.erase(m_inputs.begin());
-        return data;
+// Blocks of data returned by the BlockDecompressor.
+static std::vector<std::string> test_blocks;
+
+// Decompressor returning the test blocks one after the other.
+class BlockDecompressor : public osmium::io::Decompressor {
+
+    std::vector<std::string> m_blocks;
+
+public:
+
+    BlockDecompressor() :
+        Decompressor(),
+        m_blocks(test_blocks) {
     }
 
-    void parse_line(const char *data) {
-        REQUIRE_FALSE(m_outputs.empty());
-        REQUIRE(m_outputs.front() == data);
-        m_outputs.erase(m_outputs.begin());
+    ~BlockDecompressor() noexcept final = default;
+
+    std::string read() final {
+        if (m_blocks.empty()) {
+            return {};
+        }
+        std::string data = std::move(m_blocks.front());
+        m_blocks.erase(m_blocks.begin());
+        return data;
     }
 
-    void check() {
-        REQUIRE(m_inputs.empty());
-        REQUIRE(m_outputs.empty());
+    void close() final {
     }
 
-}; // class lbl_tester
+}; // class BlockDecompressor
 
-void check_lbl(const std::initializer_list<std::string>& in,
-               const std::initializer_list<std::string>& out) {
-    lbl_tester tester{in, out};
-    osmium::io::detail::line_by_line(tester);
-    tester.check();
-}
+// Read the blocks with the OPL parser and check that nodes with the given
+// ids come out. Lines can be split anywhere between blocks.
+void check_blocks(const std::initializer_list<std::string>& blocks,
+                  const std::initializer_list<osmium::object_id_type>& ids) {
+    static const bool registered = osmium::io::CompressionFactory::instance().register_compression(osmium::io::file_compression::gzip,
+        [](int, osmium::io::fsync) { return nullptr; },
+        [](int) { return new BlockDecompressor{}; },
+        [](const char*, size_t) { return nullptr; }
+    );
+    REQUIRE(registered);
 
-TEST_CASE("line_by_line for OPL parser 1") {
-    check_lbl({""}, {});
+    test_blocks = blocks;
+    osmium::io::Reader reader{osmium::io::File{with_data_dir("t/io/data.osm.gz"), "opl.gz"}};
+
+    std::vector<osmium::object_id_type> read_ids;
+    while (osmium::memory::Buffer buffer = reader.read()) {
+        for (const auto& node : buffer.select<osmium::Node>()) {
+            read_ids.push_back(node.id());
+        }
+    }
+    reader.close();
+
+    REQUIRE(read_ids == std::vector<osmium::object_id_type>(ids));
 }
 
-TEST_CASE("line_by_line for OPL parser 2") {
-    check_lbl({"\n"}, {});
+TEST_CASE("Read OPL data coming in blocks 1") {
+    check_blocks({""}, {});
 }
 
-TEST_CASE("line_by_line for OPL parser 3") {
-    check_lbl({"foo\n"}, {"foo"});
+TEST_CASE("Read OPL data coming in blocks 2") {
+    check_blocks({"\n"}, {});
 }
 
-TEST_CASE("line_by_line for OPL parser 4") {
-    check_lbl({"foo"}, {"foo"});
+TEST_CASE("Read OPL data coming in blocks 3") {
+    check_blocks({"n11\n"}, {11});
 }
 
-TEST_CASE("line_by_line for OPL parser 5") {
-    check_lbl({"foo\nbar\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 4") {
+    check_blocks({"n11"}, {11});
 }
 
-TEST_CASE("line_by_line for OPL parser 6") {
-    check_lbl({"foo\nbar"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 5") {
+    check_blocks({"n11\nn22\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 7") {
-    check_lbl({"foo\nbar\nbaz\n"}, {"foo", "bar", "baz"});
+TEST_CASE("Read OPL data coming in blocks 6") {
+    check_blocks({"n11\nn22"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 8") {
-    check_lbl({"foo\n", "bar\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 7") {
+    check_blocks({"n11\nn22\nn33\n"}, {11, 22, 33});
 }
 
-TEST_CASE("line_by_line for OPL parser 9") {
-    check_lbl({"foo\nb", "ar\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 8") {
+    check_blocks({"n11\n", "n22\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 10") {
-    check_lbl({"foo\nb", "ar\n", "baz\n"}, {"foo", "bar", "baz"});
+TEST_CASE("Read OPL data coming in blocks 9") {
+    check_blocks({"n11\nn", "22\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 11") {
-    check_lbl({"foo", "\nbar\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 10") {
+    check_blocks({"n11\nn", "22\n", "n33\n"}, {11, 22, 33});
 }
 
-TEST_CASE("line_by_line for OPL parser 12") {
-    check_lbl({"foo", "\nbar"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 11") {
+    check_blocks({"n11", "\nn22\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 13") {
-    check_lbl({"foo", "\nbar", "\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 12") {
+    check_blocks({"n11", "\nn22"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 14") {
-    check_lbl({"foo\n", "b", "ar\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 13") {
+    check_blocks({"n11", "\nn22", "\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 15") {
-    check_lbl({"foo\n", "ba", "r\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 14") {
+    check_blocks({"n11\n", "n", "22\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 16") {
-    check_lbl({"foo", "\n", "bar\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 15") {
+    check_blocks({"n11\n", "n2", "2\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 17") {
-    check_lbl({"foo\r\nbar\r\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 16") {
+    check_blocks({"n11", "\n", "n22\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 18") {
-    check_lbl({"foo\r\nb", "ar\r\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 17") {
+    check_blocks({"n11\r\nn22\r\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 19") {
-    check_lbl({"foo\r\nb", "ar\n", "baz\r\n"}, {"foo", "bar", "baz"});
+TEST_CASE("Read OPL data coming in blocks 18") {
+    check_blocks({"n11\r\nn", "22\r\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 20") {
-    check_lbl({"foo", "\r\nbar\r\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 19") {
+    check_blocks({"n11\r\nn", "22\n", "n33\r\n"}, {11, 22, 33});
 }
 
-TEST_CASE("line_by_line for OPL parser 21") {
-    check_lbl({"foo\r", "\nbar"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 20") {
+    check_blocks({"n11", "\r\nn22\r\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 22") {
-    check_lbl({"foo", "\r\nbar\r", "\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 21") {
+    check_blocks({"n11\r", "\nn22"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 23") {
-    check_lbl({"foo\r\n", "b", "ar\r\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 22") {
+    check_blocks({"n11", "\r\nn22\r", "\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 24") {
-    check_lbl({"foo\n", "ba", "r\r\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 23") {
+    check_blocks({"n11\r\n", "n", "22\r\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 25") {
-    check_lbl({"foo", "\n", "bar\r\n"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 24") {
+    check_blocks({"n11\n", "n2", "2\r\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 26") {
-    check_lbl({"foo", "\n\r", "bar\r"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 25") {
+    check_blocks({"n11", "\n", "n22\r\n"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 27") {
-    check_lbl({"foo\r", "bar\n\r"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 26") {
+    check_blocks({"n11", "\n\r", "n22\r"}, {11, 22});
 }
 
-TEST_CASE("line_by_line for OPL parser 28") {
-    check_lbl({"foo\nb", "ar"}, {"foo", "bar"});
+TEST_CASE("Read OPL data coming in blocks 27") {
+    check_blocks({"n11\r", "n22\n\r"}, {11, 22});
 }
 
+TEST_CASE("Read OPL data coming in blocks 28") {
+    check_blocks({"n11\nn", "22"}, {11, 22});
+}
@@ -0,0 +1,48 @@
+#include "catch.hpp"
+#include "utils.hpp"
+
+#include <osmium/io/detail/opl_scan.hpp>
+
+#include <string>
+
+namespace scan = osmium::io::detail::opl_scan;
+
+TEST_CASE("Find end of string") {
+    for (const std::string str : {"", "a", "abc def", "abc\tdef", "abc,def", "abc=def",
+                                  "abc%20%def", "0123456789abcdefghijklmnopqrstuvwxyz",
+                                  "0123456789abcdefghijklmnopqrstuvwxyz=", "\xc3\xa4\xc3\xb6\xc3\xbc,"}) {
+        check_at_all_offsets(str, scan::find_string_end, scan::scalar_find_string_end);
+    }
+
+    const char* s = "key=value";
+    REQUIRE(scan::find_string_end(s) == s + 3);
+}
+
+TEST_CASE("Find end of section") {
+    for (const std::string str : {"", " ", "a", "abc def", "abc\tdef", "abc,def=x%20%",
+                                  "n1,n2,n3,n4,n5,n6,n7,n8,n9,n10,n11,n12,n13 v1"}) {
+        check_at_all_offsets(str, scan::find_section_end, scan::scalar_find_section_end);
+    }
+
+    const char* s = "n1,n2 v1";
+    REQUIRE(scan::find_section_end(s) == s + 5);
+}
+
+TEST_CASE("Find end of digits") {
+    for (const std::string str : {"", "x", "0", "123 ", "1234567890123456789012345", "12/", "12:", "12\xff"}) {
+        check_at_all_offsets(str, scan::find_digits_end, scan::scalar_find_digits_end);
+    }
+
+    const char* s = "4711,";
+    REQUIRE(scan::find_digits_end(s) == s + 4);
+}
+
+TEST_CASE("Convert digits to integer") {
+    for (const std::string str : {"0", "7", "42", "1234567", "12345678", "123456789",
+                                  "9999999999999999", "1234567890123456789"}) {
+        const char* s = str.c_str();
+        const char* e = s + str.size();
+        REQUIRE(scan::digits_to_uint(s, e) == scan::scalar_digits_to_uint(s, e));
+        REQUIRE(scan::digits_to_uint(s, e) == std::stoull(str));
+    }
+}
@@ -7,6 +7,7 @@
 #include <osmium/io/pbf_input.hpp>
 #include <osmium/visitor.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/memory/buffer_pool.hpp>
 
 struct CountHandler : public osmium::handler::Handler {
 
@@ -63,6 +64,38 @@ TEST_CASE("Reader can be initialized with user-provided pool") {
     osmium::apply(reader, handler);
 }
 
+TEST_CASE("Reader gets its buffers from the buffer pool") {
+    osmium::memory::BufferPool buffer_pool;
+
+    std::string filename;
+    SECTION("XML") {
+        filename = with_data_dir("t/io/data.osm");
+    }
+    SECTION("PBF") {
+        filename = with_data_dir("t/io/deleted_nodes.osh.pbf");
+    }
+
+    std::ptrdiff_t count_without_pool = 0;
+    {
+        osmium::io::Reader reader{filename};
+        while (osmium::memory::Buffer buffer = reader.read()) {
+            count_without_pool += std::distance(buffer.begin(), buffer.end());
+        }
+    }
+    REQUIRE(count_without_pool > 0);
+
+    for (int run = 0; run < 2; ++run) {
+        std::ptrdiff_t count = 0;
+        osmium::io::Reader reader{filename, buffer_pool};
+        while (auto buffer = buffer_pool.wrap(reader.read())) {
+            count += std::distance(buffer->begin(), buffer->end());
+        }
+        reader.close();
+        REQUIRE(count == count_without_pool);
+        REQUIRE(buffer_pool.size() > 0);
+    }
+}
+
 TEST_CASE("Reader should throw after eof") {
     osmium::io::File file{with_data_dir("t/io/data.osm")};
     osmium::io::Reader reader{file};
@@ -0,0 +1,231 @@
+#include "catch.hpp"
+
+#include <osmium/io/o5m_input.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/way.hpp>
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+
+// Helper functions for writing o5m files by hand.
+
+static std::string varint(uint64_t value) {
+    std::string out;
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+    return out;
+}
+
+static std::string zvarint(int64_t value) {
+    return varint(static_cast<uint64_t>((value << 1) ^ (value >> 63)));
+}
+
+static std::string inline_string(const std::string& str) {
+    return std::string(1, '\0') + str + std::string(1, '\0');
+}
+
+static std::string dataset(unsigned char type, const std::string& data) {
+    return std::string(1, static_cast<char>(type)) + varint(data.size()) + data;
+}
+
+static const std::string o5m_header{"\xff\xe0\x04o5m2", 7};
+static const std::string reset{"\xff", 1};
+
+TEST_CASE("Read small o5m file") {
+    std::string data{o5m_header};
+
+    data += dataset(0xdb, zvarint(-100000000) + zvarint(-200000000) + zvarint(100000000) + zvarint(200000000));
+    data += dataset(0xdc, zvarint(1500000000));
+
+    // node 10 with user and tag written inline
+    data += dataset(0x10, zvarint(10) + varint(1) + zvarint(1400000000) + zvarint(5) +
+                          std::string(1, '\0') + varint(17) + inline_string("foo") +
+                          zvarint(12345678) + zvarint(-87654321) +
+                          inline_string(std::string{"highway\0primary", 15}));
+
+    // node 11 with user and tag from the reference table
+    data += dataset(0x10, zvarint(1) + varint(2) + zvarint(100) + zvarint(1) +
+                          varint(2) + zvarint(-1) + zvarint(1) + varint(1));
+
+    // node 12 deleted
+    data += dataset(0x10, zvarint(1) + varint(3) + zvarint(0) + zvarint(0) + varint(2));
+
+    // way 20 with two nodes
+    data += dataset(0x11, zvarint(8) + varint(0) +
+                          varint(zvarint(10).size() + zvarint(1).size()) + zvarint(10) + zvarint(1) +
+                          varint(1));
+
+    // relation 30 with a node and a way member
+    const std::string members = zvarint(11) + inline_string("0stop") +
+                                zvarint(20) + inline_string("1");
+    data += dataset(0x12, zvarint(10) + varint(0) + varint(members.size()) + members +
+                          inline_string(std::string{"type\0route", 10}));
+
+    osmium::io::Reader reader{osmium::io::File{data.data(), data.size(), "o5m"}};
+
+    REQUIRE(reader.header().box() == osmium::Box(-10.0, -20.0, 10.0, 20.0));
+    REQUIRE(reader.header().get("timestamp") == "2017-07-14T02:40:00Z");
+
+    int count = 0;
+    while (const auto buffer = reader.read()) {
+        for (const auto& object : buffer.select<osmium::OSMObject>()) {
+            switch (++count) {
+                case 1: {
+                    const auto& node = static_cast<const osmium::Node&>(object);
+                    REQUIRE(node.id() == 10);
+                    REQUIRE(node.version() == 1);
+                    REQUIRE(node.timestamp() == osmium::Timestamp{1400000000});
+                    REQUIRE(node.changeset() == 5);
+                    REQUIRE(node.uid() == 17);
+                    REQUIRE(std::string{node.user()} == "foo");
+                    REQUIRE(node.visible());
+                    REQUIRE(node.location() == osmium::Location(1.2345678, -8.7654321));
+                    REQUIRE(node.tags().size() == 1);
+                    REQUIRE(std::string{node.tags()["highway"]} == "primary");
+                    break;
+                }
+                case 2: {
+                    const auto& node = static_cast<const osmium::Node&>(object);
+                    REQUIRE(node.id() == 11);
+                    REQUIRE(node.version() == 2);
+                    REQUIRE(node.timestamp() == osmium::Timestamp{1400000100});
+                    REQUIRE(node.changeset() == 6);
+                    REQUIRE(node.uid() == 17);
+                    REQUIRE(std::string{node.user()} == "foo");
+                    REQUIRE(node.location() == osmium::Location(1.2345677, -8.765432));
+                    REQUIRE(std::string{node.tags()["highway"]} == "primary");
+                    break;
+                }
+                case 3: {
+                    const auto& node = static_cast<const osmium::Node&>(object);
+                    REQUIRE(node.id() == 12);
+                    REQUIRE(node.version() == 3);
+                    REQUIRE_FALSE(node.visible());
+                    REQUIRE_FALSE(node.location().valid());
+                    REQUIRE(node.tags().empty());
+                    break;
+                }
+                case 4: {
+                    const auto& way = static_cast<const osmium::Way&>(object);
+                    REQUIRE(way.id() == 20);
+                    REQUIRE(way.version() == 0);
+                    REQUIRE(std::string{way.user()}.empty());
+                    REQUIRE(way.nodes().size() == 2);
+                    REQUIRE(way.nodes()[0].ref() == 10);
+                    REQUIRE(way.nodes()[1].ref() == 11);
+                    REQUIRE(std::string{way.tags()["highway"]} == "primary");
+                    break;
+                }
+                case 5: {
+                    const auto& relation = static_cast<const osmium::Relation&>(object);
+                    REQUIRE(relation.id() == 30);
+                    REQUIRE(relation.members().size() == 2);
+                    auto it = relation.members().begin();
+                    REQUIRE(it->type() == osmium::item_type::node);
+                    REQUIRE(it->ref() == 11);
+                    REQUIRE(std::string{it->role()} == "stop");
+                    ++it;
+                    REQUIRE(it->type() == osmium::item_type::way);
+                    REQUIRE(it->ref() == 20);
+                    REQUIRE(std::string{it->role()}.empty());
+                    REQUIRE(std::string{relation.tags()["type"]} == "route");
+                    break;
+                }
+                default:
+                    REQUIRE(false);
+            }
+        }
+    }
+    reader.close();
+
+    REQUIRE(count == 5);
+}
+
+// Create an o5m file with num_nodes nodes with a reset every 1000 nodes.
+// After a reset the user name and the type tag are written inline, after
+// that they are references into the string table.
+static std::string make_large_o5m(int num_nodes) {
+    std::string data{o5m_header};
+    for (int i = 1; i <= num_nodes; ++i) {
+        const int k = (i - 1) % 1000;
+        const std::string name_tag{inline_string("name" + std::string(1, '\0') + "node " + std::to_string(i))};
+        if (k == 0) {
+            data += reset;
+            data += dataset(0x10, zvarint(i) + varint(1) + zvarint(1) + zvarint(1) +
+                                  inline_string(varint(1) + std::string(1, '\0') + "user") +
+                                  zvarint(i) + zvarint(-i) +
+                                  inline_string(std::string{"type\0test", 9}) + name_tag);
+        } else {
+            data += dataset(0x10, zvarint(1) + varint(1) + zvarint(0) + zvarint(0) + varint(k + 2) +
+                                  zvarint(1) + zvarint(-1) +
+                                  varint(k + 1) + name_tag);
+        }
+    }
+    return data;
+}
+
+TEST_CASE("Read large o5m file") {
+    const int num_nodes = 100000;
+    const auto data = make_large_o5m(num_nodes);
+
+    osmium::io::Reader reader{osmium::io::File{data.data(), data.size(), "o5m"}};
+
+    int buffers = 0;
+    osmium::object_id_type id = 0;
+    while (const auto buffer = reader.read()) {
+        ++buffers;
+        for (const auto& node : buffer.select<osmium::Node>()) {
+            REQUIRE(node.id() == ++id);
+            REQUIRE(node.location().x() == id);
+            REQUIRE(node.location().y() == -id);
+            REQUIRE(std::string{node.user()} == "user");
+            REQUIRE(node.uid() == 1);
+            REQUIRE(std::string{node.tags()["name"]} == "node " + std::to_string(id));
+            REQUIRE(std::string{node.tags()["type"]} == "test");
+        }
+    }
+    reader.close();
+
+    REQUIRE(id == num_nodes);
+    REQUIRE(buffers > 1);
+}
+
+TEST_CASE("Read only ways from o5m file") {
+    std::string data{o5m_header};
+    data += dataset(0x10, zvarint(1) + varint(0) + zvarint(0) + zvarint(0));
+    data += reset;
+    data += dataset(0x11, zvarint(2) + varint(0) + varint(1) + zvarint(1));
+    data += reset;
+    data += dataset(0x12, zvarint(3) + varint(0) + varint(0));
+
+    osmium::io::Reader reader{osmium::io::File{data.data(), data.size(), "o5m"}, osmium::osm_entity_bits::way};
+
+    int count = 0;
+    while (const auto buffer = reader.read()) {
+        for (const auto& way : buffer.select<osmium::Way>()) {
+            ++count;
+            REQUIRE(way.id() == 2);
+            REQUIRE(way.nodes().size() == 1);
+        }
+        REQUIRE(std::distance(buffer.begin(), buffer.end()) == count);
+    }
+    reader.close();
+
+    REQUIRE(count == 1);
+}
+
+TEST_CASE("Reading truncated o5m file fails") {
+    std::string data{o5m_header};
+    data += dataset(0x10, zvarint(1) + varint(0) + zvarint(0) + zvarint(0));
+    data.resize(data.size() - 1);
+
+    osmium::io::Reader reader{osmium::io::File{data.data(), data.size(), "o5m"}};
+    REQUIRE_THROWS_AS(reader.read(), const osmium::o5m_error&);
+}
+
@@ -0,0 +1,506 @@
+#include "catch.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <protozero/pbf_builder.hpp>
+
+#include <osmium/builder/attr.hpp>
+#include <osmium/handler.hpp>
+#include <osmium/io/blob_index.hpp>
+#include <osmium/io/gzip_compression.hpp>
+#include <osmium/io/pbf_blob_index.hpp>
+#include <osmium/io/pbf_input.hpp>
+#include <osmium/io/pbf_output.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/util/file.hpp>
+#include <osmium/visitor.hpp>
+
+struct CountHandler : public osmium::handler::Handler {
+
+    int nodes = 0;
+    int ways = 0;
+    osmium::object_id_type id_sum = 0;
+
+    void node(const osmium::Node& node) {
+        ++nodes;
+        id_sum += node.id();
+    }
+
+    void way(const osmium::Way& way) {
+        ++ways;
+        id_sum += way.id();
+    }
+
+}; // struct CountHandler
+
+static osmium::memory::Buffer make_test_buffer(int num_nodes, int num_ways) {
+    using namespace osmium::builder::attr;
+
+    osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+    for (int i = 1; i <= num_nodes; ++i) {
+        osmium::builder::add_node(buffer,
+            _id(i),
+            _version(1),
+            _location(i % 360 - 180, i % 180 - 90),
+            _tag("name", "node number " + std::to_string(i))
+        );
+    }
+    for (int i = 1; i <= num_ways; ++i) {
+        osmium::builder::add_way(buffer,
+            _id(i),
+            _version(1),
+            _nodes({i, i + 1, i + 2}),
+            _tag("highway", "residential")
+        );
+    }
+
+    return buffer;
+}
+
+static void write_test_pbf(const std::string& filename, const std::string& options, int num_nodes, int num_ways, const osmium::io::Header& header = osmium::io::Header{}) {
+    auto buffer = make_test_buffer(num_nodes, num_ways);
+
+    osmium::io::File file{filename, options};
+    osmium::io::Writer writer{file, header, osmium::io::overwrite::allow};
+    writer(std::move(buffer));
+    writer.close();
+}
+
+TEST_CASE("Reader should read PBF file with blobs spanning several input chunks") {
+    // The gzip compression makes sure the data arrives in chunks through
+    // the input queue.
+    const std::string filename{"test-reader-pbf-chunks.osm.pbf.gz"};
+    write_test_pbf(filename, "pbf.gz,pbf_compression=none", 100000, 10000);
+
+    osmium::io::Reader reader{filename};
+    CountHandler handler;
+    osmium::apply(reader, handler);
+    reader.close();
+
+    REQUIRE(handler.nodes == 100000);
+    REQUIRE(handler.ways == 10000);
+    REQUIRE(handler.id_sum == 100000LL * 100001LL / 2 + 10000LL * 10001LL / 2);
+}
+
+TEST_CASE("Reader should read uncompressed PBF file with direct access") {
+    const std::string filename{"test-reader-pbf-direct.osm.pbf"};
+    write_test_pbf(filename, "pbf,pbf_compression=none", 100000, 10000);
+
+    osmium::io::Reader reader{filename};
+    REQUIRE(reader.file_size() > 2 * osmium::io::Decompressor::input_buffer_size);
+
+    CountHandler handler;
+    osmium::apply(reader, handler);
+    REQUIRE(reader.offset() == reader.file_size());
+    reader.close();
+
+    REQUIRE(handler.nodes == 100000);
+    REQUIRE(handler.ways == 10000);
+    REQUIRE(handler.id_sum == 100000LL * 100001LL / 2 + 10000LL * 10001LL / 2);
+}
+
+TEST_CASE("Reader should read compressed PBF file") {
+    const std::string filename{"test-reader-pbf-zlib.osm.pbf"};
+    write_test_pbf(filename, "pbf", 20000, 1000);
+
+    osmium::io::Reader reader{filename};
+    CountHandler handler;
+    osmium::apply(reader, handler);
+    reader.close();
+
+    REQUIRE(handler.nodes == 20000);
+    REQUIRE(handler.ways == 1000);
+}
+
+
+TEST_CASE("Create blob index for PBF file") {
+    const std::string filename{"test-reader-pbf-index.osm.pbf"};
+    write_test_pbf(filename, "pbf", 20000, 10000);
+
+    const auto index = osmium::io::create_pbf_blob_index(filename);
+    REQUIRE(index.size() == 5);
+    REQUIRE(index.file_size() == osmium::util::file_size(filename));
+
+    auto it = index.begin();
+    REQUIRE(it->types == osmium::osm_entity_bits::node);
+    REQUIRE(it->min_id == 1);
+    REQUIRE(it->max_id == 8000);
+    ++it;
+    REQUIRE(it->types == osmium::osm_entity_bits::node);
+    ++it;
+    REQUIRE(it->types == osmium::osm_entity_bits::node);
+    REQUIRE(it->max_id == 20000);
+    ++it;
+    REQUIRE(it->types == osmium::osm_entity_bits::way);
+    REQUIRE(it->min_id == 1);
+    REQUIRE(it->max_id == 8000);
+    ++it;
+    REQUIRE(it->types == osmium::osm_entity_bits::way);
+    REQUIRE(it->min_id == 8001);
+    REQUIRE(it->max_id == 10000);
+    REQUIRE(it->offset + it->size == index.file_size());
+
+    SECTION("write and read back index") {
+        const std::string index_filename{"test-reader-pbf-index.osm.pbf.idx"};
+        osmium::io::write_blob_index(index, index_filename, osmium::io::overwrite::allow);
+        const auto index2 = osmium::io::read_blob_index(index_filename);
+        REQUIRE(index2.file_size() == index.file_size());
+        REQUIRE(index2.size() == index.size());
+        REQUIRE(std::equal(index.begin(), index.end(), index2.begin(), [](const osmium::io::blob_index_entry& a, const osmium::io::blob_index_entry& b) {
+            return a.offset == b.offset && a.size == b.size && a.types == b.types &&
+                   a.min_id == b.min_id && a.max_id == b.max_id;
+        }));
+    }
+}
+
+TEST_CASE("Reader should only decode blobs wanted by the blob filter") {
+    std::string filename{"test-reader-pbf-filter.osm.pbf"};
+    write_test_pbf(filename, "pbf", 20000, 10000);
+
+    const auto index = std::make_shared<const osmium::io::BlobIndex>(osmium::io::create_pbf_blob_index(filename));
+    const osmium::io::blob_filter filter{index, osmium::osm_entity_bits::way, 1, 5000};
+
+    SECTION("with direct access") {
+        filename = "test-reader-pbf-filter.osm.pbf";
+    }
+
+    SECTION("through input queue") {
+        filename = "test-reader-pbf-filter.osm.pbf.gz";
+        write_test_pbf(filename, "pbf", 20000, 10000);
+    }
+
+    osmium::io::Reader reader{filename, filter};
+    CountHandler handler;
+    osmium::apply(reader, handler);
+    reader.close();
+
+    REQUIRE(handler.nodes == 0);
+    REQUIRE(handler.ways == 8000);
+}
+
+TEST_CASE("Reader should read blobs missing from a partial blob index") {
+    const std::string filename{"test-reader-pbf-filter-partial.osm.pbf"};
+    write_test_pbf(filename, "pbf,pbf_add_indexdata=false", 20000, 10000);
+
+    // Leave out the blob with the ways 1 to 8000.
+    const auto full_index = osmium::io::create_pbf_blob_index(filename);
+    REQUIRE(full_index.size() == 5);
+    auto index = std::make_shared<osmium::io::BlobIndex>(full_index.file_size());
+    int n = 0;
+    for (const auto& entry : full_index) {
+        if (n++ != 3) {
+            index->add(entry);
+        }
+    }
+
+    const osmium::io::blob_filter filter{index, osmium::osm_entity_bits::way, 1, 5000};
+    REQUIRE(filter.next_wanted(full_index.begin()->offset) == (full_index.begin() + 3)->offset);
+
+    osmium::io::Reader reader{filename, filter};
+    CountHandler handler;
+    osmium::apply(reader, handler);
+    REQUIRE(reader.offset() == reader.file_size());
+    reader.close();
+
+    REQUIRE(handler.nodes == 0);
+    REQUIRE(handler.ways == 8000);
+}
+
+TEST_CASE("Reader should reject blob index for different file") {
+    const std::string filename{"test-reader-pbf-filter-mismatch.osm.pbf"};
+    write_test_pbf(filename, "pbf", 100, 10);
+
+    const auto index = std::make_shared<const osmium::io::BlobIndex>(osmium::util::file_size(filename) + 1);
+    const osmium::io::blob_filter filter{index, osmium::osm_entity_bits::all};
+
+    osmium::io::Reader reader{filename, filter};
+    REQUIRE_THROWS_AS(reader.header(), const osmium::pbf_error&);
+}
+
+// Overwrite some bytes at the given offset in the file.
+static void damage_file(const std::string& filename, uint64_t offset, const std::string& garbage) {
+    std::fstream file{filename, std::ios::in | std::ios::out | std::ios::binary};
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(garbage.data(), static_cast<std::streamsize>(garbage.size()));
+}
+
+TEST_CASE("Blob index created from BlobHeader indexdata matches scanned index") {
+    const std::string filename_with{"test-reader-pbf-indexdata.osm.pbf"};
+    const std::string filename_without{"test-reader-pbf-no-indexdata.osm.pbf"};
+    write_test_pbf(filename_with, "pbf", 20000, 10000);
+    write_test_pbf(filename_without, "pbf,pbf_add_indexdata=false", 20000, 10000);
+
+    const auto index_with = osmium::io::create_pbf_blob_index(filename_with);
+    const auto index_without = osmium::io::create_pbf_blob_index(filename_without);
+
+    REQUIRE(index_with.size() == 5);
+    REQUIRE(index_with.file_size() > index_without.file_size());
+
+    // offsets differ because of the indexdata, everything else is the same
+    auto it = index_without.begin();
+    for (const auto& entry : index_with) {
+        REQUIRE(entry.types == it->types);
+        REQUIRE(entry.min_id == it->min_id);
+        REQUIRE(entry.max_id == it->max_id);
+        ++it;
+    }
+}
+
+static std::string make_indexdata(const char* magic, uint32_t version) {
+    std::string data;
+    protozero::pbf_builder<osmium::io::detail::FileFormat::IndexData> pbf_indexdata{data};
+    if (magic) {
+        pbf_indexdata.add_string(osmium::io::detail::FileFormat::IndexData::optional_string_magic, magic);
+    }
+    if (version) {
+        pbf_indexdata.add_uint32(osmium::io::detail::FileFormat::IndexData::optional_uint32_version, version);
+    }
+    pbf_indexdata.add_uint32(osmium::io::detail::FileFormat::IndexData::optional_uint32_types, osmium::osm_entity_bits::way);
+    pbf_indexdata.add_sint64(osmium::io::detail::FileFormat::IndexData::optional_sint64_min_id, 10);
+    pbf_indexdata.add_sint64(osmium::io::detail::FileFormat::IndexData::optional_sint64_max_id, 20);
+    return data;
+}
+
+TEST_CASE("Only indexdata written by Osmium is trusted") {
+    osmium::io::blob_index_entry entry;
+
+    SECTION("with magic and known version") {
+        const auto data = make_indexdata(osmium::io::detail::indexdata_magic, osmium::io::detail::indexdata_version);
+        REQUIRE(osmium::io::detail::decode_blob_indexdata(protozero::data_view{data}, entry));
+        REQUIRE(entry.types == osmium::osm_entity_bits::way);
+        REQUIRE(entry.min_id == 10);
+        REQUIRE(entry.max_id == 20);
+    }
+
+    SECTION("without magic") {
+        const auto data = make_indexdata(nullptr, osmium::io::detail::indexdata_version);
+        REQUIRE_FALSE(osmium::io::detail::decode_blob_indexdata(protozero::data_view{data}, entry));
+        REQUIRE(entry.types == osmium::osm_entity_bits::nothing);
+    }
+
+    SECTION("with other magic") {
+        const auto data = make_indexdata("something-else", osmium::io::detail::indexdata_version);
+        REQUIRE_FALSE(osmium::io::detail::decode_blob_indexdata(protozero::data_view{data}, entry));
+        REQUIRE(entry.types == osmium::osm_entity_bits::nothing);
+    }
+
+    SECTION("with unknown version") {
+        const auto data = make_indexdata(osmium::io::detail::indexdata_magic, osmium::io::detail::indexdata_version + 1);
+        REQUIRE_FALSE(osmium::io::detail::decode_blob_indexdata(protozero::data_view{data}, entry));
+        REQUIRE(entry.types == osmium::osm_entity_bits::nothing);
+    }
+}
+
+TEST_CASE("Reader should not decompress blobs with unwanted entity types") {
+    const std::string filename{"test-reader-pbf-skip-types.osm.pbf"};
+    write_test_pbf(filename, "pbf", 20000, 10000);
+
+    // Damage the compressed data at the end of the first node blob, it
+    // can only be read if it is never decompressed.
+    const auto index = osmium::io::create_pbf_blob_index(filename);
+    const auto& first = *index.begin();
+    REQUIRE(first.types == osmium::osm_entity_bits::node);
+    damage_file(filename, first.offset + first.size - 8, std::string(8, 'x'));
+
+    SECTION("with direct access") {
+        osmium::io::Reader reader{filename, osmium::osm_entity_bits::way};
+        CountHandler handler;
+        osmium::apply(reader, handler);
+        reader.close();
+        REQUIRE(handler.ways == 10000);
+    }
+
+    SECTION("through input queue") {
+        const std::string data{read_whole_file(filename)};
+        osmium::io::Reader reader{osmium::io::File{data.data(), data.size(), "pbf"}, osmium::osm_entity_bits::way};
+        CountHandler handler;
+        osmium::apply(reader, handler);
+        reader.close();
+        REQUIRE(handler.ways == 10000);
+    }
+
+    SECTION("damage is detected when nodes are read") {
+        osmium::io::Reader reader{filename, osmium::osm_entity_bits::node};
+        CountHandler handler;
+        REQUIRE_THROWS(osmium::apply(reader, handler));
+    }
+}
+
+TEST_CASE("Reader should stop after the wanted types in sorted files") {
+    const std::string filename{"test-reader-pbf-sorted.osm.pbf"};
+    osmium::io::Header header;
+    header.set("sorting", "Type_then_ID");
+    write_test_pbf(filename, "pbf", 20000, 10000, header);
+
+    // Damage the BlobHeader size of the last blob (a way blob), it can only
+    // be read if the parser stops before it.
+    const auto index = osmium::io::create_pbf_blob_index(filename);
+    const auto& last = *std::prev(index.end());
+    REQUIRE(last.types == osmium::osm_entity_bits::way);
+    damage_file(filename, last.offset, std::string(4, '\xff'));
+
+    SECTION("reading only nodes stops at the first way blob") {
+        osmium::io::Reader reader{filename, osmium::osm_entity_bits::node};
+        REQUIRE(reader.header().get("sorting") == "Type_then_ID");
+        CountHandler handler;
+        osmium::apply(reader, handler);
+        reader.close();
+        REQUIRE(handler.nodes == 20000);
+        REQUIRE(handler.ways == 0);
+    }
+
+    SECTION("reading ways needs the damaged blob") {
+        osmium::io::Reader reader{filename, osmium::osm_entity_bits::way};
+        CountHandler handler;
+        REQUIRE_THROWS_AS(osmium::apply(reader, handler), const osmium::pbf_error&);
+    }
+}
+
+static void check_roundtrip(const std::string& options) {
+    const std::string filename{"test-reader-pbf-compression.osm.pbf"};
+    write_test_pbf(filename, options, 20000, 1000);
+
+    osmium::io::Reader reader{filename};
+    CountHandler handler;
+    osmium::apply(reader, handler);
+    reader.close();
+
+    REQUIRE(handler.nodes == 20000);
+    REQUIRE(handler.ways == 1000);
+}
+
+TEST_CASE("Read PBF files written with different blob compressions") {
+    SECTION("zlib with default level") {
+        check_roundtrip("pbf,pbf_compression=zlib");
+    }
+
+    SECTION("zlib with level 1") {
+        check_roundtrip("pbf,pbf_compression=zlib,pbf_compression_level=1");
+    }
+
+    SECTION("zlib with level 9") {
+        check_roundtrip("pbf,pbf_compression_level=9");
+    }
+
+#ifdef OSMIUM_WITH_LZ4
+    SECTION("lz4") {
+        check_roundtrip("pbf,pbf_compression=lz4");
+    }
+
+    SECTION("lz4 with level 9") {
+        check_roundtrip("pbf,pbf_compression=lz4,pbf_compression_level=9");
+    }
+#endif
+
+#ifdef OSMIUM_WITH_ZSTD
+    SECTION("zstd") {
+        check_roundtrip("pbf,pbf_compression=zstd");
+    }
+
+    SECTION("zstd with level 19") {
+        check_roundtrip("pbf,pbf_compression=zstd,pbf_compression_level=19");
+    }
+#endif
+}
+
+TEST_CASE("Invalid PBF compression options") {
+    const std::string filename{"test-reader-pbf-compression-invalid.osm.pbf"};
+
+    SECTION("unknown compression") {
+        REQUIRE_THROWS_AS(write_test_pbf(filename, "pbf,pbf_compression=foo", 1, 1), const osmium::io_error&);
+    }
+
+    SECTION("level out of range") {
+        REQUIRE_THROWS_AS(write_test_pbf(filename, "pbf,pbf_compression_level=10", 1, 1), const osmium::io_error&);
+    }
+
+    SECTION("level not a number") {
+        REQUIRE_THROWS_AS(write_test_pbf(filename, "pbf,pbf_compression_level=x", 1, 1), const osmium::io_error&);
+    }
+
+#ifndef OSMIUM_WITH_LZ4
+    SECTION("lz4 not available") {
+        REQUIRE_THROWS_AS(write_test_pbf(filename, "pbf,pbf_compression=lz4", 1, 1), const osmium::io_error&);
+    }
+#endif
+}
+
+TEST_CASE("PBF decode scratch space is per thread") {
+    auto& scratch = osmium::io::detail::thread_decode_scratch();
+    REQUIRE(&scratch == &osmium::io::detail::thread_decode_scratch());
+
+    const osmium::io::detail::pbf_decode_scratch* other = nullptr;
+    std::thread thread{[&other]() {
+        other = &osmium::io::detail::thread_decode_scratch();
+    }};
+    thread.join();
+    REQUIRE(other != &scratch);
+}
+
+TEST_CASE("PBF decode scratch space is reused") {
+    const std::string filename{"test-reader-pbf-scratch.osm.pbf"};
+    write_test_pbf(filename, "pbf", 20000, 10000);
+
+    const auto index = osmium::io::create_pbf_blob_index(filename);
+    const std::string data{read_whole_file(filename)};
+    auto& scratch = osmium::io::detail::thread_decode_scratch();
+
+    // Decode all blobs in this thread, so they all use the same scratch space.
+    int nodes = 0;
+    std::size_t capacity = 0;
+    for (const auto& entry : index) {
+        // skip the 4 byte length and the BlobHeader
+        osmium::io::detail::pbf_blob_data blob;
+        uint32_t header_size = 0;
+        std::memcpy(&header_size, data.data() + entry.offset, sizeof(header_size));
+        header_size = ntohl(header_size);
+        const auto blob_offset = entry.offset + sizeof(header_size) + header_size;
+        auto storage = std::make_shared<std::string>(data.substr(blob_offset, entry.size - sizeof(header_size) - header_size));
+        blob.data = protozero::data_view{storage->data(), storage->size()};
+        blob.storage = storage;
+
+        osmium::io::detail::PBFDataBlobDecoder decoder{std::move(blob), osmium::osm_entity_bits::node, osmium::io::read_meta::yes};
+        const auto buffer = decoder();
+        nodes += static_cast<int>(std::distance(buffer.begin<osmium::Node>(), buffer.end<osmium::Node>()));
+
+        if (capacity == 0) {
+            capacity = scratch.uncompressed.capacity();
+        } else {
+            REQUIRE(scratch.uncompressed.capacity() >= capacity);
+        }
+    }
+
+    REQUIRE(capacity > 0);
+    REQUIRE(nodes == 20000);
+}
+
+TEST_CASE("PBF output does not depend on buffer boundaries and number of threads") {
+    const std::string filename1{"test-reader-pbf-parallel-1.osm.pbf"};
+    const std::string filename2{"test-reader-pbf-parallel-2.osm.pbf"};
+
+    write_test_pbf(filename1, "pbf", 20000, 10000);
+
+    {
+        // write the same objects one by one through the internal buffer
+        // of the Writer using a pool with a different number of threads
+        const auto buffer = make_test_buffer(20000, 10000);
+        osmium::thread::Pool pool{3};
+        osmium::io::Writer writer{osmium::io::File{filename2, "pbf"}, pool, osmium::io::overwrite::allow};
+        writer.set_buffer_size(1000);
+        for (const auto& object : buffer.select<osmium::OSMObject>()) {
+            writer(object);
+        }
+        writer.close();
+    }
+
+    const auto data1 = read_whole_file(filename1);
+    const auto data2 = read_whole_file(filename2);
+    REQUIRE(data1.size() > 0);
+    REQUIRE(data1 == data2);
+}
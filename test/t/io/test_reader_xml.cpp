@@ -0,0 +1,117 @@
+#include "catch.hpp"
+
+#include <osmium/io/xml_input.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/way.hpp>
+
+#include <string>
+
+// Create an OSM XML file with num_nodes nodes and a way after every tenth
+// node. If decoys is set, comments containing a node element are added
+// after each object.
+static std::string make_large_xml(int num_nodes, bool decoys = false) {
+    std::string data{"<?xml version='1.0' encoding='UTF-8'?>\n<osm version=\"0.6\" generator=\"test\">\n"};
+    data += "  <bounds minlat=\"0\" minlon=\"0\" maxlat=\"10\" maxlon=\"10\"/>\n";
+    for (int i = 1; i <= num_nodes; ++i) {
+        const auto id = std::to_string(i);
+        data += "  <node id=\"" + id + "\" version=\"1\" lat=\"1.5\" lon=\"2.5\">\n";
+        data += "    <tag k=\"name\" v=\"node &amp; number " + id + "\"/>\n";
+        data += "  </node>\n";
+        if (decoys) {
+            data += "  <!-- <node id=\"-" + id + "\" lat=\"0\" lon=\"0\"/> -->\n";
+        }
+        if (i % 10 == 0) {
+            data += "  <way id=\"" + id + "\" version=\"1\">\n    <nd ref=\"" + id + "\"/>\n  </way>\n";
+        }
+    }
+    data += "</osm>\n";
+    return data;
+}
+
+static void check_large_xml(const std::string& data, int num_nodes) {
+    osmium::io::Reader reader{osmium::io::File{data.data(), data.size(), "osm"}};
+
+    REQUIRE(reader.header().get("generator") == "test");
+    REQUIRE(reader.header().box() == osmium::Box(0, 0, 10, 10));
+
+    int buffers = 0;
+    osmium::object_id_type node_id = 0;
+    osmium::object_id_type way_id = 0;
+    while (const auto buffer = reader.read()) {
+        ++buffers;
+        for (const auto& object : buffer.select<osmium::OSMObject>()) {
+            if (object.type() == osmium::item_type::node) {
+                REQUIRE(object.id() == ++node_id);
+                REQUIRE(static_cast<const osmium::Node&>(object).location() == osmium::Location(2.5, 1.5));
+                REQUIRE(std::string{object.tags()["name"]} == "node & number " + std::to_string(node_id));
+            } else {
+                REQUIRE(object.type() == osmium::item_type::way);
+                REQUIRE(object.id() == node_id);
+                REQUIRE(object.id() == way_id + 10);
+                way_id = object.id();
+                REQUIRE(static_cast<const osmium::Way&>(object).nodes().front().ref() == node_id);
+            }
+        }
+    }
+    reader.close();
+
+    REQUIRE(node_id == num_nodes);
+    REQUIRE(way_id == num_nodes);
+    REQUIRE(buffers > 1);
+}
+
+TEST_CASE("Read large XML file in chunks") {
+    const int num_nodes = 50000;
+    const std::string data = make_large_xml(num_nodes);
+    REQUIRE(data.size() > 4 * 1024 * 1024);
+
+    check_large_xml(data, num_nodes);
+}
+
+TEST_CASE("Read large XML file with object elements in comments") {
+    const int num_nodes = 30000;
+    const std::string data = make_large_xml(num_nodes, true);
+    REQUIRE(data.size() > 4 * 1024 * 1024);
+
+    check_large_xml(data, num_nodes);
+}
+
+TEST_CASE("Line numbers in XML errors are counted over all chunks") {
+    std::string data = make_large_xml(50000);
+    data.insert(data.size() - 7, "  <node id=\"1\">\n  </way>\n");
+
+    osmium::io::Reader reader{osmium::io::File{data.data(), data.size(), "osm"}};
+    try {
+        while (reader.read()) {
+        }
+        REQUIRE(false);
+    } catch (const osmium::xml_error& e) {
+        // header, 3 lines per node, 3 lines per way, and the new node
+        REQUIRE(e.line == 3 + 50000 * 3 + 5000 * 3 + 1 + 1);
+        REQUIRE(e.error_code == XML_ERROR_TAG_MISMATCH);
+    }
+}
+
+TEST_CASE("Read large OSM change file") {
+    std::string data{"<?xml version='1.0' encoding='UTF-8'?>\n<osmChange version=\"0.6\">\n"};
+    const int num_nodes = 50000;
+    for (int i = 1; i <= num_nodes; ++i) {
+        const char* section = (i % 2) ? "modify" : "delete";
+        data += std::string{"  <"} + section + ">\n    <node id=\"" + std::to_string(i) +
+                "\" version=\"2\" lat=\"1\" lon=\"2\"/>\n  </" + section + ">\n";
+    }
+    data += "</osmChange>\n";
+
+    osmium::io::Reader reader{osmium::io::File{data.data(), data.size(), "osc"}};
+    osmium::object_id_type id = 0;
+    while (const auto buffer = reader.read()) {
+        for (const auto& node : buffer.select<osmium::Node>()) {
+            REQUIRE(node.id() == ++id);
+            REQUIRE(node.visible() == (id % 2 == 1));
+        }
+    }
+    reader.close();
+
+    REQUIRE(id == num_nodes);
+}
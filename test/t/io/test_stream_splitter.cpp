@@ -0,0 +1,100 @@
+
+#include "catch.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/detail/stream_splitter.hpp>
+#include <osmium/util/file.hpp>
+
+static bool is_test_stream_start(const char* data) noexcept {
+    return std::memcmp(data, "STRM", 4) == 0;
+}
+
+static void write_file(const std::string& filename, const std::string& data) {
+    std::ofstream out{filename, std::ios::binary};
+    out << data;
+}
+
+TEST_CASE("Split file with many streams into blocks") {
+    const std::string filename{"test-stream-splitter-many.dat"};
+    std::string data;
+    for (int i = 0; i < 10; ++i) {
+        data += "STRM";
+        data.append(300 * 1024, 'x');
+    }
+    write_file(filename, data);
+
+    const int fd = osmium::io::detail::open_for_reading(filename);
+    osmium::io::detail::StreamSplitter splitter{fd, 'S', 4, is_test_stream_start};
+
+    std::vector<std::string> blocks;
+    for (std::string block = splitter.next_block(); !block.empty(); block = splitter.next_block()) {
+        blocks.push_back(block);
+    }
+    osmium::io::detail::reliable_close(fd);
+
+    REQUIRE_FALSE(splitter.gave_up());
+    REQUIRE(splitter.offset() == data.size());
+    REQUIRE(blocks.size() == 3);
+
+    std::string all;
+    for (const auto& block : blocks) {
+        REQUIRE(block.substr(0, 4) == "STRM");
+        all += block;
+    }
+    REQUIRE(all == data);
+
+    const std::size_t min_block_size = osmium::io::detail::StreamSplitter::min_block_size;
+    REQUIRE(blocks[0].size() >= min_block_size);
+    REQUIRE(blocks[1].size() >= min_block_size);
+}
+
+TEST_CASE("Split file with a single stream") {
+    const std::string filename{"test-stream-splitter-single.dat"};
+
+    SECTION("small file") {
+        write_file(filename, "STRMxxxx");
+
+        const int fd = osmium::io::detail::open_for_reading(filename);
+        osmium::io::detail::StreamSplitter splitter{fd, 'S', 4, is_test_stream_start};
+
+        REQUIRE(splitter.next_block() == "STRMxxxx");
+        REQUIRE(splitter.next_block().empty());
+        REQUIRE_FALSE(splitter.gave_up());
+        osmium::io::detail::reliable_close(fd);
+    }
+
+    SECTION("file too large for one block") {
+        std::string data{"STRM"};
+        data.append(osmium::io::detail::StreamSplitter::max_block_size + 100, 'S');
+        write_file(filename, data);
+
+        const int fd = osmium::io::detail::open_for_reading(filename);
+        osmium::io::detail::StreamSplitter splitter{fd, 'S', 4, is_test_stream_start};
+
+        REQUIRE(splitter.next_block().empty());
+        REQUIRE(splitter.gave_up());
+        REQUIRE(splitter.offset() == 0);
+        REQUIRE(osmium::util::file_offset(fd) == 0);
+        REQUIRE(splitter.next_block().empty());
+        osmium::io::detail::reliable_close(fd);
+    }
+
+    SECTION("file not starting with a stream header") {
+        write_file(filename, "xxxxSTRMxxxx");
+
+        const int fd = osmium::io::detail::open_for_reading(filename);
+        osmium::io::detail::StreamSplitter splitter{fd, 'S', 4, is_test_stream_start};
+
+        REQUIRE(splitter.next_block().empty());
+        REQUIRE(splitter.gave_up());
+        REQUIRE(osmium::util::file_offset(fd) == 0);
+        osmium::io::detail::reliable_close(fd);
+    }
+}
+
@@ -2,8 +2,12 @@
 #include "utils.hpp"
 
 #include <algorithm>
+#include <string>
 
+#include <osmium/builder/attr.hpp>
 #include <osmium/io/any_compression.hpp>
+#include <osmium/io/debug_output.hpp>
+#include <osmium/io/opl_output.hpp>
 #include <osmium/io/xml_input.hpp>
 #include <osmium/io/xml_output.hpp>
 #include <osmium/io/output_iterator.hpp>
@@ -148,3 +152,92 @@ TEST_CASE("Writer with user-provided pool") {
         writer.close();
     }
 }
+
+TEST_CASE("Text formats encode large buffers in several blocks in order") {
+    using namespace osmium::builder::attr;
+
+    osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+    for (int i = 1; i <= 30000; ++i) {
+        osmium::builder::add_node(buffer,
+            _id(i),
+            _version(1),
+            _location(i % 360 - 180, i % 180 - 90),
+            _tag("name", "node number " + std::to_string(i))
+        );
+    }
+    REQUIRE(buffer.committed() > 2 * 1024 * 1024);
+
+    osmium::io::Header header;
+    header.set("generator", "test_writer.cpp");
+
+    for (const std::string format : {"opl", "osm", "debug"}) {
+        const std::string filename_whole{"test-writer-blocks-whole." + format};
+        const std::string filename_single{"test-writer-blocks-single." + format};
+
+        {
+            osmium::memory::Buffer copy{buffer.committed()};
+            copy.add_buffer(buffer);
+            copy.commit();
+            osmium::io::Writer writer{filename_whole, header, osmium::io::overwrite::allow};
+            writer(std::move(copy));
+            writer.close();
+        }
+
+        {
+            osmium::io::Writer writer{filename_single, header, osmium::io::overwrite::allow};
+            for (const auto& node : buffer.select<osmium::Node>()) {
+                osmium::memory::Buffer single{node.byte_size()};
+                single.add_item(node);
+                single.commit();
+                writer(std::move(single));
+            }
+            writer.close();
+        }
+
+        const std::string whole{read_whole_file(filename_whole)};
+        REQUIRE(whole.size() > 1024 * 1024);
+        REQUIRE(whole == read_whole_file(filename_single));
+    }
+}
+
+static std::size_t count_substr(const std::string& str, const std::string& substr) {
+    std::size_t count = 0;
+    for (auto pos = str.find(substr); pos != std::string::npos; pos = str.find(substr, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+TEST_CASE("osmChange sections are carried over block boundaries") {
+    using namespace osmium::builder::attr;
+
+    osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+    for (int i = 1; i <= 30000; ++i) {
+        osmium::builder::add_node(buffer,
+            _id(i),
+            _version(i <= 20000 ? 1 : 2),
+            _location(i % 360 - 180, i % 180 - 90),
+            _tag("name", "node number " + std::to_string(i))
+        );
+    }
+    REQUIRE(buffer.committed() > 2 * 1024 * 1024);
+
+    osmium::io::Header header;
+    header.set("generator", "test_writer.cpp");
+
+    const std::string filename{"test-writer-blocks.osc"};
+    {
+        osmium::io::Writer writer{filename, header, osmium::io::overwrite::allow};
+        writer(std::move(buffer));
+        writer.close();
+    }
+
+    const std::string data{read_whole_file(filename)};
+    REQUIRE(count_substr(data, "<create>") == 1);
+    REQUIRE(count_substr(data, "</create>") == 1);
+    REQUIRE(count_substr(data, "<modify>") == 1);
+    REQUIRE(count_substr(data, "</modify>") == 1);
+    REQUIRE(count_substr(data, "<node ") == 30000);
+    REQUIRE(data.find("</create>\n  <modify>\n") != std::string::npos);
+    REQUIRE(data.substr(data.size() - 25) == "  </modify>\n</osmChange>\n");
+}
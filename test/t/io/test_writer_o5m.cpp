@@ -0,0 +1,197 @@
+#include "catch.hpp"
+
+#include <osmium/builder/attr.hpp>
+#include <osmium/io/o5m_input.hpp>
+#include <osmium/io/o5m_output.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/way.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace osmium::builder::attr;
+
+static void check_same_object(const osmium::OSMObject& a, const osmium::OSMObject& b, bool metadata = true) {
+    REQUIRE(a.type() == b.type());
+    REQUIRE(a.id() == b.id());
+    REQUIRE(a.visible() == b.visible());
+    if (metadata) {
+        REQUIRE(a.version() == b.version());
+        if (a.version() != 0) {
+            REQUIRE(a.timestamp() == b.timestamp());
+            if (a.timestamp()) {
+                REQUIRE(a.changeset() == b.changeset());
+                REQUIRE(a.uid() == b.uid());
+                if (a.uid() != 0) {
+                    REQUIRE(std::string{a.user()} == b.user());
+                }
+            }
+        }
+    } else {
+        REQUIRE(b.version() == 0);
+        REQUIRE(std::string{b.user()}.empty());
+    }
+
+    if (!a.visible()) {
+        return;
+    }
+
+    REQUIRE(a.tags().size() == b.tags().size());
+    auto tb = b.tags().begin();
+    for (const auto& tag : a.tags()) {
+        REQUIRE(std::string{tag.key()} == tb->key());
+        REQUIRE(std::string{tag.value()} == tb->value());
+        ++tb;
+    }
+
+    if (a.type() == osmium::item_type::node) {
+        REQUIRE(static_cast<const osmium::Node&>(a).location() == static_cast<const osmium::Node&>(b).location());
+    } else if (a.type() == osmium::item_type::way) {
+        const auto& na = static_cast<const osmium::Way&>(a).nodes();
+        const auto& nb = static_cast<const osmium::Way&>(b).nodes();
+        REQUIRE(na.size() == nb.size());
+        for (std::size_t i = 0; i < na.size(); ++i) {
+            REQUIRE(na[i].ref() == nb[i].ref());
+        }
+    } else {
+        const auto& ma = static_cast<const osmium::Relation&>(a).members();
+        const auto& mb = static_cast<const osmium::Relation&>(b).members();
+        REQUIRE(ma.size() == mb.size());
+        auto it = mb.begin();
+        for (const auto& member : ma) {
+            REQUIRE(member.type() == it->type());
+            REQUIRE(member.ref() == it->ref());
+            REQUIRE(std::string{member.role()} == it->role());
+            ++it;
+        }
+    }
+}
+
+static void check_round_trip(const osmium::memory::Buffer& buffer, const osmium::io::File& file, bool metadata = true) {
+    osmium::io::Header header;
+    header.add_box(osmium::Box{-1.5, -2.5, 3.5, 4.5});
+    header.set("timestamp", "2017-07-14T02:40:00Z");
+
+    {
+        osmium::io::Writer writer{file, header, osmium::io::overwrite::allow};
+        for (const auto& item : buffer) {
+            writer(item);
+        }
+        writer.close();
+    }
+
+    osmium::io::Reader reader{file.filename()};
+    REQUIRE(reader.header().box() == osmium::Box(-1.5, -2.5, 3.5, 4.5));
+    REQUIRE(reader.header().get("timestamp") == "2017-07-14T02:40:00Z");
+
+    std::vector<osmium::memory::Buffer> buffers;
+    while (auto b = reader.read()) {
+        buffers.push_back(std::move(b));
+    }
+    reader.close();
+
+    auto it = buffer.select<osmium::OSMObject>().cbegin();
+    const auto end = buffer.select<osmium::OSMObject>().cend();
+    for (const auto& b : buffers) {
+        for (const auto& object : b.select<osmium::OSMObject>()) {
+            REQUIRE(it != end);
+            check_same_object(*it, object, metadata);
+            ++it;
+        }
+    }
+    REQUIRE(it == end);
+}
+
+TEST_CASE("Write small o5m file and read it back") {
+    osmium::memory::Buffer buffer{10240, osmium::memory::Buffer::auto_grow::yes};
+
+    const std::string long_value(300, 'x');
+
+    osmium::builder::add_node(buffer, _id(1), _version(3), _timestamp("2016-01-01T00:00:00Z"), _cid(100), _uid(7), _user("foo"),
+             _location(1.5, -2.5), _tag("highway", "primary"), _tag("long", long_value.c_str()));
+    osmium::builder::add_node(buffer, _id(5), _version(1), _timestamp("2016-01-02T00:00:00Z"), _cid(99), _uid(7), _user("foo"),
+             _location(-179.9999999, 89.9999999), _tag("highway", "primary"), _tag("long", long_value.c_str()));
+    osmium::builder::add_node(buffer, _id(6), _version(1), _timestamp("2016-01-03T00:00:00Z"), _cid(101),
+             _location(0.0, 0.0));
+    osmium::builder::add_node(buffer, _id(7), _location(3.0, 4.0), _tag("name", "no metadata"));
+    osmium::builder::add_node(buffer, _id(-8), _version(2), _timestamp("2016-01-04T00:00:00Z"), _cid(102), _uid(7), _user("foo"),
+             _location(0.5, 0.5));
+    osmium::builder::add_way(buffer, _id(10), _version(1), _timestamp("2016-01-01T00:00:00Z"), _cid(100), _uid(8), _user("bar"),
+            _nodes({1, 5, 6, 7, 1}), _tag("highway", "primary"));
+    osmium::builder::add_way(buffer, _id(11), _version(1), _timestamp("2016-01-01T00:00:00Z"), _cid(100), _uid(8), _user("bar"));
+    osmium::builder::add_relation(buffer, _id(20), _version(1), _timestamp("2016-01-01T00:00:00Z"), _cid(100), _uid(7), _user("foo"),
+                 _member(osmium::item_type::node, 1, "stop"),
+                 _member(osmium::item_type::way, 10, ""),
+                 _member(osmium::item_type::relation, 21, "stop"),
+                 _member(osmium::item_type::node, 5, "stop"),
+                 _tag("type", "route"));
+    osmium::builder::add_relation(buffer, _id(21), _version(1), _timestamp("2016-01-01T00:00:00Z"), _cid(100), _uid(7), _user("foo"));
+
+    SECTION("with metadata") {
+        check_round_trip(buffer, osmium::io::File{"test-writer-o5m-out.o5m"});
+    }
+
+    SECTION("without metadata") {
+        check_round_trip(buffer, osmium::io::File{"test-writer-o5m-out-no-metadata.o5m", "o5m,add_metadata=false"}, false);
+    }
+}
+
+TEST_CASE("Write o5m and o5c files with deleted objects and read them back") {
+    osmium::memory::Buffer buffer{10240, osmium::memory::Buffer::auto_grow::yes};
+
+    osmium::builder::add_node(buffer, _id(1), _version(1), _timestamp("2016-01-01T00:00:00Z"), _cid(100), _uid(7), _user("foo"),
+             _location(1.5, -2.5), _tag("highway", "primary"));
+    osmium::builder::add_node(buffer, _id(1), _version(2), _timestamp("2016-01-02T00:00:00Z"), _cid(101), _uid(7), _user("foo"),
+             _deleted());
+    osmium::builder::add_way(buffer, _id(10), _version(2), _timestamp("2016-01-02T00:00:00Z"), _cid(101), _uid(7), _user("foo"),
+            _deleted());
+    osmium::builder::add_relation(buffer, _id(20), _version(2), _timestamp("2016-01-02T00:00:00Z"), _cid(101), _uid(7), _user("foo"),
+                 _deleted());
+
+    SECTION("o5c") {
+        check_round_trip(buffer, osmium::io::File{"test-writer-o5m-out.o5c"});
+    }
+
+    SECTION("o5m") {
+        check_round_trip(buffer, osmium::io::File{"test-writer-o5m-out-deleted.o5m"});
+    }
+}
+
+TEST_CASE("Write large o5m file and read it back") {
+    osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+
+    // Each node adds at least three new strings to the string table, so
+    // the names are already dropped from the table when they come up again.
+    const int num_nodes = 30000;
+    for (int i = 1; i <= num_nodes; ++i) {
+        const auto name = "name " + std::to_string(i % 6000);
+        const auto user = "user " + std::to_string(i % 100);
+        const auto value = std::to_string(i);
+        osmium::builder::add_node(buffer, _id(i), _version(1), _timestamp(osmium::Timestamp{1400000000 + i}), _cid(1000 + i / 10),
+                 _uid(i % 100), _user(user.c_str()),
+                 _location(i * 0.0001, -i * 0.0001), _tag("name", name.c_str()), _tag("type", "test"),
+                 _tag("a", value.c_str()), _tag("b", value.c_str()), _tag("c", value.c_str()));
+    }
+    for (int i = 1; i <= num_nodes / 10; ++i) {
+        osmium::builder::add_way(buffer, _id(i), _version(2), _timestamp(osmium::Timestamp{1400000000 + i}), _cid(1000 + i),
+                _uid(5), _user("user"), _nodes({i * 10 - 9, i * 10 - 5, i * 10}), _tag("name", "way"));
+    }
+
+    check_round_trip(buffer, osmium::io::File{"test-writer-o5m-out-large.o5m"});
+
+    SECTION("Read only the ways") {
+        osmium::io::Reader reader{"test-writer-o5m-out-large.o5m", osmium::osm_entity_bits::way};
+        osmium::object_id_type id = 0;
+        while (const auto b = reader.read()) {
+            for (const auto& way : b.select<osmium::Way>()) {
+                REQUIRE(way.id() == ++id);
+                REQUIRE(way.nodes().back().ref() == id * 10);
+            }
+        }
+        reader.close();
+        REQUIRE(id == num_nodes / 10);
+    }
+}
+
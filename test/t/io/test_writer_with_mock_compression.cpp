@@ -2,9 +2,14 @@
 #include "catch.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
+#include <osmium/builder/attr.hpp>
 #include <osmium/io/compression.hpp>
 #include <osmium/io/xml_input.hpp>
 #include <osmium/io/xml_output.hpp>
@@ -97,3 +102,104 @@ TEST_CASE("Write with mock compressor") {
 
 }
 
+
+class MockBlockCompressor : public osmium::io::Compressor {
+
+    std::string m_fail_in;
+    std::shared_ptr<std::string> m_output;
+
+public:
+
+    MockBlockCompressor(const std::string& fail_in, const std::shared_ptr<std::string>& output) :
+        Compressor(osmium::io::fsync::no),
+        m_fail_in(fail_in),
+        m_output(output) {
+    }
+
+    ~MockBlockCompressor() noexcept final = default;
+
+    void write(const std::string&) final {
+        throw std::logic_error{"write must not be called"};
+    }
+
+    void close() final {
+    }
+
+    bool can_compress_blocks() const noexcept final {
+        return true;
+    }
+
+    std::string compress_block(const std::string& data) const final {
+        if (m_fail_in == "compress_block") {
+            throw std::logic_error{"compress_block"};
+        }
+        return "[" + data + "]";
+    }
+
+    void write_compressed(const std::string& data) final {
+        *m_output += data;
+    }
+
+}; // class MockBlockCompressor
+
+TEST_CASE("Write with mock block compressor") {
+    using namespace osmium::builder::attr;
+
+    std::string fail_in;
+    const auto output = std::make_shared<std::string>();
+
+    // The factory keeps the first registration, so this uses a different
+    // compression than the test above.
+    osmium::io::CompressionFactory::instance().register_compression(osmium::io::file_compression::bzip2,
+        [&](int, osmium::io::fsync) { return new MockBlockCompressor(fail_in, output); },
+        [](int) { return nullptr; },
+        [](const char*, size_t) { return nullptr; }
+    );
+
+    osmium::io::Header header;
+    header.set("generator", "test_writer_with_mock_compression.cpp");
+
+    osmium::memory::Buffer buffer{1024 * 1024, osmium::memory::Buffer::auto_grow::yes};
+    for (int i = 1; i <= 30000; ++i) {
+        osmium::builder::add_node(buffer, _id(i), _version(1), _location(1.5, 2.5));
+    }
+
+    SECTION("blocks are written in order") {
+        {
+            osmium::memory::Buffer copy{buffer.committed()};
+            copy.add_buffer(buffer);
+            copy.commit();
+            osmium::io::Writer writer{"test-writer-mock-uncompressed.osm", header, osmium::io::overwrite::allow};
+            writer(std::move(copy));
+            writer.close();
+        }
+
+        osmium::io::Writer writer{"test-writer-mock-blocks.osm.bz2", header, osmium::io::overwrite::allow};
+        writer(std::move(buffer));
+        writer.close();
+
+        std::ifstream in{"test-writer-mock-uncompressed.osm", std::ios::binary};
+        const std::string expected{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+        REQUIRE(expected.size() > 1024 * 1024);
+
+        REQUIRE(std::count(output->begin(), output->end(), '[') > 1);
+        REQUIRE(output->front() == '[');
+        REQUIRE(output->back() == ']');
+
+        std::string data{*output};
+        data.erase(std::remove(data.begin(), data.end(), '['), data.end());
+        data.erase(std::remove(data.begin(), data.end(), ']'), data.end());
+        REQUIRE(data == expected);
+    }
+
+    SECTION("fail on compress_block") {
+        fail_in = "compress_block";
+
+        REQUIRE_THROWS_AS([&](){
+            osmium::io::Writer writer("test-writer-mock-fail-on-compress-block.osm.bz2", header, osmium::io::overwrite::allow);
+            writer(std::move(buffer));
+            writer.close();
+        }(), const std::logic_error&);
+    }
+
+}
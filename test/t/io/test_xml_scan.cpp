@@ -0,0 +1,43 @@
+#include "catch.hpp"
+#include "utils.hpp"
+
+#include <osmium/io/detail/xml_scan.hpp>
+
+#include <string>
+
+namespace scan = osmium::io::detail::xml_scan;
+
+TEST_CASE("Find end of name") {
+    for (const std::string str : {"", "a", "node id", "tag\tk", "nd\nref", "k=", "nd/>", "osm>",
+                                  "abcdefghijklmnopqrstuvwxyz0123456789", "osmChange\r\n",
+                                  "abcdefghijklmnopqrstuvwxyz0123456789:_-.>"}) {
+        check_at_all_offsets(str, scan::find_name_end, scan::scalar_find_name_end);
+    }
+
+    const char* s = "node id=\"1\"";
+    REQUIRE(scan::find_name_end(s) == s + 4);
+}
+
+TEST_CASE("Find special character in attribute value") {
+    for (const std::string str : {"", "a", "abc\"", "abc'", "a&amp;b", "a<b", "a\tb", "a\nb", "a\rb",
+                                  "abcdefghijklmnopqrstuvwxyz0123456789 \"",
+                                  "abcdefghijklmnopqrstuvwxyz0123456789 '",
+                                  "\xc3\xa4\xc3\xb6\xc3\xbc\xc3\xa4\xc3\xb6\xc3\xbc\xc3\xa4\xc3\xb6\xc3\xbc=/>\""}) {
+        check_at_all_offsets(str, scan::find_value_special<'"'>, scan::scalar_find_value_special<'"'>);
+        check_at_all_offsets(str, scan::find_value_special<'\''>, scan::scalar_find_value_special<'\''>);
+    }
+
+    const char* s = "it's \"quoted\"";
+    REQUIRE(scan::find_value_special<'"'>(s) == s + 5);
+    REQUIRE(scan::find_value_special<'\''>(s) == s + 2);
+}
+
+TEST_CASE("Find first non-space character") {
+    for (const std::string str : {"", "a", " a", "\t\n\r x", "  \n  \n  \n  \n  \n  \n<node",
+                                  "                                  ", "\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n/>"}) {
+        check_at_all_offsets(str, scan::find_non_space, scan::scalar_find_non_space);
+    }
+
+    const char* s = " \n\t<tag";
+    REQUIRE(scan::find_non_space(s) == s + 3);
+}
@@ -0,0 +1,219 @@
+#include "catch.hpp"
+
+#include <osmium/io/detail/xml_input_format.hpp>
+#include <osmium/io/xml_input.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/node.hpp>
+
+#include <expat.h>
+
+#include <string>
+
+namespace {
+
+    // Records all callbacks in a string. Consecutive character data is
+    // merged, because Expat reports it in several pieces.
+    struct recorder {
+
+        std::string log;
+        std::string text;
+
+        void flush_text() {
+            if (!text.empty()) {
+                log += "{" + text + "}";
+                text.clear();
+            }
+        }
+
+        void start_element(const char* element, const char** attrs) {
+            flush_text();
+            log += "<";
+            log += element;
+            for (; *attrs; attrs += 2) {
+                log += " ";
+                log += attrs[0];
+                log += "=[";
+                log += attrs[1];
+                log += "]";
+            }
+            log += ">";
+        }
+
+        void end_element(const char* element) {
+            flush_text();
+            log += "</";
+            log += element;
+            log += ">";
+        }
+
+        void characters(const char* data, int len) {
+            text.append(data, static_cast<std::size_t>(len));
+        }
+
+    }; // struct recorder
+
+    std::string parse_with_expat(const std::string& data) {
+        recorder r;
+        XML_Parser parser = XML_ParserCreate(nullptr);
+        XML_SetUserData(parser, &r);
+        XML_SetElementHandler(parser,
+            [](void* ud, const XML_Char* element, const XML_Char** attrs) {
+                static_cast<recorder*>(ud)->start_element(element, attrs);
+            },
+            [](void* ud, const XML_Char* element) {
+                static_cast<recorder*>(ud)->end_element(element);
+            });
+        XML_SetCharacterDataHandler(parser, [](void* ud, const XML_Char* text, int len) {
+            static_cast<recorder*>(ud)->characters(text, len);
+        });
+        const auto status = XML_Parse(parser, data.data(), static_cast<int>(data.size()), 1);
+        XML_ParserFree(parser);
+        REQUIRE(status == XML_STATUS_OK);
+        r.flush_text();
+        return r.log;
+    }
+
+    // Parse data with the tokenizer, split into two chunks at pos.
+    std::string parse_with_tokenizer(const std::string& data, std::size_t pos) {
+        recorder r;
+        osmium::io::detail::XMLTokenizer<recorder> tokenizer{&r};
+        std::string first{data.substr(0, pos)};
+        std::string second{data.substr(pos)};
+        REQUIRE(tokenizer(first, false));
+        REQUIRE(tokenizer(second, true));
+        r.flush_text();
+        return r.log;
+    }
+
+    bool tokenizer_accepts(const std::string& data) {
+        recorder r;
+        osmium::io::detail::XMLTokenizer<recorder> tokenizer{&r};
+        std::string input{data};
+        const bool result = tokenizer(input, true);
+        if (!result) {
+            REQUIRE(r.log.empty());
+        }
+        return result;
+    }
+
+    osmium::xml_error tokenizer_error(const std::string& data) {
+        recorder r;
+        osmium::io::detail::XMLTokenizer<recorder> tokenizer{&r};
+        std::string input{data};
+        try {
+            tokenizer(input, true);
+        } catch (const osmium::xml_error& e) {
+            return e;
+        }
+        FAIL("expected xml_error");
+        return osmium::xml_error{""};
+    }
+
+} // anonymous namespace
+
+TEST_CASE("XML tokenizer gives same results as Expat") {
+    const std::string data{
+        "\xef\xbb\xbf<?xml version='1.0' encoding=\"utf-8\"?>\n"
+        "<!-- comment with <tags> -->\n"
+        "<osm version=\"0.6\" generator='test'>\n"
+        "  <node id=\"1\" lat = \"1.5\" lon='2.5' user=\"a &amp; b &lt;&gt;&quot;&apos;\">\n"
+        "    <tag k=\"name\" v=\"&#228;&#x1F600;&#xe4;\"/>\n"
+        "    <tag k=\"ws\" v=\"a\tb\nc\r\nd\re&#10;f\"/>\n"
+        "    <tag k=\"quotes\" v='say \"hi\"'/>\n"
+        "  </node>\r\n"
+        "  <way id=\"2\"><nd ref=\"1\"/><nd\n ref=\"2\"\n/></way >\n"
+        "  <changeset id=\"3\"><discussion><comment><text>a &amp; b\r\nc</text></comment>"
+        "<comment><text><![CDATA[<raw> & data]]></text></comment></discussion></changeset>\n"
+        "  <?pi data?>\n"
+        "  <relation id=\"4\"/>\n"
+        "</osm>\n"
+        "<!-- trailing comment -->\n"
+    };
+
+    const std::string expected{parse_with_expat(data)};
+    REQUIRE(expected.find("<tag k=[ws] v=[a b c d e\nf]>") != std::string::npos);
+
+    for (std::size_t pos = 0; pos <= data.size(); ++pos) {
+        REQUIRE(parse_with_tokenizer(data, pos) == expected);
+    }
+}
+
+TEST_CASE("XML tokenizer reads data in small chunks") {
+    const std::string data{"<osm version=\"0.6\"><node id=\"1\"><tag k=\"a\" v=\"&lt;b&gt;\"/></node></osm>"};
+
+    recorder r;
+    osmium::io::detail::XMLTokenizer<recorder> tokenizer{&r};
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        std::string chunk(1, data[i]);
+        REQUIRE(tokenizer(chunk, false));
+    }
+    std::string empty;
+    REQUIRE(tokenizer(empty, true));
+
+    REQUIRE(r.log == parse_with_expat(data));
+}
+
+TEST_CASE("XML tokenizer falls back to Expat for unusual input") {
+    REQUIRE(tokenizer_accepts("<?xml version=\"1.0\" encoding=\"UTF-8\"?><osm/>"));
+    REQUIRE(tokenizer_accepts("\xef\xbb\xbf<osm/>"));
+    REQUIRE_FALSE(tokenizer_accepts("<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?><osm/>"));
+    REQUIRE_FALSE(tokenizer_accepts("<!DOCTYPE osm [ <!ENTITY a \"b\"> ]><osm/>"));
+    REQUIRE_FALSE(tokenizer_accepts(std::string{"\xff\xfe<\0o\0s\0m\0/\0>\0", 14}));
+}
+
+TEST_CASE("XML tokenizer reports errors like Expat") {
+    SECTION("empty input") {
+        const auto e = tokenizer_error("");
+        REQUIRE(e.error_code == XML_ERROR_NO_ELEMENTS);
+        REQUIRE(e.line == 1);
+        REQUIRE(e.column == 0);
+    }
+
+    SECTION("truncated input") {
+        REQUIRE(tokenizer_error("<osm version=\"0.6\">\n<node id=\"1\">\n</node>\n").error_code == XML_ERROR_NO_ELEMENTS);
+        REQUIRE(tokenizer_error("<osm version=\"0.6\">\n<node id=\"1").error_code == XML_ERROR_UNCLOSED_TOKEN);
+    }
+
+    SECTION("mismatched tag") {
+        const auto e = tokenizer_error("<osm>\n  <node>\n  </way>\n</osm>");
+        REQUIRE(e.error_code == XML_ERROR_TAG_MISMATCH);
+        REQUIRE(e.line == 3);
+        REQUIRE(e.column == 2);
+    }
+
+    SECTION("junk after document element") {
+        REQUIRE(tokenizer_error("<osm/><osm/>").error_code == XML_ERROR_JUNK_AFTER_DOC_ELEMENT);
+        REQUIRE(tokenizer_error("<osm/>junk").error_code == XML_ERROR_JUNK_AFTER_DOC_ELEMENT);
+    }
+
+    SECTION("invalid references") {
+        REQUIRE(tokenizer_error("<osm a=\"&foo;\"/>").error_code == XML_ERROR_UNDEFINED_ENTITY);
+        REQUIRE(tokenizer_error("<osm a=\"&#0;\"/>").error_code == XML_ERROR_BAD_CHAR_REF);
+        REQUIRE(tokenizer_error("<osm a=\"&#xd800;\"/>").error_code == XML_ERROR_BAD_CHAR_REF);
+        REQUIRE(tokenizer_error("<osm a=\"a & b\"/>").error_code == XML_ERROR_INVALID_TOKEN);
+    }
+
+    SECTION("invalid tags") {
+        REQUIRE(tokenizer_error("<osm a=b/>").error_code == XML_ERROR_INVALID_TOKEN);
+        REQUIRE(tokenizer_error("<osm a=\"1\"b=\"2\"/>").error_code == XML_ERROR_INVALID_TOKEN);
+        REQUIRE(tokenizer_error("<osm a=\"<\"/>").error_code == XML_ERROR_INVALID_TOKEN);
+        REQUIRE(tokenizer_error("< osm/>").error_code == XML_ERROR_INVALID_TOKEN);
+    }
+}
+
+TEST_CASE("Reader falls back to Expat for XML file in other encoding") {
+    const std::string data{
+        "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n"
+        "<osm version=\"0.6\">\n"
+        "  <node id=\"1\" version=\"1\" lat=\"1\" lon=\"2\"><tag k=\"name\" v=\"\xe4\"/></node>\n"
+        "</osm>\n"
+    };
+
+    osmium::io::Reader reader{osmium::io::File{data.data(), data.size(), "osm"}};
+    const osmium::memory::Buffer buffer = reader.read();
+    reader.close();
+
+    const auto& node = buffer.get<osmium::Node>(0);
+    REQUIRE(node.id() == 1);
+    REQUIRE(std::string{node.tags().get_value_by_key("name")} == "\xc3\xa4");
+}
@@ -0,0 +1,129 @@
+#include "catch.hpp"
+
+#include <thread>
+#include <vector>
+
+#include <osmium/builder/attr.hpp>
+#include <osmium/memory/buffer_pool.hpp>
+
+using namespace osmium::builder::attr;
+
+TEST_CASE("Buffer pool creates new buffers when empty") {
+    osmium::memory::BufferPool pool;
+    REQUIRE(pool.size() == 0);
+    REQUIRE(pool.max_size() == 32);
+
+    auto buffer = pool.get(1000);
+    REQUIRE(buffer);
+    REQUIRE(buffer.capacity() >= 1000);
+    REQUIRE(buffer.committed() == 0);
+    REQUIRE(pool.size() == 0);
+}
+
+TEST_CASE("Buffer pool reuses buffers given back") {
+    osmium::memory::BufferPool pool;
+
+    auto buffer = pool.get(1000);
+    osmium::builder::add_node(buffer, _id(1));
+    REQUIRE(buffer.committed() > 0);
+    const auto* data = buffer.data();
+
+    pool.put(std::move(buffer));
+    REQUIRE(pool.size() == 1);
+
+    SECTION("Get buffer of same size") {
+        auto buffer2 = pool.get(1000);
+        REQUIRE(buffer2.data() == data);
+        REQUIRE(buffer2.committed() == 0);
+        REQUIRE(pool.size() == 0);
+
+        // reused buffer grows automatically
+        for (int i = 0; i < 100; ++i) {
+            osmium::builder::add_node(buffer2, _id(i), _tag("some_key", "some_value"));
+        }
+        REQUIRE(buffer2.capacity() > 1000);
+    }
+
+    SECTION("Get larger buffer") {
+        auto buffer2 = pool.get(10000);
+        REQUIRE(buffer2.data() != data);
+        REQUIRE(buffer2.capacity() >= 10000);
+        REQUIRE(pool.size() == 1);
+    }
+}
+
+TEST_CASE("Buffer pool drops buffers it can not reuse") {
+    osmium::memory::BufferPool pool{2};
+
+    SECTION("Invalid buffer") {
+        pool.put(osmium::memory::Buffer{});
+        REQUIRE(pool.size() == 0);
+    }
+
+    SECTION("Externally managed buffer") {
+        alignas(8) unsigned char data[64];
+        pool.put(osmium::memory::Buffer{data, sizeof(data), 0});
+        REQUIRE(pool.size() == 0);
+    }
+
+    SECTION("Pool is full") {
+        pool.put(osmium::memory::Buffer{100});
+        pool.put(osmium::memory::Buffer{100});
+        pool.put(osmium::memory::Buffer{100});
+        REQUIRE(pool.size() == 2);
+        pool.clear();
+        REQUIRE(pool.size() == 0);
+    }
+}
+
+TEST_CASE("Buffer pool resets auto grow on buffers given back") {
+    osmium::memory::BufferPool pool;
+
+    pool.put(osmium::memory::Buffer{64, osmium::memory::Buffer::auto_grow::no});
+    auto buffer = pool.get(64);
+    REQUIRE(buffer.capacity() == 64);
+
+    for (int i = 0; i < 10; ++i) {
+        osmium::builder::add_node(buffer, _id(i));
+    }
+    REQUIRE(buffer.capacity() > 64);
+}
+
+TEST_CASE("Buffer pool handle gives buffer back automatically") {
+    osmium::memory::BufferPool pool;
+
+    {
+        auto handle = pool.wrap(pool.get(1000));
+        REQUIRE(handle);
+        osmium::builder::add_node(*handle, _id(1));
+        REQUIRE(pool.size() == 0);
+    }
+    REQUIRE(pool.size() == 1);
+
+    {
+        auto handle = pool.wrap(osmium::memory::Buffer{});
+        REQUIRE_FALSE(handle);
+    }
+    REQUIRE(pool.size() == 1);
+}
+
+TEST_CASE("Buffer pool can be used from several threads") {
+    osmium::memory::BufferPool pool{8};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pool](){
+            for (int i = 0; i < 1000; ++i) {
+                auto buffer = pool.get(1000);
+                osmium::builder::add_node(buffer, _id(i));
+                pool.put(std::move(buffer));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(pool.size() > 0);
+    REQUIRE(pool.size() <= 4);
+}
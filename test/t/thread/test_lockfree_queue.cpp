@@ -0,0 +1,130 @@
+#include "catch.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <osmium/thread/lockfree_queue.hpp>
+
+TEST_CASE("Lock-free queue capacity is rounded up to power of two") {
+    REQUIRE(osmium::thread::detail::ring_capacity(0) == 2);
+    REQUIRE(osmium::thread::detail::ring_capacity(2) == 2);
+    REQUIRE(osmium::thread::detail::ring_capacity(3) == 4);
+    REQUIRE(osmium::thread::detail::ring_capacity(20) == 32);
+    REQUIRE(osmium::thread::detail::ring_capacity(1024) == 1024);
+}
+
+template <typename TQueue>
+void check_single_thread() {
+    TQueue queue{4};
+    REQUIRE(queue.empty());
+    REQUIRE(queue.size() == 0);
+
+    std::string value;
+    REQUIRE_FALSE(queue.try_pop(value));
+
+    for (int i = 0; i < 4; ++i) {
+        queue.push(std::to_string(i));
+    }
+    REQUIRE(queue.size() == 4);
+    REQUIRE_FALSE(queue.empty());
+
+    queue.wait_and_pop(value);
+    REQUIRE(value == "0");
+    REQUIRE(queue.try_pop(value));
+    REQUIRE(value == "1");
+
+    // wrap around the end of the ring
+    queue.push("4");
+    queue.push("5");
+    for (int i = 2; i < 6; ++i) {
+        queue.wait_and_pop(value);
+        REQUIRE(value == std::to_string(i));
+    }
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("SPSC queue in single thread") {
+    check_single_thread<osmium::thread::SPSCQueue<std::string>>();
+}
+
+TEST_CASE("MPMC queue in single thread") {
+    check_single_thread<osmium::thread::MPMCQueue<std::string>>();
+}
+
+TEST_CASE("Lock-free queue with move-only type") {
+    osmium::thread::SPSCQueue<std::unique_ptr<int>> queue{2};
+    queue.push(std::unique_ptr<int>{new int{17}});
+
+    std::unique_ptr<int> value;
+    queue.wait_and_pop(value);
+    REQUIRE(value);
+    REQUIRE(*value == 17);
+}
+
+TEST_CASE("SPSC queue with producer and consumer threads") {
+    constexpr const int num = 100000;
+    osmium::thread::SPSCQueue<int> queue{8};
+
+    std::thread producer{[&queue]() {
+        for (int i = 0; i < num; ++i) {
+            queue.push(i);
+        }
+    }};
+
+    bool in_order = true;
+    for (int i = 0; i < num; ++i) {
+        int value = -1;
+        queue.wait_and_pop(value);
+        if (value != i) {
+            in_order = false;
+        }
+    }
+    producer.join();
+
+    REQUIRE(in_order);
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("MPMC queue with several producer and consumer threads") {
+    constexpr const int num_threads = 4;
+    constexpr const int num = 20000;
+    osmium::thread::MPMCQueue<int> queue{16};
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < num_threads; ++t) {
+        producers.emplace_back([&queue]() {
+            for (int i = 1; i <= num; ++i) {
+                queue.push(i);
+            }
+        });
+    }
+
+    std::vector<long long> sums(num_threads, 0);
+    std::vector<std::thread> consumers;
+    for (int t = 0; t < num_threads; ++t) {
+        consumers.emplace_back([&queue, &sums, t]() {
+            for (int i = 0; i < num; ++i) {
+                int value = 0;
+                queue.wait_and_pop(value);
+                sums[std::size_t(t)] += value;
+            }
+        });
+    }
+
+    for (auto& thread : producers) {
+        thread.join();
+    }
+    for (auto& thread : consumers) {
+        thread.join();
+    }
+
+    long long sum = 0;
+    for (const auto s : sums) {
+        sum += s;
+    }
+    REQUIRE(sum == static_cast<long long>(num_threads) * num * (num + 1) / 2);
+    REQUIRE(queue.empty());
+}
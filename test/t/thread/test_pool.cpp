@@ -1,8 +1,11 @@
 #include "catch.hpp"
 
 #include <chrono>
+#include <functional>
+#include <future>
 #include <stdexcept>
 #include <thread>
+#include <vector>
 
 #include <osmium/thread/pool.hpp>
 #include <osmium/util/compatibility.hpp>
@@ -48,6 +51,19 @@ TEST_CASE("number of threads in pool") {
 
 }
 
+TEST_CASE("number of threads in pool on large machines") {
+    REQUIRE(osmium::thread::detail::get_pool_size(  64, 0, 96) == 64);
+    REQUIRE(osmium::thread::detail::get_pool_size(1000, 0, 96) == 96);
+    REQUIRE(osmium::thread::detail::get_pool_size(   0, 0, 96) == 94);
+}
+
+TEST_CASE("pool affinity setting") {
+    REQUIRE(osmium::thread::detail::get_pool_affinity(nullptr) == osmium::thread::pool_affinity::none);
+    REQUIRE(osmium::thread::detail::get_pool_affinity("") == osmium::thread::pool_affinity::none);
+    REQUIRE(osmium::thread::detail::get_pool_affinity("compact") == osmium::thread::pool_affinity::compact);
+    REQUIRE(osmium::thread::detail::get_pool_affinity("spread") == osmium::thread::pool_affinity::spread);
+}
+
 TEST_CASE("if zero number of threads requested, threads configured") {
     osmium::thread::Pool pool{0};
     REQUIRE(pool.num_threads() > 0);
@@ -116,3 +132,67 @@ TEST_CASE("thread (user-provided pool)") {
 
 }
 
+TEST_CASE("pool with small queue runs all jobs") {
+    osmium::thread::Pool pool{4, 2};
+
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 1000; ++i) {
+        futures.push_back(pool.submit([i]() { return i; }));
+    }
+
+    int sum = 0;
+    for (auto& future : futures) {
+        sum += future.get();
+    }
+    REQUIRE(sum == 999 * 1000 / 2);
+}
+
+TEST_CASE("can submit batch of jobs to pool") {
+    osmium::thread::Pool pool{3};
+
+    std::vector<std::function<int()>> jobs;
+    for (int i = 0; i < 100; ++i) {
+        jobs.emplace_back([i]() { return i * 2; });
+    }
+
+    auto futures = pool.submit_batch(jobs.begin(), jobs.end());
+    REQUIRE(futures.size() == 100);
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(futures[std::size_t(i)].get() == i * 2);
+    }
+
+    REQUIRE(pool.submit_batch(jobs.end(), jobs.end()).empty());
+}
+
+TEST_CASE("can submit jobs to pool from pool thread") {
+    osmium::thread::Pool pool{2, 2};
+
+    auto future = pool.submit([&pool]() {
+        std::vector<std::future<int>> futures;
+        for (int i = 0; i < 10; ++i) {
+            futures.push_back(pool.submit(test_job_with_result{}));
+        }
+        int sum = 0;
+        for (auto& f : futures) {
+            sum += f.get();
+        }
+        return sum;
+    });
+
+    REQUIRE(future.get() == 420);
+}
+
+TEST_CASE("pool threads can be pinned to CPUs") {
+    osmium::thread::Pool pool{2, 0, osmium::thread::pool_affinity::compact};
+
+    auto future = pool.submit(test_job_with_result{});
+    REQUIRE(future.get() == 42);
+
+#ifdef __linux__
+    REQUIRE(pool.thread_cpu(0) >= 0);
+#endif
+
+    osmium::thread::Pool unpinned{2, 0, osmium::thread::pool_affinity::none};
+    REQUIRE(unpinned.thread_cpu(0) == -1);
+    REQUIRE(unpinned.thread_cpu(1) == -1);
+}
@@ -2,6 +2,7 @@
 
 #include <stdexcept>
 #include <type_traits>
+#include <vector>
 
 #include <osmium/thread/util.hpp>
 
@@ -58,3 +59,17 @@ TEST_CASE("valid thread_handler") {
     REQUIRE(foo == 5);
 }
 
+
+TEST_CASE("parse list of CPUs") {
+    using osmium::thread::detail::parse_cpu_list;
+    REQUIRE(parse_cpu_list("").empty());
+    REQUIRE(parse_cpu_list("0") == std::vector<int>({0}));
+    REQUIRE(parse_cpu_list("0-3\n") == std::vector<int>({0, 1, 2, 3}));
+    REQUIRE(parse_cpu_list("0-1,8,10-11") == std::vector<int>({0, 1, 8, 10, 11}));
+    REQUIRE(parse_cpu_list("2,x") == std::vector<int>({2}));
+}
+
+TEST_CASE("get CPUs grouped by NUMA node") {
+    const auto nodes = osmium::thread::get_numa_node_cpus();
+    REQUIRE_FALSE(nodes.empty());
+}
@@ -58,6 +58,96 @@ TEST_CASE("use_pool_threads_for_pbf_parsing") {
     REQUIRE(osmium::config::use_pool_threads_for_pbf_parsing());
 }
 
+TEST_CASE("use_pool_threads_for_opl_parsing") {
+    env = nullptr;
+    REQUIRE(osmium::config::use_pool_threads_for_opl_parsing());
+    REQUIRE(name == "OSMIUM_USE_POOL_THREADS_FOR_OPL_PARSING");
+
+    env = "off";
+    REQUIRE_FALSE(osmium::config::use_pool_threads_for_opl_parsing());
+
+    env = "on";
+    REQUIRE(osmium::config::use_pool_threads_for_opl_parsing());
+}
+
+TEST_CASE("use_pool_threads_for_o5m_parsing") {
+    env = nullptr;
+    REQUIRE(osmium::config::use_pool_threads_for_o5m_parsing());
+    REQUIRE(name == "OSMIUM_USE_POOL_THREADS_FOR_O5M_PARSING");
+
+    env = "false";
+    REQUIRE_FALSE(osmium::config::use_pool_threads_for_o5m_parsing());
+
+    env = "true";
+    REQUIRE(osmium::config::use_pool_threads_for_o5m_parsing());
+}
+
+TEST_CASE("use_pool_threads_for_compression") {
+    env = nullptr;
+    REQUIRE(osmium::config::use_pool_threads_for_compression());
+    REQUIRE(name == "OSMIUM_USE_POOL_THREADS_FOR_COMPRESSION");
+
+    env = "false";
+    REQUIRE_FALSE(osmium::config::use_pool_threads_for_compression());
+
+    env = "true";
+    REQUIRE(osmium::config::use_pool_threads_for_compression());
+}
+
+TEST_CASE("use_pool_threads_for_decompression") {
+    env = nullptr;
+    REQUIRE(osmium::config::use_pool_threads_for_decompression());
+    REQUIRE(name == "OSMIUM_USE_POOL_THREADS_FOR_DECOMPRESSION");
+
+    env = "false";
+    REQUIRE_FALSE(osmium::config::use_pool_threads_for_decompression());
+
+    env = "true";
+    REQUIRE(osmium::config::use_pool_threads_for_decompression());
+}
+
+TEST_CASE("use_pool_threads_for_xml_parsing") {
+    env = nullptr;
+    REQUIRE(osmium::config::use_pool_threads_for_xml_parsing());
+    REQUIRE(name == "OSMIUM_USE_POOL_THREADS_FOR_XML_PARSING");
+
+    env = "false";
+    REQUIRE_FALSE(osmium::config::use_pool_threads_for_xml_parsing());
+
+    env = "true";
+    REQUIRE(osmium::config::use_pool_threads_for_xml_parsing());
+}
+
+TEST_CASE("use_xml_tokenizer") {
+    env = nullptr;
+    REQUIRE(osmium::config::use_xml_tokenizer());
+    REQUIRE(name == "OSMIUM_USE_XML_TOKENIZER");
+
+    env = "false";
+    REQUIRE_FALSE(osmium::config::use_xml_tokenizer());
+
+    env = "true";
+    REQUIRE(osmium::config::use_xml_tokenizer());
+}
+
+TEST_CASE("use_mmap_for_reading") {
+    env = nullptr;
+    REQUIRE(osmium::config::use_mmap_for_reading());
+    REQUIRE(name == "OSMIUM_USE_MMAP_FOR_READING");
+    env = "";
+    REQUIRE(osmium::config::use_mmap_for_reading());
+
+    env = "off";
+    REQUIRE_FALSE(osmium::config::use_mmap_for_reading());
+    env = "no";
+    REQUIRE_FALSE(osmium::config::use_mmap_for_reading());
+
+    env = "on";
+    REQUIRE(osmium::config::use_mmap_for_reading());
+    env = "1";
+    REQUIRE(osmium::config::use_mmap_for_reading());
+}
+
 TEST_CASE("get_max_queue_size") {
     env = nullptr;
     REQUIRE(osmium::config::get_max_queue_size("NAME", 0) == 0);
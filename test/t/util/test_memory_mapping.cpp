@@ -146,6 +146,32 @@ TEST_CASE("File-based mapping: writing to a mapped file should work") {
     REQUIRE(0 == unlink(filename));
 }
 
+TEST_CASE("File-based mapping: telling the system which pages will be needed should work") {
+    char filename[] = "test_mmap_will_need_XXXXXX";
+    const int fd = mkstemp(filename);
+    REQUIRE(fd > 0);
+
+    const std::size_t size = 10 * osmium::util::get_pagesize();
+    osmium::util::resize_file(fd, size);
+
+    {
+        osmium::util::MemoryMapping mapping{size, osmium::util::MemoryMapping::mapping_mode::write_shared, fd};
+        mapping.get_addr<char>()[size - 1] = 'x';
+
+        // Ranges not starting on a page boundary and ranges outside the
+        // mapping are okay.
+        mapping.will_need(0, size);
+        mapping.will_need(17, 100);
+        mapping.will_need(size - 10, 1000);
+        mapping.will_need(size + 10, 1000);
+
+        REQUIRE(mapping.get_addr<char>()[size - 1] == 'x');
+    }
+
+    REQUIRE(0 == close(fd));
+    REQUIRE(0 == unlink(filename));
+}
+
 TEST_CASE("File-based mapping: Reading from a zero-sized mapped file should work") {
     char filename[] = "test_mmap_read_zero_XXXXXX";
     const int fd = mkstemp(filename);
@@ -408,3 +434,127 @@ TEST_CASE("Anonymous memory mapping class: remapping to smaller size should work
 }
 #endif
 
+TEST_CASE("Anonymous mapping options: parsing environment values") {
+    using osmium::util::huge_pages;
+    using osmium::util::numa_policy;
+
+    REQUIRE(osmium::util::detail::get_huge_pages(nullptr) == huge_pages::none);
+    REQUIRE(osmium::util::detail::get_huge_pages("") == huge_pages::none);
+    REQUIRE(osmium::util::detail::get_huge_pages("foo") == huge_pages::none);
+    REQUIRE(osmium::util::detail::get_huge_pages("transparent") == huge_pages::transparent);
+    REQUIRE(osmium::util::detail::get_huge_pages("hugetlb") == huge_pages::hugetlb);
+
+    int node = -1;
+    REQUIRE(osmium::util::detail::get_numa_policy(nullptr, &node) == numa_policy::none);
+    REQUIRE(osmium::util::detail::get_numa_policy("bind", &node) == numa_policy::none);
+    REQUIRE(osmium::util::detail::get_numa_policy("bind:", &node) == numa_policy::none);
+    REQUIRE(node == -1);
+    REQUIRE(osmium::util::detail::get_numa_policy("interleave", &node) == numa_policy::interleave);
+    REQUIRE(osmium::util::detail::get_numa_policy("bind:3", &node) == numa_policy::bind);
+    REQUIRE(node == 3);
+}
+
+TEST_CASE("Anonymous mapping options: huge page size is a multiple of the page size") {
+    REQUIRE(osmium::util::get_huge_page_size() > 0);
+    REQUIRE(osmium::util::get_huge_page_size() % osmium::util::get_pagesize() == 0);
+}
+
+#ifdef __linux__
+static void check_mapping_with_options(const osmium::util::anonymous_mapping_options& options) {
+    const std::size_t size = 8 * 1024 * 1024;
+    osmium::util::AnonymousTypedMemoryMapping<int> mapping{size / sizeof(int), options};
+    REQUIRE(mapping.size() == size / sizeof(int));
+    REQUIRE(mapping.options().numa == options.numa);
+
+    int* addr = mapping.begin();
+    for (std::size_t i = 0; i < mapping.size(); ++i) {
+        addr[i] = static_cast<int>(i);
+    }
+    REQUIRE(mapping.huge_page_bytes() <= osmium::util::get_huge_page_size() * (size / osmium::util::get_huge_page_size() + 1));
+
+    mapping.resize(size / sizeof(int) * 2);
+    addr = mapping.begin();
+    for (std::size_t i = 0; i < size / sizeof(int); ++i) {
+        REQUIRE(addr[i] == static_cast<int>(i));
+    }
+    addr[mapping.size() - 1] = 42;
+
+    mapping.resize(1000);
+    REQUIRE(mapping.begin()[999] == 999);
+}
+
+TEST_CASE("Anonymous mapping with options: normal pages") {
+    osmium::util::anonymous_mapping_options options;
+    check_mapping_with_options(options);
+
+    // The kernel can merge this mapping with neighbouring mappings
+    // which use transparent huge pages.
+    osmium::util::MemoryMapping mapping{1000, options};
+    REQUIRE(mapping.huge_page_bytes() <= mapping.size());
+}
+
+TEST_CASE("Anonymous mapping with options: transparent huge pages") {
+    osmium::util::anonymous_mapping_options options;
+    options.pages = osmium::util::huge_pages::transparent;
+    check_mapping_with_options(options);
+}
+
+TEST_CASE("Anonymous mapping with options: huge pages from pool or fallback") {
+    osmium::util::anonymous_mapping_options options;
+    options.pages = osmium::util::huge_pages::hugetlb;
+    check_mapping_with_options(options);
+
+    // Falls back to transparent huge pages if the pool is empty.
+    osmium::util::AnonymousMemoryMapping mapping{1000, options};
+    REQUIRE(mapping.options().pages != osmium::util::huge_pages::none);
+    if (mapping.options().pages == osmium::util::huge_pages::hugetlb) {
+        REQUIRE(mapping.huge_page_bytes() == osmium::util::get_huge_page_size());
+    }
+}
+
+TEST_CASE("Anonymous mapping with options: growing in small steps keeps the data") {
+    osmium::util::anonymous_mapping_options options;
+    options.pages = osmium::util::huge_pages::hugetlb;
+
+    osmium::util::AnonymousTypedMemoryMapping<int> mapping{1000, options};
+    for (std::size_t i = 0; i < mapping.size(); ++i) {
+        mapping.begin()[i] = static_cast<int>(i);
+    }
+    for (std::size_t size = 2000; size <= 2 * 1024 * 1024; size += 100000) {
+        const std::size_t old_size = mapping.size();
+        mapping.resize(size);
+        REQUIRE(mapping.size() == size);
+        for (std::size_t i = old_size; i < size; ++i) {
+            mapping.begin()[i] = static_cast<int>(i);
+        }
+    }
+    std::size_t wrong = 0;
+    for (std::size_t i = 0; i < mapping.size(); ++i) {
+        if (mapping.begin()[i] != static_cast<int>(i)) {
+            ++wrong;
+        }
+    }
+    REQUIRE(wrong == 0);
+}
+
+TEST_CASE("Anonymous mapping with options: NUMA policies") {
+    osmium::util::anonymous_mapping_options options;
+
+    SECTION("interleave") {
+        options.numa = osmium::util::numa_policy::interleave;
+        check_mapping_with_options(options);
+    }
+
+    SECTION("bind") {
+        options.numa = osmium::util::numa_policy::bind;
+        options.numa_node = 0;
+        check_mapping_with_options(options);
+    }
+
+    SECTION("bind to node that doesn't exist") {
+        options.numa = osmium::util::numa_policy::bind;
+        options.numa_node = 1000;
+        check_mapping_with_options(options);
+    }
+}
+#endif